@@ -0,0 +1,62 @@
+// Fuzzer implementation that feeds JSON text to JsonReader and to the MQTT JSON downlink decoder.
+#include <cassert>
+#include <cstring>
+
+#include "mesh/MeshTypes.h"
+#include "mqtt/JsonDownlink.h"
+#include "serialization/JsonReader.h"
+
+namespace
+{
+constexpr NodeNum nodeId = 0x12345678;
+
+// Walk every token, exercising the accessors on each, and check the reader keeps its own limits.
+void walkTokens(const char *json, size_t length)
+{
+    JsonReader reader(json, length);
+    char text[64];
+    while (true) {
+        JsonToken token = reader.next();
+        assert(reader.getDepth() <= JSON_READER_MAX_DEPTH);
+        if (token == JSON_END || token == JSON_ERROR) {
+            assert(token == JSON_END || reader.getError() != JsonReader::NO_ERROR);
+            assert(reader.getErrorOffset() <= length);
+            break;
+        }
+        if (token == JSON_KEY || token == JSON_STRING) {
+            assert(reader.getText() >= json && reader.getText() + reader.getTextLength() <= json + length);
+            size_t n = reader.copyString(text, sizeof(text));
+            assert(n >= sizeof(text) || text[n] == 0);
+            reader.keyIs("payload");
+        } else if (token == JSON_NUMBER) {
+            assert(reader.getTextLength() <= JSON_READER_MAX_NUMBER);
+            (void)reader.getNumber();
+        }
+    }
+    // Once finished, the reader stays finished
+    JsonToken last = reader.next();
+    assert(last == JSON_END || last == JSON_ERROR);
+}
+} // namespace
+
+extern "C" {
+// The bytes are the JSON text as it would arrive on the MQTT json downlink topic. They are copied so that reading even one
+// byte past the end is caught by the sanitizers; the reader must not need a NUL terminator.
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t length)
+{
+    char *json = new char[length ? length : 1];
+    memcpy(json, data, length);
+
+    walkTokens(json, length);
+
+    meshtastic_MeshPacket p = meshtastic_MeshPacket_init_default;
+    JsonDownlinkResult result = decodeJsonDownlink(json, length, nodeId, "!12345678", 8, p);
+    if (result == JSON_DOWNLINK_OK) {
+        assert(p.decoded.payload.size <= sizeof(p.decoded.payload.bytes));
+        assert(p.channel < 8);
+    }
+
+    delete[] json;
+    return 0;
+}
+}
@@ -0,0 +1,52 @@
+"""Generate an initial set of MQTT JSON downlink envelopes.
+
+The fuzzer uses these as an initial seed of test candidates. The node number
+matches the one json_reader_fuzzer.cpp decodes for, so the seeds reach the
+payload decoding instead of stopping at the envelope check.
+
+It's also good to add any previously discovered crash test cases to this list
+to avoid future regressions.
+"""
+
+import json
+
+NODE_ID = 0x12345678
+
+envelopes = (
+    (
+        "sendtext",
+        {"from": NODE_ID, "type": "sendtext", "payload": "hello mesh"},
+    ),
+    (
+        "sendtext_full",
+        {
+            "from": NODE_ID,
+            "to": 4294967295,
+            "channel": 1,
+            "hopLimit": 3,
+            "type": "sendtext",
+            "payload": "café ☃ \U0001f4e1 \"quoted\"\n",
+            "sender": "!abcdef01",
+        },
+    ),
+    (
+        "sendposition",
+        {
+            "from": NODE_ID,
+            "type": "sendposition",
+            "payload": {"latitude_i": 523456789, "longitude_i": -41234567, "altitude": 120, "time": 1700000000},
+        },
+    ),
+    (
+        "unsupported",
+        {"from": NODE_ID, "type": "sendtelemetry", "payload": [1, 2.5, -3e2, True, False, None]},
+    ),
+)
+
+for name, envelope in envelopes:
+    with open(f"{name}.json", "w") as f:
+        json.dump(envelope, f)
+
+# Escapes as they are written by hand rather than by json.dump
+with open("escapes.json", "w") as f:
+    f.write('{"from":305419896,"type":"sendtext","payload":"\\ud83d\\udce1\\u0041\\/\\t\\\\"}')
@@ -0,0 +1,172 @@
+#!/usr/bin/env python3
+"""Drive many concurrent TCP API clients against a running meshtasticd.
+
+Every client connects to the API port, does want_config and waits for
+config_complete_id. Then each client sends one text message with want_ack,
+addressed to the node itself. The node acks each message with a routing
+packet from itself to itself, and that packet is fanned out to every
+connected client. Packets that came from a client are never echoed back, so
+the acks are what the clients can observe. The test passes when each client
+receives the ack for every client's message.
+
+    .pio/build/native/program &
+    bin/api-load-test.py --clients 8
+
+Needs the meshtastic python package for the protobufs. Keep --clients at or
+below MAX_API_CLIENTS (8 on portduino). More clients than that evict the
+least recently active session, and the test reports those clients as failed.
+"""
+
+import argparse
+import random
+import socket
+import statistics
+import struct
+import sys
+import threading
+import time
+
+from meshtastic.protobuf import mesh_pb2, portnums_pb2
+
+START1 = 0x94
+START2 = 0xC3
+MAX_FRAME = 512
+
+
+class Client:
+    def __init__(self, index, host, port):
+        self.index = index
+        self.sock = socket.create_connection((host, port), timeout=5)
+        self.sock.settimeout(None)
+        self.buf = b""
+        self.lock = threading.Lock()
+        self.configured = threading.Event()
+        self.my_node_num = None
+        self.config_id = random.randint(1, 0xFFFFFFFF)
+        self.config_msec = None
+        self.received = {}  # request_id of a routing ack -> arrival time
+        self.error = None
+
+    def send(self, to_radio):
+        data = to_radio.SerializeToString()
+        self.sock.sendall(bytes([START1, START2]) + struct.pack(">H", len(data)) + data)
+
+    def frames(self):
+        """Yield FromRadio messages, skipping the debug log text mixed into the stream."""
+        while True:
+            while len(self.buf) >= 4:
+                if self.buf[0] != START1 or self.buf[1] != START2:
+                    self.buf = self.buf[1:]
+                    continue
+                (length,) = struct.unpack(">H", self.buf[2:4])
+                if length > MAX_FRAME:
+                    self.buf = self.buf[1:]
+                    continue
+                if len(self.buf) < 4 + length:
+                    break
+                frame, self.buf = self.buf[4 : 4 + length], self.buf[4 + length :]
+                msg = mesh_pb2.FromRadio()
+                msg.ParseFromString(frame)
+                yield msg
+            chunk = self.sock.recv(4096)
+            if not chunk:
+                return
+            self.buf += chunk
+
+    def run(self):
+        start = time.monotonic()
+        try:
+            self.send(mesh_pb2.ToRadio(want_config_id=self.config_id))
+            for msg in self.frames():
+                field = msg.WhichOneof("payload_variant")
+                if field == "my_info":
+                    self.my_node_num = msg.my_info.my_node_num
+                elif field == "config_complete_id" and msg.config_complete_id == self.config_id:
+                    self.config_msec = (time.monotonic() - start) * 1000
+                    self.configured.set()
+                elif field == "packet" and msg.packet.decoded.portnum == portnums_pb2.ROUTING_APP:
+                    with self.lock:
+                        self.received.setdefault(msg.packet.decoded.request_id, time.monotonic())
+        except OSError as e:
+            self.error = str(e)
+        finally:
+            self.configured.set()
+
+    def send_text(self, packet_id, text):
+        packet = mesh_pb2.MeshPacket()
+        packet.to = self.my_node_num
+        packet.id = packet_id
+        packet.want_ack = True
+        packet.decoded.portnum = portnums_pb2.TEXT_MESSAGE_APP
+        packet.decoded.payload = text.encode()
+        self.send(mesh_pb2.ToRadio(packet=packet))
+
+    def close(self):
+        try:
+            self.sock.shutdown(socket.SHUT_RDWR)
+        except OSError:
+            pass
+        self.sock.close()
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--host", default="localhost")
+    parser.add_argument("--port", type=int, default=4403)
+    parser.add_argument("--clients", type=int, default=8)
+    parser.add_argument("--timeout", type=float, default=30, help="seconds to wait for config and for the fanout")
+    args = parser.parse_args()
+
+    clients = [Client(i, args.host, args.port) for i in range(args.clients)]
+    threads = [threading.Thread(target=c.run, daemon=True) for c in clients]
+    for t in threads:
+        t.start()
+
+    deadline = time.monotonic() + args.timeout
+    for c in clients:
+        c.configured.wait(max(0, deadline - time.monotonic()))
+    failed = [c for c in clients if c.config_msec is None or c.my_node_num is None]
+    for c in failed:
+        print(f"client {c.index}: want_config did not complete ({c.error or 'timeout'})")
+    if failed:
+        return 1
+    config_times = [c.config_msec for c in clients]
+    print(
+        f"{len(clients)} clients configured: median {statistics.median(config_times):.0f} ms, "
+        f"max {max(config_times):.0f} ms"
+    )
+
+    ids = random.sample(range(1, 0xFFFFFFFF), len(clients))
+    sent = time.monotonic()
+    for c, packet_id in zip(clients, ids):
+        c.send_text(packet_id, f"api-load-test client {c.index}")
+
+    deadline = time.monotonic() + args.timeout
+    while time.monotonic() < deadline:
+        if all(all(i in c.received for i in ids) for c in clients):
+            break
+        time.sleep(0.05)
+
+    ok = True
+    latencies = []
+    for c in clients:
+        with c.lock:
+            missing = [i for i in ids if i not in c.received]
+            latencies += [(c.received[i] - sent) * 1000 for i in ids if i in c.received]
+        if missing:
+            ok = False
+            print(f"client {c.index}: missed {len(missing)} of {len(ids)} acks ({c.error or 'timeout'})")
+    if latencies:
+        print(
+            f"fanout: {len(latencies)} of {len(ids) * len(clients)} deliveries, "
+            f"median {statistics.median(latencies):.0f} ms, max {max(latencies):.0f} ms"
+        )
+
+    for c in clients:
+        c.close()
+    print("PASS" if ok else "FAIL")
+    return 0 if ok else 1
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,199 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Airtime used in the last N * BUCKET_MSEC milliseconds.
+ *
+ * A ring of buckets plus a running total, so adding airtime and reading the total are O(1) no matter how long the window is.
+ * The buckets move along lazily, with the msec time passed to each call, so nothing has to tick them.  Times only need to
+ * increase modulo 2^32, which keeps this working when millis() wraps.
+ *
+ * T must be able to hold BUCKET_MSEC, a bucket saturates instead of wrapping when overlapping receptions overfill it.
+ */
+template <typename T, uint16_t N, uint32_t BUCKET_MSEC> class AirtimeWindow
+{
+    static_assert(N >= 2, "need at least two buckets");
+    static_assert(BUCKET_MSEC > 0 && BUCKET_MSEC <= (T)~(T)0, "bucket type too small for BUCKET_MSEC");
+
+    T buckets[N] = {};
+    uint32_t total = 0;
+    uint16_t head = 0;      // Index of the bucket for the current time
+    uint32_t headStart = 0; // msec time the head bucket started at
+    bool started = false;
+
+    void put(uint16_t index, uint32_t msec)
+    {
+        uint32_t room = (T)~(T)0 - buckets[index];
+        if (msec > room)
+            msec = room;
+        buckets[index] += msec;
+        total += msec;
+    }
+
+  public:
+    static constexpr uint32_t windowMsec = (uint32_t)N * BUCKET_MSEC;
+    static constexpr uint32_t bucketMsec = BUCKET_MSEC;
+
+    /// Drop the buckets that are older than the window at nowMsec
+    void advance(uint32_t nowMsec)
+    {
+        if (!started) {
+            started = true;
+            headStart = nowMsec - nowMsec % BUCKET_MSEC;
+            return;
+        }
+        uint32_t steps = (nowMsec - headStart) / BUCKET_MSEC;
+        if (!steps)
+            return;
+        if (steps >= N) {
+            clear();
+            started = true;
+        } else {
+            for (uint32_t i = 0; i < steps; i++) {
+                head = (head + 1) % N;
+                total -= buckets[head];
+                buckets[head] = 0;
+            }
+        }
+        headStart += steps * BUCKET_MSEC;
+    }
+
+    /// Count msec of airtime that ended at nowMsec, spread over the buckets it overlapped
+    void add(uint32_t nowMsec, uint32_t msec)
+    {
+        advance(nowMsec);
+        uint32_t inBucket = nowMsec - headStart;
+        uint16_t index = head;
+        for (uint16_t age = 0; msec && age < N; age++) {
+            uint32_t part = msec < inBucket ? msec : inBucket;
+            put(index, part);
+            msec -= part;
+            index = (index + N - 1) % N;
+            inBucket = BUCKET_MSEC;
+        }
+    }
+
+    /// Airtime within the window at nowMsec
+    uint32_t sum(uint32_t nowMsec)
+    {
+        advance(nowMsec);
+        return total;
+    }
+
+    /// msec from nowMsec until the airtime in the window drops to limitMsec or below, if nothing more is added
+    uint32_t msecUntilAtMost(uint32_t nowMsec, uint32_t limitMsec)
+    {
+        advance(nowMsec);
+        uint32_t left = total;
+        if (left <= limitMsec)
+            return 0;
+        // The bucket of age k leaves the window N - k buckets after headStart
+        for (uint16_t age = N - 1; age > 0; age--) {
+            left -= buckets[(head + N - age) % N];
+            if (left <= limitMsec)
+                return headStart + (uint32_t)(N - age) * BUCKET_MSEC - nowMsec;
+        }
+        return headStart + windowMsec - nowMsec;
+    }
+
+    void clear()
+    {
+        for (uint16_t i = 0; i < N; i++)
+            buckets[i] = 0;
+        total = 0;
+        head = 0;
+        started = false;
+    }
+};
+
+/// Airtime of one key (a NodeNum or a portnum), see AirtimeTally::getTop()
+struct AirtimeShare {
+    uint32_t key;
+    uint32_t msec;
+};
+
+/**
+ * Airtime per key over the last hour, for the N keys using the most of it.
+ *
+ * When the table is full a new key replaces the one with the least airtime, so busy keys stay tracked while keys that went
+ * quiet age out.
+ */
+template <uint8_t N> class AirtimeTally
+{
+  public:
+    typedef AirtimeWindow<uint32_t, 12, 5 * 60 * 1000> Window;
+
+  private:
+    struct Entry {
+        uint32_t key;
+        bool used;
+        Window window;
+    };
+    Entry entries[N] = {};
+
+  public:
+    void add(uint32_t nowMsec, uint32_t key, uint32_t msec)
+    {
+        Entry *slot = NULL, *quietest = NULL;
+        uint32_t quietestMsec = UINT32_MAX;
+        for (uint8_t i = 0; i < N && !slot; i++) {
+            Entry &e = entries[i];
+            if (e.used && e.key == key) {
+                slot = &e;
+            } else if (!e.used) {
+                quietest = &e;
+                quietestMsec = 0;
+            } else if (quietestMsec) {
+                uint32_t used = e.window.sum(nowMsec);
+                if (used < quietestMsec) {
+                    quietest = &e;
+                    quietestMsec = used;
+                }
+            }
+        }
+        if (!slot) {
+            slot = quietest;
+            slot->window.clear();
+            slot->key = key;
+            slot->used = true;
+        }
+        slot->window.add(nowMsec, msec);
+    }
+
+    /// Airtime of key in the window, 0 if it isn't tracked
+    uint32_t get(uint32_t nowMsec, uint32_t key)
+    {
+        for (uint8_t i = 0; i < N; i++)
+            if (entries[i].used && entries[i].key == key)
+                return entries[i].window.sum(nowMsec);
+        return 0;
+    }
+
+    /// Fill out with up to max keys that used airtime in the window, most first.  @return how many were filled
+    size_t getTop(uint32_t nowMsec, AirtimeShare *out, size_t max)
+    {
+        size_t count = 0;
+        for (uint8_t i = 0; i < N; i++) {
+            if (!entries[i].used)
+                continue;
+            AirtimeShare share = {entries[i].key, entries[i].window.sum(nowMsec)};
+            if (!share.msec)
+                continue;
+            // Insertion sort, N is small
+            size_t pos = count < max ? count : max;
+            while (pos > 0 && out[pos - 1].msec < share.msec) {
+                if (pos < max)
+                    out[pos] = out[pos - 1];
+                pos--;
+            }
+            if (pos < max) {
+                out[pos] = share;
+                if (count < max)
+                    count++;
+            }
+        }
+        return count;
+    }
+};
@@ -11,13 +11,14 @@ uint32_t air_period_rx[PERIODS_TO_LOG];
 
 void AirTime::logAirtime(reportTypes reportType, uint32_t airtime_ms)
 {
+    uint32_t now = millis();
 
     if (reportType == TX_LOG) {
         LOG_DEBUG("Packet TX: %ums", airtime_ms);
         this->airtimes.periodTX[0] = this->airtimes.periodTX[0] + airtime_ms;
         air_period_tx[0] = air_period_tx[0] + airtime_ms;
 
-        this->utilizationTX[this->getPeriodUtilHour()] = this->utilizationTX[this->getPeriodUtilHour()] + airtime_ms;
+        txWindow.add(now, airtime_ms);
     } else if (reportType == RX_LOG) {
         LOG_DEBUG("Packet RX: %ums", airtime_ms);
         this->airtimes.periodRX[0] = this->airtimes.periodRX[0] + airtime_ms;
@@ -28,22 +29,73 @@ void AirTime::logAirtime(reportTypes reportType, uint32_t airtime_ms)
     }
 
     // Log all airtime type for channel utilization
-    this->channelUtilization[this->getPeriodUtilMinute()] = channelUtilization[this->getPeriodUtilMinute()] + airtime_ms;
+    channelWindow.add(now, airtime_ms);
 }
 
-uint8_t AirTime::currentPeriodIndex()
+void AirTime::logAirtime(reportTypes reportType, uint32_t airtime_ms, const meshtastic_MeshPacket *p)
 {
-    return ((getSecondsSinceBoot() / SECONDS_PER_PERIOD) % PERIODS_TO_LOG);
+    logAirtime(reportType, airtime_ms);
+
+    uint32_t now = millis();
+    NodeNum from = getFrom(p);
+    nodeTally.add(now, from, airtime_ms);
+
+    RecentPacket *recent = findRecentPacket(from, p->id);
+    if (!recent && p->which_payload_variant == meshtastic_MeshPacket_decoded_tag) {
+        recent = addRecentPacket(from, p->id);
+        recent->portnum = p->decoded.portnum;
+    }
+    if (!recent)
+        recent = addRecentPacket(from, p->id);
+    if (recent->portnum == PORTNUM_PENDING)
+        recent->pendingMsec += airtime_ms;
+    else
+        portnumTally.add(now, recent->portnum, airtime_ms);
 }
 
-uint8_t AirTime::getPeriodUtilMinute()
+void AirTime::notePortnum(const meshtastic_MeshPacket *p)
 {
-    return (getSecondsSinceBoot() / 10) % CHANNEL_UTILIZATION_PERIODS;
+    if (p->which_payload_variant != meshtastic_MeshPacket_decoded_tag)
+        return;
+    NodeNum from = getFrom(p);
+    RecentPacket *recent = findRecentPacket(from, p->id);
+    if (!recent)
+        recent = addRecentPacket(from, p->id);
+    if (recent->portnum == PORTNUM_PENDING && recent->pendingMsec)
+        portnumTally.add(millis(), p->decoded.portnum, recent->pendingMsec);
+    recent->portnum = p->decoded.portnum;
+    recent->pendingMsec = 0;
 }
 
-uint8_t AirTime::getPeriodUtilHour()
+AirTime::RecentPacket *AirTime::findRecentPacket(NodeNum from, PacketId id)
 {
-    return (getSecondsSinceBoot() / 60) % MINUTES_IN_HOUR;
+    for (uint8_t i = 0; i < AIRTIME_RECENT_PACKETS; i++) {
+        RecentPacket &r = recentPackets[i];
+        if (r.from == from && r.id == id && (r.from || r.id))
+            return &r;
+    }
+    return NULL;
+}
+
+AirTime::RecentPacket *AirTime::addRecentPacket(NodeNum from, PacketId id)
+{
+    RecentPacket &r = recentPackets[nextRecentPacket];
+    nextRecentPacket = (nextRecentPacket + 1) % AIRTIME_RECENT_PACKETS;
+
+    // Whatever the packet we push out used without us learning its portnum stays unknown
+    if (r.portnum == PORTNUM_PENDING && r.pendingMsec)
+        portnumTally.add(millis(), meshtastic_PortNum_UNKNOWN_APP, r.pendingMsec);
+
+    r.from = from;
+    r.id = id;
+    r.pendingMsec = 0;
+    r.portnum = PORTNUM_PENDING;
+    return &r;
+}
+
+uint8_t AirTime::currentPeriodIndex()
+{
+    return ((getSecondsSinceBoot() / SECONDS_PER_PERIOD) % PERIODS_TO_LOG);
 }
 
 void AirTime::airtimeRotatePeriod()
@@ -102,22 +154,32 @@ uint32_t AirTime::getSecondsSinceBoot()
 
 float AirTime::channelUtilizationPercent()
 {
-    uint32_t sum = 0;
-    for (uint32_t i = 0; i < CHANNEL_UTILIZATION_PERIODS; i++) {
-        sum += this->channelUtilization[i];
-    }
-
-    return (float(sum) / float(CHANNEL_UTILIZATION_PERIODS * 10 * 1000)) * 100;
+    return (float(channelWindow.sum(millis())) / float(channelWindow.windowMsec)) * 100;
 }
 
 float AirTime::utilizationTXPercent()
 {
-    uint32_t sum = 0;
-    for (uint32_t i = 0; i < MINUTES_IN_HOUR; i++) {
-        sum += this->utilizationTX[i];
-    }
+    return (float(txWindow.sum(millis())) / float(txWindow.windowMsec)) * 100;
+}
+
+uint32_t AirTime::getNodeAirtimeMsec(NodeNum node)
+{
+    return nodeTally.get(millis(), node);
+}
 
-    return (float(sum) / float(MS_IN_HOUR)) * 100;
+float AirTime::getNodeAirtimePercent(NodeNum node)
+{
+    return (float(getNodeAirtimeMsec(node)) / float(MS_IN_HOUR)) * 100;
+}
+
+size_t AirTime::getTopNodes(AirtimeShare *out, size_t max)
+{
+    return nodeTally.getTop(millis(), out, max);
+}
+
+size_t AirTime::getTopPortnums(AirtimeShare *out, size_t max)
+{
+    return portnumTally.getTop(millis(), out, max);
 }
 
 bool AirTime::isTxAllowedChannelUtil(bool polite)
@@ -147,14 +209,11 @@ bool AirTime::isTxAllowedAirUtil()
 // Get the amount of minutes we have to be silent before we can send again
 uint8_t AirTime::getSilentMinutes(float txPercent, float dutyCycle)
 {
-    float newTxPercent = txPercent;
-    for (int8_t i = MINUTES_IN_HOUR - 1; i >= 0; --i) {
-        newTxPercent -= ((float)this->utilizationTX[i] / (MS_IN_MINUTE * MINUTES_IN_HOUR / 100));
-        if (newTxPercent < dutyCycle)
-            return MINUTES_IN_HOUR - 1 - i;
-    }
-
-    return MINUTES_IN_HOUR;
+    // txPercent is what the caller saw from utilizationTXPercent(), the window itself tells when enough of it expires
+    uint32_t allowedMsec = (uint32_t)(dutyCycle * MS_IN_HOUR / 100);
+    uint32_t waitMsec = txWindow.msecUntilAtMost(millis(), allowedMsec);
+    uint32_t minutes = (waitMsec + MS_IN_MINUTE - 1) / MS_IN_MINUTE;
+    return minutes < MINUTES_IN_HOUR ? minutes : MINUTES_IN_HOUR;
 }
 
 AirTime::AirTime() : concurrency::OSThread("AirTime"), airtimes({}) {}
@@ -163,21 +222,7 @@ int32_t AirTime::runOnce()
 {
     secSinceBoot++;
 
-    uint8_t utilPeriod = this->getPeriodUtilMinute();
-    uint8_t utilPeriodTX = this->getPeriodUtilHour();
-
     if (firstTime) {
-
-        // Init utilizationTX window to all 0
-        for (uint32_t i = 0; i < MINUTES_IN_HOUR; i++) {
-            this->utilizationTX[i] = 0;
-        }
-
-        // Init channelUtilization window to all 0
-        for (uint32_t i = 0; i < CHANNEL_UTILIZATION_PERIODS; i++) {
-            this->channelUtilization[i] = 0;
-        }
-
         // Init airtime windows to all 0
         for (int i = 0; i < PERIODS_TO_LOG; i++) {
             this->airtimes.periodTX[i] = 0;
@@ -189,22 +234,8 @@ int32_t AirTime::runOnce()
         }
 
         firstTime = false;
-        lastUtilPeriod = utilPeriod;
     } else {
         this->airtimeRotatePeriod();
-
-        // Reset the channelUtilization window when we roll over
-        if (lastUtilPeriod != utilPeriod) {
-            lastUtilPeriod = utilPeriod;
-
-            this->channelUtilization[utilPeriod] = 0;
-        }
-
-        if (lastUtilPeriodTX != utilPeriodTX) {
-            lastUtilPeriodTX = utilPeriodTX;
-
-            this->utilizationTX[utilPeriodTX] = 0;
-        }
     }
     return (1000 * 1);
 }
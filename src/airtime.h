@@ -1,6 +1,8 @@
 #pragma once
 
+#include "AirtimeWindow.h"
 #include "MeshRadio.h"
+#include "MeshTypes.h"
 #include "concurrency/OSThread.h"
 #include "configuration.h"
 #include <Arduino.h>
@@ -33,6 +35,30 @@
 #define MS_IN_MINUTE (SECONDS_IN_MINUTE * 1000)
 #define MS_IN_HOUR (MINUTES_IN_HOUR * SECONDS_IN_MINUTE * 1000)
 
+// Channel utilization covers the last minute and TX utilization the last hour, both slide along in small steps
+#define CHANNEL_UTILIZATION_BUCKET_MSEC 500
+#define CHANNEL_UTILIZATION_BUCKETS (CHANNEL_UTILIZATION_PERIODS * 10 * 1000 / CHANNEL_UTILIZATION_BUCKET_MSEC)
+#define TX_UTILIZATION_BUCKET_MSEC (10 * 1000)
+#define TX_UTILIZATION_BUCKETS (MS_IN_HOUR / TX_UTILIZATION_BUCKET_MSEC)
+
+// How many sending nodes and portnums get their airtime over the last hour tracked, the busiest ones win
+#ifndef AIRTIME_TRACKED_NODES
+#ifdef ARCH_STM32WL
+#define AIRTIME_TRACKED_NODES 8
+#else
+#define AIRTIME_TRACKED_NODES 32
+#endif
+#endif
+#ifndef AIRTIME_TRACKED_PORTNUMS
+#ifdef ARCH_STM32WL
+#define AIRTIME_TRACKED_PORTNUMS 8
+#else
+#define AIRTIME_TRACKED_PORTNUMS 16
+#endif
+#endif
+// Recently heard or sent packets, so rebroadcasts and our transmissions can be charged to a portnum without decoding them
+#define AIRTIME_RECENT_PACKETS 16
+
 enum reportTypes { TX_LOG, RX_LOG, RX_ALL_LOG };
 
 void logAirtime(reportTypes reportType, uint32_t airtime_ms);
@@ -46,12 +72,27 @@ class AirTime : private concurrency::OSThread
     AirTime();
 
     void logAirtime(reportTypes reportType, uint32_t airtime_ms);
+
+    /// Like logAirtime(), and also charges the airtime to p's sender and portnum
+    void logAirtime(reportTypes reportType, uint32_t airtime_ms, const meshtastic_MeshPacket *p);
+
+    /**
+     * Tell us the portnum of a packet once it is known, i.e. after decoding or before encrypting.  Airtime logged for it
+     * before and after is charged to that portnum, packets we never learn the portnum of count as UNKNOWN_APP.
+     */
+    void notePortnum(const meshtastic_MeshPacket *p);
+
     float channelUtilizationPercent();
     float utilizationTXPercent();
 
-    float UtilizationPercentTX();
-    uint32_t channelUtilization[CHANNEL_UTILIZATION_PERIODS] = {0};
-    uint32_t utilizationTX[MINUTES_IN_HOUR] = {0};
+    /// Airtime charged to a sending node over the last hour, 0 if it isn't among the AIRTIME_TRACKED_NODES busiest
+    uint32_t getNodeAirtimeMsec(NodeNum node);
+    /// Percent of the last hour a sending node kept the channel busy
+    float getNodeAirtimePercent(NodeNum node);
+    /// Fill out with the up to max nodes that used the most airtime in the last hour, busiest first
+    size_t getTopNodes(AirtimeShare *out, size_t max);
+    /// Fill out with the up to max portnums that used the most airtime in the last hour, busiest first
+    size_t getTopPortnums(AirtimeShare *out, size_t max);
 
     void airtimeRotatePeriod();
     uint8_t getPeriodsToLog();
@@ -64,8 +105,6 @@ class AirTime : private concurrency::OSThread
 
   private:
     bool firstTime = true;
-    uint8_t lastUtilPeriod = 0;
-    uint8_t lastUtilPeriodTX = 0;
     uint32_t secSinceBoot = 0;
     uint8_t max_channel_util_percent = 40;
     uint8_t polite_channel_util_percent = 25;
@@ -78,8 +117,25 @@ class AirTime : private concurrency::OSThread
         uint8_t lastPeriodIndex;
     } airtimes;
 
-    uint8_t getPeriodUtilMinute();
-    uint8_t getPeriodUtilHour();
+    AirtimeWindow<uint16_t, CHANNEL_UTILIZATION_BUCKETS, CHANNEL_UTILIZATION_BUCKET_MSEC> channelWindow;
+    AirtimeWindow<uint16_t, TX_UTILIZATION_BUCKETS, TX_UTILIZATION_BUCKET_MSEC> txWindow;
+    AirtimeTally<AIRTIME_TRACKED_NODES> nodeTally;
+    AirtimeTally<AIRTIME_TRACKED_PORTNUMS> portnumTally;
+
+    /// A packet whose airtime is charged to a portnum, see notePortnum()
+    struct RecentPacket {
+        NodeNum from;
+        PacketId id;
+        uint32_t pendingMsec; // Airtime logged before the portnum was known
+        uint16_t portnum;     // PORTNUM_PENDING until known
+    };
+    static const uint16_t PORTNUM_PENDING = 0xFFFF;
+    RecentPacket recentPackets[AIRTIME_RECENT_PACKETS] = {};
+    uint8_t nextRecentPacket = 0;
+
+    RecentPacket *findRecentPacket(NodeNum from, PacketId id);
+    RecentPacket *addRecentPacket(NodeNum from, PacketId id);
+
     uint8_t currentPeriodIndex();
 
   protected:
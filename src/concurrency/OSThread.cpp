@@ -1,7 +1,11 @@
 #include "OSThread.h"
 #include "configuration.h"
 #include "memGet.h"
+#include <algorithm>
 #include <assert.h>
+#include <functional>
+#include <utility>
+#include <vector>
 
 namespace concurrency
 {
@@ -20,6 +24,30 @@ const OSThread *OSThread::currentThread;
 ThreadController mainController, timerController;
 InterruptableDelay mainDelay;
 
+/// (deadline, thread) min-heap.  Entries go stale when a thread is rescheduled, they are skipped when popped.
+typedef std::pair<uint64_t, OSThread *> Deadline;
+static std::vector<Deadline> deadlines;
+
+/// Every thread on mainController, and the disabled ones among them
+static std::vector<OSThread *> scheduledThreads, parkedThreads;
+
+/// Threads being run by the current runOrDelay() pass
+static std::vector<OSThread *> dueThreads;
+
+/// Some thread was rescheduled outside of run()
+static volatile bool scheduleDirty;
+
+/// millis() extended to 64 bits, so deadlines never wrap
+static uint64_t clockMsec;
+static uint32_t lastMillis;
+
+static uint64_t advanceClock(uint32_t nowMsec)
+{
+    clockMsec += (uint32_t)(nowMsec - lastMillis);
+    lastMillis = nowMsec;
+    return clockMsec;
+}
+
 void OSThread::setup()
 {
     mainController.ThreadName = "mainController";
@@ -37,12 +65,150 @@ OSThread::OSThread(const char *_name, uint32_t period, ThreadController *_contro
         bool added = controller->add(this);
         assert(added);
     }
+
+    if (controller == &mainController) {
+        scheduledThreads.push_back(this);
+        rescheduled = true;
+        scheduleDirty = true;
+    }
 }
 
 OSThread::~OSThread()
 {
     if (controller)
         controller->remove(this);
+
+    if (controller == &mainController) {
+        unschedule();
+        scheduledThreads.erase(std::remove(scheduledThreads.begin(), scheduledThreads.end(), this), scheduledThreads.end());
+        // We might be deleted by another thread's runOnce() while waiting our turn in the same pass
+        std::replace(dueThreads.begin(), dueThreads.end(), this, (OSThread *)NULL);
+    }
+}
+
+void OSThread::unschedule()
+{
+    // Superseded entries of ours can be left in the heap whatever our state (parked after a reschedule, or waiting in
+    // dueThreads), and runOrDelay() looks at the thread of every entry it pops
+    auto ours = [this](const Deadline &d) { return d.second == this; };
+    auto stale = std::remove_if(deadlines.begin(), deadlines.end(), ours);
+    if (stale != deadlines.end()) {
+        deadlines.erase(stale, deadlines.end());
+        std::make_heap(deadlines.begin(), deadlines.end(), std::greater<Deadline>());
+    }
+    parkedThreads.erase(std::remove(parkedThreads.begin(), parkedThreads.end(), this), parkedThreads.end());
+    scheduleState = SCHEDULE_NONE;
+}
+
+void OSThread::schedule(uint32_t nowMsec, uint64_t now)
+{
+    if (!enabled) {
+        if (scheduleState != SCHEDULE_PARKED) {
+            scheduleState = SCHEDULE_PARKED;
+            parkedThreads.push_back(this);
+        }
+        return;
+    }
+
+    if (scheduleState == SCHEDULE_PARKED)
+        parkedThreads.erase(std::remove(parkedThreads.begin(), parkedThreads.end(), this), parkedThreads.end());
+
+    // _cached_next_run is at most INT32_MAX away, so the signed difference is exact
+    deadline = now + (int32_t)(uint32_t)(_cached_next_run - nowMsec);
+    scheduleState = SCHEDULE_HEAP;
+
+    // Superseded entries pile up when threads are rescheduled often, rebuild before the heap gets silly
+    if (deadlines.size() > 4 * scheduledThreads.size() + 16) {
+        deadlines.clear();
+        for (auto t : scheduledThreads)
+            if (t->scheduleState == SCHEDULE_HEAP)
+                deadlines.push_back(Deadline(t->deadline, t));
+        std::make_heap(deadlines.begin(), deadlines.end(), std::greater<Deadline>());
+        return; // we were included above
+    }
+
+    deadlines.push_back(Deadline(deadline, this));
+    std::push_heap(deadlines.begin(), deadlines.end(), std::greater<Deadline>());
+}
+
+long OSThread::runOrDelay()
+{
+    uint32_t nowMsec = millis();
+    uint64_t now = advanceClock(nowMsec);
+
+    if (scheduleDirty) {
+        scheduleDirty = false;
+        for (auto t : scheduledThreads) {
+            if (t->rescheduled) {
+                t->rescheduled = false;
+                t->schedule(nowMsec, now);
+            }
+        }
+    }
+
+    // Plenty of code enables threads by just setting enabled, so check on the parked ones
+    for (size_t i = 0; i < parkedThreads.size();) {
+        OSThread *t = parkedThreads[i];
+        if (t->enabled)
+            t->schedule(nowMsec, now); // removes it from parkedThreads
+        else
+            i++;
+    }
+
+    dueThreads.clear();
+    while (!deadlines.empty() && deadlines.front().first <= now) {
+        Deadline d = deadlines.front();
+        std::pop_heap(deadlines.begin(), deadlines.end(), std::greater<Deadline>());
+        deadlines.pop_back();
+
+        OSThread *t = d.second;
+        if (t->scheduleState == SCHEDULE_HEAP && t->deadline == d.first) {
+            t->scheduleState = SCHEDULE_NONE;
+            dueThreads.push_back(t);
+        }
+    }
+
+    for (size_t i = 0; i < dueThreads.size(); i++) {
+        OSThread *t = dueThreads[i];
+        if (!t)
+            continue; // deleted by an earlier thread in this pass
+
+        if (t->shouldRun(nowMsec))
+            t->run();
+        if (!dueThreads[i])
+            continue; // deleted during its own run
+
+        dueThreads[i] = NULL;
+        t->rescheduled = false;
+        uint32_t ranMsec = millis();
+        // Already-due entries wait for the next pass, so nobody runs twice in one pass
+        t->schedule(ranMsec, advanceClock(ranMsec));
+    }
+    dueThreads.clear();
+
+    nowMsec = millis();
+    now = advanceClock(nowMsec);
+    for (size_t i = 0; i < parkedThreads.size();) {
+        OSThread *t = parkedThreads[i];
+        if (t->enabled)
+            t->schedule(nowMsec, now);
+        else
+            i++;
+    }
+
+    // Drop stale entries so the top is the real next deadline
+    while (!deadlines.empty()) {
+        const Deadline &d = deadlines.front();
+        if (d.second->scheduleState == SCHEDULE_HEAP && d.second->deadline == d.first)
+            break;
+        std::pop_heap(deadlines.begin(), deadlines.end(), std::greater<Deadline>());
+        deadlines.pop_back();
+    }
+
+    if (scheduleDirty || deadlines.empty())
+        return scheduleDirty ? 0 : INT32_MAX;
+    uint64_t next = deadlines.front().first;
+    return next <= now ? 0 : (long)std::min<uint64_t>(next - now, INT32_MAX);
 }
 
 /**
@@ -55,6 +221,21 @@ void OSThread::setIntervalFromNow(unsigned long _interval)
 
     // Cache the next run based on the last_run
     _cached_next_run = millis() + interval;
+
+    if (controller == &mainController) {
+        rescheduled = true;
+        scheduleDirty = true;
+    }
+}
+
+void OSThread::setInterval(unsigned long _interval)
+{
+    Thread::setInterval(_interval);
+
+    if (controller == &mainController) {
+        rescheduled = true;
+        scheduleDirty = true;
+    }
 }
 
 bool OSThread::shouldRun(unsigned long time)
@@ -82,7 +263,9 @@ void OSThread::run()
     auto heap = memGet.getFreeHeap();
 #endif
     currentThread = this;
+    uint32_t start = micros();
     auto newDelay = runOnce();
+    uint32_t elapsed = micros() - start;
 #ifdef DEBUG_HEAP
     auto newHeap = memGet.getFreeHeap();
     if (newHeap < heap)
@@ -91,10 +274,18 @@ void OSThread::run()
         LOG_DEBUG("++++++ Thread %s freed heap %d -> %d (%d) ++++++", ThreadName.c_str(), heap, newHeap, newHeap - heap);
 #endif
 
+    stats.runs++;
+    stats.totalRunUsec += elapsed;
+    if (elapsed > stats.maxRunUsec)
+        stats.maxRunUsec = elapsed;
+    if (elapsed > OSTHREAD_OVERRUN_MSEC * 1000)
+        stats.overruns++;
+
     runned();
 
+    // runOrDelay() reschedules us once we return, no need to flag it
     if (newDelay >= 0)
-        setInterval(newDelay);
+        Thread::setInterval(newDelay);
 
     currentThread = NULL;
 }
@@ -15,6 +15,19 @@ extern InterruptableDelay mainDelay;
 
 #define RUN_SAME -1
 
+/// runOnce() calls slower than this are counted as overruns
+#ifndef OSTHREAD_OVERRUN_MSEC
+#define OSTHREAD_OVERRUN_MSEC 100
+#endif
+
+/// Run time accounting for a thread, see OSThread::getStats()
+struct OSThreadStats {
+    uint32_t runs;
+    uint32_t overruns; // runOnce() calls that took longer than OSTHREAD_OVERRUN_MSEC
+    uint32_t maxRunUsec;
+    uint64_t totalRunUsec;
+};
+
 /**
  * @brief Base threading
  *
@@ -41,6 +54,23 @@ class OSThread : public Thread
     /// Show debugging info for threads we decide not to run;
     static bool showWaiting;
 
+    OSThreadStats stats = {};
+
+    /// Where a mainController thread is in the deadline scheduler
+    enum ScheduleState : uint8_t { SCHEDULE_NONE, SCHEDULE_HEAP, SCHEDULE_PARKED };
+    ScheduleState scheduleState = SCHEDULE_NONE;
+
+    /// Set when our interval changes outside of run(), possibly from an ISR
+    volatile bool rescheduled = false;
+
+    /// Due time of our newest heap entry, on the scheduler's 64 bit clock
+    uint64_t deadline = 0;
+
+    /// Put us back in the deadline heap (or park us if disabled) after our next run time changed
+    void schedule(uint32_t nowMsec, uint64_t now);
+
+    void unschedule();
+
   public:
     /// For debug printing only (might be null)
     static const OSThread *currentThread;
@@ -60,6 +90,21 @@ class OSThread : public Thread
      */
     void setIntervalFromNow(unsigned long _interval);
 
+    /// Same as Thread::setInterval, but also tells the scheduler our next run time moved
+    void setInterval(unsigned long _interval);
+
+    /// How often and how long our runOnce() has run
+    const OSThreadStats &getStats() const { return stats; }
+
+    /**
+     * Run the mainController threads that are due, each at most once, and return the msecs until the next one is due.
+     *
+     * Threads sit in a min-heap keyed by their next run time, so a pass only touches the threads that are actually due
+     * instead of asking every registered thread whether it wants to run.  Threads that are disabled are parked off the heap
+     * and picked up again once enabled.
+     */
+    static long runOrDelay();
+
   protected:
     /**
      * The method that will be called each time our thread gets a chance to run
@@ -2,9 +2,14 @@
 
 #if !MESHTASTIC_EXCLUDE_I2C
 
+#include "FSCommon.h"
+#include "SPILock.h"
 #include "concurrency/LockGuard.h"
+#include "mesh/generated/meshtastic/mesh.pb.h"
+#include <ErriezCRC32.h>
 #if defined(ARCH_PORTDUINO)
 #include "linux/LinuxHardwareI2C.h"
+#include "platform/portduino/PortduinoGlue.h"
 #endif
 #if !defined(ARCH_PORTDUINO) && !defined(ARCH_STM32WL)
 #include "meshUtils.h" // vformat
@@ -109,6 +114,36 @@ uint16_t ScanI2CTwoWire::getRegisterValue(const ScanI2CTwoWire::RegisterLocation
     return value;
 }
 
+#ifdef RV3028_RTC
+static void setupRV3028(TwoWire *i2cBus)
+{
+    Melopero_RV3028 rtc;
+    rtc.initI2C(*i2cBus);
+    rtc.writeToRegister(0x35, 0x07); // no Clkout
+    rtc.writeToRegister(0x37, 0xB4);
+}
+#endif
+
+/// Address the device and see if it answers.  @return 0 if it did, the endTransmission() error if not
+uint8_t ScanI2CTwoWire::probeAddress(TwoWire *i2cBus, uint8_t address)
+{
+    i2cBus->beginTransmission(address);
+#ifdef ARCH_PORTDUINO
+    uint8_t err = 2;
+    if ((address >= 0x30 && address <= 0x37) || (address >= 0x50 && address <= 0x5F)) {
+        if (i2cBus->read() != -1)
+            err = 0;
+    } else {
+        err = i2cBus->writeQuick((uint8_t)0);
+    }
+    if (err != 0)
+        err = 2;
+    return err;
+#else
+    return i2cBus->endTransmission();
+#endif
+}
+
 #define SCAN_SIMPLE_CASE(ADDR, T, ...)                                                                                           \
     case ADDR:                                                                                                                   \
         logFoundDevice(__VA_ARGS__);                                                                                             \
@@ -119,8 +154,7 @@ void ScanI2CTwoWire::scanPort(I2CPort port, uint8_t *address, uint8_t asize)
 {
     concurrency::LockGuard guard((concurrency::Lock *)&lock);
 
-    LOG_DEBUG("Scan for I2C devices on port %d", port);
-
+    uint32_t start = millis();
     uint8_t err;
 
     DeviceAddress addr(port, 0x00);
@@ -128,9 +162,6 @@ void ScanI2CTwoWire::scanPort(I2CPort port, uint8_t *address, uint8_t asize)
     uint16_t registerValue = 0x00;
     ScanI2C::DeviceType type;
     TwoWire *i2cBus;
-#ifdef RV3028_RTC
-    Melopero_RV3028 rtc;
-#endif
 
 #if WIRE_INTERFACES_COUNT == 2
     if (port == I2CPort::WIRE1) {
@@ -142,6 +173,18 @@ void ScanI2CTwoWire::scanPort(I2CPort port, uint8_t *address, uint8_t asize)
     }
 #endif
 
+    if (asize == 0 && (cachedPorts & (1 << port))) {
+        if (verifyCachedPort(port, i2cBus)) {
+            cachedPortsUsed |= 1 << port;
+            scanMsec += millis() - start;
+            LOG_INFO("I2C port %d: cached devices checked in %u ms", port, millis() - start);
+            return;
+        }
+        LOG_INFO("I2C devices on port %d changed since the last scan", port);
+    }
+
+    LOG_DEBUG("Scan for I2C devices on port %d", port);
+
     // We only need to scan 112 addresses, the rest is reserved for special purposes
     // 0x00 General Call
     // 0x01 CBUS addresses
@@ -157,20 +200,7 @@ void ScanI2CTwoWire::scanPort(I2CPort port, uint8_t *address, uint8_t asize)
                 continue;
             LOG_DEBUG("Scan address 0x%x", (uint8_t)addr.address);
         }
-        i2cBus->beginTransmission(addr.address);
-#ifdef ARCH_PORTDUINO
-        err = 2;
-        if ((addr.address >= 0x30 && addr.address <= 0x37) || (addr.address >= 0x50 && addr.address <= 0x5F)) {
-            if (i2cBus->read() != -1)
-                err = 0;
-        } else {
-            err = i2cBus->writeQuick((uint8_t)0);
-        }
-        if (err != 0)
-            err = 2;
-#else
-        err = i2cBus->endTransmission();
-#endif
+        err = probeAddress(i2cBus, addr.address);
         type = NONE;
         if (err == 0) {
             switch (addr.address) {
@@ -183,9 +213,7 @@ void ScanI2CTwoWire::scanPort(I2CPort port, uint8_t *address, uint8_t asize)
                 // foundDevices[addr] = RTC_RV3028;
                 type = RTC_RV3028;
                 logFoundDevice("RV3028", (uint8_t)addr.address);
-                rtc.initI2C(*i2cBus);
-                rtc.writeToRegister(0x35, 0x07); // no Clkout
-                rtc.writeToRegister(0x37, 0xB4);
+                setupRV3028(i2cBus);
                 break;
 #endif
 
@@ -513,6 +541,34 @@ void ScanI2CTwoWire::scanPort(I2CPort port, uint8_t *address, uint8_t asize)
             foundDevices[addr] = type;
         }
     }
+
+    if (asize == 0) {
+        fullScanPorts |= 1 << port;
+        LOG_INFO("I2C port %d: full scan took %u ms", port, millis() - start);
+    }
+    scanMsec += millis() - start;
+}
+
+bool ScanI2CTwoWire::verifyCachedPort(I2CPort port, TwoWire *i2cBus)
+{
+    for (const FoundDevice &device : cachedDevices) {
+        if (device.address.port == port && probeAddress(i2cBus, device.address.address) != 0) {
+            LOG_DEBUG("Cached I2C device at 0x%x doesn't answer", device.address.address);
+            return false;
+        }
+    }
+    for (const FoundDevice &device : cachedDevices) {
+        if (device.address.port != port)
+            continue;
+        LOG_INFO("I2C device type %d at address 0x%x (cached)", device.type, device.address.address);
+#ifdef RV3028_RTC
+        if (device.type == RTC_RV3028)
+            setupRV3028(i2cBus);
+#endif
+        deviceAddresses[device.type] = device.address;
+        foundDevices[device.address] = device.type;
+    }
+    return true;
 }
 
 void ScanI2CTwoWire::scanPort(I2CPort port)
@@ -538,6 +594,105 @@ size_t ScanI2CTwoWire::countDevices() const
     return foundDevices.size();
 }
 
+// Change this when DeviceType or I2CScanCache change, older caches are then ignored
+#define I2C_SCAN_CACHE_MAGIC 0x49324301
+
+/// What the last full scan found, so later boots can skip it
+struct I2CScanCache {
+    uint32_t magic;
+    uint32_t fingerprint;
+    uint8_t ports; // Bit per I2CPort scanned, a port can have no devices
+    uint8_t count;
+    struct {
+        uint8_t port;
+        uint8_t address;
+        uint8_t type;
+    } devices[I2C_SCAN_CACHE_MAX];
+};
+
+/// Changes when the board, the firmware (and with it what the scan recognises) or on Linux the I2C device does
+static uint32_t hardwareFingerprint()
+{
+    char id[96];
+#ifdef ARCH_PORTDUINO
+    snprintf(id, sizeof(id), "%d %s %s", HW_VENDOR, optstr(APP_VERSION), settingsStrings[i2cdev].c_str());
+#else
+    snprintf(id, sizeof(id), "%d %s", HW_VENDOR, optstr(APP_VERSION));
+#endif
+    return crc32Buffer(id, strlen(id));
+}
+
+bool ScanI2CTwoWire::loadCache()
+{
+#ifdef FSCom
+    I2CScanCache cache = {};
+    {
+        concurrency::LockGuard g(spiLock);
+        auto file = FSCom.open(I2C_SCAN_CACHE_FILE, FILE_O_READ);
+        if (!file)
+            return false;
+        size_t got = file.read((uint8_t *)&cache, sizeof(cache));
+        file.close();
+        if (got != sizeof(cache))
+            return false;
+    }
+    if (cache.magic != I2C_SCAN_CACHE_MAGIC || cache.fingerprint != hardwareFingerprint() || cache.count > I2C_SCAN_CACHE_MAX) {
+        LOG_INFO("I2C scan cache is for other hardware or firmware, ignore");
+        return false;
+    }
+
+    cachedDevices.clear();
+    for (uint8_t i = 0; i < cache.count; i++) {
+        cachedDevices.push_back(FoundDevice((DeviceType)cache.devices[i].type,
+                                            DeviceAddress((I2CPort)cache.devices[i].port, cache.devices[i].address)));
+    }
+    cachedPorts = cache.ports;
+    LOG_DEBUG("Loaded %u I2C devices from cache", cache.count);
+    return true;
+#else
+    return false;
+#endif
+}
+
+void ScanI2CTwoWire::saveCache()
+{
+#ifdef FSCom
+    if (!fullScanPorts)
+        return;
+
+    I2CScanCache cache = {};
+    cache.magic = I2C_SCAN_CACHE_MAGIC;
+    cache.fingerprint = hardwareFingerprint();
+    cache.ports = fullScanPorts | cachedPortsUsed;
+    for (auto &found : foundDevices) {
+        if (cache.count >= I2C_SCAN_CACHE_MAX) {
+            // Cover no ports, so the next boot scans them all again
+            LOG_WARN("Too many I2C devices to cache");
+            cache.ports = 0;
+            cache.count = 0;
+            break;
+        }
+        cache.devices[cache.count].port = found.first.port;
+        cache.devices[cache.count].address = found.first.address;
+        cache.devices[cache.count].type = found.second;
+        cache.count++;
+    }
+
+    concurrency::LockGuard g(spiLock);
+    if (FSCom.exists(I2C_SCAN_CACHE_FILE) && !FSCom.remove(I2C_SCAN_CACHE_FILE)) {
+        LOG_WARN("Can't remove old I2C scan cache");
+    }
+    auto file = FSCom.open(I2C_SCAN_CACHE_FILE, FILE_O_WRITE);
+    if (file) {
+        file.write((uint8_t *)&cache, sizeof(cache));
+        file.flush();
+        file.close();
+    } else {
+        LOG_WARN("Can't write I2C scan cache (File: %s)", I2C_SCAN_CACHE_FILE);
+    }
+#endif
+}
+
 void ScanI2CTwoWire::logFoundDevice(const char *device, uint8_t address)
 {
     LOG_INFO("%s found at address 0x%x", device, address);
@@ -5,6 +5,7 @@
 
 #include <map>
 #include <memory>
+#include <vector>
 #include <stddef.h>
 #include <stdint.h>
 
@@ -14,6 +15,14 @@
 
 #include "../concurrency/Lock.h"
 
+/// Devices the last full scan found, delete it (e.g. with AdminMessage.delete_file_request) to force a full scan on next boot
+#define I2C_SCAN_CACHE_FILE "/prefs/i2c.dat"
+
+/// Most devices the cache keeps, more than that and every boot does a full scan
+#ifndef I2C_SCAN_CACHE_MAX
+#define I2C_SCAN_CACHE_MAX 24
+#endif
+
 class ScanI2CTwoWire : public ScanI2C
 {
   public:
@@ -29,6 +38,24 @@ class ScanI2CTwoWire : public ScanI2C
 
     size_t countDevices() const override;
 
+    /**
+     * Read what the last full scan found, if it was on the same hardware and firmware.  A following scanPort() of all addresses
+     * then only checks the cached devices still answer, and does the full scan only if one doesn't.  Devices added since aren't
+     * seen until the cache is deleted.
+     *
+     * @return true if there was a cache to use
+     */
+    bool loadCache();
+
+    /// Save what was found for the next boot, if any port needed a full scan
+    void saveCache();
+
+    /// Time spent in scanPort() so far
+    uint32_t getScanMsec() const { return scanMsec; }
+
+    /// Whether every port scanned so far was taken from the cache
+    bool isFromCache() const { return cachedPortsUsed && !fullScanPorts; }
+
   protected:
     FoundDevice firstOfOrNONE(size_t, DeviceType[]) const override;
 
@@ -53,10 +80,21 @@ class ScanI2CTwoWire : public ScanI2C
 
     concurrency::Lock lock;
 
+    // Devices read from the cache, and the ports they cover (bit per I2CPort)
+    std::vector<ScanI2C::FoundDevice> cachedDevices;
+    uint8_t cachedPorts = 0;
+    uint8_t cachedPortsUsed = 0;
+    uint8_t fullScanPorts = 0;
+    uint32_t scanMsec = 0;
+
+    bool verifyCachedPort(ScanI2C::I2CPort, TwoWire *);
+
     uint16_t getRegisterValue(const RegisterLocation &, ResponseWidth, bool) const;
 
     DeviceType probeOLED(ScanI2C::DeviceAddress) const;
 
+    static uint8_t probeAddress(TwoWire *, uint8_t);
+
     static void logFoundDevice(const char *device, uint8_t address);
 };
 #endif
\ No newline at end of file
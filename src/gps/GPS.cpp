@@ -5,11 +5,13 @@
 #include "configuration.h"
 #if !MESHTASTIC_EXCLUDE_GPS
 #include "Default.h"
+#include "FSCommon.h"
 #include "GPS.h"
 #include "GpioLogic.h"
 #include "NodeDB.h"
 #include "PowerMon.h"
 #include "RTC.h"
+#include "SPILock.h"
 #include "Throttle.h"
 #include "buzz.h"
 #include "concurrency/Periodic.h"
@@ -222,591 +224,864 @@ uint8_t GPS::makeCASPacket(uint8_t class_id, uint8_t msg_id, uint8_t payload_siz
     return (payload_size + 10);
 }
 
-GPS_RESPONSE GPS::getACK(const char *message, uint32_t waitMillis)
-{
-    uint8_t buffer[768] = {0};
-    uint8_t b;
-    int bytesRead = 0;
-    uint32_t startTimeout = millis() + waitMillis;
-#ifdef GPS_DEBUG
-    std::string debugmsg = "";
+#if GPS_BAUDRATE_FIXED
+// if GPS_BAUDRATE is specified in variant, only try that.
+static const int serialSpeeds[1] = {GPS_BAUDRATE};
+static const int rareSerialSpeeds[1] = {GPS_BAUDRATE};
+#else
+static const int serialSpeeds[3] = {9600, 115200, 38400};
+static const int rareSerialSpeeds[3] = {4800, 57600, GPS_BAUDRATE};
 #endif
-    while (millis() < startTimeout) {
-        if (_serial_gps->available()) {
-            b = _serial_gps->read();
 
-#ifdef GPS_DEBUG
-            debugmsg += vformat("%c", (b >= 32 && b <= 126) ? b : '.');
+#ifndef GPS_PROBETRIES
+#define GPS_PROBETRIES 2
 #endif
-            buffer[bytesRead] = b;
-            bytesRead++;
-            if ((bytesRead == 767) || (b == '\r')) {
-                if (strnstr((char *)buffer, message, bytesRead) != nullptr) {
-#ifdef GPS_DEBUG
-                    LOG_DEBUG("Found: %s", message); // Log the found message
+
+// How often setup() looks for replies while it waits, 9600 baud is about a byte per msec
+#ifndef GPS_INIT_POLL_MS
+#define GPS_INIT_POLL_MS 10
 #endif
-                    return GNSS_RESPONSE_OK;
-                } else {
-                    bytesRead = 0;
-#ifdef GPS_DEBUG
-                    LOG_DEBUG(debugmsg.c_str());
+
+// How long to wait for a good frame at the cached baud rate before probing again
+#ifndef GPS_CACHE_VERIFY_MS
+#define GPS_CACHE_VERIFY_MS 2500
 #endif
-                }
-            }
-        }
-    }
-    return GNSS_RESPONSE_NONE;
-}
 
-GPS_RESPONSE GPS::getACKCas(uint8_t class_id, uint8_t msg_id, uint32_t waitMillis)
-{
-    uint32_t startTime = millis();
-    uint8_t buffer[CAS_ACK_NACK_MSG_SIZE] = {0};
-    uint8_t bufferPos = 0;
-
-    // CAS-ACK-(N)ACK structure
-    //         | H1   | H2   | Payload Len | cls  | msg  | Payload                   | Checksum (4)              |
-    //         |      |      |             |      |      | Cls  | Msg  | Reserved    |                           |
-    //         |------|------|-------------|------|------|------|------|-------------|---------------------------|
-    // ACK-NACK| 0xBA | 0xCE | 0x04 | 0x00 | 0x05 | 0x00 | 0xXX | 0xXX | 0x00 | 0x00 | 0xXX | 0xXX | 0xXX | 0xXX |
-    // ACK-ACK | 0xBA | 0xCE | 0x04 | 0x00 | 0x05 | 0x01 | 0xXX | 0xXX | 0x00 | 0x00 | 0xXX | 0xXX | 0xXX | 0xXX |
-
-    while (Throttle::isWithinTimespanMs(startTime, waitMillis)) {
-        if (_serial_gps->available()) {
-            buffer[bufferPos++] = _serial_gps->read();
-
-            // keep looking at the first two bytes of buffer until
-            // we have found the CAS frame header (0xBA, 0xCE), if not
-            // keep reading bytes until we find a frame header or we run
-            // out of time.
-            if ((bufferPos == 2) && !(buffer[0] == 0xBA && buffer[1] == 0xCE)) {
-                buffer[0] = buffer[1];
-                buffer[1] = 0;
-                bufferPos = 1;
-            }
-        }
+static const char *PROBE_MESSAGE = "Trying %s (%s)...";
+static const char *DETECTED_MESSAGE = "%s detected";
 
-        // we have read all the bytes required for the Ack/Nack (14-bytes)
-        // and we must have found a frame to get this far
-        if (bufferPos == sizeof(buffer) - 1) {
-            uint8_t msg_cls = buffer[4];     // message class should be 0x05
-            uint8_t msg_msg_id = buffer[5];  // message id should be 0x00 or 0x01
-            uint8_t payload_cls = buffer[6]; // payload class id
-            uint8_t payload_msg = buffer[7]; // payload message id
+/// A reply that identifies a chip
+struct GPSProbeMatch {
+    const char *chipName;        // The name of the chip (for logging)
+    const char *detectionString; // The string to match in the response
+    GnssModel_t driver;          // The driver to use
+};
+
+/// One query of the probe.  The steps are tried in order at each baud rate until a reply matches
+struct GPSProbeStep {
+    const char *family;   // For logging
+    const char *preamble; // Sent before the query (with line endings) or NULL
+    uint16_t settleMs;    // Time the module needs after the preamble
+    const char *query;    // Without the line ending
+    const GPSProbeMatch *matches;
+    uint8_t numMatches;
+    uint16_t timeoutMs;
+};
+
+#define PROBE_MATCHES(M) M, sizeof(M) / sizeof(M[0])
+
+// Unicore UFirebirdII Series: UC6580, UM620, UM621, UM670A, UM680A, or UM681A
+static const GPSProbeMatch unicore[] = {{"UC6580", "UC6580", GNSS_MODEL_UC6580}, {"UM600", "UM600", GNSS_MODEL_UC6580}};
+
+static const GPSProbeMatch atgm[] = {
+    {"ATGM336H", "$GPTXT,01,01,02,HW=ATGM336H", GNSS_MODEL_ATGM336H},
+    /* ATGM332D series (-11(GPS), -21(BDS), -31(GPS+BDS), -51(GPS+GLONASS), -71-0(GPS+BDS+GLONASS)) based on AT6558 */
+    {"ATGM332D", "$GPTXT,01,01,02,HW=ATGM332D", GNSS_MODEL_ATGM336H}};
+
+/* Airoha (Mediatek) AG3335A/M/S, A3352Q, Quectel L89 2.0, SimCom SIM65M */
+static const GPSProbeMatch airoha[] = {{"AG3335", "$PAIR021,AG3335", GNSS_MODEL_AG3335},
+                                       {"AG3352", "$PAIR021,AG3352", GNSS_MODEL_AG3352},
+                                       {"RYS3520", "$PAIR021,REYAX_RYS3520_V2", GNSS_MODEL_AG3352}};
+
+static const GPSProbeMatch lc86[] = {{"LC86", "$PQTMVERNO,LC86", GNSS_MODEL_AG3352}};
+
+static const GPSProbeMatch l76k[] = {{"L76K", "$GPTXT,01,01,02,SW=", GNSS_MODEL_MTK}};
+
+static const GPSProbeMatch mtk[] = {{"L76B", "Quectel-L76B", GNSS_MODEL_MTK_L76B}, {"PA1010D", "1010D", GNSS_MODEL_MTK_PA1010D},
+                                    {"PA1616S", "1616S", GNSS_MODEL_MTK_PA1616S},  {"LS20031", "MC-1513", GNSS_MODEL_MTK_L76B},
+                                    {"L96", "Quectel-L96", GNSS_MODEL_MTK_L76B},   {"L80-R", "_3337_", GNSS_MODEL_MTK_L76B},
+                                    {"L80", "_3339_", GNSS_MODEL_MTK_L76B}};
+
+static const GPSProbeStep probeSteps[] = {
+    // Close all NMEA sentences, valid for L76K, ATGM336H (and likely other AT6558 devices), then the NMEA sequences on Ublox
+    {"Unicore Family",
+     "$PCAS03,0,0,0,0,0,0,0,0,0,0,,,0,0*02\r\n$PUBX,40,GLL,0,0,0,0,0,0*5C\r\n$PUBX,40,GSV,0,0,0,0,0,0*59\r\n"
+     "$PUBX,40,VTG,0,0,0,0,0,0*5E\r\n",
+     40, "$PDTINFO", PROBE_MATCHES(unicore), 500},
+    {"ATGM33xx Family", NULL, 0, "$PCAS06,1*1A", PROBE_MATCHES(atgm), 500},
+    // GSA and GSV off to reduce volume, then save configuration
+    {"Airoha Family", "$PAIR062,2,0*3C\r\n$PAIR062,3,0*3D\r\n$PAIR513*3D\r\n", 0, "$PAIR021*39", PROBE_MATCHES(airoha), 1000},
+    {"LC86", NULL, 0, "$PQTMVERNO*58", PROBE_MATCHES(lc86), 500},
+    {"L76K", NULL, 0, "$PCAS06,0*1B", PROBE_MATCHES(l76k), 500},
+    // Close all NMEA sentences, valid for MTK3333 and MTK3339 platforms
+    {"MTK Family", "$PMTK514,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0*2E\r\n", 20, "$PMTK605*31", PROBE_MATCHES(mtk), 500},
+};
+
+/// UBX-MON-VER hardware versions
+static const struct {
+    const char *hwVersion;
+    const char *name;
+    GnssModel_t model;
+} ubloxModels[] = {{"00040007", "U-blox 6", GNSS_MODEL_UBLOX6},
+                   {"00070000", "U-blox 7", GNSS_MODEL_UBLOX7},
+                   {"00080000", "U-blox 8", GNSS_MODEL_UBLOX8},
+                   {"00190000", "U-blox 9", GNSS_MODEL_UBLOX9},
+                   {"000A0000", "U-blox 10", GNSS_MODEL_UBLOX10}};
 
-            // Check for an ACK-ACK for the specified class and message id
-            if ((msg_cls == 0x05) && (msg_msg_id == 0x01) && payload_cls == class_id && payload_msg == msg_id) {
-#ifdef GPS_DEBUG
-                LOG_INFO("Got ACK for class %02X message %02X in %dms", class_id, msg_id, millis() - startTime);
+#ifdef TRACKER_T1000_E
+// Power the module down and up again before each probe, improves ag3335 detection success
+static const struct {
+    uint8_t pin;
+    uint8_t level;
+    uint16_t pauseMs;
+} powerCycle[] = {{PIN_GPS_EN, LOW, 500}, {GPS_VRTC_EN, LOW, 1000}, {GPS_VRTC_EN, HIGH, 500}, {PIN_GPS_EN, HIGH, 1000}};
 #endif
-                return GNSS_RESPONSE_OK;
-            }
 
-            // Check for an ACK-NACK for the specified class and message id
-            if ((msg_cls == 0x05) && (msg_msg_id == 0x00) && payload_cls == class_id && payload_msg == msg_id) {
-#ifdef GPS_DEBUG
-                LOG_WARN("Got NACK for class %02X message %02X in %dms", class_id, msg_id, millis() - startTime);
+static int getProbeSpeed(uint8_t probeTries, uint8_t speedSelect)
+{
+    return probeTries < GPS_PROBETRIES ? serialSpeeds[speedSelect] : rareSerialSpeeds[speedSelect];
+}
+
+static const char *gpsCacheFileName = "/prefs/gps.dat";
+
+// Change this when GnssModel_t or GPSCache change, older caches are then ignored
+#define GPS_CACHE_MAGIC 0x47505302
+
+/// What the last probe found, so later boots can skip it
+struct GPSCache {
+    uint32_t magic;
+    uint32_t serialSpeed;
+    uint32_t rxGpio;
+    uint32_t txGpio;
+    uint8_t model;
+    uint8_t protocolVersion;
+    uint8_t probeStep; // The probeSteps entry that found the model, array_count(probeSteps) if UBX-MON-VER did
+};
+
+bool GPS::loadCache()
+{
+#ifdef FSCom
+    GPSCache cache = {};
+    {
+        concurrency::LockGuard g(spiLock);
+        auto file = FSCom.open(gpsCacheFileName, FILE_O_READ);
+        if (!file)
+            return false;
+        size_t got = file.read((uint8_t *)&cache, sizeof(cache));
+        file.close();
+        if (got != sizeof(cache))
+            return false;
+    }
+    // Only good for the module on the same pins
+    if (cache.magic != GPS_CACHE_MAGIC || cache.rxGpio != rx_gpio || cache.txGpio != tx_gpio ||
+        cache.model == GNSS_MODEL_UNKNOWN || cache.model > GNSS_MODEL_LS20031 || cache.probeStep > array_count(probeSteps))
+        return false;
+    gnssModel = (GnssModel_t)cache.model;
+    initStep = cache.probeStep;
+    ublox_info.protocol_version = cache.protocolVersion;
+    serialSpeed = cache.serialSpeed;
+    return true;
+#else
+    return false;
 #endif
-                return GNSS_RESPONSE_NAK;
-            }
+}
 
-            // This isn't the frame we are looking for, clear the buffer
-            // and try again until we run out of time.
-            memset(buffer, 0x0, sizeof(buffer));
-            bufferPos = 0;
-        }
+void GPS::saveCache(uint8_t probeStep)
+{
+#ifdef FSCom
+    GPSCache cache = {};
+    cache.magic = GPS_CACHE_MAGIC;
+    cache.serialSpeed = serialSpeed;
+    cache.rxGpio = rx_gpio;
+    cache.txGpio = tx_gpio;
+    cache.model = gnssModel;
+    cache.protocolVersion = ublox_info.protocol_version;
+    cache.probeStep = probeStep;
+
+    concurrency::LockGuard g(spiLock);
+    if (FSCom.exists(gpsCacheFileName) && !FSCom.remove(gpsCacheFileName)) {
+        LOG_WARN("Can't remove old GPS cache");
     }
-    return GNSS_RESPONSE_NONE;
+    auto file = FSCom.open(gpsCacheFileName, FILE_O_WRITE);
+    if (file) {
+        file.write((uint8_t *)&cache, sizeof(cache));
+        file.flush();
+        file.close();
+    } else {
+        LOG_WARN("Can't write GPS cache (File: %s)", gpsCacheFileName);
+    }
+#endif
 }
 
-GPS_RESPONSE GPS::getACK(uint8_t class_id, uint8_t msg_id, uint32_t waitMillis)
+void GPS::removeCache()
 {
-    uint8_t b;
-    uint8_t ack = 0;
-    const uint8_t ackP[2] = {class_id, msg_id};
-    uint8_t buf[10] = {0xB5, 0x62, 0x05, 0x01, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00};
-    uint32_t startTime = millis();
-    const char frame_errors[] = "More than 100 frame errors";
-    int sCounter = 0;
-#ifdef GPS_DEBUG
-    std::string debugmsg = "";
+#ifdef FSCom
+    concurrency::LockGuard g(spiLock);
+    if (FSCom.exists(gpsCacheFileName))
+        FSCom.remove(gpsCacheFileName);
 #endif
+}
 
-    for (int j = 2; j < 6; j++) {
-        buf[8] += buf[j];
-        buf[9] += buf[8];
+void GPS::setSerialSpeed(uint32_t speed)
+{
+#if defined(ARCH_NRF52) || defined(ARCH_PORTDUINO) || defined(ARCH_STM32WL)
+    _serial_gps->end();
+    _serial_gps->begin(speed);
+#elif defined(ARCH_RP2040)
+    _serial_gps->end();
+    _serial_gps->setFIFOSize(256);
+    _serial_gps->begin(speed);
+#else
+    if (_serial_gps->baudRate() != speed) {
+        LOG_DEBUG("Set Baud to %i", speed);
+        _serial_gps->updateBaudRate(speed);
     }
+#endif
+    serialSpeed = speed;
+}
 
-    for (int j = 0; j < 2; j++) {
-        buf[6 + j] = ackP[j];
-        buf[8] += buf[6 + j];
-        buf[9] += buf[8];
+void GPS::setInitState(GPSInitState state, uint32_t waitMsec)
+{
+    initState = state;
+    initStateStartMsec = millis();
+    initStateWaitMsec = waitMsec;
+}
+
+/**
+ * @brief  Setup the GPS based on the model detected.
+ *  The model and baud rate found last time are tried first.  Otherwise we detect the GPS by cycling through a set of baud
+ *  rates, first common then rare.  For each baud rate we go through probeSteps, sending queries and matching the replies to
+ *  known GPS responses, then ask for UBX replies.  Once the model is known its config steps are sent.
+ *
+ *  Each call only sends what is due and looks at what the module sent since the last call, the waits in between are left
+ *  to the scheduler.
+ * @retval msecs until the next call, 0 once setup reached the end of its potential to configure the GPS.
+ */
+int32_t GPS::setup()
+{
+    if (initState == GPS_INIT_DONE)
+        return 0;
+
+    if (initState == GPS_INIT_START) {
+        if (didSerialInit) {
+            setInitState(GPS_INIT_DONE, 0);
+            notifyDeepSleepObserver.observe(&notifyDeepSleep);
+            return 0;
+        }
+        if (!tx_gpio)
+            return 2000; // We can't talk to the module to find out what it is
+        initStartMsec = millis();
+        if (loadCache()) {
+            LOG_DEBUG("Try cached GPS model %d at %u baud", gnssModel, serialSpeed);
+            modelFromCache = true;
+            setSerialSpeed(serialSpeed);
+            clearBuffer();
+            parser.reset();
+            setInitState(GPS_INIT_VERIFY_CACHE, GPS_CACHE_VERIFY_MS);
+        } else {
+            startProbe();
+        }
     }
 
-    while (Throttle::isWithinTimespanMs(startTime, waitMillis)) {
-        if (ack > 9) {
-#ifdef GPS_DEBUG
-            LOG_INFO("Got ACK for class %02X message %02X in %dms", class_id, msg_id, millis() - startTime);
-#endif
-            return GNSS_RESPONSE_OK; // ACK received
+    while (initState != GPS_INIT_DONE) {
+        // Look through what the module sent, a frame may be what we're waiting for
+        bool advanced = false;
+        while (!advanced && _serial_gps->available() > 0) {
+            GPSFrameType type = parser.feed(_serial_gps->read());
+            if (type != GPS_FRAME_NONE)
+                advanced = handleInitFrame(type);
         }
-        if (_serial_gps->available()) {
-            b = _serial_gps->read();
-            if (b == frame_errors[sCounter]) {
-                sCounter++;
-                if (sCounter == 26) {
-#ifdef GPS_DEBUG
+        if (advanced)
+            continue;
+        if (Throttle::isWithinTimespanMs(initStateStartMsec, initStateWaitMsec))
+            return GPS_INIT_POLL_MS;
+        handleInitTimeout();
+    }
+    return 0;
+}
 
-                    LOG_DEBUG(debugmsg.c_str());
-#endif
-                    return GNSS_RESPONSE_FRAME_ERRORS;
-                }
-            } else {
-                sCounter = 0;
+/// @return true if the frame moved setup() on to another state
+bool GPS::handleInitFrame(GPSFrameType type)
+{
+    switch (initState) {
+    case GPS_INIT_VERIFY_CACHE:
+        // Anything with a good checksum means the baud rate is right
+        if (type == GPS_FRAME_NMEA && !parser.hasChecksum())
+            return false;
+        sendCacheQuery();
+        return true;
+
+    case GPS_INIT_VERIFY_MODEL: {
+        // Another module on the same pins at the same baud rate must not get the cached model's commands
+        GnssModel_t model = GNSS_MODEL_UNKNOWN;
+        if (initStep >= array_count(probeSteps)) {
+            if (type != GPS_FRAME_UBX || parser.getClass() != 0x0A || parser.getId() != 0x04)
+                return false;
+            model = parseMonVer(parser.getPayload(), parser.getPayloadLength());
+        } else {
+            if (type != GPS_FRAME_NMEA)
+                return false;
+            const GPSProbeStep &step = probeSteps[initStep];
+            for (uint8_t i = 0; i < step.numMatches && model == GNSS_MODEL_UNKNOWN; i++) {
+                if (strstr(parser.getSentence(), step.matches[i].detectionString) != nullptr)
+                    model = step.matches[i].driver;
             }
+            if (model == GNSS_MODEL_UNKNOWN)
+                return false; // Regular output, keep waiting for the answer
+        }
+        if (model != gnssModel) {
+            LOG_WARN("Cached GPS model %d, but the module is model %d, probe again", gnssModel, model);
+            abandonCache();
+            return true;
+        }
+        LOG_INFO("GPS model %d at %u baud, from cache", gnssModel, serialSpeed);
+        startConfigure();
+        return true;
+    }
+
+    case GPS_INIT_PROBE_QUERY: {
+        if (type != GPS_FRAME_NMEA)
+            return false;
 #ifdef GPS_DEBUG
-            debugmsg += vformat("%02X", b);
-#endif
-            if (b == buf[ack]) {
-                ack++;
-            } else {
-                if (ack == 3 && b == 0x00) { // UBX-ACK-NAK message
-#ifdef GPS_DEBUG
-                    LOG_DEBUG(debugmsg.c_str());
-#endif
-                    LOG_WARN("Got NAK for class %02X message %02X", class_id, msg_id);
-                    return GNSS_RESPONSE_NAK; // NAK received
-                }
-                ack = 0; // Reset the acknowledgement counter
+        LOG_DEBUG(parser.getSentence());
+#endif
+        const GPSProbeStep &step = probeSteps[initStep];
+        for (uint8_t i = 0; i < step.numMatches; i++) {
+            if (strstr(parser.getSentence(), step.matches[i].detectionString) != nullptr) {
+                LOG_INFO(DETECTED_MESSAGE, step.matches[i].chipName);
+                probeFound(step.matches[i].driver);
+                return true;
             }
         }
+        return false;
+    }
+
+    case GPS_INIT_PROBE_UBX_RATE: {
+        // An ACK or NAK for CFG-RATE, or a u-blox complaining about what the NMEA probes sent
+        if (type == GPS_FRAME_NMEA && strstr(parser.getSentence(), "More than 100 frame errors")) {
+            LOG_INFO("UBlox Frame Errors (baudrate %d)", serialSpeed);
+        } else if (type != GPS_FRAME_UBX || parser.getClass() != 0x05 || parser.getPayloadLength() < 2 ||
+                   parser.getPayload()[0] != 0x06 || parser.getPayload()[1] != 0x08) {
+            return false;
+        }
+        //  Get Ublox gnss module hardware and software info
+        uint8_t msglen = makeUBXPacket(0x0A, 0x04, 0, NULL);
+        clearBuffer();
+        parser.reset();
+        _serial_gps->write(UBXscratch, msglen);
+        setInitState(GPS_INIT_PROBE_UBX_VERSION, 1200);
+        return true;
+    }
+
+    case GPS_INIT_PROBE_UBX_VERSION: {
+        if (type != GPS_FRAME_UBX || parser.getClass() != 0x0A || parser.getId() != 0x04)
+            return false;
+        GnssModel_t model = parseMonVer(parser.getPayload(), parser.getPayloadLength());
+        if (model != GNSS_MODEL_UNKNOWN) {
+            probeFound(model);
+        } else {
+            LOG_WARN("No GNSS Module (baudrate %d)", serialSpeed);
+            nextProbeSpeed();
+        }
+        return true;
+    }
+
+    case GPS_INIT_CONFIGURE: {
+        if (!ackPending)
+            return false;
+        // CAS and UBX ACK-ACK are 0x05 0x01, ACK-NAK 0x05 0x00, with the class and id of the command
+        const GPSConfigStep &step = configSteps[initStep];
+        bool sameProtocol =
+            (step.kind == GPS_STEP_UBX && type == GPS_FRAME_UBX) || (step.kind == GPS_STEP_CAS && type == GPS_FRAME_CAS);
+        if (!sameProtocol || parser.getClass() != 0x05 || parser.getId() > 0x01 || parser.getPayloadLength() < 2 ||
+            parser.getPayload()[0] != step.cls || parser.getPayload()[1] != step.id)
+            return false;
+        configStepAnswered(parser.getId() == 0x01 ? GNSS_RESPONSE_OK : GNSS_RESPONSE_NAK);
+        return true;
+    }
+
+    default:
+        return false;
     }
-#ifdef GPS_DEBUG
-    LOG_DEBUG(debugmsg.c_str());
-    LOG_WARN("No response for class %02X message %02X", class_id, msg_id);
-#endif
-    return GNSS_RESPONSE_NONE; // No response received within timeout
 }
 
-/**
- * @brief
- * @note   New method, this method can wait for the specified class and message ID, and return the payload
- * @param  *buffer: The message buffer, if there is a response payload message, it will be returned through the buffer parameter
- * @param  size:    size of buffer
- * @param  requestedClass:  request class constant
- * @param  requestedID:     request message ID constant
- * @retval length of payload message
- */
-int GPS::getACK(uint8_t *buffer, uint16_t size, uint8_t requestedClass, uint8_t requestedID, uint32_t waitMillis)
+/// The wait of the current state is over without the frame it was waiting for
+void GPS::handleInitTimeout()
 {
-    uint16_t ubxFrameCounter = 0;
-    uint32_t startTime = millis();
-    uint16_t needRead = 0;
-
-    while (Throttle::isWithinTimespanMs(startTime, waitMillis)) {
-        if (_serial_gps->available()) {
-            int c = _serial_gps->read();
-            switch (ubxFrameCounter) {
-            case 0:
-                // ubxFrame 'μ'
-                if (c == 0xB5) {
-                    ubxFrameCounter++;
-                }
-                break;
-            case 1:
-                // ubxFrame 'b'
-                if (c == 0x62) {
-                    ubxFrameCounter++;
-                } else {
-                    ubxFrameCounter = 0;
-                }
-                break;
-            case 2:
-                // Class
-                if (c == requestedClass) {
-                    ubxFrameCounter++;
-                } else {
-                    ubxFrameCounter = 0;
-                }
-                break;
-            case 3:
-                // Message ID
-                if (c == requestedID) {
-                    ubxFrameCounter++;
-                } else {
-                    ubxFrameCounter = 0;
-                }
-                break;
-            case 4:
-                // Payload length lsb
-                needRead = c;
-                ubxFrameCounter++;
-                break;
-            case 5:
-                // Payload length msb
-                needRead |= (c << 8);
-                ubxFrameCounter++;
-                // Check for buffer overflow
-                if (needRead >= size) {
-                    ubxFrameCounter = 0;
-                    break;
-                }
-                if (_serial_gps->readBytes(buffer, needRead) != needRead) {
-                    ubxFrameCounter = 0;
-                } else {
-                    // return payload length
-#ifdef GPS_DEBUG
-                    LOG_INFO("Got ACK for class %02X message %02X in %dms", requestedClass, requestedID, millis() - startTime);
+    switch (initState) {
+    case GPS_INIT_VERIFY_CACHE:
+        LOG_WARN("No GPS data at cached %u baud, probe again", serialSpeed);
+        abandonCache();
+        break;
+
+    case GPS_INIT_VERIFY_MODEL:
+        LOG_WARN("Cached GPS model %d did not answer, probe again", gnssModel);
+        abandonCache();
+        break;
+
+    case GPS_INIT_POWER_CYCLE:
+#ifdef TRACKER_T1000_E
+        if (++initStep < array_count(powerCycle)) {
+            digitalWrite(powerCycle[initStep].pin, powerCycle[initStep].level);
+            setInitState(GPS_INIT_POWER_CYCLE, powerCycle[initStep].pauseMs);
+            break;
+        }
 #endif
-                    return needRead;
-                }
-                break;
+        setSerialSpeed(getProbeSpeed(probeTries, speedSelect));
+        setInitState(GPS_INIT_SET_BAUD, 100);
+        break;
 
-            default:
-                break;
-            }
+    case GPS_INIT_SET_BAUD:
+        initStep = 0;
+        sendProbeStep();
+        break;
+
+    case GPS_INIT_PROBE_SETTLE:
+        sendProbeQuery();
+        break;
+
+    case GPS_INIT_PROBE_QUERY:
+        initStep++;
+        sendProbeStep();
+        break;
+
+    case GPS_INIT_PROBE_UBX_RATE:
+    case GPS_INIT_PROBE_UBX_VERSION:
+        LOG_WARN("No GNSS Module (baudrate %d)", serialSpeed);
+        nextProbeSpeed();
+        break;
+
+    case GPS_INIT_CONFIGURE:
+        if (ackPending) {
+            configStepAnswered(GNSS_RESPONSE_NONE);
+        } else {
+            initStep++;
+            runConfigStep();
         }
+        break;
+
+    default:
+        break;
     }
-    return 0;
 }
 
-#if GPS_BAUDRATE_FIXED
-// if GPS_BAUDRATE is specified in variant, only try that.
-static const int serialSpeeds[1] = {GPS_BAUDRATE};
-static const int rareSerialSpeeds[1] = {GPS_BAUDRATE};
+/// Start probing at the baud rate speedSelect and probeTries point at
+void GPS::startProbe()
+{
+    int speed = getProbeSpeed(probeTries, speedSelect);
+    LOG_DEBUG("Probe for GPS at %d", speed);
+    memset(&ublox_info, 0, sizeof(ublox_info));
+#ifdef TRACKER_T1000_E
+    initStep = 0;
+    digitalWrite(powerCycle[0].pin, powerCycle[0].level);
+    setInitState(GPS_INIT_POWER_CYCLE, powerCycle[0].pauseMs);
 #else
-static const int serialSpeeds[3] = {9600, 115200, 38400};
-static const int rareSerialSpeeds[3] = {4800, 57600, GPS_BAUDRATE};
-#endif
-
-#ifndef GPS_PROBETRIES
-#define GPS_PROBETRIES 2
+    setSerialSpeed(speed);
+    setInitState(GPS_INIT_SET_BAUD, 100);
 #endif
+}
 
-/**
- * @brief  Setup the GPS based on the model detected.
- *  We detect the GPS by cycling through a set of baud rates, first common then rare.
- *  For each baud rate, we run GPS::Probe to send commands and match the responses
- *  to known GPS responses.
- * @retval Whether setup reached the end of its potential to configure the GPS.
- */
-bool GPS::setup()
+/// Nothing answered at this baud rate, go on to the next one or give up
+void GPS::nextProbeSpeed()
 {
-    if (!didSerialInit) {
-        int msglen = 0;
-        if (tx_gpio && gnssModel == GNSS_MODEL_UNKNOWN) {
-#ifdef TRACKER_T1000_E
-            // add power up/down strategy, improve ag3335 detection success
-            digitalWrite(PIN_GPS_EN, LOW);
-            delay(500);
-            digitalWrite(GPS_VRTC_EN, LOW);
-            delay(1000);
-            digitalWrite(GPS_VRTC_EN, HIGH);
-            delay(500);
-            digitalWrite(PIN_GPS_EN, HIGH);
-            delay(1000);
-#endif
-            if (probeTries < GPS_PROBETRIES) {
-                LOG_DEBUG("Probe for GPS at %d", serialSpeeds[speedSelect]);
-                gnssModel = probe(serialSpeeds[speedSelect]);
-                if (gnssModel == GNSS_MODEL_UNKNOWN) {
-                    if (++speedSelect == array_count(serialSpeeds)) {
-                        speedSelect = 0;
-                        ++probeTries;
-                    }
-                }
-            }
-            // Rare Serial Speeds
-            if (probeTries == GPS_PROBETRIES) {
-                LOG_DEBUG("Probe for GPS at %d", rareSerialSpeeds[speedSelect]);
-                gnssModel = probe(rareSerialSpeeds[speedSelect]);
-                if (gnssModel == GNSS_MODEL_UNKNOWN) {
-                    if (++speedSelect == array_count(rareSerialSpeeds)) {
-                        LOG_WARN("Give up on GPS probe and set to %d", GPS_BAUDRATE);
-                        return true;
-                    }
-                }
-            }
+    if (probeTries < GPS_PROBETRIES) {
+        if (++speedSelect == array_count(serialSpeeds)) {
+            speedSelect = 0;
+            ++probeTries;
         }
+    } else if (++speedSelect == array_count(rareSerialSpeeds)) {
+        LOG_WARN("Give up on GPS probe and set to %d", GPS_BAUDRATE);
+        setSerialSpeed(GPS_BAUDRATE);
+        finishInit();
+        return;
+    }
+    startProbe();
+}
 
-        if (gnssModel != GNSS_MODEL_UNKNOWN) {
-            setConnected();
-        } else {
-            return false;
-        }
+void GPS::sendProbeStep()
+{
+    if (initStep >= array_count(probeSteps)) {
+        // No NMEA query was answered, see if it speaks UBX
+        uint8_t msglen = makeUBXPacket(0x06, 0x08, 0, NULL);
+        clearBuffer();
+        parser.reset();
+        _serial_gps->write(UBXscratch, msglen);
+        setInitState(GPS_INIT_PROBE_UBX_RATE, 750);
+        return;
+    }
 
-        if (gnssModel == GNSS_MODEL_MTK) {
-            /*
-             * t-beam-s3-core uses the same L76K GNSS module as t-echo.
-             * Unlike t-echo, L76K uses 9600 baud rate for communication by default.
-             * */
-
-            // Initialize the L76K Chip, use GPS + GLONASS + BEIDOU
-            _serial_gps->write("$PCAS04,7*1E\r\n");
-            delay(250);
-            // only ask for RMC and GGA
-            _serial_gps->write("$PCAS03,1,0,0,0,1,0,0,0,0,0,,,0,0*02\r\n");
-            delay(250);
-            // Switch to Vehicle Mode, since SoftRF enables Aviation < 2g
-            _serial_gps->write("$PCAS11,3*1E\r\n");
-            delay(250);
-        } else if (gnssModel == GNSS_MODEL_MTK_L76B) {
-            // Waveshare Pico-GPS hat uses the L76B with 9600 baud
-            // Initialize the L76B Chip, use GPS + GLONASS
-            // See note in L76_Series_GNSS_Protocol_Specification, chapter 3.29
-            _serial_gps->write("$PMTK353,1,1,0,0,0*2B\r\n");
-            // Above command will reset the GPS and takes longer before it will accept new commands
-            delay(1000);
-            // only ask for RMC and GGA (GNRMC and GNGGA)
-            // See note in L76_Series_GNSS_Protocol_Specification, chapter 2.1
-            _serial_gps->write("$PMTK314,0,1,0,1,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0*28\r\n");
-            delay(250);
-            // Enable SBAS
-            _serial_gps->write("$PMTK301,2*2E\r\n");
-            delay(250);
-            // Enable PPS for 2D/3D fix only
-            _serial_gps->write("$PMTK285,3,100*3F\r\n");
-            delay(250);
-            // Switch to Fitness Mode, for running and walking purpose with low speed (<5 m/s)
-            _serial_gps->write("$PMTK886,1*29\r\n");
-            delay(250);
-        } else if (gnssModel == GNSS_MODEL_MTK_PA1010D) {
-            // PA1010D is used in the Pimoroni GPS board.
-
-            // Enable all constellations.
-            _serial_gps->write("$PMTK353,1,1,1,1,1*2A\r\n");
-            // Above command will reset the GPS and takes longer before it will accept new commands
-            delay(1000);
-            // Only ask for RMC and GGA (GNRMC and GNGGA)
-            _serial_gps->write("$PMTK314,0,1,0,1,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0*28\r\n");
-            delay(250);
-            // Enable SBAS / WAAS
-            _serial_gps->write("$PMTK301,2*2E\r\n");
-            delay(250);
-        } else if (gnssModel == GNSS_MODEL_MTK_PA1616S) {
-            // PA1616S is used in some GPS breakout boards from Adafruit
-            // PA1616S does not have GLONASS capability. PA1616D does, but is not implemented here.
-            _serial_gps->write("$PMTK353,1,0,0,0,0*2A\r\n");
-            // Above command will reset the GPS and takes longer before it will accept new commands
-            delay(1000);
-            // Only ask for RMC and GGA (GNRMC and GNGGA)
-            _serial_gps->write("$PMTK314,0,1,0,1,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0*28\r\n");
-            delay(250);
-            // Enable SBAS / WAAS
-            _serial_gps->write("$PMTK301,2*2E\r\n");
-            delay(250);
-        } else if (gnssModel == GNSS_MODEL_ATGM336H) {
-            // Set the intial configuration of the device - these _should_ work for most AT6558 devices
-            msglen = makeCASPacket(0x06, 0x07, sizeof(_message_CAS_CFG_NAVX_CONF), _message_CAS_CFG_NAVX_CONF);
-            _serial_gps->write(UBXscratch, msglen);
-            if (getACKCas(0x06, 0x07, 250) != GNSS_RESPONSE_OK) {
-                LOG_WARN("ATGM336H: Could not set Config");
-            }
+    const GPSProbeStep &step = probeSteps[initStep];
+    if (step.preamble)
+        _serial_gps->write(step.preamble);
+    if (step.settleMs)
+        setInitState(GPS_INIT_PROBE_SETTLE, step.settleMs);
+    else
+        sendProbeQuery();
+}
 
-            // Set the update frequence to 1Hz
-            msglen = makeCASPacket(0x06, 0x04, sizeof(_message_CAS_CFG_RATE_1HZ), _message_CAS_CFG_RATE_1HZ);
-            _serial_gps->write(UBXscratch, msglen);
-            if (getACKCas(0x06, 0x04, 250) != GNSS_RESPONSE_OK) {
-                LOG_WARN("ATGM336H: Could not set Update Frequency");
-            }
+void GPS::sendProbeQuery()
+{
+    const GPSProbeStep &step = probeSteps[initStep];
+    LOG_DEBUG(PROBE_MESSAGE, step.query, step.family);
+    clearBuffer();
+    parser.reset();
+    _serial_gps->write(step.query);
+    _serial_gps->write("\r\n");
+    setInitState(GPS_INIT_PROBE_QUERY, step.timeoutMs);
+}
 
-            // Set the NEMA output messages
-            // Ask for only RMC and GGA
-            uint8_t fields[] = {CAS_NEMA_RMC, CAS_NEMA_GGA};
-            for (unsigned int i = 0; i < sizeof(fields); i++) {
-                // Construct a CAS-CFG-MSG packet
-                uint8_t cas_cfg_msg_packet[] = {0x4e, fields[i], 0x01, 0x00};
-                msglen = makeCASPacket(0x06, 0x01, sizeof(cas_cfg_msg_packet), cas_cfg_msg_packet);
-                _serial_gps->write(UBXscratch, msglen);
-                if (getACKCas(0x06, 0x01, 250) != GNSS_RESPONSE_OK) {
-                    LOG_WARN("ATGM336H: Could not enable NMEA MSG: %d", fields[i]);
-                }
-            }
-        } else if (gnssModel == GNSS_MODEL_UC6580) {
-            // The Unicore UC6580 can use a lot of sat systems, enable it to
-            // use GPS L1 & L5 + BDS B1I & B2a + GLONASS L1 + GALILEO E1 & E5a + SBAS + QZSS
-            // This will reset the receiver, so wait a bit afterwards
-            // The paranoid will wait for the OK*04 confirmation response after each command.
-            _serial_gps->write("$CFGSYS,h35155\r\n");
-            delay(750);
-            // Must be done after the CFGSYS command
-            // Turn off GSV messages, we don't really care about which and where the sats are, maybe someday.
-            _serial_gps->write("$CFGMSG,0,3,0\r\n");
-            delay(250);
-            // Turn off GSA messages, TinyGPS++ doesn't use this message.
-            _serial_gps->write("$CFGMSG,0,2,0\r\n");
-            delay(250);
-            // Turn off NOTICE __TXT messages, these may provide Unicore some info but we don't care.
-            _serial_gps->write("$CFGMSG,6,0,0\r\n");
-            delay(250);
-            _serial_gps->write("$CFGMSG,6,1,0\r\n");
-            delay(250);
-        } else if (IS_ONE_OF(gnssModel, GNSS_MODEL_AG3335, GNSS_MODEL_AG3352)) {
-
-            _serial_gps->write("$PAIR066,1,0,1,0,0,1*3B\r\n"); // Enable GPS+GALILEO+NAVIC
-
-            // Configure NMEA (sentences will output once per fix)
-            _serial_gps->write("$PAIR062,0,1*3F\r\n"); // GGA ON
-            _serial_gps->write("$PAIR062,1,0*3F\r\n"); // GLL OFF
-            _serial_gps->write("$PAIR062,2,0*3C\r\n"); // GSA OFF
-            _serial_gps->write("$PAIR062,3,0*3D\r\n"); // GSV OFF
-            _serial_gps->write("$PAIR062,4,1*3B\r\n"); // RMC ON
-            _serial_gps->write("$PAIR062,5,0*3B\r\n"); // VTG OFF
-            _serial_gps->write("$PAIR062,6,0*38\r\n"); // ZDA ON
-
-            delay(250);
-            _serial_gps->write("$PAIR513*3D\r\n"); // save configuration
-        } else if (gnssModel == GNSS_MODEL_UBLOX6) {
-            clearBuffer();
-            SEND_UBX_PACKET(0x06, 0x02, _message_DISABLE_TXT_INFO, "disable text info messages", 500);
-            SEND_UBX_PACKET(0x06, 0x39, _message_JAM_6_7, "enable interference resistance", 500);
-            SEND_UBX_PACKET(0x06, 0x23, _message_NAVX5, "configure NAVX5 settings", 500);
-
-            // Turn off unwanted NMEA messages, set update rate
-            SEND_UBX_PACKET(0x06, 0x08, _message_1HZ, "set GPS update rate", 500);
-            SEND_UBX_PACKET(0x06, 0x01, _message_GLL, "disable NMEA GLL", 500);
-            SEND_UBX_PACKET(0x06, 0x01, _message_GSA, "enable NMEA GSA", 500);
-            SEND_UBX_PACKET(0x06, 0x01, _message_GSV, "disable NMEA GSV", 500);
-            SEND_UBX_PACKET(0x06, 0x01, _message_VTG, "disable NMEA VTG", 500);
-            SEND_UBX_PACKET(0x06, 0x01, _message_RMC, "enable NMEA RMC", 500);
-            SEND_UBX_PACKET(0x06, 0x01, _message_GGA, "enable NMEA GGA", 500);
+void GPS::probeFound(GnssModel_t model)
+{
+    gnssModel = model;
+    saveCache(initStep);
+    startConfigure();
+}
 
-            clearBuffer();
-            SEND_UBX_PACKET(0x06, 0x11, _message_CFG_RXM_ECO, "enable powersave ECO mode for Neo-6", 500);
-            SEND_UBX_PACKET(0x06, 0x3B, _message_CFG_PM2, "enable powersave details for GPS", 500);
-            SEND_UBX_PACKET(0x06, 0x01, _message_AID, "disable UBX-AID", 500);
+/// The cached baud rate works, ask the query that identified the cached model last time
+void GPS::sendCacheQuery()
+{
+    clearBuffer();
+    parser.reset();
+    if (initStep >= array_count(probeSteps)) {
+        uint8_t msglen = makeUBXPacket(0x0A, 0x04, 0, NULL);
+        _serial_gps->write(UBXscratch, msglen);
+    } else {
+        // No preamble, the module keeps what the probe configured
+        _serial_gps->write(probeSteps[initStep].query);
+        _serial_gps->write("\r\n");
+    }
+    setInitState(GPS_INIT_VERIFY_MODEL, 1200);
+}
 
-            msglen = makeUBXPacket(0x06, 0x09, sizeof(_message_SAVE), _message_SAVE);
-            _serial_gps->write(UBXscratch, msglen);
-            if (getACK(0x06, 0x09, 2000) != GNSS_RESPONSE_OK) {
-                LOG_WARN("Unable to save GNSS module config");
-            } else {
-                LOG_INFO("GNSS module config saved!");
-            }
-        } else if (IS_ONE_OF(gnssModel, GNSS_MODEL_UBLOX7, GNSS_MODEL_UBLOX8, GNSS_MODEL_UBLOX9)) {
-            if (gnssModel == GNSS_MODEL_UBLOX7) {
-                LOG_DEBUG("Set GPS+SBAS");
-                msglen = makeUBXPacket(0x06, 0x3e, sizeof(_message_GNSS_7), _message_GNSS_7);
-                _serial_gps->write(UBXscratch, msglen);
-            } else { // 8,9
-                msglen = makeUBXPacket(0x06, 0x3e, sizeof(_message_GNSS_8), _message_GNSS_8);
-                _serial_gps->write(UBXscratch, msglen);
-            }
+/// The cache doesn't describe the module any more, forget it and probe from scratch
+void GPS::abandonCache()
+{
+    removeCache();
+    gnssModel = GNSS_MODEL_UNKNOWN;
+    modelFromCache = false;
+    startProbe();
+}
 
-            if (getACK(0x06, 0x3e, 800) == GNSS_RESPONSE_NAK) {
-                // It's not critical if the module doesn't acknowledge this configuration.
-                LOG_DEBUG("reconfigure GNSS - defaults maintained. Is this module GPS-only?");
-            } else {
-                if (gnssModel == GNSS_MODEL_UBLOX7) {
-                    LOG_INFO("GPS+SBAS configured");
-                } else { // 8,9
-                    LOG_INFO("GPS+SBAS+GLONASS+Galileo configured");
-                }
-                // Documentation say, we need wait atleast 0.5s after reconfiguration of GNSS module, before sending next
-                // commands for the M8 it tends to be more... 1 sec should be enough ;>)
-                delay(1000);
-            }
+/// Fill ublox_info from a UBX-MON-VER payload.  @return the model it names, GNSS_MODEL_UNKNOWN if none we know
+GnssModel_t GPS::parseMonVer(const uint8_t *payload, uint16_t len)
+{
+    if (len < 40)
+        return GNSS_MODEL_UNKNOWN;
 
-            // Disable Text Info messages //6,7,8,9
-            clearBuffer();
-            SEND_UBX_PACKET(0x06, 0x02, _message_DISABLE_TXT_INFO, "disable text info messages", 500);
+    memset(&ublox_info, 0, sizeof(ublox_info));
+    memcpy(ublox_info.swVersion, payload, 30);
+    memcpy(ublox_info.hwVersion, payload + 30, 10);
+    ublox_info.swVersion[29] = 0;
+    ublox_info.hwVersion[9] = 0;
+    for (uint16_t position = 40; len >= position + 30 && ublox_info.extensionNo < 10; position += 30) {
+        char *extension = ublox_info.extension[ublox_info.extensionNo++];
+        memcpy(extension, payload + position, 30);
+        extension[29] = 0;
+    }
 
-            if (gnssModel == GNSS_MODEL_UBLOX8) { // 8
-                clearBuffer();
-                SEND_UBX_PACKET(0x06, 0x39, _message_JAM_8, "enable interference resistance", 500);
+    LOG_DEBUG("Module Info : ");
+    LOG_DEBUG("Soft version: %s", ublox_info.swVersion);
+    LOG_DEBUG("Hard version: %s", ublox_info.hwVersion);
+    LOG_DEBUG("Extensions:%d", ublox_info.extensionNo);
+    for (int i = 0; i < ublox_info.extensionNo; i++) {
+        LOG_DEBUG("  %s", ublox_info.extension[i]);
+    }
 
-                clearBuffer();
-                SEND_UBX_PACKET(0x06, 0x23, _message_NAVX5_8, "configure NAVX5_8 settings", 500);
-            } else { // 6,7,9
-                SEND_UBX_PACKET(0x06, 0x39, _message_JAM_6_7, "enable interference resistance", 500);
-                SEND_UBX_PACKET(0x06, 0x23, _message_NAVX5, "configure NAVX5 settings", 500);
-            }
-            // Turn off unwanted NMEA messages, set update rate
-            SEND_UBX_PACKET(0x06, 0x08, _message_1HZ, "set GPS update rate", 500);
-            SEND_UBX_PACKET(0x06, 0x01, _message_GLL, "disable NMEA GLL", 500);
-            SEND_UBX_PACKET(0x06, 0x01, _message_GSA, "enable NMEA GSA", 500);
-            SEND_UBX_PACKET(0x06, 0x01, _message_GSV, "disable NMEA GSV", 500);
-            SEND_UBX_PACKET(0x06, 0x01, _message_VTG, "disable NMEA VTG", 500);
-            SEND_UBX_PACKET(0x06, 0x01, _message_RMC, "enable NMEA RMC", 500);
-            SEND_UBX_PACKET(0x06, 0x01, _message_GGA, "enable NMEA GGA", 500);
-
-            if (ublox_info.protocol_version >= 18) {
-                clearBuffer();
-                SEND_UBX_PACKET(0x06, 0x86, _message_PMS, "enable powersave for GPS", 500);
-                SEND_UBX_PACKET(0x06, 0x3B, _message_CFG_PM2, "enable powersave details for GPS", 500);
+    // tips: extensionNo field is 0 on some 6M GNSS modules
+    for (int i = 0; i < ublox_info.extensionNo; ++i) {
+        if (!strncmp(ublox_info.extension[i], "PROTVER", 7)) {
+            const char *version = &ublox_info.extension[i][8];
+            LOG_DEBUG("Protocol Version:%s", version);
+            ublox_info.protocol_version = strlen(version) ? strtoul(version, nullptr, 10) : 0;
+            LOG_DEBUG("ProtVer=%d", ublox_info.protocol_version);
+        }
+    }
 
-                // For M8 we want to enable NMEA vserion 4.10 so we can see the additional sats.
-                if (gnssModel == GNSS_MODEL_UBLOX8) {
-                    clearBuffer();
-                    SEND_UBX_PACKET(0x06, 0x17, _message_NMEA, "enable NMEA 4.10", 500);
-                }
-            } else {
-                SEND_UBX_PACKET(0x06, 0x11, _message_CFG_RXM_PSM, "enable powersave mode for GPS", 500);
-                SEND_UBX_PACKET(0x06, 0x3B, _message_CFG_PM2, "enable powersave details for GPS", 500);
-            }
+    for (size_t i = 0; i < array_count(ubloxModels); i++) {
+        if (strncmp(ublox_info.hwVersion, ubloxModels[i].hwVersion, 8) == 0) {
+            LOG_INFO(DETECTED_MESSAGE, ubloxModels[i].name);
+            return ubloxModels[i].model;
+        }
+    }
+    return GNSS_MODEL_UNKNOWN;
+}
 
-            msglen = makeUBXPacket(0x06, 0x09, sizeof(_message_SAVE), _message_SAVE);
-            _serial_gps->write(UBXscratch, msglen);
-            if (getACK(0x06, 0x09, 2000) != GNSS_RESPONSE_OK) {
-                LOG_WARN("Unable to save GNSS module config");
-            } else {
-                LOG_INFO("GNSS module configuration saved!");
+void GPS::startConfigure()
+{
+    setConnected();
+    buildConfigSteps();
+    initStep = 0;
+    runConfigStep();
+}
+
+bool GPS::addConfigStep(GPSConfigStepKind kind, uint8_t cls, uint8_t id, const uint8_t *payload, uint8_t len, const char *what,
+                        uint16_t ackMs, uint16_t pauseMs)
+{
+    if (numConfigSteps >= GPS_MAX_CONFIG_STEPS) {
+        LOG_ERROR("Too many GPS config steps, skip %s", what);
+        return false;
+    }
+    configSteps[numConfigSteps++] = {kind, cls, id, len, payload, NULL, ackMs, pauseMs, what};
+    return true;
+}
+
+void GPS::addNMEAStep(const char *sentence, uint16_t pauseMs)
+{
+    if (addConfigStep(GPS_STEP_NMEA, 0, 0, NULL, 0, sentence, 0, pauseMs))
+        configSteps[numConfigSteps - 1].sentence = sentence;
+}
+
+/// Queue the commands that configure gnssModel, runConfigStep() sends them
+void GPS::buildConfigSteps()
+{
+    numConfigSteps = 0;
+
+    if (gnssModel == GNSS_MODEL_MTK) {
+        /*
+         * t-beam-s3-core uses the same L76K GNSS module as t-echo.
+         * Unlike t-echo, L76K uses 9600 baud rate for communication by default.
+         * */
+
+        // Initialize the L76K Chip, use GPS + GLONASS + BEIDOU
+        addNMEAStep("$PCAS04,7*1E", 250);
+        // only ask for RMC and GGA
+        addNMEAStep("$PCAS03,1,0,0,0,1,0,0,0,0,0,,,0,0*02", 250);
+        // Switch to Vehicle Mode, since SoftRF enables Aviation < 2g
+        addNMEAStep("$PCAS11,3*1E", 250);
+    } else if (gnssModel == GNSS_MODEL_MTK_L76B) {
+        // Waveshare Pico-GPS hat uses the L76B with 9600 baud
+        // Initialize the L76B Chip, use GPS + GLONASS
+        // See note in L76_Series_GNSS_Protocol_Specification, chapter 3.29
+        // This command will reset the GPS and takes longer before it will accept new commands
+        addNMEAStep("$PMTK353,1,1,0,0,0*2B", 1000);
+        // only ask for RMC and GGA (GNRMC and GNGGA)
+        // See note in L76_Series_GNSS_Protocol_Specification, chapter 2.1
+        addNMEAStep("$PMTK314,0,1,0,1,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0*28", 250);
+        // Enable SBAS
+        addNMEAStep("$PMTK301,2*2E", 250);
+        // Enable PPS for 2D/3D fix only
+        addNMEAStep("$PMTK285,3,100*3F", 250);
+        // Switch to Fitness Mode, for running and walking purpose with low speed (<5 m/s)
+        addNMEAStep("$PMTK886,1*29", 250);
+    } else if (gnssModel == GNSS_MODEL_MTK_PA1010D) {
+        // PA1010D is used in the Pimoroni GPS board.
+
+        // Enable all constellations.  This resets the GPS and takes longer before it will accept new commands
+        addNMEAStep("$PMTK353,1,1,1,1,1*2A", 1000);
+        // Only ask for RMC and GGA (GNRMC and GNGGA)
+        addNMEAStep("$PMTK314,0,1,0,1,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0*28", 250);
+        // Enable SBAS / WAAS
+        addNMEAStep("$PMTK301,2*2E", 250);
+    } else if (gnssModel == GNSS_MODEL_MTK_PA1616S) {
+        // PA1616S is used in some GPS breakout boards from Adafruit
+        // PA1616S does not have GLONASS capability. PA1616D does, but is not implemented here.
+        // This resets the GPS and takes longer before it will accept new commands
+        addNMEAStep("$PMTK353,1,0,0,0,0*2A", 1000);
+        // Only ask for RMC and GGA (GNRMC and GNGGA)
+        addNMEAStep("$PMTK314,0,1,0,1,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0*28", 250);
+        // Enable SBAS / WAAS
+        addNMEAStep("$PMTK301,2*2E", 250);
+    } else if (gnssModel == GNSS_MODEL_ATGM336H) {
+        // Set the intial configuration of the device - these _should_ work for most AT6558 devices
+        ADD_CAS_STEP(0x06, 0x07, _message_CAS_CFG_NAVX_CONF, "set ATGM336H config", 250);
+        // Set the update frequence to 1Hz
+        ADD_CAS_STEP(0x06, 0x04, _message_CAS_CFG_RATE_1HZ, "set ATGM336H update frequency", 250);
+        // Set the NEMA output messages, ask for only RMC and GGA
+        ADD_CAS_STEP(0x06, 0x01, _message_CAS_CFG_MSG_RMC, "enable ATGM336H NMEA RMC", 250);
+        ADD_CAS_STEP(0x06, 0x01, _message_CAS_CFG_MSG_GGA, "enable ATGM336H NMEA GGA", 250);
+    } else if (gnssModel == GNSS_MODEL_UC6580) {
+        // The Unicore UC6580 can use a lot of sat systems, enable it to
+        // use GPS L1 & L5 + BDS B1I & B2a + GLONASS L1 + GALILEO E1 & E5a + SBAS + QZSS
+        // This will reset the receiver, so wait a bit afterwards
+        // The paranoid will wait for the OK*04 confirmation response after each command.
+        addNMEAStep("$CFGSYS,h35155", 750);
+        // Must be done after the CFGSYS command
+        // Turn off GSV messages, we don't really care about which and where the sats are, maybe someday.
+        addNMEAStep("$CFGMSG,0,3,0", 250);
+        // Turn off GSA messages, TinyGPS++ doesn't use this message.
+        addNMEAStep("$CFGMSG,0,2,0", 250);
+        // Turn off NOTICE __TXT messages, these may provide Unicore some info but we don't care.
+        addNMEAStep("$CFGMSG,6,0,0", 250);
+        addNMEAStep("$CFGMSG,6,1,0", 250);
+    } else if (IS_ONE_OF(gnssModel, GNSS_MODEL_AG3335, GNSS_MODEL_AG3352)) {
+        addNMEAStep("$PAIR066,1,0,1,0,0,1*3B"); // Enable GPS+GALILEO+NAVIC
+
+        // Configure NMEA (sentences will output once per fix)
+        addNMEAStep("$PAIR062,0,1*3F");      // GGA ON
+        addNMEAStep("$PAIR062,1,0*3F");      // GLL OFF
+        addNMEAStep("$PAIR062,2,0*3C");      // GSA OFF
+        addNMEAStep("$PAIR062,3,0*3D");      // GSV OFF
+        addNMEAStep("$PAIR062,4,1*3B");      // RMC ON
+        addNMEAStep("$PAIR062,5,0*3B");      // VTG OFF
+        addNMEAStep("$PAIR062,6,0*38", 250); // ZDA ON
+
+        addNMEAStep("$PAIR513*3D"); // save configuration
+    } else if (gnssModel == GNSS_MODEL_UBLOX6) {
+        ADD_UBX_STEP(0x06, 0x02, _message_DISABLE_TXT_INFO, "disable text info messages", 500, 0);
+        ADD_UBX_STEP(0x06, 0x39, _message_JAM_6_7, "enable interference resistance", 500, 0);
+        ADD_UBX_STEP(0x06, 0x23, _message_NAVX5, "configure NAVX5 settings", 500, 0);
+
+        // Turn off unwanted NMEA messages, set update rate
+        ADD_UBX_STEP(0x06, 0x08, _message_1HZ, "set GPS update rate", 500, 0);
+        ADD_UBX_STEP(0x06, 0x01, _message_GLL, "disable NMEA GLL", 500, 0);
+        ADD_UBX_STEP(0x06, 0x01, _message_GSA, "enable NMEA GSA", 500, 0);
+        ADD_UBX_STEP(0x06, 0x01, _message_GSV, "disable NMEA GSV", 500, 0);
+        ADD_UBX_STEP(0x06, 0x01, _message_VTG, "disable NMEA VTG", 500, 0);
+        ADD_UBX_STEP(0x06, 0x01, _message_RMC, "enable NMEA RMC", 500, 0);
+        ADD_UBX_STEP(0x06, 0x01, _message_GGA, "enable NMEA GGA", 500, 0);
+
+        ADD_UBX_STEP(0x06, 0x11, _message_CFG_RXM_ECO, "enable powersave ECO mode for Neo-6", 500, 0);
+        ADD_UBX_STEP(0x06, 0x3B, _message_CFG_PM2, "enable powersave details for GPS", 500, 0);
+        ADD_UBX_STEP(0x06, 0x01, _message_AID, "disable UBX-AID", 500, 0);
+
+        ADD_UBX_STEP(0x06, 0x09, _message_SAVE, "save GNSS module config", 2000, 0);
+    } else if (IS_ONE_OF(gnssModel, GNSS_MODEL_UBLOX7, GNSS_MODEL_UBLOX8, GNSS_MODEL_UBLOX9)) {
+        // It's not critical if the module doesn't acknowledge this configuration.
+        // Documentation say, we need wait atleast 0.5s after reconfiguration of GNSS module, before sending next
+        // commands for the M8 it tends to be more... 1 sec should be enough ;>)
+        if (gnssModel == GNSS_MODEL_UBLOX7) {
+            ADD_UBX_STEP(0x06, 0x3e, _message_GNSS_7, "set GPS+SBAS, defaults maintained", 800, 1000);
+        } else { // 8,9
+            ADD_UBX_STEP(0x06, 0x3e, _message_GNSS_8, "set GPS+SBAS+GLONASS+Galileo, defaults maintained", 800, 1000);
+        }
+
+        // Disable Text Info messages //6,7,8,9
+        ADD_UBX_STEP(0x06, 0x02, _message_DISABLE_TXT_INFO, "disable text info messages", 500, 0);
+
+        if (gnssModel == GNSS_MODEL_UBLOX8) { // 8
+            ADD_UBX_STEP(0x06, 0x39, _message_JAM_8, "enable interference resistance", 500, 0);
+            ADD_UBX_STEP(0x06, 0x23, _message_NAVX5_8, "configure NAVX5_8 settings", 500, 0);
+        } else { // 6,7,9
+            ADD_UBX_STEP(0x06, 0x39, _message_JAM_6_7, "enable interference resistance", 500, 0);
+            ADD_UBX_STEP(0x06, 0x23, _message_NAVX5, "configure NAVX5 settings", 500, 0);
+        }
+        // Turn off unwanted NMEA messages, set update rate
+        ADD_UBX_STEP(0x06, 0x08, _message_1HZ, "set GPS update rate", 500, 0);
+        ADD_UBX_STEP(0x06, 0x01, _message_GLL, "disable NMEA GLL", 500, 0);
+        ADD_UBX_STEP(0x06, 0x01, _message_GSA, "enable NMEA GSA", 500, 0);
+        ADD_UBX_STEP(0x06, 0x01, _message_GSV, "disable NMEA GSV", 500, 0);
+        ADD_UBX_STEP(0x06, 0x01, _message_VTG, "disable NMEA VTG", 500, 0);
+        ADD_UBX_STEP(0x06, 0x01, _message_RMC, "enable NMEA RMC", 500, 0);
+        ADD_UBX_STEP(0x06, 0x01, _message_GGA, "enable NMEA GGA", 500, 0);
+
+        if (ublox_info.protocol_version >= 18) {
+            ADD_UBX_STEP(0x06, 0x86, _message_PMS, "enable powersave for GPS", 500, 0);
+            ADD_UBX_STEP(0x06, 0x3B, _message_CFG_PM2, "enable powersave details for GPS", 500, 0);
+
+            // For M8 we want to enable NMEA vserion 4.10 so we can see the additional sats.
+            if (gnssModel == GNSS_MODEL_UBLOX8) {
+                ADD_UBX_STEP(0x06, 0x17, _message_NMEA, "enable NMEA 4.10", 500, 0);
             }
-        } else if (gnssModel == GNSS_MODEL_UBLOX10) {
-            delay(1000);
-            clearBuffer();
-            SEND_UBX_PACKET(0x06, 0x8A, _message_VALSET_DISABLE_NMEA_RAM, "disable NMEA messages in M10 RAM", 300);
-            delay(750);
-            clearBuffer();
-            SEND_UBX_PACKET(0x06, 0x8A, _message_VALSET_DISABLE_NMEA_BBR, "disable NMEA messages in M10 BBR", 300);
-            delay(750);
-            clearBuffer();
-            SEND_UBX_PACKET(0x06, 0x8A, _message_VALSET_DISABLE_TXT_INFO_RAM, "disable Info messages for M10 GPS RAM", 300);
-            delay(750);
-            // Next disable Info txt messages in BBR layer
+        } else {
+            ADD_UBX_STEP(0x06, 0x11, _message_CFG_RXM_PSM, "enable powersave mode for GPS", 500, 0);
+            ADD_UBX_STEP(0x06, 0x3B, _message_CFG_PM2, "enable powersave details for GPS", 500, 0);
+        }
+
+        ADD_UBX_STEP(0x06, 0x09, _message_SAVE, "save GNSS module config", 2000, 0);
+    } else if (gnssModel == GNSS_MODEL_UBLOX10) {
+        addConfigStep(GPS_STEP_PAUSE, 0, 0, NULL, 0, "wait for M10", 0, 1000);
+        // Each of these may cause a receiver restart so wait a bit after them
+        ADD_UBX_STEP(0x06, 0x8A, _message_VALSET_DISABLE_NMEA_RAM, "disable NMEA messages in M10 RAM", 300, 750);
+        ADD_UBX_STEP(0x06, 0x8A, _message_VALSET_DISABLE_NMEA_BBR, "disable NMEA messages in M10 BBR", 300, 750);
+        ADD_UBX_STEP(0x06, 0x8A, _message_VALSET_DISABLE_TXT_INFO_RAM, "disable Info messages for M10 GPS RAM", 300, 750);
+        // Next disable Info txt messages in BBR layer
+        ADD_UBX_STEP(0x06, 0x8A, _message_VALSET_DISABLE_TXT_INFO_BBR, "disable Info messages for M10 GPS BBR", 300, 750);
+        // Do M10 configuration for Power Management.
+        ADD_UBX_STEP(0x06, 0x8A, _message_VALSET_PM_RAM, "enable powersave for M10 GPS RAM", 300, 750);
+        ADD_UBX_STEP(0x06, 0x8A, _message_VALSET_PM_BBR, "enable powersave for M10 GPS BBR", 300, 750);
+        ADD_UBX_STEP(0x06, 0x8A, _message_VALSET_ITFM_RAM, "enable jam detection M10 GPS RAM", 300, 750);
+        ADD_UBX_STEP(0x06, 0x8A, _message_VALSET_ITFM_BBR, "enable jam detection M10 GPS BBR", 300, 750);
+        // Here is where the init commands should go to do further M10 initialization.
+        ADD_UBX_STEP(0x06, 0x8A, _message_VALSET_DISABLE_SBAS_RAM, "disable SBAS M10 GPS RAM", 300, 750);
+        ADD_UBX_STEP(0x06, 0x8A, _message_VALSET_DISABLE_SBAS_BBR, "disable SBAS M10 GPS BBR", 300, 750);
+
+        // Done with initialization, Now enable wanted NMEA messages in BBR layer so they will survive a periodic
+        // sleep.
+        ADD_UBX_STEP(0x06, 0x8A, _message_VALSET_ENABLE_NMEA_BBR, "enable messages for M10 GPS BBR", 300, 750);
+        // Next enable wanted NMEA messages in RAM layer
+        ADD_UBX_STEP(0x06, 0x8A, _message_VALSET_ENABLE_NMEA_RAM, "enable messages for M10 GPS RAM", 500, 750);
+
+        // As the M10 has no flash, the best we can do to preserve the config is to set it in RAM and BBR.
+        // BBR will survive a restart, and power off for a while, but modules with small backup
+        // batteries or super caps will not retain the config for a long power off time.
+        ADD_UBX_STEP(0x06, 0x09, _message_SAVE_10, "save GNSS module config", 2000, 0);
+    }
+}
+
+/// Send config steps from initStep on, until one has to wait for an ACK or a pause
+void GPS::runConfigStep()
+{
+    while (initStep < numConfigSteps) {
+        const GPSConfigStep &step = configSteps[initStep];
+        if (step.ackMs) {
             clearBuffer();
-            SEND_UBX_PACKET(0x06, 0x8A, _message_VALSET_DISABLE_TXT_INFO_BBR, "disable Info messages for M10 GPS BBR", 300);
-            delay(750);
-            // Do M10 configuration for Power Management.
-            SEND_UBX_PACKET(0x06, 0x8A, _message_VALSET_PM_RAM, "enable powersave for M10 GPS RAM", 300);
-            delay(750);
-            SEND_UBX_PACKET(0x06, 0x8A, _message_VALSET_PM_BBR, "enable powersave for M10 GPS BBR", 300);
-            delay(750);
-            SEND_UBX_PACKET(0x06, 0x8A, _message_VALSET_ITFM_RAM, "enable jam detection M10 GPS RAM", 300);
-            delay(750);
-            SEND_UBX_PACKET(0x06, 0x8A, _message_VALSET_ITFM_BBR, "enable jam detection M10 GPS BBR", 300);
-            delay(750);
-            // Here is where the init commands should go to do further M10 initialization.
-            SEND_UBX_PACKET(0x06, 0x8A, _message_VALSET_DISABLE_SBAS_RAM, "disable SBAS M10 GPS RAM", 300);
-            delay(750); // will cause a receiver restart so wait a bit
-            SEND_UBX_PACKET(0x06, 0x8A, _message_VALSET_DISABLE_SBAS_BBR, "disable SBAS M10 GPS BBR", 300);
-            delay(750); // will cause a receiver restart so wait a bit
-
-            // Done with initialization, Now enable wanted NMEA messages in BBR layer so they will survive a periodic
-            // sleep.
-            SEND_UBX_PACKET(0x06, 0x8A, _message_VALSET_ENABLE_NMEA_BBR, "enable messages for M10 GPS BBR", 300);
-            delay(750);
-            // Next enable wanted NMEA messages in RAM layer
-            SEND_UBX_PACKET(0x06, 0x8A, _message_VALSET_ENABLE_NMEA_RAM, "enable messages for M10 GPS RAM", 500);
-            delay(750);
-
-            // As the M10 has no flash, the best we can do to preserve the config is to set it in RAM and BBR.
-            // BBR will survive a restart, and power off for a while, but modules with small backup
-            // batteries or super caps will not retain the config for a long power off time.
-            msglen = makeUBXPacket(0x06, 0x09, sizeof(_message_SAVE_10), _message_SAVE_10);
+            parser.reset();
+        }
+
+        uint8_t msglen;
+        switch (step.kind) {
+        case GPS_STEP_NMEA:
+            _serial_gps->write(step.sentence);
+            _serial_gps->write("\r\n");
+            break;
+        case GPS_STEP_UBX:
+            msglen = makeUBXPacket(step.cls, step.id, step.len, step.payload);
             _serial_gps->write(UBXscratch, msglen);
-            if (getACK(0x06, 0x09, 2000) != GNSS_RESPONSE_OK) {
-                LOG_WARN("Unable to save GNSS module config");
-            } else {
-                LOG_INFO("GNSS module configuration saved!");
-            }
+            break;
+        case GPS_STEP_CAS:
+            msglen = makeCASPacket(step.cls, step.id, step.len, step.payload);
+            _serial_gps->write(UBXscratch, msglen);
+            break;
+        case GPS_STEP_PAUSE:
+            break;
         }
-        didSerialInit = true;
+
+        ackPending = step.ackMs != 0;
+        if (step.ackMs || step.pauseMs) {
+            setInitState(GPS_INIT_CONFIGURE, step.ackMs ? step.ackMs : step.pauseMs);
+            return;
+        }
+        initStep++;
     }
+    finishInit();
+}
 
+void GPS::configStepAnswered(GPS_RESPONSE response)
+{
+    const GPSConfigStep &step = configSteps[initStep];
+    ackPending = false;
+    if (response == GNSS_RESPONSE_OK) {
+#ifdef GPS_DEBUG
+        LOG_INFO("Got ACK for class %02X message %02X in %dms", step.cls, step.id, millis() - initStateStartMsec);
+#endif
+        if (step.kind == GPS_STEP_UBX && step.cls == 0x06 && step.id == 0x09)
+            LOG_INFO("GNSS module config saved!");
+    } else {
+        if (response == GNSS_RESPONSE_NAK)
+            LOG_WARN("Got NAK for class %02X message %02X", step.cls, step.id);
+        LOG_WARN(failMessage, step.what);
+    }
+
+    // Nothing changed on a NAK, so nothing to wait for
+    if (step.pauseMs && response != GNSS_RESPONSE_NAK) {
+        setInitState(GPS_INIT_CONFIGURE, step.pauseMs);
+        return;
+    }
+    initStep++;
+    runConfigStep();
+}
+
+void GPS::finishInit()
+{
+    initDoneMsec = millis();
+    if (gnssModel != GNSS_MODEL_UNKNOWN)
+        didSerialInit = true;
+    setInitState(GPS_INIT_DONE, 0);
+    LOG_INFO("GPS init took %u ms (%s), longest GPS thread run %u us", initDoneMsec - initStartMsec,
+             gnssModel == GNSS_MODEL_UNKNOWN ? "no module found" : (modelFromCache ? "cached model" : "probed"),
+             getStats().maxRunUsec);
     notifyDeepSleepObserver.observe(&notifyDeepSleep);
+}
 
-    return true;
+GPSInitStats GPS::getInitStats() const
+{
+    GPSInitStats stats = {};
+    if (initState == GPS_INIT_DONE)
+        stats.initMsec = initDoneMsec - initStartMsec;
+    stats.firstFixMsec = firstFixMsec;
+    stats.maxRunUsec = getStats().maxRunUsec;
+    stats.fromCache = modelFromCache;
+    return stats;
 }
 
 GPS::~GPS()
@@ -1081,8 +1356,9 @@ int32_t GPS::runOnce()
             LOG_INFO("GPS set to not-present. Skip probe");
             return disable();
         }
-        if (!setup())
-            return 2000; // Setup failed, re-run in two seconds
+        int32_t wait = setup();
+        if (wait)
+            return wait; // Still probing or configuring, come back for the replies
 
         // We have now loaded our saved preferences from flash
         if (config.position.gps_mode != meshtastic_Config_PositionConfig_GpsMode_ENABLED) {
@@ -1116,6 +1392,10 @@ int32_t GPS::runOnce()
     bool gotLoc = lookForLocation();
     if (gotLoc && !hasValidLocation) { // declare that we have location ASAP
         LOG_DEBUG("hasValidLocation RISING EDGE");
+        if (!firstFixMsec) {
+            firstFixMsec = millis();
+            LOG_INFO("First GPS fix %u ms after boot, %u ms after GPS init", firstFixMsec, firstFixMsec - initDoneMsec);
+        }
         hasValidLocation = true;
         shouldPublish = true;
     }
@@ -1171,219 +1451,6 @@ int GPS::prepareDeepSleep(void *unused)
     return 0;
 }
 
-static const char *PROBE_MESSAGE = "Trying %s (%s)...";
-static const char *DETECTED_MESSAGE = "%s detected";
-
-#define PROBE_SIMPLE(CHIP, TOWRITE, RESPONSE, DRIVER, TIMEOUT, ...)                                                              \
-    do {                                                                                                                         \
-        LOG_DEBUG(PROBE_MESSAGE, TOWRITE, CHIP);                                                                                 \
-        clearBuffer();                                                                                                           \
-        _serial_gps->write(TOWRITE "\r\n");                                                                                      \
-        if (getACK(RESPONSE, TIMEOUT) == GNSS_RESPONSE_OK) {                                                                     \
-            LOG_INFO(DETECTED_MESSAGE, CHIP);                                                                                    \
-            return DRIVER;                                                                                                       \
-        }                                                                                                                        \
-    } while (0)
-
-#define PROBE_FAMILY(FAMILY_NAME, COMMAND, RESPONSE_MAP, TIMEOUT)                                                                \
-    do {                                                                                                                         \
-        LOG_DEBUG(PROBE_MESSAGE, COMMAND, FAMILY_NAME);                                                                          \
-        clearBuffer();                                                                                                           \
-        _serial_gps->write(COMMAND "\r\n");                                                                                      \
-        GnssModel_t detectedDriver = getProbeResponse(TIMEOUT, RESPONSE_MAP);                                                    \
-        if (detectedDriver != GNSS_MODEL_UNKNOWN) {                                                                              \
-            return detectedDriver;                                                                                               \
-        }                                                                                                                        \
-    } while (0)
-
-GnssModel_t GPS::probe(int serialSpeed)
-{
-#if defined(ARCH_NRF52) || defined(ARCH_PORTDUINO) || defined(ARCH_STM32WL)
-    _serial_gps->end();
-    _serial_gps->begin(serialSpeed);
-#elif defined(ARCH_RP2040)
-    _serial_gps->end();
-    _serial_gps->setFIFOSize(256);
-    _serial_gps->begin(serialSpeed);
-#else
-    if (_serial_gps->baudRate() != serialSpeed) {
-        LOG_DEBUG("Set Baud to %i", serialSpeed);
-        _serial_gps->updateBaudRate(serialSpeed);
-    }
-#endif
-
-    memset(&ublox_info, 0, sizeof(ublox_info));
-    uint8_t buffer[768] = {0};
-    delay(100);
-
-    // Close all NMEA sentences, valid for L76K, ATGM336H (and likely other AT6558 devices)
-    _serial_gps->write("$PCAS03,0,0,0,0,0,0,0,0,0,0,,,0,0*02\r\n");
-    delay(20);
-    // Close NMEA sequences on Ublox
-    _serial_gps->write("$PUBX,40,GLL,0,0,0,0,0,0*5C\r\n");
-    _serial_gps->write("$PUBX,40,GSV,0,0,0,0,0,0*59\r\n");
-    _serial_gps->write("$PUBX,40,VTG,0,0,0,0,0,0*5E\r\n");
-    delay(20);
-
-    // Unicore UFirebirdII Series: UC6580, UM620, UM621, UM670A, UM680A, or UM681A
-    std::vector<ChipInfo> unicore = {{"UC6580", "UC6580", GNSS_MODEL_UC6580}, {"UM600", "UM600", GNSS_MODEL_UC6580}};
-    PROBE_FAMILY("Unicore Family", "$PDTINFO", unicore, 500);
-
-    std::vector<ChipInfo> atgm = {
-        {"ATGM336H", "$GPTXT,01,01,02,HW=ATGM336H", GNSS_MODEL_ATGM336H},
-        /* ATGM332D series (-11(GPS), -21(BDS), -31(GPS+BDS), -51(GPS+GLONASS), -71-0(GPS+BDS+GLONASS)) based on AT6558 */
-        {"ATGM332D", "$GPTXT,01,01,02,HW=ATGM332D", GNSS_MODEL_ATGM336H}};
-    PROBE_FAMILY("ATGM33xx Family", "$PCAS06,1*1A", atgm, 500);
-
-    /* Airoha (Mediatek) AG3335A/M/S, A3352Q, Quectel L89 2.0, SimCom SIM65M */
-    _serial_gps->write("$PAIR062,2,0*3C\r\n"); // GSA OFF to reduce volume
-    _serial_gps->write("$PAIR062,3,0*3D\r\n"); // GSV OFF to reduce volume
-    _serial_gps->write("$PAIR513*3D\r\n");     // save configuration
-    std::vector<ChipInfo> airoha = {{"AG3335", "$PAIR021,AG3335", GNSS_MODEL_AG3335},
-                                    {"AG3352", "$PAIR021,AG3352", GNSS_MODEL_AG3352},
-                                    {"RYS3520", "$PAIR021,REYAX_RYS3520_V2", GNSS_MODEL_AG3352}};
-    PROBE_FAMILY("Airoha Family", "$PAIR021*39", airoha, 1000);
-
-    PROBE_SIMPLE("LC86", "$PQTMVERNO*58", "$PQTMVERNO,LC86", GNSS_MODEL_AG3352, 500);
-    PROBE_SIMPLE("L76K", "$PCAS06,0*1B", "$GPTXT,01,01,02,SW=", GNSS_MODEL_MTK, 500);
-
-    // Close all NMEA sentences, valid for MTK3333 and MTK3339 platforms
-    _serial_gps->write("$PMTK514,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0*2E\r\n");
-    delay(20);
-    std::vector<ChipInfo> mtk = {{"L76B", "Quectel-L76B", GNSS_MODEL_MTK_L76B}, {"PA1010D", "1010D", GNSS_MODEL_MTK_PA1010D},
-                                 {"PA1616S", "1616S", GNSS_MODEL_MTK_PA1616S},  {"LS20031", "MC-1513", GNSS_MODEL_MTK_L76B},
-                                 {"L96", "Quectel-L96", GNSS_MODEL_MTK_L76B},   {"L80-R", "_3337_", GNSS_MODEL_MTK_L76B},
-                                 {"L80", "_3339_", GNSS_MODEL_MTK_L76B}};
-
-    PROBE_FAMILY("MTK Family", "$PMTK605*31", mtk, 500);
-
-    uint8_t cfg_rate[] = {0xB5, 0x62, 0x06, 0x08, 0x00, 0x00, 0x00, 0x00};
-    UBXChecksum(cfg_rate, sizeof(cfg_rate));
-    clearBuffer();
-    _serial_gps->write(cfg_rate, sizeof(cfg_rate));
-    // Check that the returned response class and message ID are correct
-    GPS_RESPONSE response = getACK(0x06, 0x08, 750);
-    if (response == GNSS_RESPONSE_NONE) {
-        LOG_WARN("No GNSS Module (baudrate %d)", serialSpeed);
-        return GNSS_MODEL_UNKNOWN;
-    } else if (response == GNSS_RESPONSE_FRAME_ERRORS) {
-        LOG_INFO("UBlox Frame Errors (baudrate %d)", serialSpeed);
-    }
-
-    memset(buffer, 0, sizeof(buffer));
-    uint8_t _message_MONVER[8] = {
-        0xB5, 0x62, // Sync message for UBX protocol
-        0x0A, 0x04, // Message class and ID (UBX-MON-VER)
-        0x00, 0x00, // Length of payload (we're asking for an answer, so no payload)
-        0x00, 0x00  // Checksum
-    };
-    //  Get Ublox gnss module hardware and software info
-    UBXChecksum(_message_MONVER, sizeof(_message_MONVER));
-    clearBuffer();
-    _serial_gps->write(_message_MONVER, sizeof(_message_MONVER));
-
-    uint16_t len = getACK(buffer, sizeof(buffer), 0x0A, 0x04, 1200);
-    if (len) {
-        uint16_t position = 0;
-        for (int i = 0; i < 30; i++) {
-            ublox_info.swVersion[i] = buffer[position];
-            position++;
-        }
-        for (int i = 0; i < 10; i++) {
-            ublox_info.hwVersion[i] = buffer[position];
-            position++;
-        }
-
-        while (len >= position + 30) {
-            for (int i = 0; i < 30; i++) {
-                ublox_info.extension[ublox_info.extensionNo][i] = buffer[position];
-                position++;
-            }
-            ublox_info.extensionNo++;
-            if (ublox_info.extensionNo > 9)
-                break;
-        }
-
-        LOG_DEBUG("Module Info : ");
-        LOG_DEBUG("Soft version: %s", ublox_info.swVersion);
-        LOG_DEBUG("Hard version: %s", ublox_info.hwVersion);
-        LOG_DEBUG("Extensions:%d", ublox_info.extensionNo);
-        for (int i = 0; i < ublox_info.extensionNo; i++) {
-            LOG_DEBUG("  %s", ublox_info.extension[i]);
-        }
-
-        memset(buffer, 0, sizeof(buffer));
-
-        // tips: extensionNo field is 0 on some 6M GNSS modules
-        for (int i = 0; i < ublox_info.extensionNo; ++i) {
-            if (!strncmp(ublox_info.extension[i], "MOD=", 4)) {
-                strncpy((char *)buffer, &(ublox_info.extension[i][4]), sizeof(buffer));
-            } else if (!strncmp(ublox_info.extension[i], "PROTVER", 7)) {
-                char *ptr = nullptr;
-                memset(buffer, 0, sizeof(buffer));
-                strncpy((char *)buffer, &(ublox_info.extension[i][8]), sizeof(buffer));
-                LOG_DEBUG("Protocol Version:%s", (char *)buffer);
-                if (strlen((char *)buffer)) {
-                    ublox_info.protocol_version = strtoul((char *)buffer, &ptr, 10);
-                    LOG_DEBUG("ProtVer=%d", ublox_info.protocol_version);
-                } else {
-                    ublox_info.protocol_version = 0;
-                }
-            }
-        }
-        if (strncmp(ublox_info.hwVersion, "00040007", 8) == 0) {
-            LOG_INFO(DETECTED_MESSAGE, "U-blox 6", "6");
-            return GNSS_MODEL_UBLOX6;
-        } else if (strncmp(ublox_info.hwVersion, "00070000", 8) == 0) {
-            LOG_INFO(DETECTED_MESSAGE, "U-blox 7", "7");
-            return GNSS_MODEL_UBLOX7;
-        } else if (strncmp(ublox_info.hwVersion, "00080000", 8) == 0) {
-            LOG_INFO(DETECTED_MESSAGE, "U-blox 8", "8");
-            return GNSS_MODEL_UBLOX8;
-        } else if (strncmp(ublox_info.hwVersion, "00190000", 8) == 0) {
-            LOG_INFO(DETECTED_MESSAGE, "U-blox 9", "9");
-            return GNSS_MODEL_UBLOX9;
-        } else if (strncmp(ublox_info.hwVersion, "000A0000", 8) == 0) {
-            LOG_INFO(DETECTED_MESSAGE, "U-blox 10", "10");
-            return GNSS_MODEL_UBLOX10;
-        }
-    }
-    LOG_WARN("No GNSS Module (baudrate %d)", serialSpeed);
-    return GNSS_MODEL_UNKNOWN;
-}
-
-GnssModel_t GPS::getProbeResponse(unsigned long timeout, const std::vector<ChipInfo> &responseMap)
-{
-    String response = "";
-    unsigned long start = millis();
-    while (millis() - start < timeout) {
-        if (_serial_gps->available()) {
-            response += (char)_serial_gps->read();
-
-            if (response.endsWith(",") || response.endsWith("\r\n")) {
-#ifdef GPS_DEBUG
-                LOG_DEBUG(response.c_str());
-#endif
-                // check if we can see our chips
-                for (const auto &chipInfo : responseMap) {
-                    if (strstr(response.c_str(), chipInfo.detectionString.c_str()) != nullptr) {
-                        LOG_INFO("%s detected", chipInfo.chipName.c_str());
-                        return chipInfo.driver;
-                    }
-                }
-            }
-            if (response.endsWith("\r\n")) {
-                response.trim();
-                response = ""; // Reset the response string for the next potential message
-            }
-        }
-    }
-#ifdef GPS_DEBUG
-    LOG_DEBUG(response.c_str());
-#endif
-    return GNSS_MODEL_UNKNOWN; // Return empty string on timeout
-}
-
 GPS *GPS::createGps()
 {
     int8_t _rx_gpio = config.position.rx_gpio;
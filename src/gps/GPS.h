@@ -2,6 +2,7 @@
 #include "configuration.h"
 #if !MESHTASTIC_EXCLUDE_GPS
 
+#include "GPSFrameParser.h"
 #include "GPSStatus.h"
 #include "GpioLogic.h"
 #include "Observer.h"
@@ -49,11 +50,47 @@ enum GPSPowerState : uint8_t {
     GPS_OFF        // Powered off indefinitely
 };
 
-struct ChipInfo {
-    String chipName;        // The name of the chip (for logging)
-    String detectionString; // The string to match in the response
-    GnssModel_t driver;     // The driver to use
+/// Where GPS::setup() is in bringing up the module, see GPS::setup()
+enum GPSInitState : uint8_t {
+    GPS_INIT_START,             // Nothing done yet
+    GPS_INIT_VERIFY_CACHE,      // At the cached baud rate, waiting for a good frame
+    GPS_INIT_VERIFY_MODEL,      // Sent the cached model's probe query (or UBX-MON-VER), waiting for a reply naming that model
+    GPS_INIT_POWER_CYCLE,       // Stepping through the power up sequence of the board before a probe
+    GPS_INIT_SET_BAUD,          // Changed baud rate, letting the UART settle
+    GPS_INIT_PROBE_SETTLE,      // Sent the preamble of a probe step, giving the module time to act on it
+    GPS_INIT_PROBE_QUERY,       // Sent the query of a probe step, waiting for a matching reply
+    GPS_INIT_PROBE_UBX_RATE,    // Polled UBX-CFG-RATE, waiting for an ACK/NAK
+    GPS_INIT_PROBE_UBX_VERSION, // Polled UBX-MON-VER, waiting for it
+    GPS_INIT_CONFIGURE,         // Sent a config step, waiting for its ACK or the pause after it
+    GPS_INIT_DONE
 };
+
+enum GPSConfigStepKind : uint8_t { GPS_STEP_NMEA, GPS_STEP_UBX, GPS_STEP_CAS, GPS_STEP_PAUSE };
+
+/// One command of the configuration for a model, see GPS::buildConfigSteps()
+struct GPSConfigStep {
+    GPSConfigStepKind kind;
+    uint8_t cls, id;        // UBX/CAS class and message id
+    uint8_t len;            // UBX/CAS payload length
+    const uint8_t *payload; // UBX/CAS payload
+    const char *sentence;   // NMEA sentence, without the line ending
+    uint16_t ackMs;         // How long to wait for the ACK/NAK, 0 to not wait for one
+    uint16_t pauseMs;       // How long the module needs before the next command, not waited if it NAKed this one
+    const char *what;       // For "Unable to %s" if it isn't acknowledged
+};
+
+#ifndef GPS_MAX_CONFIG_STEPS
+#define GPS_MAX_CONFIG_STEPS 20
+#endif
+
+/// How bringing up the GPS went, see GPS::getInitStats()
+struct GPSInitStats {
+    uint32_t initMsec;     // From the first setup() call until the module was configured (or given up on), 0 until then
+    uint32_t firstFixMsec; // millis() at the first valid location, 0 until then
+    uint32_t maxRunUsec;   // Longest the GPS thread held up the main loop
+    bool fromCache;        // Model and baud rate came from the cache, not a probe
+};
+
 /**
  * A gps class that only reads from the GPS periodically and keeps the gps powered down except when reading
  *
@@ -77,9 +114,12 @@ class GPS : private concurrency::OSThread
     Observable<const meshtastic::GPSStatus *> newStatus;
 
     /**
-     * Returns true if we succeeded
+     * Take the next step of finding out which module we have and configuring it.  Never waits for the module: commands are
+     * sent and the replies are picked out of the serial data on later calls.
+     *
+     * @return msecs until it wants to be called again, 0 once it is done
      */
-    virtual bool setup();
+    virtual int32_t setup();
 
     // re-enable the thread
     void enable();
@@ -117,6 +157,8 @@ class GPS : private concurrency::OSThread
     // Let the GPS hardware save power between updates
     void down();
 
+    GPSInitStats getInitStats() const;
+
   private:
     GPS() : concurrency::OSThread("GPS") {}
 
@@ -166,6 +208,20 @@ class GPS : private concurrency::OSThread
     uint8_t speedSelect = 0;
     uint8_t probeTries = 0;
 
+    // State of setup(), see GPSInitState
+    GPSFrameParser parser;
+    GPSInitState initState = GPS_INIT_START;
+    uint32_t initStateStartMsec = 0;
+    uint32_t initStateWaitMsec = 0;
+    uint8_t initStep = 0;     // Index into the power up sequence, probe steps or config steps
+    bool ackPending = false;  // The current config step is waiting for its ACK, not its pause
+    uint32_t serialSpeed = 0; // Baud rate the module is being talked to at
+    uint32_t initStartMsec = 0, initDoneMsec = 0, firstFixMsec = 0;
+    bool modelFromCache = false;
+
+    GPSConfigStep configSteps[GPS_MAX_CONFIG_STEPS];
+    uint8_t numConfigSteps = 0;
+
     /**
      * hasValidLocation - indicates that the position variables contain a complete
      *   GPS location, valid and fresh (< gps_update_interval + position_broadcast_secs)
@@ -203,11 +259,32 @@ class GPS : private concurrency::OSThread
 
     int rebootsSeen = 0;
 
-    int getACK(uint8_t *buffer, uint16_t size, uint8_t requestedClass, uint8_t requestedID, uint32_t waitMillis);
-    GPS_RESPONSE getACK(uint8_t c, uint8_t i, uint32_t waitMillis);
-    GPS_RESPONSE getACK(const char *message, uint32_t waitMillis);
-
-    GPS_RESPONSE getACKCas(uint8_t class_id, uint8_t msg_id, uint32_t waitMillis);
+    void setInitState(GPSInitState state, uint32_t waitMsec);
+    bool handleInitFrame(GPSFrameType type);
+    void handleInitTimeout();
+
+    void setSerialSpeed(uint32_t speed);
+    void startProbe();
+    void nextProbeSpeed();
+    void sendProbeStep();
+    void sendProbeQuery();
+    void probeFound(GnssModel_t model);
+    void sendCacheQuery();
+    void abandonCache();
+    GnssModel_t parseMonVer(const uint8_t *payload, uint16_t len);
+
+    void startConfigure();
+    void buildConfigSteps();
+    bool addConfigStep(GPSConfigStepKind kind, uint8_t cls, uint8_t id, const uint8_t *payload, uint8_t len, const char *what,
+                       uint16_t ackMs, uint16_t pauseMs = 0);
+    void addNMEAStep(const char *sentence, uint16_t pauseMs = 0);
+    void runConfigStep();
+    void configStepAnswered(GPS_RESPONSE response);
+    void finishInit();
+
+    bool loadCache();
+    void saveCache(uint8_t probeStep);
+    void removeCache();
 
     /// Prepare the GPS for the cpu entering deep sleep, expect to be gone for at least 100s of msecs
     /// always returns 0 to indicate okay to sleep
@@ -236,11 +313,6 @@ class GPS : private concurrency::OSThread
 
     virtual int32_t runOnce() override;
 
-    GnssModel_t getProbeResponse(unsigned long timeout, const std::vector<ChipInfo> &responseMap);
-
-    // Get GNSS model
-    GnssModel_t probe(int serialSpeed);
-
     // delay counter to allow more sats before fixed position stops GPS thread
     uint8_t fixeddelayCtr = 0;
 };
@@ -0,0 +1,181 @@
+#include "GPSFrameParser.h"
+
+#include <string.h>
+
+static uint8_t hexValue(char c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    return 0xFF;
+}
+
+void GPSFrameParser::reset()
+{
+    state = IDLE;
+    pos = 0;
+    length = 0;
+}
+
+GPSFrameType GPSFrameParser::startFrame(uint8_t c)
+{
+    pos = 0;
+    switch (c) {
+    case '$':
+        buf[0] = c;
+        length = 1;
+        state = NMEA_BODY;
+        break;
+    case 0xB5:
+        state = UBX_SYNC;
+        break;
+    case 0xBA:
+        state = CAS_SYNC;
+        break;
+    default:
+        state = IDLE;
+        break;
+    }
+    return GPS_FRAME_NONE;
+}
+
+GPSFrameType GPSFrameParser::endSentence()
+{
+    state = IDLE;
+    buf[length] = 0;
+    const char *star = (const char *)memchr(buf, '*', length);
+    checksummed = star != NULL;
+    if (!checksummed)
+        return GPS_FRAME_NMEA;
+
+    uint8_t sum = 0;
+    for (const char *p = (const char *)buf + 1; p < star; p++)
+        sum ^= *p;
+    size_t starAt = star - (const char *)buf;
+    if (starAt + 3 != length || hexValue(star[1]) > 15 || hexValue(star[2]) > 15 ||
+        (hexValue(star[1]) << 4 | hexValue(star[2])) != sum) {
+        errors++;
+        return GPS_FRAME_NONE;
+    }
+    return GPS_FRAME_NMEA;
+}
+
+bool GPSFrameParser::casChecksumMatches() const
+{
+    // Sum of id << 24, class << 16, length and the payload taken as little endian 32 bit words
+    uint32_t sum = ((uint32_t)id << 24) + ((uint32_t)cls << 16) + length;
+    for (uint16_t i = 0; i + 4 <= length; i += 4)
+        sum += (uint32_t)buf[i] | (uint32_t)buf[i + 1] << 8 | (uint32_t)buf[i + 2] << 16 | (uint32_t)buf[i + 3] << 24;
+    uint32_t got = (uint32_t)check[0] | (uint32_t)check[1] << 8 | (uint32_t)check[2] << 16 | (uint32_t)check[3] << 24;
+    return sum == got;
+}
+
+GPSFrameType GPSFrameParser::feed(uint8_t c)
+{
+    switch (state) {
+    case IDLE:
+        return startFrame(c);
+
+    case NMEA_BODY:
+        if (c == '\n' || c == '\r')
+            return length > 1 ? endSentence() : startFrame(c);
+        if (c < 0x20 || c > 0x7E) {
+            // Binary in the middle of a sentence, the sentence was cut off, this may start a frame
+            errors++;
+            return startFrame(c);
+        }
+        if (c == '$')
+            return startFrame(c); // Lost the end of the previous one
+        if (length >= GPS_FRAME_MAX_SENTENCE) {
+            errors++;
+            state = IDLE;
+            return GPS_FRAME_NONE;
+        }
+        buf[length++] = c;
+        return GPS_FRAME_NONE;
+
+    case UBX_SYNC:
+        if (c != 0x62)
+            return startFrame(c);
+        state = UBX_HEADER;
+        ckA = ckB = 0;
+        return GPS_FRAME_NONE;
+
+    case CAS_SYNC:
+        if (c != 0xCE)
+            return startFrame(c);
+        state = CAS_HEADER;
+        return GPS_FRAME_NONE;
+
+    case UBX_HEADER:
+    case CAS_HEADER:
+        if (state == UBX_HEADER) {
+            ckA += c;
+            ckB += ckA;
+        }
+        header[pos++] = c;
+        if (pos < 4)
+            return GPS_FRAME_NONE;
+        // UBX has class, id then the length, CAS the length first
+        if (state == UBX_HEADER) {
+            cls = header[0];
+            id = header[1];
+            length = header[2] | header[3] << 8;
+        } else {
+            length = header[0] | header[1] << 8;
+            cls = header[2];
+            id = header[3];
+        }
+        if (length > GPS_FRAME_MAX_PAYLOAD) {
+            // Too big to keep, or a false sync in other data.  Drop it rather than read past what may be good frames
+            errors++;
+            state = IDLE;
+            return GPS_FRAME_NONE;
+        }
+        pos = 0;
+        if (state == UBX_HEADER)
+            state = length ? UBX_PAYLOAD : UBX_CHECKSUM;
+        else
+            state = length ? CAS_PAYLOAD : CAS_CHECKSUM;
+        return GPS_FRAME_NONE;
+
+    case UBX_PAYLOAD:
+    case CAS_PAYLOAD:
+        if (state == UBX_PAYLOAD) {
+            ckA += c;
+            ckB += ckA;
+        }
+        buf[pos] = c;
+        if (++pos < length)
+            return GPS_FRAME_NONE;
+        pos = 0;
+        state = state == UBX_PAYLOAD ? UBX_CHECKSUM : CAS_CHECKSUM;
+        return GPS_FRAME_NONE;
+
+    case UBX_CHECKSUM:
+        check[pos++] = c;
+        if (pos < 2)
+            return GPS_FRAME_NONE;
+        state = IDLE;
+        if (check[0] != ckA || check[1] != ckB) {
+            errors++;
+            return GPS_FRAME_NONE;
+        }
+        return GPS_FRAME_UBX;
+
+    case CAS_CHECKSUM:
+        check[pos++] = c;
+        if (pos < 4)
+            return GPS_FRAME_NONE;
+        state = IDLE;
+        if (!casChecksumMatches()) {
+            errors++;
+            return GPS_FRAME_NONE;
+        }
+        return GPS_FRAME_CAS;
+    }
+    return GPS_FRAME_NONE;
+}
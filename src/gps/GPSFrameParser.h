@@ -0,0 +1,79 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/// Longest NMEA sentence kept, MTK and Unicore version replies run well past the 82 characters of the standard
+#ifndef GPS_FRAME_MAX_SENTENCE
+#define GPS_FRAME_MAX_SENTENCE 160
+#endif
+
+/// Largest UBX/CAS payload kept, enough for a UBX-MON-VER with 10 extensions.  Longer frames are dropped
+#ifndef GPS_FRAME_MAX_PAYLOAD
+#define GPS_FRAME_MAX_PAYLOAD 384
+#endif
+
+enum GPSFrameType : uint8_t { GPS_FRAME_NONE, GPS_FRAME_NMEA, GPS_FRAME_UBX, GPS_FRAME_CAS };
+
+/**
+ * Splits the byte stream of a GNSS module into NMEA sentences, UBX frames (B5 62) and CASIC frames (BA CE), one byte at a
+ * time, so the GPS thread can hand it whatever the UART has and come back later instead of waiting for a reply.
+ *
+ * Binary frames are only returned when their checksum is right.  NMEA sentences with a *hh checksum are only returned when it
+ * matches, sentences without one are returned as they are, hasChecksum() tells them apart.
+ */
+class GPSFrameParser
+{
+  public:
+    /// Feed one byte.  @return the type of frame it completed, the frame can be read until the next call
+    GPSFrameType feed(uint8_t c);
+
+    /// Start over, dropping any partial frame
+    void reset();
+
+    /// The last NMEA sentence, NUL terminated and without the line ending
+    const char *getSentence() const { return (const char *)buf; }
+
+    /// Whether the last NMEA sentence carried a checksum (which then matched)
+    bool hasChecksum() const { return checksummed; }
+
+    uint8_t getClass() const { return cls; }
+    uint8_t getId() const { return id; }
+    const uint8_t *getPayload() const { return buf; }
+    uint16_t getPayloadLength() const { return length; }
+
+    /// Frames dropped because of a bad checksum or because they didn't fit
+    uint32_t getErrors() const { return errors; }
+
+  private:
+    enum State : uint8_t {
+        IDLE,
+        NMEA_BODY,
+        UBX_SYNC,
+        UBX_HEADER,
+        UBX_PAYLOAD,
+        UBX_CHECKSUM,
+        CAS_SYNC,
+        CAS_HEADER,
+        CAS_PAYLOAD,
+        CAS_CHECKSUM,
+    };
+
+    static const size_t BUF_SIZE = GPS_FRAME_MAX_PAYLOAD > GPS_FRAME_MAX_SENTENCE ? GPS_FRAME_MAX_PAYLOAD + 1
+                                                                                  : GPS_FRAME_MAX_SENTENCE + 1;
+
+    GPSFrameType startFrame(uint8_t c);
+    GPSFrameType endSentence();
+    bool casChecksumMatches() const;
+
+    uint8_t buf[BUF_SIZE] = {};
+    State state = IDLE;
+    uint16_t pos = 0;    // Bytes of the current part (header, payload or checksum) seen so far
+    uint16_t length = 0; // Payload length, or sentence length while in NMEA_BODY
+    uint8_t header[4] = {};
+    uint8_t check[4] = {};
+    uint8_t ckA = 0, ckB = 0;
+    uint8_t cls = 0, id = 0;
+    bool checksummed = false;
+    uint32_t errors = 0;
+};
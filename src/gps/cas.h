@@ -19,6 +19,9 @@
 // Size of a CAS-ACK-(N)ACK message (14 bytes)
 #define CAS_ACK_NACK_MSG_SIZE 0x0E
 
+// Queue a CAS message from one of the arrays below as a config step, see GPS::buildConfigSteps()
+#define ADD_CAS_STEP(TYPE, ID, DATA, WHAT, ACK_MS) addConfigStep(GPS_STEP_CAS, TYPE, ID, DATA, sizeof(DATA), WHAT, ACK_MS)
+
 // CFG-RST (0x06, 0x02)
 // Factory reset
 static const uint8_t _message_CAS_CFG_RST_FACTORY[] = {
@@ -61,3 +64,17 @@ static const uint8_t _message_CAS_CFG_NAVX_CONF[] = {
     0x00, 0x00, 0x00, 0x00, // Time Accuracy Max
     0x00, 0x00, 0x00, 0x00  // Static Hold Threshold
 };
+
+// CFG-MSG (0x06, 0x01)
+// Output a NMEA message (Class ID 0x4e) once per fix
+static const uint8_t _message_CAS_CFG_MSG_RMC[] = {
+    0x4e,         // Class: NMEA
+    CAS_NEMA_RMC, // Message ID
+    0x01, 0x00    // Rate: every fix
+};
+
+static const uint8_t _message_CAS_CFG_MSG_GGA[] = {
+    0x4e,         // Class: NMEA
+    CAS_NEMA_GGA, // Message ID
+    0x01, 0x00    // Rate: every fix
+};
@@ -1,13 +1,8 @@
 static const char *failMessage = "Unable to %s";
 
-#define SEND_UBX_PACKET(TYPE, ID, DATA, ERRMSG, TIMEOUT)                                                                         \
-    do {                                                                                                                         \
-        msglen = makeUBXPacket(TYPE, ID, sizeof(DATA), DATA);                                                                    \
-        _serial_gps->write(UBXscratch, msglen);                                                                                  \
-        if (getACK(TYPE, ID, TIMEOUT) != GNSS_RESPONSE_OK) {                                                                     \
-            LOG_WARN(failMessage, #ERRMSG);                                                                                      \
-        }                                                                                                                        \
-    } while (0)
+// Queue a UBX message from one of the arrays below as a config step, see GPS::buildConfigSteps()
+#define ADD_UBX_STEP(TYPE, ID, DATA, WHAT, ACK_MS, PAUSE_MS)                                                                     \
+    addConfigStep(GPS_STEP_UBX, TYPE, ID, DATA, sizeof(DATA), WHAT, ACK_MS, PAUSE_MS)
 
 // Power Management
 
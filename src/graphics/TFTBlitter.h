@@ -0,0 +1,145 @@
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+/// Unchanged pixels a span may run through before it is cheaper to start a new one, a new address window costs ~11 bytes
+#ifndef TFT_BLIT_MAX_GAP
+#define TFT_BLIT_MAX_GAP 5
+#endif
+
+/**
+ * Turns the changes between two frames of a mono, page ordered framebuffer (the OLEDDisplay layout: each byte holds 8 vertical
+ * pixels, rows of bytes are 8 pixel high pages) into horizontal spans for a TFT.
+ *
+ * Each page is compared 32 bits at a time to find the columns that changed, and only the rows with a changed pixel there are
+ * looked at.  Changed pixels of a row are joined into spans, bridging up to maxGap unchanged pixels, and every span is handed
+ * to the sink as runs of equal pixels, so a panel can fill each run instead of being written pixel by pixel.
+ *
+ * The Sink needs these, called as beginSpan, pushRun..., endSpan for every span:
+ *   void beginSpan(uint16_t x, uint16_t y, uint16_t len);
+ *   void pushRun(bool on, uint16_t count);
+ *   void endSpan();
+ */
+class TFTBlitter
+{
+  public:
+    /** Send the pixels of buffer that differ from back to sink.
+     *
+     * @param back the frame that is on the panel now, NULL if the panel is blank, then only set pixels are sent
+     */
+    template <class Sink>
+    static void blit(const uint8_t *buffer, const uint8_t *back, uint16_t width, uint16_t height, Sink &sink,
+                     uint16_t maxGap = TFT_BLIT_MAX_GAP)
+    {
+        for (uint16_t page = 0; page * 8 < height; page++) {
+            const uint8_t *cur = buffer + page * width;
+            const uint8_t *old = back ? back + page * width : NULL;
+
+            uint16_t first, last;
+            if (!findChangedColumns(cur, old, width, first, last))
+                continue;
+
+            // Rows of this page with any changed pixel
+            uint8_t rows = 0;
+            for (uint16_t x = first; x <= last; x++)
+                rows |= cur[x] ^ (old ? old[x] : 0);
+
+            for (uint8_t bit = 0; bit < 8 && page * 8 + bit < height; bit++) {
+                if (rows & (1 << bit))
+                    blitRow(cur, old, first, last, bit, page * 8 + bit, sink, maxGap);
+            }
+        }
+    }
+
+    /// Find the first and last column of a page that differ from old (or are set if old is NULL).  @return false if none
+    static bool findChangedColumns(const uint8_t *cur, const uint8_t *old, uint16_t width, uint16_t &first, uint16_t &last)
+    {
+        uint16_t words = width / 4;
+        uint16_t x = 0;
+        bool found = false;
+        for (uint16_t w = 0; w < words && !found; w++) {
+            if (wordDiff(cur, old, w * 4)) {
+                x = w * 4;
+                found = true;
+            }
+        }
+        if (!found)
+            x = words * 4;
+        for (; x < width; x++) {
+            if (cur[x] != (old ? old[x] : 0))
+                break;
+        }
+        if (x >= width)
+            return false;
+        first = x;
+
+        // Search backwards the same way, the tail that isn't a whole word first
+        x = width;
+        while (x > words * 4) {
+            x--;
+            if (cur[x] != (old ? old[x] : 0)) {
+                last = x;
+                return true;
+            }
+        }
+        for (uint16_t w = words; w > 0; w--) {
+            if (wordDiff(cur, old, (w - 1) * 4)) {
+                last = w * 4 - 1;
+                while (cur[last] == (old ? old[last] : 0))
+                    last--;
+                return true;
+            }
+        }
+        last = first;
+        return true;
+    }
+
+  private:
+    static bool wordDiff(const uint8_t *cur, const uint8_t *old, uint16_t x)
+    {
+        // memcpy because the page rows aren't guaranteed to be aligned
+        uint32_t a, b = 0;
+        memcpy(&a, cur + x, sizeof(a));
+        if (old)
+            memcpy(&b, old + x, sizeof(b));
+        return a != b;
+    }
+
+    template <class Sink>
+    static void blitRow(const uint8_t *cur, const uint8_t *old, uint16_t first, uint16_t last, uint8_t bit, uint16_t y,
+                        Sink &sink, uint16_t maxGap)
+    {
+        const uint8_t mask = 1 << bit;
+        int32_t spanStart = -1, lastChanged = -1;
+        for (int32_t x = first; x <= last; x++) {
+            if (!((cur[x] ^ (old ? old[x] : 0)) & mask))
+                continue;
+            if (spanStart >= 0 && x - lastChanged - 1 > maxGap) {
+                emitSpan(cur, mask, spanStart, lastChanged, y, sink);
+                spanStart = -1;
+            }
+            if (spanStart < 0)
+                spanStart = x;
+            lastChanged = x;
+        }
+        if (spanStart >= 0)
+            emitSpan(cur, mask, spanStart, lastChanged, y, sink);
+    }
+
+    template <class Sink>
+    static void emitSpan(const uint8_t *cur, uint8_t mask, uint16_t from, uint16_t to, uint16_t y, Sink &sink)
+    {
+        sink.beginSpan(from, y, to - from + 1);
+        uint16_t x = from;
+        while (x <= to) {
+            bool on = cur[x] & mask;
+            uint16_t count = 1;
+            while (x + count <= to && (bool)(cur[x + count] & mask) == on)
+                count++;
+            sink.pushRun(on, count);
+            x += count;
+        }
+        sink.endSpan();
+    }
+};
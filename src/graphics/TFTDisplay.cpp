@@ -948,6 +948,7 @@ static LGFX *tft = nullptr;
 #if defined(ST7701_CS) || defined(ST7735_CS) || defined(ST7789_CS) || defined(ILI9341_DRIVER) || defined(ILI9342_DRIVER) ||      \
     defined(RAK14014) || defined(HX8357_CS) || defined(ILI9488_CS) || defined(ST72xx_DE) || (ARCH_PORTDUINO && HAS_SCREEN != 0)
 #include "SPILock.h"
+#include "TFTBlitter.h"
 #include "TFTDisplay.h"
 #include <SPI.h>
 
@@ -991,6 +992,61 @@ TFTDisplay::TFTDisplay(uint8_t address, int sda, int scl, OLEDDISPLAY_GEOMETRY g
 }
 
 // Write the buffer to the display memory
+#if defined(TFT_BLIT_DMA) && !defined(RAK14014) && !defined(ST7735_CS)
+/// Renders each span into a line buffer and sends it by DMA, while the next span is being rendered into the other buffer
+class TFTBlitSink
+{
+    static lgfx::rgb565_t *lines[2];
+    lgfx::rgb565_t *line = NULL;
+    uint16_t used = 0;
+    uint8_t which = 0;
+
+  public:
+    explicit TFTBlitSink(uint16_t width)
+    {
+        for (auto &l : lines)
+            if (!l)
+                l = new lgfx::rgb565_t[width];
+    }
+
+    void beginSpan(uint16_t x, uint16_t y, uint16_t len)
+    {
+        line = lines[which];
+        used = 0;
+        tft->waitDMA(); // The window can't move while the previous span is still going out
+        tft->setAddrWindow(x, y, len, 1);
+    }
+
+    void pushRun(bool on, uint16_t count)
+    {
+        lgfx::rgb565_t color(on ? TFT_MESH : TFT_BLACK);
+        while (count--)
+            line[used++] = color;
+    }
+
+    void endSpan()
+    {
+        tft->pushPixelsDMA(line, used);
+        which ^= 1;
+    }
+};
+
+lgfx::rgb565_t *TFTBlitSink::lines[2];
+#else
+/// Fills each run of a span straight into the address window
+class TFTBlitSink
+{
+  public:
+    explicit TFTBlitSink(uint16_t) {}
+
+    void beginSpan(uint16_t x, uint16_t y, uint16_t len) { tft->setAddrWindow(x, y, len, 1); }
+
+    void pushRun(bool on, uint16_t count) { tft->pushBlock(on ? TFT_MESH : TFT_BLACK, count); }
+
+    void endSpan() {}
+};
+#endif
+
 void TFTDisplay::display(bool fromBlank)
 {
     if (fromBlank)
@@ -998,29 +1054,14 @@ void TFTDisplay::display(bool fromBlank)
     // tft->clear();
     concurrency::LockGuard g(spiLock);
 
-    uint16_t x, y;
-
-    for (y = 0; y < displayHeight; y++) {
-        for (x = 0; x < displayWidth; x++) {
-            auto isset = buffer[x + (y / 8) * displayWidth] & (1 << (y & 7));
-            if (!fromBlank) {
-                // get src pixel in the page based ordering the OLED lib uses FIXME, super inefficent
-                auto dblbuf_isset = buffer_back[x + (y / 8) * displayWidth] & (1 << (y & 7));
-                if (isset != dblbuf_isset) {
-                    tft->drawPixel(x, y, isset ? TFT_MESH : TFT_BLACK);
-                }
-            } else if (isset) {
-                tft->drawPixel(x, y, TFT_MESH);
-            }
-        }
-    }
+    // Only the changed parts of the page based buffer the OLED lib draws into, as runs of equal pixels
+    TFTBlitSink sink(displayWidth);
+    tft->startWrite();
+    TFTBlitter::blit(buffer, fromBlank ? NULL : buffer_back, displayWidth, displayHeight, sink);
+    tft->endWrite();
+
     // Copy the Buffer to the Back Buffer
-    for (y = 0; y < (displayHeight / 8); y++) {
-        for (x = 0; x < displayWidth; x++) {
-            uint16_t pos = x + y * displayWidth;
-            buffer_back[pos] = buffer[pos];
-        }
-    }
+    memcpy(buffer_back, buffer, displayBufferSize);
 }
 
 // Send a command to the display (low level function)
@@ -1173,6 +1214,9 @@ bool TFTDisplay::connect()
     tft->setRotation(3); // Orient horizontal and wide underneath the silkscreen name label
 #endif
     tft->fillScreen(TFT_BLACK);
+#if defined(TFT_BLIT_DMA) && !defined(RAK14014) && !defined(ST7735_CS)
+    tft->initDMA();
+#endif
 
     return true;
 }
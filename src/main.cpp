@@ -554,6 +554,7 @@ void setup()
     // We need to scan here to decide if we have a screen for nodeDB.init() and because power has been applied to
     // accessories
     auto i2cScanner = std::unique_ptr<ScanI2CTwoWire>(new ScanI2CTwoWire());
+    i2cScanner->loadCache();
 #if HAS_WIRE
     LOG_INFO("Scan for i2c devices");
 #endif
@@ -587,6 +588,9 @@ void setup()
     i2cScanner->scanPort(ScanI2C::I2CPort::WIRE);
 #endif
 
+    i2cScanner->saveCache();
+    LOG_INFO("I2C scan took %u ms%s", i2cScanner->getScanMsec(), i2cScanner->isFromCache() ? " (cached)" : "");
+
     auto i2cCount = i2cScanner->countDevices();
     if (i2cCount == 0) {
         LOG_INFO("No I2C devices found");
@@ -1407,7 +1411,7 @@ void loop()
 
     service->loop();
 
-    long delayMsec = mainController.runOrDelay();
+    long delayMsec = OSThread::runOrDelay();
 
     // We want to sleep as long as possible here - because it saves power
     if (!runASAP && loopCanSleep()) {
@@ -9,6 +9,8 @@
 
 #include <assert.h>
 
+static_assert(MAX_NUM_CHANNELS <= 8, "channelsByHash stores one bit per channel in a uint8_t");
+
 #if !MESHTASTIC_EXCLUDE_MQTT
 #include "mqtt/MQTT.h"
 #endif
@@ -72,10 +74,30 @@ meshtastic_Channel &Channels::fixupChannel(ChannelIndex chIndex)
     }
 
     hashes[chIndex] = generateHash(chIndex);
+    keys[chIndex] = getKey(chIndex);
+    rebuildHashTable();
 
     return ch;
 }
 
+void Channels::refreshKeys()
+{
+    for (ChannelIndex i = 0; i < channelFile.channels_count && i < MAX_NUM_CHANNELS; i++) {
+        hashes[i] = generateHash(i);
+        keys[i] = getKey(i);
+    }
+    rebuildHashTable();
+}
+
+void Channels::rebuildHashTable()
+{
+    memset(channelsByHash, 0, sizeof(channelsByHash));
+    for (ChannelIndex i = 0; i < getNumChannels() && i < MAX_NUM_CHANNELS; i++) {
+        if (hashes[i] >= 0)
+            channelsByHash[hashes[i]] |= (1 << i);
+    }
+}
+
 void Channels::initDefaultLoraConfig()
 {
     meshtastic_Config_LoRaConfig &loraConfig = config.lora;
@@ -257,7 +279,11 @@ CryptoKey Channels::getKey(ChannelIndex chIndex)
  */
 int16_t Channels::setCrypto(ChannelIndex chIndex)
 {
-    CryptoKey k = getKey(chIndex);
+    if (chIndex >= MAX_NUM_CHANNELS)
+        return -1;
+
+    // Keys are precomputed in fixupChannel/onConfigChanged
+    const CryptoKey &k = keys[chIndex];
 
     if (k.length < 0)
         return -1;
@@ -293,6 +319,8 @@ void Channels::onConfigChanged()
         if (ch.role == meshtastic_Channel_Role_PRIMARY)
             primaryIndex = i;
     }
+    // Secondary channels without a PSK use the primary key, so redo their keys and hashes now that we know the primary
+    refreshKeys();
 #if !MESHTASTIC_EXCLUDE_MQTT
     if (channels.anyMqttEnabled() && mqtt && !mqtt->isEnabled()) {
         LOG_DEBUG("MQTT is enabled on at least one channel, so set MQTT thread to run immediately");
@@ -341,6 +369,12 @@ void Channels::setChannel(const meshtastic_Channel &c)
                 channelFile.channels[i].role = meshtastic_Channel_Role_SECONDARY;
 
     old = c; // slam in the new settings/role
+    if (c.role == meshtastic_Channel_Role_PRIMARY && c.index >= 0 && c.index < MAX_NUM_CHANNELS)
+        primaryIndex = c.index;
+
+    // Packets are encrypted with the precomputed keys, which must not wait for the next onConfigChanged (an open edit
+    // transaction holds that back).  A new primary also changes the key of every secondary channel without a PSK.
+    refreshKeys();
 }
 
 bool Channels::anyMqttEnabled()
@@ -28,6 +28,12 @@ class Channels
     /// the precomputed hashes for each of our channels, or -1 for invalid
     int16_t hashes[MAX_NUM_CHANNELS] = {};
 
+    /// the precomputed keys for each of our channels, so decoding doesn't need to expand short PSKs per packet
+    CryptoKey keys[MAX_NUM_CHANNELS] = {};
+
+    /// for every possible channel hash, a bitmask of the channel indexes with that hash
+    uint8_t channelsByHash[256] = {};
+
   public:
     Channels() {}
 
@@ -75,6 +81,12 @@ class Channels
      */
     bool decryptForHash(ChannelIndex chIndex, ChannelHash channelHash);
 
+    /** Return a bitmask (bit n set for channel index n) of the channels that could have sent a packet with this hash
+     *
+     * Lets the receive path skip every channel that can't possibly decrypt the packet
+     */
+    uint8_t getChannelsForHash(ChannelHash channelHash) const { return channelsByHash[channelHash]; }
+
     /** Given a channel index setup crypto for encoding that channel (or the primary channel if that channel is unsecured)
      *
      * This method is called before encoding outbound packets
@@ -113,6 +125,12 @@ class Channels
 
     int16_t getHash(ChannelIndex i) { return hashes[i]; }
 
+    /// Recompute the channelsByHash table from hashes[]
+    void rebuildHashTable();
+
+    /// Recompute the key and hash of every channel, then channelsByHash, called once primaryIndex is known
+    void refreshKeys();
+
     /**
      * Validate a channel, fixing any errors as needed
      */
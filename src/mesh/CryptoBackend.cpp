@@ -0,0 +1,52 @@
+#include "CryptoBackend.h"
+#include "AES.h"
+
+#include <algorithm>
+#include <string.h>
+
+void AESContext::ctr(const uint8_t *nonce, size_t numBytes, uint8_t *bytes)
+{
+    uint8_t counter[16], stream[16];
+    memcpy(counter, nonce, sizeof(counter));
+    for (size_t posn = 0; posn < numBytes; posn += sizeof(stream)) {
+        encryptBlock(counter, stream);
+        const size_t len = std::min(sizeof(stream), numBytes - posn);
+        for (size_t i = 0; i < len; i++)
+            bytes[posn + i] ^= stream[i];
+        for (int i = 15; i >= 12 && ++counter[i] == 0; i--)
+            ;
+    }
+}
+
+template <class Cipher> class SoftwareAESContext : public AESContext
+{
+    Cipher cipher;
+
+  public:
+    SoftwareAESContext(const uint8_t *key, size_t keyLen) { cipher.setKey(key, keyLen); }
+
+    ~SoftwareAESContext() { cipher.clear(); }
+
+    virtual void encryptBlock(const uint8_t *in, uint8_t *out) override { cipher.encryptBlock(out, in); }
+};
+
+class SoftwareCryptoBackend : public CryptoBackend
+{
+  public:
+    virtual const char *name() const override { return "software"; }
+
+    virtual AESContext *newContext(const uint8_t *key, size_t keyLen) override
+    {
+        if (keyLen == 16)
+            return new SoftwareAESContext<AES128>(key, keyLen);
+        if (keyLen == 32)
+            return new SoftwareAESContext<AES256>(key, keyLen);
+        return NULL;
+    }
+};
+
+CryptoBackend *softwareCryptoBackend()
+{
+    static SoftwareCryptoBackend backend;
+    return &backend;
+}
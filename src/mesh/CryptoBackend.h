@@ -0,0 +1,47 @@
+#pragma once
+
+#include "configuration.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * One AES key, expanded by a CryptoBackend.  CryptoEngine keeps these around for as long as the key is in use, so the key
+ * schedule is computed once per channel key or PKI shared key instead of once per packet.
+ */
+class AESContext
+{
+  public:
+    virtual ~AESContext() {}
+
+    /// Encrypt the 16 byte block in, into out which may be the same buffer
+    virtual void encryptBlock(const uint8_t *in, uint8_t *out) = 0;
+
+    /**
+     * AES-CTR over bytes, in place
+     *
+     * @param nonce the first counter block, its last 4 bytes are a big endian block counter.  CryptoEngine never lets that
+     * counter wrap, so a backend may as well carry into the rest of the block.
+     */
+    virtual void ctr(const uint8_t *nonce, size_t numBytes, uint8_t *bytes);
+};
+
+/// A way of doing AES, e.g. in software or with whatever acceleration the platform has
+class CryptoBackend
+{
+  public:
+    virtual ~CryptoBackend() {}
+
+    virtual const char *name() const = 0;
+
+    /// Expand key for this backend, NULL if the key length isn't supported
+    virtual AESContext *newContext(const uint8_t *key, size_t keyLen) = 0;
+};
+
+/// The portable backend, rweather/Crypto's AES
+CryptoBackend *softwareCryptoBackend();
+
+#if defined(ARCH_PORTDUINO) && __has_include(<openssl/evp.h>)
+#define HAS_OPENSSL_CRYPTO_BACKEND 1
+/// OpenSSL's EVP ciphers, which use AES-NI or the ARMv8 crypto extensions when the CPU has them
+CryptoBackend *openSSLCryptoBackend();
+#endif
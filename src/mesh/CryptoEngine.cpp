@@ -20,6 +20,7 @@ void CryptoEngine::generateKeyPair(uint8_t *pubKey, uint8_t *privKey)
 {
     LOG_DEBUG("Generate Curve25519 keypair");
     Curve25519::dh1(public_key, private_key);
+    clearSharedKeyCache();
     memcpy(pubKey, public_key, sizeof(public_key));
     memcpy(privKey, private_key, sizeof(private_key));
 }
@@ -41,6 +42,7 @@ bool CryptoEngine::regeneratePublicKey(uint8_t *pubKey, uint8_t *privKey)
         }
         memcpy(private_key, privKey, sizeof(private_key));
         memcpy(public_key, pubKey, sizeof(public_key));
+        clearSharedKeyCache();
     } else {
         LOG_WARN("X25519 key generation failed due to blank private key");
         return false;
@@ -52,6 +54,51 @@ void CryptoEngine::clearKeys()
 {
     memset(public_key, 0, sizeof(public_key));
     memset(private_key, 0, sizeof(private_key));
+    clearSharedKeyCache();
+    clearAESContextCache();
+}
+
+void CryptoEngine::clearSharedKeyCache()
+{
+    memset(sharedKeyCache, 0, sizeof(sharedKeyCache));
+    sharedKeyCacheClock = 0;
+}
+
+void CryptoEngine::invalidateSharedKey(uint32_t nodeNum)
+{
+    for (auto &entry : sharedKeyCache) {
+        if (entry.lastUsed && entry.nodeNum == nodeNum)
+            memset(&entry, 0, sizeof(entry));
+    }
+}
+
+bool CryptoEngine::setSharedKeyFor(uint32_t nodeNum, const meshtastic_UserLite_public_key_t &remotePublic)
+{
+    SharedKeyCacheEntry *victim = &sharedKeyCache[0];
+    for (auto &entry : sharedKeyCache) {
+        if (entry.lastUsed && entry.nodeNum == nodeNum && memcmp(entry.publicKey, remotePublic.bytes, 32) == 0) {
+            entry.lastUsed = ++sharedKeyCacheClock;
+            memcpy(shared_key, entry.sharedKey, 32);
+            sharedKeyCacheHits++;
+            return true;
+        }
+        if (entry.lastUsed < victim->lastUsed)
+            victim = &entry; // Least recently used, unused entries (0) win
+    }
+    sharedKeyCacheMisses++;
+
+    uint8_t pubKey[32];
+    memcpy(pubKey, remotePublic.bytes, 32);
+    if (!setDHPublicKey(pubKey)) {
+        return false;
+    }
+    hash(shared_key, 32);
+
+    victim->nodeNum = nodeNum;
+    victim->lastUsed = ++sharedKeyCacheClock;
+    memcpy(victim->publicKey, remotePublic.bytes, 32);
+    memcpy(victim->sharedKey, shared_key, 32);
+    return true;
 }
 
 /**
@@ -79,10 +126,9 @@ bool CryptoEngine::encryptCurve25519(uint32_t toNode, uint32_t fromNode, meshtas
         LOG_DEBUG("Node %d or their public_key not found", toNode);
         return false;
     }
-    if (!crypto->setDHPublicKey(remotePublic.bytes)) {
+    if (!setSharedKeyFor(toNode, remotePublic)) {
         return false;
     }
-    crypto->hash(shared_key, 32);
     initNonce(fromNode, packetNum, extraNonceTmp);
 
     // Calculate the shared secret with the destination node and encrypt
@@ -120,11 +166,10 @@ bool CryptoEngine::decryptCurve25519(uint32_t fromNode, meshtastic_UserLite_publ
         return false;
     }
 
-    // Calculate the shared secret with the sending node and decrypt
-    if (!crypto->setDHPublicKey(remotePublic.bytes)) {
+    // Calculate (or look up) the shared secret with the sending node and decrypt
+    if (!setSharedKeyFor(fromNode, remotePublic)) {
         return false;
     }
-    crypto->hash(shared_key, 32);
 
     initNonce(fromNode, packetNum, extraNonce);
     printBytes("Attempt decrypt with nonce: ", nonce, 13);
@@ -134,6 +179,8 @@ bool CryptoEngine::decryptCurve25519(uint32_t fromNode, meshtastic_UserLite_publ
 
 void CryptoEngine::setDHPrivateKey(uint8_t *_private_key)
 {
+    if (memcmp(private_key, _private_key, 32) != 0)
+        clearSharedKeyCache();
     memcpy(private_key, _private_key, 32);
 }
 
@@ -161,17 +208,12 @@ void CryptoEngine::hash(uint8_t *bytes, size_t numBytes)
 
 void CryptoEngine::aesSetKey(const uint8_t *key_bytes, size_t key_len)
 {
-    delete aes;
-    aes = nullptr;
-    if (key_len != 0) {
-        aes = new AESSmall256();
-        aes->setKey(key_bytes, key_len);
-    }
+    aesContext = key_len ? getAESContext(key_bytes, key_len) : NULL;
 }
 
 void CryptoEngine::aesEncrypt(uint8_t *in, uint8_t *out)
 {
-    aes->encryptBlock(out, in);
+    aesContext->encryptBlock(in, out);
 }
 
 bool CryptoEngine::setDHPublicKey(uint8_t *pubKey)
@@ -220,24 +262,55 @@ void CryptoEngine::decrypt(uint32_t fromNode, uint64_t packetId, size_t numBytes
     encryptPacket(fromNode, packetId, numBytes, bytes);
 }
 
-// Generic implementation of AES-CTR encryption.
+// Generic implementation of AES-CTR encryption, in place with whatever the backend offers
 void CryptoEngine::encryptAESCtr(CryptoKey _key, uint8_t *_nonce, size_t numBytes, uint8_t *bytes)
 {
-    delete ctr;
-    ctr = nullptr;
-    if (_key.length == 16)
-        ctr = new CTR<AES128>();
-    else
-        ctr = new CTR<AES256>();
-    ctr->setKey(_key.bytes, _key.length);
-    static uint8_t scratch[MAX_BLOCKSIZE];
-    memcpy(scratch, bytes, numBytes);
-    memset(scratch + numBytes, 0,
-           sizeof(scratch) - numBytes); // Fill rest of buffer with zero (in case cypher looks at it)
+    AESContext *context = getAESContext(_key.bytes, _key.length);
+    if (context)
+        context->ctr(_nonce, numBytes, bytes);
+}
+
+void CryptoEngine::setBackend(CryptoBackend *_backend)
+{
+    clearAESContextCache();
+    backend = _backend;
+}
 
-    ctr->setIV(_nonce, 16);
-    ctr->setCounterSize(4);
-    ctr->encrypt(bytes, scratch, numBytes);
+AESContext *CryptoEngine::getAESContext(const uint8_t *keyBytes, size_t keyLen)
+{
+    if (keyLen == 0 || keyLen > sizeof(aesContextCache[0].key))
+        return NULL;
+
+    AESContextCacheEntry *victim = &aesContextCache[0];
+    for (auto &entry : aesContextCache) {
+        if (entry.context && entry.keyLen == keyLen && memcmp(entry.key, keyBytes, keyLen) == 0) {
+            entry.lastUsed = ++aesContextCacheClock;
+            aesContextCacheHits++;
+            return entry.context;
+        }
+        if (entry.lastUsed < victim->lastUsed)
+            victim = &entry; // Least recently used, unused entries (0) win
+    }
+    aesContextCacheMisses++;
+
+    AESContext *context = backend->newContext(keyBytes, keyLen);
+    if (!context)
+        return NULL;
+    delete victim->context;
+    memcpy(victim->key, keyBytes, keyLen);
+    victim->keyLen = keyLen;
+    victim->lastUsed = ++aesContextCacheClock;
+    victim->context = context;
+    return context;
+}
+
+void CryptoEngine::clearAESContextCache()
+{
+    for (auto &entry : aesContextCache)
+        delete entry.context;
+    memset(aesContextCache, 0, sizeof(aesContextCache));
+    aesContextCacheClock = 0;
+    aesContext = NULL;
 }
 
 /**
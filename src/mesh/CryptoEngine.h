@@ -1,6 +1,5 @@
 #pragma once
-#include "AES.h"
-#include "CTR.h"
+#include "CryptoBackend.h"
 #include "concurrency/LockGuard.h"
 #include "configuration.h"
 #include "mesh-pb-constants.h"
@@ -21,6 +20,21 @@ struct CryptoKey {
  */
 
 #define MAX_BLOCKSIZE 256
+
+/// Number of Curve25519 shared keys we remember, each entry costs ~72 bytes of RAM
+#ifndef PKI_SHARED_KEY_CACHE_SIZE
+#ifdef ARCH_PORTDUINO
+#define PKI_SHARED_KEY_CACHE_SIZE 64
+#else
+#define PKI_SHARED_KEY_CACHE_SIZE 8
+#endif
+#endif
+
+/// Number of expanded AES keys we keep, enough for every channel key and every cached PKI shared key. Entries are only
+/// allocated once a key is used.
+#ifndef AES_CONTEXT_CACHE_SIZE
+#define AES_CONTEXT_CACHE_SIZE (8 + PKI_SHARED_KEY_CACHE_SIZE)
+#endif
 #define TEST_CURVE25519_FIELD_OPS // Exposes Curve25519::isWeakPoint() for testing keys
 
 class CryptoEngine
@@ -30,7 +44,7 @@ class CryptoEngine
     uint8_t public_key[32] = {0};
 #endif
 
-    virtual ~CryptoEngine() {}
+    virtual ~CryptoEngine() { clearAESContextCache(); }
 #if !(MESHTASTIC_EXCLUDE_PKI)
 #if !(MESHTASTIC_EXCLUDE_PKI_KEYGEN)
     virtual void generateKeyPair(uint8_t *pubKey, uint8_t *privKey);
@@ -46,13 +60,30 @@ class CryptoEngine
     virtual bool setDHPublicKey(uint8_t *publicKey);
     virtual void hash(uint8_t *bytes, size_t numBytes);
 
+    /// Forget the cached shared key for a node, e.g. because its public key changed
+    void invalidateSharedKey(uint32_t nodeNum);
+
+    /// Forget all cached shared keys, needed whenever our private key changes
+    void clearSharedKeyCache();
+
+    /// Shared key cache statistics, reported along with our local stats
+    uint32_t sharedKeyCacheHits = 0;
+    uint32_t sharedKeyCacheMisses = 0;
+
     virtual void aesSetKey(const uint8_t *key, size_t key_len);
 
     virtual void aesEncrypt(uint8_t *in, uint8_t *out);
-    AESSmall256 *aes = NULL;
 
 #endif
 
+    /// Do all AES with backend from now on, forgetting the keys expanded by the previous one
+    void setBackend(CryptoBackend *backend);
+    CryptoBackend *getBackend() const { return backend; }
+
+    /// Expanded AES key cache statistics
+    uint32_t aesContextCacheHits = 0;
+    uint32_t aesContextCacheMisses = 0;
+
     /**
      * Set the key used for encrypt, decrypt.
      *
@@ -78,10 +109,43 @@ class CryptoEngine
     /** Our per packet nonce */
     uint8_t nonce[16] = {0};
     CryptoKey key = {};
-    CTRCommon *ctr = NULL;
+
+    CryptoBackend *backend = softwareCryptoBackend();
+
+    /// A key as expanded by the backend, kept while it is in use
+    struct AESContextCacheEntry {
+        uint8_t key[32];
+        uint8_t keyLen;
+        uint32_t lastUsed; // Value of aesContextCacheClock when this entry was last used
+        AESContext *context;
+    };
+    AESContextCacheEntry aesContextCache[AES_CONTEXT_CACHE_SIZE] = {};
+    uint32_t aesContextCacheClock = 0;
+    AESContext *aesContext = NULL; // What aesSetKey() chose for aesEncrypt()
+
+    /// The expanded context for key, from the cache or made by the backend.  NULL if the backend can't use the key.
+    AESContext *getAESContext(const uint8_t *key, size_t keyLen);
+
+    void clearAESContextCache();
 #if !(MESHTASTIC_EXCLUDE_PKI)
     uint8_t shared_key[32] = {0};
     uint8_t private_key[32] = {0};
+
+    /// A derived (Curve25519 + SHA256) shared key for a peer, valid as long as neither side changes its key
+    struct SharedKeyCacheEntry {
+        uint32_t nodeNum;
+        uint32_t lastUsed; // Value of sharedKeyCacheClock when this entry was last used, 0 for an unused entry
+        uint8_t publicKey[32];
+        uint8_t sharedKey[32];
+    };
+    SharedKeyCacheEntry sharedKeyCache[PKI_SHARED_KEY_CACHE_SIZE] = {};
+    uint32_t sharedKeyCacheClock = 0;
+
+    /**
+     * Set shared_key for the given peer, from the cache if possible, otherwise with a full Curve25519 DH and hash.
+     * @return false if the DH step failed
+     */
+    bool setSharedKeyFor(uint32_t nodeNum, const meshtastic_UserLite_public_key_t &remotePublic);
 #endif
     /**
      * Init our 128 bit nonce for a new packet
@@ -25,10 +25,7 @@ bool FloodingRouter::shouldFilterReceived(const meshtastic_MeshPacket *p)
         printPacket("Ignore dupe incoming msg", p);
         rxDupe++;
 
-        /* If the original transmitter is doing retransmissions (hopStart equals hopLimit) for a reliable transmission, e.g., when
-        the ACK got lost, we will handle the packet again to make sure it gets an implicit ACK. */
-        bool isRepeated = p->hop_start > 0 && p->hop_start == p->hop_limit;
-        if (isRepeated) {
+        if (dupeAction(p) == DUPE_REPEATED) {
             LOG_DEBUG("Repeated reliable tx");
             // Check if it's still in the Tx queue, if not, we have to relay it again
             if (!findInTxQueue(p->from, p->id))
@@ -43,11 +40,24 @@ bool FloodingRouter::shouldFilterReceived(const meshtastic_MeshPacket *p)
     return Router::shouldFilterReceived(p);
 }
 
+FloodingRouter::DupeAction FloodingRouter::dupeAction(const meshtastic_MeshPacket *p)
+{
+    /* If the original transmitter is doing retransmissions (hopStart equals hopLimit) for a reliable transmission, e.g., when
+    the ACK got lost, we will handle the packet again to make sure it gets an implicit ACK. */
+    bool isRepeated = p->hop_start > 0 && p->hop_start == p->hop_limit;
+    return isRepeated ? DUPE_REPEATED : DUPE_CANCEL;
+}
+
+bool FloodingRouter::cancelsDupes()
+{
+    return config.device.role != meshtastic_Config_DeviceConfig_Role_ROUTER &&
+           config.device.role != meshtastic_Config_DeviceConfig_Role_REPEATER &&
+           config.device.role != meshtastic_Config_DeviceConfig_Role_ROUTER_LATE;
+}
+
 void FloodingRouter::perhapsCancelDupe(const meshtastic_MeshPacket *p)
 {
-    if (config.device.role != meshtastic_Config_DeviceConfig_Role_ROUTER &&
-        config.device.role != meshtastic_Config_DeviceConfig_Role_REPEATER &&
-        config.device.role != meshtastic_Config_DeviceConfig_Role_ROUTER_LATE) {
+    if (cancelsDupes()) {
         // cancel rebroadcast of this message *if* there was already one, unless we're a router/repeater!
         if (Router::cancelSending(p->from, p->id))
             txRelayCanceled++;
@@ -63,7 +73,7 @@ bool FloodingRouter::isRebroadcaster()
            config.device.rebroadcast_mode != meshtastic_Config_DeviceConfig_RebroadcastMode_NONE;
 }
 
-void FloodingRouter::perhapsRebroadcast(const meshtastic_MeshPacket *p)
+meshtastic_MeshPacket *FloodingRouter::copyForRebroadcast(const meshtastic_MeshPacket *p)
 {
     if (!isToUs(p) && (p->hop_limit > 0) && !isFromUs(p)) {
         if (p->id != 0) {
@@ -79,11 +89,7 @@ void FloodingRouter::perhapsRebroadcast(const meshtastic_MeshPacket *p)
                 }
 #endif
                 tosend->next_hop = NO_NEXT_HOP_PREFERENCE; // this should already be the case, but just in case
-
-                LOG_INFO("Rebroadcast received floodmsg");
-                // Note: we are careful to resend using the original senders node id
-                // We are careful not to call our hooked version of send() - because we don't want to check this again
-                Router::send(tosend);
+                return tosend;
             } else {
                 LOG_DEBUG("No rebroadcast: Role = CLIENT_MUTE or Rebroadcast Mode = NONE");
             }
@@ -91,6 +97,18 @@ void FloodingRouter::perhapsRebroadcast(const meshtastic_MeshPacket *p)
             LOG_DEBUG("Ignore 0 id broadcast");
         }
     }
+    return NULL;
+}
+
+void FloodingRouter::perhapsRebroadcast(const meshtastic_MeshPacket *p)
+{
+    meshtastic_MeshPacket *tosend = copyForRebroadcast(p);
+    if (tosend) {
+        LOG_INFO("Rebroadcast received floodmsg");
+        // Note: we are careful to resend using the original senders node id
+        // We are careful not to call our hooked version of send() - because we don't want to check this again
+        Router::send(tosend);
+    }
 }
 
 void FloodingRouter::sniffReceived(const meshtastic_MeshPacket *p, const meshtastic_Routing *c)
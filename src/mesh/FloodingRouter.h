@@ -45,6 +45,31 @@ class FloodingRouter : public Router
      */
     virtual ErrorCode send(meshtastic_MeshPacket *p) override;
 
+    /*
+     * The relay decisions below only look at the packet and the node globals (our node number and config), so
+     * test/test_mesh_sim can make them for many simulated nodes by switching those globals.
+     */
+
+    /// What to do on hearing a packet we have a record of already
+    enum DupeAction {
+        DUPE_DROP,        // nothing
+        DUPE_CANCEL,      // cancel our own pending rebroadcast of it, see perhapsCancelDupe()
+        DUPE_RELAY_AGAIN, // relay it again unless it is still in our Tx queue
+        DUPE_REPEATED     // the original sender is retrying: relay it again unless queued, or resend our ACK if it is for us
+    };
+
+    /// What FloodingRouter does on hearing p again
+    static DupeAction dupeAction(const meshtastic_MeshPacket *p);
+
+    /// Whether hearing a dupe cancels our pending rebroadcast, routers and repeaters always send theirs
+    static bool cancelsDupes();
+
+    /// Return true if we are a rebroadcaster
+    static bool isRebroadcaster();
+
+    /// The copy of p to rebroadcast (from the pool, hop limit already lowered), or NULL if we should not
+    static meshtastic_MeshPacket *copyForRebroadcast(const meshtastic_MeshPacket *p);
+
   protected:
     /**
      * Should this incoming filter be dropped?
@@ -61,7 +86,4 @@ class FloodingRouter : public Router
 
     /* Call when receiving a duplicate packet to check whether we should cancel a packet in the Tx queue */
     void perhapsCancelDupe(const meshtastic_MeshPacket *p);
-
-    // Return true if we are a rebroadcaster
-    bool isRebroadcaster();
 };
\ No newline at end of file
@@ -0,0 +1,48 @@
+#include "FromRadioCache.h"
+#include "NodeDB.h"
+#include "configuration.h"
+
+#if FROMRADIO_CACHE
+
+FromRadioCache fromRadioCache;
+
+/// Nodes come and go, so cap the number of entries rather than track which ones went stale
+#define FROMRADIO_CACHE_MAX_ENTRIES (MAX_NUM_NODES + 64)
+
+void FromRadioCache::touchSegments(int saveWhat)
+{
+    if (saveWhat & SEGMENT_CONFIG)
+        touch(CONFIG);
+    if (saveWhat & SEGMENT_MODULECONFIG)
+        touch(MODULECONFIG);
+    if (saveWhat & SEGMENT_CHANNELS)
+        touch(CHANNELS);
+    if (saveWhat & SEGMENT_NODEDATABASE)
+        touch(NODES);
+}
+
+size_t FromRadioCache::encode(Section section, uint32_t index, const meshtastic_FromRadio &msg, uint8_t *buf)
+{
+    auto it = entries.find(key(section, index));
+    if (it != entries.end() && it->second.epoch == epochs[section]) {
+        hits++;
+        memcpy(buf, it->second.bytes.data(), it->second.bytes.size());
+        return it->second.bytes.size();
+    }
+
+    misses++;
+    size_t numbytes = pb_encode_to_bytes(buf, meshtastic_FromRadio_size, &meshtastic_FromRadio_msg, &msg);
+    if (numbytes == 0)
+        return 0;
+
+    if (it == entries.end()) {
+        if (entries.size() >= FROMRADIO_CACHE_MAX_ENTRIES)
+            entries.clear();
+        it = entries.emplace(key(section, index), Entry()).first;
+    }
+    it->second.epoch = epochs[section];
+    it->second.bytes.assign(buf, buf + numbytes);
+    return numbytes;
+}
+
+#endif
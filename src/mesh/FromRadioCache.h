@@ -0,0 +1,69 @@
+#pragma once
+
+#include "MeshTypes.h"
+#include "mesh-pb-constants.h"
+#include <stdint.h>
+#include <unordered_map>
+#include <vector>
+
+/// Keep the encoded want_config messages around between client connections. Costs roughly one encoded NodeInfo per node,
+/// so only enabled where RAM is plentiful.
+#ifndef FROMRADIO_CACHE
+#if defined(ARCH_PORTDUINO) || defined(BOARD_HAS_PSRAM)
+#define FROMRADIO_CACHE 1
+#else
+#define FROMRADIO_CACHE 0
+#endif
+#endif
+
+#if FROMRADIO_CACHE
+
+/**
+ * Remembers how each FromRadio of the want_config download (channels, config, module config and node infos) was encoded.
+ *
+ * A reconnecting client usually gets the same few hundred messages it got last time.  Each entry is keyed by its section
+ * and its position in that section, and remembers the section epoch it was encoded at.  Whoever changes a section must
+ * call touch() (or touchNode() for a single node) so those messages are re-encoded, everything else is copied straight
+ * out of the cache.
+ */
+class FromRadioCache
+{
+  public:
+    enum Section : uint8_t { NONE, CHANNELS, CONFIG, MODULECONFIG, NODES, NUM_SECTIONS };
+
+    /**
+     * Encode msg, the index'th message of section, into buf (which must hold meshtastic_FromRadio_size bytes), reusing the
+     * previous encoding if the section has not been touched since.
+     * @return the encoded length, 0 on failure
+     */
+    size_t encode(Section section, uint32_t index, const meshtastic_FromRadio &msg, uint8_t *buf);
+
+    /// Invalidate every message of section
+    void touch(Section section) { epochs[section]++; }
+
+    /// Invalidate the sections stored in saveWhat (a mask of SEGMENT_* flags)
+    void touchSegments(int saveWhat);
+
+    /// Invalidate the NodeInfo of node n
+    void touchNode(NodeNum n) { entries.erase(key(NODES, n)); }
+
+    /// Forget everything, e.g. after a factory reset
+    void clear() { entries.clear(); }
+
+    uint32_t hits = 0, misses = 0;
+
+  private:
+    struct Entry {
+        uint32_t epoch;
+        std::vector<uint8_t> bytes;
+    };
+
+    static uint64_t key(Section section, uint32_t index) { return ((uint64_t)section << 32) | index; }
+
+    uint32_t epochs[NUM_SECTIONS] = {};
+    std::unordered_map<uint64_t, Entry> entries;
+};
+
+extern FromRadioCache fromRadioCache;
+
+#endif
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <stdint.h>
+
+/**
+ * Counts values in power of two buckets, cheap enough to update on every packet.
+ *
+ * Bucket 0 holds 0, bucket i holds [2^(i-1), 2^i) and the last bucket also takes everything larger.
+ */
+template <uint8_t N> class Log2Histogram
+{
+    static_assert(N >= 2 && N <= 33, "bucket count must be between 2 and 33");
+
+    uint32_t counts[N] = {};
+    uint32_t total = 0;
+
+  public:
+    static constexpr uint8_t numBuckets = N;
+
+    void add(uint32_t value)
+    {
+        uint8_t bucket = 0;
+        while (value && bucket < N - 1) {
+            value >>= 1;
+            bucket++;
+        }
+        counts[bucket]++;
+        total++;
+    }
+
+    uint32_t getCount(uint8_t bucket) const { return bucket < N ? counts[bucket] : 0; }
+
+    uint32_t getTotal() const { return total; }
+
+    /// Largest value that lands in bucket, UINT32_MAX for the last one
+    static uint32_t getBucketLimit(uint8_t bucket)
+    {
+        if (bucket >= N - 1)
+            return UINT32_MAX;
+        return bucket == 0 ? 0 : (uint32_t)((1ULL << bucket) - 1);
+    }
+
+    /// Upper limit of the bucket holding the pct'th percentile, 0 if nothing was counted yet
+    uint32_t percentile(uint8_t pct) const
+    {
+        if (!total)
+            return 0;
+        uint64_t wanted = ((uint64_t)total * pct + 99) / 100;
+        uint32_t seen = 0;
+        for (uint8_t i = 0; i < N; i++) {
+            seen += counts[i];
+            if (seen >= wanted && seen > 0)
+                return getBucketLimit(i);
+        }
+        return getBucketLimit(N - 1);
+    }
+
+    void reset()
+    {
+        for (uint8_t i = 0; i < N; i++)
+            counts[i] = 0;
+        total = 0;
+    }
+};
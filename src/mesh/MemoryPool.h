@@ -2,10 +2,12 @@
 
 #include <Arduino.h>
 #include <assert.h>
+#include <atomic>
 #include <functional>
 #include <memory>
 
 #include "PointerQueue.h"
+#include "concurrency/LockGuard.h"
 
 template <class T> class Allocator
 {
@@ -15,7 +17,7 @@ template <class T> class Allocator
     virtual ~Allocator() {}
 
     /// Return a queable object which has been prefilled with zeros.  Panic if no buffer is available
-    /// Note: this method is safe to call from regular OR ISR code
+    /// Note: allocators may fall back to malloc(), so don't call this from an ISR
     T *allocZeroed()
     {
         T *p = allocZeroed(0);
@@ -96,3 +98,155 @@ template <class T> class MemoryDynamic : public Allocator<T>
         return p;
     }
 };
+
+/// Usage counters for a MemoryPool
+struct MemoryPoolStats {
+    uint32_t capacity;  // number of preallocated blocks
+    uint32_t live;      // blocks currently handed out (pool and heap overflow)
+    uint32_t highWater; // most blocks ever live at once
+    uint32_t overflows; // allocations the pool could not serve and sent to the heap instead
+};
+
+/// Cortex-M0+ (RP2040) has no compare-and-swap instruction, std::atomic would pull in libatomic's emulation there, so the pool
+/// takes a lock instead
+#ifndef MEMORY_POOL_LOCK_FREE
+#if defined(__ARM_ARCH_6M__)
+#define MEMORY_POOL_LOCK_FREE 0
+#else
+#define MEMORY_POOL_LOCK_FREE 1
+#endif
+#endif
+
+/**
+ * A fixed block allocator carved out of a static array, so long running nodes don't fragment their heap with packet sized
+ * holes.
+ *
+ * The free blocks form a Treiber stack: alloc and release are a single compare-and-swap on the head, which carries a
+ * generation tag to defeat ABA, so tasks never wait on each other.  Where that isn't available (MEMORY_POOL_LOCK_FREE 0) the
+ * stack is guarded by a concurrency::Lock.  If the pool ever runs dry the allocation is served from the heap instead (and
+ * counted as an overflow) - running out of packets is not worth a crash.  Because of that malloc(), and the lock, do not
+ * alloc from an ISR.
+ */
+template <class T, size_t N> class MemoryPool : public Allocator<T>
+{
+    static_assert(N > 0 && N < 0xFFFF, "MemoryPool indexes its blocks with 16 bits");
+
+    static constexpr uint16_t NIL = 0xFFFF;
+
+    alignas(T) uint8_t storage[N][sizeof(T)];
+
+#if MEMORY_POOL_LOCK_FREE
+    /// next[i] is the block below i on the free stack
+    std::atomic<uint16_t> next[N];
+
+    /// Generation tag in the high 16 bits, index of the top free block in the low 16 bits
+    std::atomic<uint32_t> head;
+
+    std::atomic<uint32_t> live{0}, highWater{0}, overflows{0};
+#else
+    uint16_t next[N];
+    uint16_t head = 0;
+    uint32_t live = 0, highWater = 0, overflows = 0;
+    mutable concurrency::Lock lock;
+#endif
+
+  public:
+    MemoryPool()
+    {
+#if MEMORY_POOL_LOCK_FREE
+        for (size_t i = 0; i < N; i++)
+            next[i].store(i + 1 < N ? i + 1 : NIL, std::memory_order_relaxed);
+        head.store(0, std::memory_order_release);
+#else
+        for (size_t i = 0; i < N; i++)
+            next[i] = i + 1 < N ? i + 1 : NIL;
+#endif
+    }
+
+    /// Return a buffer for use by others
+    virtual void release(T *p) override
+    {
+        assert(p);
+        uint8_t *b = (uint8_t *)p;
+        bool fromHeap = b < storage[0] || b >= storage[N];
+        uint16_t idx = fromHeap ? NIL : (b - storage[0]) / sizeof(T);
+        assert(fromHeap || storage[idx] == b);
+
+#if MEMORY_POOL_LOCK_FREE
+        live.fetch_sub(1, std::memory_order_relaxed);
+        if (!fromHeap) {
+            uint32_t old = head.load(std::memory_order_relaxed), desired;
+            do {
+                next[idx].store(old & 0xFFFF, std::memory_order_relaxed);
+                desired = ((old + 0x10000) & 0xFFFF0000) | idx;
+            } while (!head.compare_exchange_weak(old, desired, std::memory_order_release, std::memory_order_relaxed));
+        }
+#else
+        {
+            concurrency::LockGuard guard(&lock);
+            live--;
+            if (!fromHeap) {
+                next[idx] = head;
+                head = idx;
+            }
+        }
+#endif
+        if (fromHeap)
+            free(p); // one of our heap overflow allocations
+    }
+
+    MemoryPoolStats getStats() const
+    {
+#if MEMORY_POOL_LOCK_FREE
+        return MemoryPoolStats{N, live.load(std::memory_order_relaxed), highWater.load(std::memory_order_relaxed),
+                               overflows.load(std::memory_order_relaxed)};
+#else
+        concurrency::LockGuard guard(&lock);
+        return MemoryPoolStats{N, live, highWater, overflows};
+#endif
+    }
+
+  protected:
+    // Alloc some storage
+    virtual T *alloc(TickType_t maxWait) override
+    {
+        T *p = NULL;
+
+#if MEMORY_POOL_LOCK_FREE
+        uint32_t old = head.load(std::memory_order_acquire);
+        while ((old & 0xFFFF) != NIL) {
+            uint16_t idx = old & 0xFFFF;
+            uint32_t desired = ((old + 0x10000) & 0xFFFF0000) | next[idx].load(std::memory_order_relaxed);
+            if (head.compare_exchange_weak(old, desired, std::memory_order_acquire, std::memory_order_acquire)) {
+                p = (T *)storage[idx];
+                break;
+            }
+        }
+        if (!p)
+            overflows.fetch_add(1, std::memory_order_relaxed);
+
+        uint32_t nowLive = live.fetch_add(1, std::memory_order_relaxed) + 1;
+        uint32_t peak = highWater.load(std::memory_order_relaxed);
+        while (nowLive > peak && !highWater.compare_exchange_weak(peak, nowLive, std::memory_order_relaxed))
+            ;
+#else
+        {
+            concurrency::LockGuard guard(&lock);
+            if (head != NIL) {
+                p = (T *)storage[head];
+                head = next[head];
+            } else {
+                overflows++;
+            }
+            if (++live > highWater)
+                highWater = live;
+        }
+#endif
+
+        if (!p) {
+            p = (T *)malloc(sizeof(T));
+            assert(p);
+        }
+        return p;
+    }
+};
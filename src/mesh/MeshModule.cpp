@@ -8,6 +8,9 @@
 #include <assert.h>
 
 std::vector<MeshModule *> *MeshModule::modules;
+std::vector<MeshModule::PortDispatch> MeshModule::dispatchTable;
+std::vector<MeshModule *> MeshModule::anyPortModules;
+bool MeshModule::dispatchTableValid = false;
 
 const meshtastic_MeshPacket *MeshModule::currentRequest;
 uint8_t MeshModule::numPeriodicModules = 0;
@@ -25,6 +28,7 @@ MeshModule::MeshModule(const char *_name) : name(_name)
         modules = new std::vector<MeshModule *>();
 
     modules->push_back(this);
+    dispatchTableValid = false;
 }
 
 void MeshModule::setup() {}
@@ -34,6 +38,7 @@ MeshModule::~MeshModule()
     auto it = std::find(modules->begin(), modules->end(), this);
     assert(it != modules->end());
     modules->erase(it);
+    dispatchTableValid = false;
 }
 
 // ⚠️ **Only call once** to set the initial delay before a module starts broadcasting periodically
@@ -85,7 +90,84 @@ meshtastic_MeshPacket *MeshModule::allocErrorResponse(meshtastic_Routing_Error e
     return r;
 }
 
-void MeshModule::callModules(meshtastic_MeshPacket &mp, RxSource src)
+bool MeshModule::portNumLess(const PortDispatch &entry, meshtastic_PortNum portNum)
+{
+    return entry.portNum < portNum;
+}
+
+void MeshModule::buildDispatchTable()
+{
+    dispatchTable.clear();
+    anyPortModules.clear();
+
+    std::vector<meshtastic_PortNum> portNums;
+    for (auto i = modules->begin(); i != modules->end(); ++i) {
+        auto &pi = **i;
+        portNums.clear();
+        if (!pi.getPortNums(portNums)) {
+            anyPortModules.push_back(&pi);
+            // Every portnum seen so far gets this module too, later ones copy anyPortModules when they are added
+            for (auto &d : dispatchTable)
+                d.modules.push_back(&pi);
+            continue;
+        }
+        for (auto portNum : portNums) {
+            auto d = std::lower_bound(dispatchTable.begin(), dispatchTable.end(), portNum, portNumLess);
+            if (d == dispatchTable.end() || d->portNum != portNum)
+                d = dispatchTable.insert(d, PortDispatch{portNum, anyPortModules});
+            // A module listing the same portnum twice still only gets each packet once
+            if (d->modules.empty() || d->modules.back() != &pi)
+                d->modules.push_back(&pi);
+        }
+    }
+
+    dispatchTableValid = true;
+    LOG_DEBUG("Module dispatch table: %u portnums, %u modules want every packet", (unsigned)dispatchTable.size(),
+              (unsigned)anyPortModules.size());
+}
+
+const std::vector<MeshModule *> &MeshModule::getDispatchList(const meshtastic_MeshPacket &mp)
+{
+    if (!dispatchTableValid)
+        buildDispatchTable();
+
+    // Encrypted packets have no portnum yet, only modules that want everything can be interested
+    if (mp.which_payload_variant != meshtastic_MeshPacket_decoded_tag)
+        return anyPortModules;
+
+    meshtastic_PortNum portNum = mp.decoded.portnum;
+    auto d = std::lower_bound(dispatchTable.begin(), dispatchTable.end(), portNum, portNumLess);
+    if (d == dispatchTable.end() || d->portNum != portNum)
+        return anyPortModules;
+    return d->modules;
+}
+
+size_t MeshModule::getBusiestModules(const MeshModule **out, size_t max)
+{
+    size_t count = 0;
+    if (!modules)
+        return 0;
+    for (auto i = modules->begin(); i != modules->end(); ++i) {
+        const MeshModule *pi = *i;
+        if (!pi->stats.calls)
+            continue;
+        // Insertion sort, there are only a few dozen modules
+        size_t pos = count < max ? count : max;
+        while (pos > 0 && out[pos - 1]->stats.totalUsec < pi->stats.totalUsec) {
+            if (pos < max)
+                out[pos] = out[pos - 1];
+            pos--;
+        }
+        if (pos < max) {
+            out[pos] = pi;
+            if (count < max)
+                count++;
+        }
+    }
+    return count;
+}
+
+void MeshModule::callModules(meshtastic_MeshPacket &mp, RxSource src, bool batched)
 {
     // LOG_DEBUG("In call modules");
     bool moduleFound = false;
@@ -101,7 +183,10 @@ void MeshModule::callModules(meshtastic_MeshPacket &mp, RxSource src)
     auto ourNodeNum = nodeDB->getNodeNum();
     bool toUs = isBroadcast(mp.to) || isToUs(&mp);
 
-    for (auto i = modules->begin(); i != modules->end(); ++i) {
+    // Only the modules registered for this portnum, plus the ones that want everything, keeping the order of modules
+    const std::vector<MeshModule *> &interested = getDispatchList(mp);
+
+    for (auto i = interested.begin(); i != interested.end(); ++i) {
         auto &pi = **i;
 
         pi.currentRequest = &mp;
@@ -141,10 +226,22 @@ void MeshModule::callModules(meshtastic_MeshPacket &mp, RxSource src)
                     currentReply = pi.allocErrorResponse(meshtastic_Routing_Error_NOT_AUTHORIZED, &mp);
                 } else
                     printPacket("packet on wrong channel, but can't respond", &mp);
+            } else if (pi.acceptsBatches) {
+                // Batch aware modules only observe, so they can wait for the end of the batch
+                if (batched) {
+                    pi.pendingBatch.push_back(&mp);
+                } else {
+                    const meshtastic_MeshPacket *single = &mp;
+                    uint32_t start = micros();
+                    pi.handleReceivedBatch(&single, 1);
+                    pi.countHandling(micros() - start);
+                }
             } else {
+                uint32_t start = micros();
                 ProcessMessage handled = pi.handleReceived(mp);
 
                 pi.alterReceived(mp);
+                pi.countHandling(micros() - start);
 
                 // Possibly send replies (but only if the message was directed to us specifically, i.e. not for promiscious
                 // sniffing) also: we only let the one module send a reply, once that happens, remaining modules are not
@@ -204,6 +301,30 @@ void MeshModule::callModules(meshtastic_MeshPacket &mp, RxSource src)
     }
 }
 
+void MeshModule::callBatchModules()
+{
+    if (!modules)
+        return;
+    for (auto i = modules->begin(); i != modules->end(); ++i) {
+        auto &pi = **i;
+        if (pi.pendingBatch.empty())
+            continue;
+        LOG_DEBUG("Module '%s' handles a batch of %u", pi.name, (unsigned)pi.pendingBatch.size());
+        uint32_t start = micros();
+        pi.handleReceivedBatch(pi.pendingBatch.data(), pi.pendingBatch.size());
+        pi.countHandling(micros() - start);
+        pi.pendingBatch.clear();
+    }
+}
+
+void MeshModule::countHandling(uint32_t usec)
+{
+    stats.calls++;
+    stats.totalUsec += usec;
+    if (usec > stats.maxUsec)
+        stats.maxUsec = usec;
+}
+
 meshtastic_MeshPacket *MeshModule::allocReply()
 {
     auto r = myReply;
@@ -12,6 +12,13 @@
 #define MESHMODULE_MIN_BROADCAST_DELAY_MS 30 * 1000 // Min. delay after boot before sending first broadcast by any module
 #define MESHMODULE_BROADCAST_SPACING_MS 15 * 1000   // Initial spacing between broadcasts of different modules
 
+/// Time spent handling received packets by a module, see MeshModule::getStats()
+struct MeshModuleStats {
+    uint32_t calls;
+    uint32_t maxUsec;
+    uint64_t totalUsec;
+};
+
 /** handleReceived return enumeration
  *
  * Use ProcessMessage::CONTINUE to allows other modules to process a message.
@@ -63,6 +70,28 @@ class MeshModule
 {
     static std::vector<MeshModule *> *modules;
 
+    /// The modules that can want packets on one portnum, in the order of modules
+    struct PortDispatch {
+        meshtastic_PortNum portNum;
+        std::vector<MeshModule *> modules;
+    };
+
+    /// Sorted by portnum, built from getPortNums() by buildDispatchTable()
+    static std::vector<PortDispatch> dispatchTable;
+
+    /// Modules that asked for every packet, offered encrypted packets and the portnums no one registered
+    static std::vector<MeshModule *> anyPortModules;
+
+    /// Cleared whenever a module comes or goes, so the next packet rebuilds the table
+    static bool dispatchTableValid;
+
+    static bool portNumLess(const PortDispatch &entry, meshtastic_PortNum portNum);
+
+    static void buildDispatchTable();
+
+    /// The modules callModules() needs to consider for mp
+    static const std::vector<MeshModule *> &getDispatchList(const meshtastic_MeshPacket &mp);
+
   public:
     /** Constructor
      * name is for debugging output
@@ -72,8 +101,26 @@ class MeshModule
     virtual ~MeshModule();
 
     /** For use only by MeshService
+     *
+     * @param batched mp is part of a Router receive batch, batch aware modules get it from callBatchModules() instead of right
+     * away, so mp must stay valid until then
+     */
+    static void callModules(meshtastic_MeshPacket &mp, RxSource src = RX_SRC_RADIO, bool batched = false);
+
+    /** Hand each batch aware module the packets of the current receive batch it wanted, called by Router once per batch
+     */
+    static void callBatchModules();
+
+    /** Fill out with up to max modules, the ones that spent the most time handling packets first.
+     * @return how many were filled
      */
-    static void callModules(meshtastic_MeshPacket &mp, RxSource src = RX_SRC_RADIO);
+    static size_t getBusiestModules(const MeshModule **out, size_t max);
+
+    static size_t getNumModules() { return modules ? modules->size() : 0; }
+
+    const char *getName() const { return name; }
+
+    const MeshModuleStats &getStats() const { return stats; }
 
     static std::vector<MeshModule *> GetMeshModulesWithUIFrames();
     static void observeUIEvents(Observer<const UIFrameEvent *> *observer);
@@ -105,6 +152,12 @@ class MeshModule
     /* We allow modules to ignore a request without sending an error if they have a specific reason for it. */
     bool ignoreRequest = false;
 
+    /** Modules that only observe traffic can set this to get packets through handleReceivedBatch(), once per router wakeup
+     * with everything that arrived in it, instead of through handleReceived().  Batch aware modules can't reply to a packet or
+     * stop other modules from seeing it.
+     */
+    bool acceptsBatches = false;
+
     /** If a bound channel name is set, we will only accept received packets that come in on that channel.
      * A special exception (FIXME, not sure if this is a good idea) - packets that arrive on the local interface
      * are allowed on any channel (this lets the local user do anything).
@@ -144,6 +197,14 @@ class MeshModule
      */
     virtual bool wantPacket(const meshtastic_MeshPacket *p) = 0;
 
+    /** Add the portnums wantPacket() can accept to portNums, so callModules() only asks this module about packets on those.
+     * Return false to be asked about every packet instead, which modules that sniff all traffic or want encrypted packets need.
+     *
+     * Read when the dispatch table is built on the first packet after modules were added or removed, so the answer must not
+     * change after construction.
+     */
+    virtual bool getPortNums(std::vector<meshtastic_PortNum> &portNums) { return false; }
+
     /** Called to handle a particular incoming message
 
     @return ProcessMessage::STOP if you've guaranteed you've handled this message and no other handlers should be considered for
@@ -151,6 +212,11 @@ class MeshModule
     */
     virtual ProcessMessage handleReceived(const meshtastic_MeshPacket &mp) { return ProcessMessage::CONTINUE; }
 
+    /** Called instead of handleReceived() if acceptsBatches is set, with the packets this module wanted, in arrival order.
+     * Packets from the local node come one at a time.
+     */
+    virtual void handleReceivedBatch(const meshtastic_MeshPacket *const *packets, size_t count) {}
+
     /** Called to change a particular incoming message
         This allows the module to change the message before it is passed through the rest of the call-chain.
     */
@@ -207,6 +273,14 @@ class MeshModule
 #endif
 
   private:
+    MeshModuleStats stats = {};
+
+    /// Add one handleReceived() or handleReceivedBatch() call that took usec to stats
+    void countHandling(uint32_t usec);
+
+    /// Packets of the current receive batch for handleReceivedBatch(), see callModules()
+    std::vector<const meshtastic_MeshPacket *> pendingBatch;
+
     /**
      * If any of the current chain of modules has already sent a reply, it will be here.  This is useful to allow
      * the RoutingModule to avoid sending redundant acks
@@ -3,8 +3,6 @@
 #include "configuration.h"
 #include <assert.h>
 
-#include <algorithm>
-
 /// @return the priority of the specified packet
 inline uint32_t getPriority(const meshtastic_MeshPacket *p)
 {
@@ -28,11 +26,136 @@ bool CompareMeshPacketFunc(const meshtastic_MeshPacket *p1, const meshtastic_Mes
     return (p1p != p2p) ? (p1p > p2p) : (!isFromUs(p1) && isFromUs(p2));
 }
 
-MeshPacketQueue::MeshPacketQueue(size_t _maxLen) : maxLen(_maxLen) {}
+#define INDEX_EMPTY ((uint16_t)0xFFFF)
+
+MeshPacketQueue::MeshPacketQueue(size_t _maxLen) : maxLen(_maxLen)
+{
+    assert(maxLen < INDEX_EMPTY);
+
+    // Keep the index at most half full so probe chains stay short
+    size_t indexSize = 8;
+    while (indexSize < 2 * maxLen)
+        indexSize <<= 1;
+    index.assign(indexSize, INDEX_EMPTY);
+    indexMask = indexSize - 1;
+    heap.reserve(maxLen);
+}
 
 bool MeshPacketQueue::empty()
 {
-    return queue.empty();
+    return heap.empty();
+}
+
+bool MeshPacketQueue::before(const Entry &a, const Entry &b)
+{
+    if (CompareMeshPacketFunc(a.p, b.p))
+        return true;
+    if (CompareMeshPacketFunc(b.p, a.p))
+        return false;
+    return (int32_t)(a.seq - b.seq) < 0; // equally ranked, first come first served
+}
+
+uint16_t MeshPacketQueue::homeSlot(NodeNum from, PacketId id) const
+{
+    uint32_t h = (from * 0x9E3779B1u) ^ id;
+    h ^= h >> 16;
+    h *= 0x85EBCA6Bu;
+    h ^= h >> 13;
+    return h & indexMask;
+}
+
+void MeshPacketQueue::place(size_t pos, const Entry &e)
+{
+    heap[pos] = e;
+    index[e.slot] = pos;
+}
+
+void MeshPacketQueue::siftUp(size_t pos)
+{
+    Entry e = heap[pos];
+    while (pos > 0) {
+        size_t parent = (pos - 1) / 2;
+        if (!before(e, heap[parent]))
+            break;
+        place(pos, heap[parent]);
+        pos = parent;
+    }
+    place(pos, e);
+}
+
+void MeshPacketQueue::siftDown(size_t pos)
+{
+    Entry e = heap[pos];
+    size_t n = heap.size();
+    while (true) {
+        size_t child = 2 * pos + 1;
+        if (child >= n)
+            break;
+        if (child + 1 < n && before(heap[child + 1], heap[child]))
+            child++;
+        if (!before(heap[child], e))
+            break;
+        place(pos, heap[child]);
+        pos = child;
+    }
+    place(pos, e);
+}
+
+void MeshPacketQueue::indexInsert(size_t pos)
+{
+    Entry &e = heap[pos];
+    uint16_t slot = homeSlot(e.from, e.p->id);
+    while (index[slot] != INDEX_EMPTY)
+        slot = (slot + 1) & indexMask;
+    index[slot] = pos;
+    e.slot = slot;
+}
+
+void MeshPacketQueue::indexErase(uint16_t slot)
+{
+    // Backward shift deletion, so lookups never need tombstones
+    uint16_t hole = slot;
+    index[hole] = INDEX_EMPTY;
+    for (uint16_t next = (hole + 1) & indexMask; index[next] != INDEX_EMPTY; next = (next + 1) & indexMask) {
+        Entry &e = heap[index[next]];
+        uint16_t home = homeSlot(e.from, e.p->id);
+        if (((next - home) & indexMask) >= ((next - hole) & indexMask)) {
+            index[hole] = index[next];
+            index[next] = INDEX_EMPTY;
+            e.slot = hole;
+            hole = next;
+        }
+    }
+}
+
+meshtastic_MeshPacket *MeshPacketQueue::removeAt(size_t pos)
+{
+    meshtastic_MeshPacket *p = heap[pos].p;
+    indexErase(heap[pos].slot);
+
+    Entry last = heap.back();
+    heap.pop_back();
+    if (pos < heap.size()) {
+        place(pos, last);
+        if (pos > 0 && before(heap[pos], heap[(pos - 1) / 2]))
+            siftUp(pos);
+        else
+            siftDown(pos);
+    }
+    return p;
+}
+
+int MeshPacketQueue::findPos(NodeNum from, PacketId id, bool tx_normal, bool tx_late) const
+{
+    // The same (from, id) can be queued more than once, the caller wants the one that would be sent first
+    int found = -1;
+    for (uint16_t slot = homeSlot(from, id); index[slot] != INDEX_EMPTY; slot = (slot + 1) & indexMask) {
+        const Entry &e = heap[index[slot]];
+        if (e.from == from && e.p->id == id && ((tx_normal && !e.p->tx_after) || (tx_late && e.p->tx_after)) &&
+            (found < 0 || before(e, heap[found])))
+            found = index[slot];
+    }
+    return found;
 }
 
 /**
@@ -68,7 +191,7 @@ void fixPriority(meshtastic_MeshPacket *p)
 bool MeshPacketQueue::enqueue(meshtastic_MeshPacket *p)
 {
     // no space - try to replace a lower priority packet in the queue
-    if (queue.size() >= maxLen) {
+    if (heap.size() >= maxLen) {
         bool replaced = replaceLowerPriorityPacket(p);
         if (!replaced) {
             LOG_WARN("TX queue is full, and there is no lower-priority packet available to evict in favour of 0x%08x", p->id);
@@ -76,9 +199,9 @@ bool MeshPacketQueue::enqueue(meshtastic_MeshPacket *p)
         return replaced;
     }
 
-    // Find the correct position using upper_bound to maintain a stable order
-    auto it = std::upper_bound(queue.begin(), queue.end(), p, CompareMeshPacketFunc);
-    queue.insert(it, p); // Insert packet at the found position
+    heap.push_back(Entry{p, getFrom(p), nextSeq++, 0});
+    indexInsert(heap.size() - 1);
+    siftUp(heap.size() - 1);
     return true;
 }
 
@@ -88,9 +211,7 @@ meshtastic_MeshPacket *MeshPacketQueue::dequeue()
         return NULL;
     }
 
-    auto *p = queue.front();
-    queue.erase(queue.begin()); // Remove the highest-priority packet
-    return p;
+    return removeAt(0); // Remove the highest-priority packet
 }
 
 meshtastic_MeshPacket *MeshPacketQueue::getFront()
@@ -99,35 +220,20 @@ meshtastic_MeshPacket *MeshPacketQueue::getFront()
         return NULL;
     }
 
-    auto *p = queue.front();
-    return p;
+    return heap[0].p;
 }
 
 /** Attempt to find and remove a packet from this queue.  Returns a pointer to the removed packet, or NULL if not found */
 meshtastic_MeshPacket *MeshPacketQueue::remove(NodeNum from, PacketId id, bool tx_normal, bool tx_late)
 {
-    for (auto it = queue.begin(); it != queue.end(); it++) {
-        auto p = (*it);
-        if (getFrom(p) == from && p->id == id && ((tx_normal && !p->tx_after) || (tx_late && p->tx_after))) {
-            queue.erase(it);
-            return p;
-        }
-    }
-
-    return NULL;
+    int pos = findPos(from, id, tx_normal, tx_late);
+    return pos < 0 ? NULL : removeAt(pos);
 }
 
 /* Attempt to find a packet from this queue. Return true if it was found. */
 bool MeshPacketQueue::find(NodeNum from, PacketId id)
 {
-    for (auto it = queue.begin(); it != queue.end(); it++) {
-        auto p = (*it);
-        if (getFrom(p) == from && p->id == id) {
-            return true;
-        }
-    }
-
-    return false;
+    return findPos(from, id) >= 0;
 }
 
 /**
@@ -136,40 +242,23 @@ bool MeshPacketQueue::find(NodeNum from, PacketId id)
  */
 bool MeshPacketQueue::replaceLowerPriorityPacket(meshtastic_MeshPacket *p)
 {
-
-    if (queue.empty()) {
-        return false; // No packets to replace
+    // Late packets are never evicted, look for the last non-late packet in queue order.  Only reached when the queue is
+    // full, so a scan is fine here.
+    int worst = -1;
+    for (size_t i = 0; i < heap.size(); i++) {
+        if (!heap[i].p->tx_after && (worst < 0 || before(heap[worst], heap[i])))
+            worst = i;
     }
 
-    // Check if the packet at the back has a lower priority than the new packet
-    auto *backPacket = queue.back();
-    if (!backPacket->tx_after && backPacket->priority < p->priority) {
-        LOG_WARN("Dropping packet 0x%08x to make room in the TX queue for higher-priority packet 0x%08x", backPacket->id, p->id);
-        // Remove the back packet
-        queue.pop_back();
-        packetPool.release(backPacket);
+    if (worst >= 0 && heap[worst].p->priority < p->priority) {
+        LOG_WARN("Dropping packet 0x%08x to make room in the TX queue for higher-priority packet 0x%08x", heap[worst].p->id,
+                 p->id);
+        packetPool.release(removeAt(worst));
         // Insert the new packet in the correct order
         enqueue(p);
         return true;
     }
 
-    if (backPacket->tx_after) {
-        // Check if there's a non-late packet with lower priority
-        auto it = queue.end();
-        auto refPacket = *--it;
-        for (; refPacket->tx_after && it != queue.begin(); refPacket = *--it)
-            ;
-        if (!refPacket->tx_after && refPacket->priority < p->priority) {
-            LOG_WARN("Dropping non-late packet 0x%08x to make room in the TX queue for higher-priority packet 0x%08x",
-                     refPacket->id, p->id);
-            queue.erase(it);
-            packetPool.release(refPacket);
-            // Insert the new packet in the correct order
-            enqueue(p);
-            return true;
-        }
-    }
-
-    // If the back packet's priority is not lower, no replacement occurs
+    // If no packet has lower priority, no replacement occurs
     return false;
-}
\ No newline at end of file
+}
@@ -2,15 +2,51 @@
 
 #include "MeshTypes.h"
 
-#include <queue>
+#include <vector>
 
 /**
  * A priority queue of packets
+ *
+ * Packets live in a binary heap ordered by CompareMeshPacketFunc, with ties broken by arrival so equal packets leave in the
+ * order they came (the same order a sorted list with upper_bound insertion gives).  A small open addressing table maps
+ * (from, id) to heap positions, so the cancel/find lookups we do for every duplicate we hear don't scan the queue.
  */
 class MeshPacketQueue
 {
+    struct Entry {
+        meshtastic_MeshPacket *p;
+        NodeNum from;  // getFrom(p), cached for the index
+        uint32_t seq;  // arrival order, breaks ties between equally ranked packets
+        uint16_t slot; // our position in index
+    };
+
     size_t maxLen;
-    std::vector<meshtastic_MeshPacket *> queue;
+    std::vector<Entry> heap;
+
+    /// (from, id) hash table of heap positions, linear probing, INDEX_EMPTY marks a free slot
+    std::vector<uint16_t> index;
+    uint16_t indexMask = 0;
+
+    uint32_t nextSeq = 0;
+
+    /// @return true if a should leave the queue before b
+    static bool before(const Entry &a, const Entry &b);
+
+    uint16_t homeSlot(NodeNum from, PacketId id) const;
+
+    /// Put the entry at pos into its slot and fix up index/slot links as it moves
+    void place(size_t pos, const Entry &e);
+    void siftUp(size_t pos);
+    void siftDown(size_t pos);
+
+    void indexInsert(size_t pos);
+    void indexErase(uint16_t slot);
+
+    /// Remove the entry at heap position pos and return its packet
+    meshtastic_MeshPacket *removeAt(size_t pos);
+
+    /// @return heap position of the first queued (from, id) packet matching the tx window filter, or -1
+    int findPos(NodeNum from, PacketId id, bool tx_normal = true, bool tx_late = true) const;
 
     /** Replace a lower priority package in the queue with 'mp' (provided there are lower pri packages). Return true if replaced.
      */
@@ -26,7 +62,7 @@ class MeshPacketQueue
     bool empty();
 
     /** return amount of free packets in Queue */
-    size_t getFree() { return maxLen - queue.size(); }
+    size_t getFree() { return maxLen - heap.size(); }
 
     /** return total size of the Queue */
     size_t getMaxLen() { return maxLen; }
@@ -40,4 +76,4 @@ class MeshPacketQueue
 
     /* Attempt to find a packet from this queue. Return true if it was found. */
     bool find(NodeNum from, PacketId id);
-};
\ No newline at end of file
+};
@@ -3,6 +3,7 @@
 #include <Arduino.h>
 #include <assert.h>
 #include <string>
+#include <vector>
 
 #include "GPSStatus.h"
 #include "MemoryPool.h"
@@ -67,6 +68,14 @@ class MeshService
                p->decoded.portnum == meshtastic_PortNum_DETECTION_SENSOR_APP ||
                p->decoded.portnum == meshtastic_PortNum_ALERT_APP;
     }
+    /// Add every portnum isTextPayload() can accept, for MeshModule::getPortNums()
+    static void getTextPortNums(std::vector<meshtastic_PortNum> &portNums)
+    {
+        portNums.push_back(meshtastic_PortNum_TEXT_MESSAGE_APP);
+        portNums.push_back(meshtastic_PortNum_DETECTION_SENSOR_APP);
+        portNums.push_back(meshtastic_PortNum_ALERT_APP);
+        portNums.push_back(meshtastic_PortNum_RANGE_TEST_APP);
+    }
     /// Called when some new packets have arrived from one of the radios
     Observable<uint32_t> fromNumChanged;
 
@@ -93,6 +102,9 @@ class MeshService
     /// Return the next MqttClientProxyMessage packet destined to the phone.
     meshtastic_MqttClientProxyMessage *getMqttClientProxyMessageForPhone() { return toPhoneMqttProxyQueue.dequeuePtr(0); }
 
+    /// How many more messages the client proxy queue takes before it starts dropping the oldest
+    int numFreeMqttClientProxyMessages() { return toPhoneMqttProxyQueue.numFree(); }
+
     /// Return the next ClientNotification packet destined to the phone.
     meshtastic_ClientNotification *getClientNotificationForPhone() { return toPhoneClientNotificationQueue.dequeuePtr(0); }
 
@@ -51,6 +51,9 @@ typedef int ErrorCode;
 extern Allocator<meshtastic_MeshPacket> &packetPool;
 using UniquePacketPoolPacket = Allocator<meshtastic_MeshPacket>::UniqueAllocation;
 
+/// How full packetPool is and has been
+MemoryPoolStats getPacketPoolStats();
+
 /**
  * Most (but not always) of the time we want to treat packets 'from' the local phone (where from == 0), as if they originated on
  * the local node. If from is zero this function returns our node number instead
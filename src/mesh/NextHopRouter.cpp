@@ -2,12 +2,6 @@
 
 NextHopRouter::NextHopRouter() {}
 
-PendingPacket::PendingPacket(meshtastic_MeshPacket *p, uint8_t numRetransmissions)
-{
-    packet = p;
-    this->numRetransmissions = numRetransmissions - 1; // We subtract one, because we assume the user just did the first send
-}
-
 /**
  * Send a packet
  */
@@ -37,21 +31,22 @@ bool NextHopRouter::shouldFilterReceived(const meshtastic_MeshPacket *p)
         rxDupe++;
         stopRetransmission(p->from, p->id);
 
-        // If it was a fallback to flooding, try to relay again
-        if (wasFallback) {
-            LOG_INFO("Fallback to flooding from relay_node=0x%x", p->relay_node);
+        switch (dupeAction(p, wasFallback, weWereNextHop)) {
+        case DUPE_RELAY_AGAIN:
             // Check if it's still in the Tx queue, if not, we have to relay it again
             if (!findInTxQueue(p->from, p->id))
                 perhapsRelay(p);
-        } else {
-            bool isRepeated = p->hop_start > 0 && p->hop_start == p->hop_limit;
-            // If repeated and not in Tx queue anymore, try relaying again, or if we are the destination, send the ACK again
-            if (isRepeated) {
-                if (!findInTxQueue(p->from, p->id) && !perhapsRelay(p) && isToUs(p) && p->want_ack)
-                    sendAckNak(meshtastic_Routing_Error_NONE, getFrom(p), p->id, p->channel, 0);
-            } else if (!weWereNextHop) {
-                perhapsCancelDupe(p); // If it's a dupe, cancel relay if we were not explicitly asked to relay
-            }
+            break;
+        case DUPE_REPEATED:
+            // If not in Tx queue anymore, try relaying again, or if we are the destination, send the ACK again
+            if (!findInTxQueue(p->from, p->id) && !perhapsRelay(p) && isToUs(p) && p->want_ack)
+                sendAckNak(meshtastic_Routing_Error_NONE, getFrom(p), p->id, p->channel, 0);
+            break;
+        case DUPE_CANCEL:
+            perhapsCancelDupe(p);
+            break;
+        case DUPE_DROP:
+            break;
         }
         return true;
     }
@@ -59,6 +54,19 @@ bool NextHopRouter::shouldFilterReceived(const meshtastic_MeshPacket *p)
     return Router::shouldFilterReceived(p);
 }
 
+FloodingRouter::DupeAction NextHopRouter::dupeAction(const meshtastic_MeshPacket *p, bool wasFallback, bool weWereNextHop)
+{
+    // If it was a fallback to flooding, try to relay again
+    if (wasFallback) {
+        LOG_INFO("Fallback to flooding from relay_node=0x%x", p->relay_node);
+        return DUPE_RELAY_AGAIN;
+    }
+    if (p->hop_start > 0 && p->hop_start == p->hop_limit)
+        return DUPE_REPEATED;
+    // If it's a dupe, cancel relay if we were not explicitly asked to relay
+    return weWereNextHop ? DUPE_DROP : DUPE_CANCEL;
+}
+
 void NextHopRouter::sniffReceived(const meshtastic_MeshPacket *p, const meshtastic_Routing *c)
 {
     NodeNum ourNodeNum = getNodeNum();
@@ -95,26 +103,32 @@ void NextHopRouter::sniffReceived(const meshtastic_MeshPacket *p, const meshtast
     Router::sniffReceived(p, c);
 }
 
-/* Check if we should be relaying this packet if so, do so. */
-bool NextHopRouter::perhapsRelay(const meshtastic_MeshPacket *p)
+meshtastic_MeshPacket *NextHopRouter::copyForRelay(const meshtastic_MeshPacket *p)
 {
     if (!isToUs(p) && !isFromUs(p) && p->hop_limit > 0) {
-        if (p->next_hop == NO_NEXT_HOP_PREFERENCE || p->next_hop == nodeDB->getLastByteOfNodeNum(getNodeNum())) {
+        if (p->next_hop == NO_NEXT_HOP_PREFERENCE || p->next_hop == nodeDB->getLastByteOfNodeNum(nodeDB->getNodeNum())) {
             if (isRebroadcaster()) {
                 meshtastic_MeshPacket *tosend = packetPool.allocCopy(*p); // keep a copy because we will be sending it
-                LOG_INFO("Relaying received message coming from %x", p->relay_node);
-
-                tosend->hop_limit--; // bump down the hop count
-                NextHopRouter::send(tosend);
-
-                return true;
+                tosend->hop_limit--;                                      // bump down the hop count
+                return tosend;
             } else {
                 LOG_DEBUG("Not rebroadcasting: Role = CLIENT_MUTE or Rebroadcast Mode = NONE");
             }
         }
     }
+    return NULL;
+}
 
-    return false;
+/* Check if we should be relaying this packet if so, do so. */
+bool NextHopRouter::perhapsRelay(const meshtastic_MeshPacket *p)
+{
+    meshtastic_MeshPacket *tosend = copyForRelay(p);
+    if (!tosend)
+        return false;
+
+    LOG_INFO("Relaying received message coming from %x", p->relay_node);
+    NextHopRouter::send(tosend);
+    return true;
 }
 
 /**
@@ -141,11 +155,7 @@ uint8_t NextHopRouter::getNextHop(NodeNum to, uint8_t relay_node)
 
 PendingPacket *NextHopRouter::findPendingPacket(GlobalPacketId key)
 {
-    auto old = pending.find(key); // If we have an old record, someone messed up because id got reused
-    if (old != pending.end()) {
-        return &old->second;
-    } else
-        return NULL;
+    return pending.find(key); // If we have an old record, someone messed up because id got reused
 }
 
 /**
@@ -170,8 +180,8 @@ bool NextHopRouter::stopRetransmission(GlobalPacketId key)
             // now free the pooled copy for retransmission too
             packetPool.release(p);
         }
-        auto numErased = pending.erase(key);
-        assert(numErased == 1);
+        bool removed = pending.remove(key);
+        assert(removed);
         return true;
     } else
         return false;
@@ -188,77 +198,69 @@ PendingPacket *NextHopRouter::startRetransmission(meshtastic_MeshPacket *p, uint
     stopRetransmission(getFrom(p), p->id);
 
     setNextTx(&rec);
-    pending[id] = rec;
-
-    return &pending[id];
+    return pending.add(id, rec);
 }
 
 /**
- * Do any retransmissions that are scheduled (FIXME - for the time being called from loop)
+ * Do any retransmissions that are due
  */
 int32_t NextHopRouter::doRetransmissions()
 {
     uint32_t now = millis();
-    int32_t d = INT32_MAX;
-
-    // FIXME, we should use a better datastructure rather than walking through this map.
-    // for(auto el: pending) {
-    for (auto it = pending.begin(), nextIt = it; it != pending.end(); it = nextIt) {
-        ++nextIt; // we use this odd pattern because we might be deleting it...
-        auto &p = it->second;
-
-        bool stillValid = true; // assume we'll keep this record around
-
-        // FIXME, handle 51 day rolloever here!!!
-        if (p.nextTxMsec <= now) {
-            if (p.numRetransmissions == 0) {
-                if (isFromUs(p.packet)) {
-                    LOG_DEBUG("Reliable send failed, returning a nak for fr=0x%x,to=0x%x,id=0x%x", p.packet->from, p.packet->to,
-                              p.packet->id);
-                    sendAckNak(meshtastic_Routing_Error_MAX_RETRANSMIT, getFrom(p.packet), p.packet->id, p.packet->channel);
-                }
-                // Note: we don't stop retransmission here, instead the Nak packet gets processed in sniffReceived
-                stopRetransmission(it->first);
-                stillValid = false; // just deleted it
-            } else {
-                LOG_DEBUG("Sending retransmission fr=0x%x,to=0x%x,id=0x%x, tries left=%d", p.packet->from, p.packet->to,
-                          p.packet->id, p.numRetransmissions);
 
-                if (!isBroadcast(p.packet->to)) {
-                    if (p.numRetransmissions == 1) {
-                        // Last retransmission, reset next_hop (fallback to FloodingRouter)
-                        p.packet->next_hop = NO_NEXT_HOP_PREFERENCE;
-                        // Also reset it in the nodeDB
-                        meshtastic_NodeInfoLite *sentTo = nodeDB->getMeshNode(p.packet->to);
-                        if (sentTo) {
-                            LOG_INFO("Resetting next hop for packet with dest 0x%x\n", p.packet->to);
-                            sentTo->next_hop = NO_NEXT_HOP_PREFERENCE;
-                        }
-                        FloodingRouter::send(packetPool.allocCopy(*p.packet));
-                    } else {
-                        NextHopRouter::send(packetPool.allocCopy(*p.packet));
+    // Only the due records get touched, each one is either rescheduled or removed so this terminates
+    while (auto e = pending.nextDue(now)) {
+        // Sending can stop or restart this very retransmission (and free the record), so keep what we need by value
+        const GlobalPacketId key = e->first;
+        auto &p = e->second;
+
+        if (p.numRetransmissions == 0) {
+            if (isFromUs(p.packet)) {
+                LOG_DEBUG("Reliable send failed, returning a nak for fr=0x%x,to=0x%x,id=0x%x", p.packet->from, p.packet->to,
+                          p.packet->id);
+                sendAckNak(meshtastic_Routing_Error_MAX_RETRANSMIT, getFrom(p.packet), p.packet->id, p.packet->channel);
+            }
+            // Note: we don't stop retransmission here, instead the Nak packet gets processed in sniffReceived
+            stopRetransmission(key);
+        } else {
+            LOG_DEBUG("Sending retransmission fr=0x%x,to=0x%x,id=0x%x, tries left=%d", p.packet->from, p.packet->to,
+                      p.packet->id, p.numRetransmissions);
+
+            const meshtastic_MeshPacket *packet = p.packet;
+            const uint8_t numRetransmissions = p.numRetransmissions;
+            meshtastic_MeshPacket *copy = packetPool.allocCopy(*packet);
+            if (!isBroadcast(packet->to)) {
+                if (numRetransmissions == 1) {
+                    // Last retransmission, reset next_hop (fallback to FloodingRouter)
+                    p.packet->next_hop = NO_NEXT_HOP_PREFERENCE;
+                    copy->next_hop = NO_NEXT_HOP_PREFERENCE;
+                    // Also reset it in the nodeDB
+                    meshtastic_NodeInfoLite *sentTo = nodeDB->getMeshNode(packet->to);
+                    if (sentTo) {
+                        LOG_INFO("Resetting next hop for packet with dest 0x%x\n", packet->to);
+                        sentTo->next_hop = NO_NEXT_HOP_PREFERENCE;
                     }
+                    FloodingRouter::send(copy);
                 } else {
-                    // Note: we call the superclass version because we don't want to have our version of send() add a new
-                    // retransmission record
-                    FloodingRouter::send(packetPool.allocCopy(*p.packet));
+                    NextHopRouter::send(copy);
                 }
-
-                // Queue again
-                --p.numRetransmissions;
-                setNextTx(&p);
+            } else {
+                // Note: we call the superclass version because we don't want to have our version of send() add a new
+                // retransmission record
+                FloodingRouter::send(copy);
             }
-        }
 
-        if (stillValid) {
-            // Update our desired sleep delay
-            int32_t t = p.nextTxMsec - now;
-
-            d = min(t, d);
+            // Queue again, unless sending removed our record or replaced it with a fresh one
+            PendingPacket *rec = pending.find(key);
+            if (rec && rec->packet == packet && rec->numRetransmissions == numRetransmissions) {
+                --rec->numRetransmissions;
+                setNextTx(rec);
+                pending.reschedule(rec);
+            }
         }
     }
 
-    return d;
+    return pending.msecUntilNext(millis());
 }
 
 void NextHopRouter::setNextTx(PendingPacket *pending)
@@ -1,52 +1,7 @@
 #pragma once
 
 #include "FloodingRouter.h"
-#include <unordered_map>
-
-/**
- * An identifier for a globally unique message - a pair of the sending nodenum and the packet id assigned
- * to that message
- */
-struct GlobalPacketId {
-    NodeNum node;
-    PacketId id;
-
-    bool operator==(const GlobalPacketId &p) const { return node == p.node && id == p.id; }
-
-    explicit GlobalPacketId(const meshtastic_MeshPacket *p)
-    {
-        node = getFrom(p);
-        id = p->id;
-    }
-
-    GlobalPacketId(NodeNum _from, PacketId _id)
-    {
-        node = _from;
-        id = _id;
-    }
-};
-
-/**
- * A packet queued for retransmission
- */
-struct PendingPacket {
-    meshtastic_MeshPacket *packet;
-
-    /** The next time we should try to retransmit this packet */
-    uint32_t nextTxMsec = 0;
-
-    /** Starts at NUM_RETRANSMISSIONS -1 and counts down.  Once zero it will be removed from the list */
-    uint8_t numRetransmissions = 0;
-
-    PendingPacket() {}
-    explicit PendingPacket(meshtastic_MeshPacket *p, uint8_t numRetransmissions);
-};
-
-class GlobalPacketIdHashFunction
-{
-  public:
-    size_t operator()(const GlobalPacketId &p) const { return (std::hash<NodeNum>()(p.node)) ^ (std::hash<PacketId>()(p.id)); }
-};
+#include "RetransmissionQueue.h"
 
 /*
   Router for direct messages, which only relays if it is the next hop for a packet. The next hop is set by the current
@@ -86,6 +41,12 @@ class NextHopRouter : public FloodingRouter
         return min(d, r);
     }
 
+    /// What NextHopRouter does on hearing p again, given what wasSeenRecently() said about our record of it
+    static DupeAction dupeAction(const meshtastic_MeshPacket *p, bool wasFallback, bool weWereNextHop);
+
+    /// The copy of p to relay (from the pool, hop limit already lowered), or NULL if it is not ours to relay
+    static meshtastic_MeshPacket *copyForRelay(const meshtastic_MeshPacket *p);
+
     // The number of retransmissions intermediate nodes will do (actually 1 less than this)
     constexpr static uint8_t NUM_INTERMEDIATE_RETX = 2;
     // The number of retransmissions the original sender will do
@@ -95,7 +56,7 @@ class NextHopRouter : public FloodingRouter
     /**
      * Pending retransmissions
      */
-    std::unordered_map<GlobalPacketId, PendingPacket, GlobalPacketIdHashFunction> pending;
+    RetransmissionQueue pending;
 
     /**
      * Should this incoming filter be dropped?
@@ -130,7 +91,7 @@ class NextHopRouter : public FloodingRouter
     bool stopRetransmission(GlobalPacketId p);
 
     /**
-     * Do any retransmissions that are scheduled (FIXME - for the time being called from loop)
+     * Do any retransmissions that are due (called from runOnce)
      *
      * @return the number of msecs until our next retransmission or MAXINT if none scheduled
      */
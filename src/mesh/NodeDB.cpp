@@ -7,6 +7,7 @@
 #include "CryptoEngine.h"
 #include "Default.h"
 #include "FSCommon.h"
+#include "FromRadioCache.h"
 #include "MeshRadio.h"
 #include "NodeDB.h"
 #include "PacketHistory.h"
@@ -23,6 +24,7 @@
 #include "modules/NeighborInfoModule.h"
 #include <ErriezCRC32.h>
 #include <algorithm>
+#include <functional>
 #include <pb_decode.h>
 #include <pb_encode.h>
 #include <vector>
@@ -472,6 +474,7 @@ void NodeDB::installDefaultNodeDatabase()
     nodeDatabase.nodes = std::vector<meshtastic_NodeInfoLite>(MAX_NUM_NODES);
     numMeshNodes = 0;
     meshNodes = &nodeDatabase.nodes;
+    rebuildNodeIndex();
 }
 
 void NodeDB::installDefaultConfig(bool preserveKey = false)
@@ -905,6 +908,10 @@ void NodeDB::resetNodes()
         clearLocalPosition();
     numMeshNodes = 1;
     std::fill(nodeDatabase.nodes.begin() + 1, nodeDatabase.nodes.end(), meshtastic_NodeInfoLite());
+    rebuildNodeIndex();
+#if FROMRADIO_CACHE
+    fromRadioCache.touch(FromRadioCache::NODES);
+#endif
     devicestate.has_rx_text_message = false;
     devicestate.has_rx_waypoint = false;
     saveNodeDatabaseToDisk();
@@ -915,18 +922,14 @@ void NodeDB::resetNodes()
 
 void NodeDB::removeNodeByNum(NodeNum nodeNum)
 {
-    int newPos = 0, removed = 0;
-    for (int i = 0; i < numMeshNodes; i++) {
-        if (meshNodes->at(i).num != nodeNum)
-            meshNodes->at(newPos++) = meshNodes->at(i);
-        else
-            removed++;
+    int removed = 0;
+    pb_size_t pos = nodeIndex[findIndexBucket(nodeNum)];
+    if (pos != NODEDB_INDEX_EMPTY) {
+        removeNodeAt(pos);
+        removed++;
     }
-    numMeshNodes -= removed;
-    std::fill(nodeDatabase.nodes.begin() + numMeshNodes, nodeDatabase.nodes.begin() + numMeshNodes + 1,
-              meshtastic_NodeInfoLite());
     LOG_DEBUG("NodeDB::removeNodeByNum purged %d entries. Save changes", removed);
-    saveNodeDatabaseToDisk();
+    flushNodeJournal();
 }
 
 void NodeDB::clearLocalPosition()
@@ -942,6 +945,8 @@ void NodeDB::clearLocalPosition()
 void NodeDB::cleanupMeshDB()
 {
     int newPos = 0, removed = 0;
+    // Compact in place and rebuild the index as we go, so duplicate entries for the same NodeNum are purged as well
+    std::fill(nodeIndex.begin(), nodeIndex.end(), NODEDB_INDEX_EMPTY);
     for (int i = 0; i < numMeshNodes; i++) {
         if (meshNodes->at(i).has_user) {
             if (meshNodes->at(i).user.public_key.size > 0) {
@@ -949,15 +954,23 @@ void NodeDB::cleanupMeshDB()
                     meshNodes->at(i).user.public_key.size = 0;
                 }
             }
-            meshNodes->at(newPos++) = meshNodes->at(i);
-        } else {
-            removed++;
+            if (newPos != i)
+                meshNodes->at(newPos) = meshNodes->at(i);
+            if (indexNode(newPos)) {
+                newPos++;
+                continue;
+            }
         }
+        removed++;
     }
     numMeshNodes -= removed;
     std::fill(nodeDatabase.nodes.begin() + numMeshNodes, nodeDatabase.nodes.begin() + numMeshNodes + removed,
               meshtastic_NodeInfoLite());
+    evictionOrderDirty = true;
     LOG_DEBUG("cleanupMeshDB purged %d entries", removed);
+#if FROMRADIO_CACHE
+    fromRadioCache.touch(FromRadioCache::NODES);
+#endif
 }
 
 void NodeDB::installDefaultDeviceState()
@@ -1098,14 +1111,30 @@ void NodeDB::loadFromDisk()
     } else {
         meshNodes = &nodeDatabase.nodes;
         numMeshNodes = nodeDatabase.nodes.size();
+        pb_get_encoded_size(&lastSnapshotBytes, meshtastic_NodeDatabase_fields, &nodeDatabase);
         LOG_INFO("Loaded saved nodedatabase version %d, with nodes count: %d", nodeDatabase.version, nodeDatabase.nodes.size());
     }
+    bool replayJournal = state == LoadFileResult::LOAD_SUCCESS && nodeDatabase.version >= DEVICESTATE_MIN_VER;
 
     if (numMeshNodes > MAX_NUM_NODES) {
         LOG_WARN("Node count %d exceeds MAX_NUM_NODES %d, truncating", numMeshNodes, MAX_NUM_NODES);
         numMeshNodes = MAX_NUM_NODES;
     }
     meshNodes->resize(MAX_NUM_NODES);
+    rebuildNodeIndex();
+
+    // Then apply what changed since that file was written.  A journal without its snapshot is worthless, and a damaged one
+    // is replaced by a fresh snapshot so that new changes don't end up behind the damage.
+    if (!replayJournal) {
+        nodeJournal.reset();
+    } else if (!nodeJournal.replay([this](NodeNum n) { return getOrCreateMeshNode(n); },
+                                   [this](NodeNum n) {
+                                       pb_size_t pos = nodeIndex[findIndexBucket(n)];
+                                       if (pos != NODEDB_INDEX_EMPTY)
+                                           removeNodeAt(pos);
+                                   })) {
+        saveNodeDatabaseToDisk();
+    }
 
     // static DeviceState scratch; We no longer read into a tempbuf because this structure is 15KB of valuable RAM
     state = loadProto(deviceStateFileName, meshtastic_DeviceState_size, sizeof(meshtastic_DeviceState),
@@ -1307,7 +1336,21 @@ bool NodeDB::saveNodeDatabaseToDisk()
 #endif
     size_t nodeDatabaseSize;
     pb_get_encoded_size(&nodeDatabaseSize, meshtastic_NodeDatabase_fields, &nodeDatabase);
-    return saveProto(nodeDatabaseFileName, nodeDatabaseSize, &meshtastic_NodeDatabase_msg, &nodeDatabase, false);
+    if (!saveProto(nodeDatabaseFileName, nodeDatabaseSize, &meshtastic_NodeDatabase_msg, &nodeDatabase, false))
+        return false;
+    // The snapshot holds every change in the journal
+    lastSnapshotBytes = nodeDatabaseSize;
+    nodeJournal.reset();
+    return true;
+}
+
+bool NodeDB::flushNodeJournal(uint8_t parts)
+{
+    lastJournalFlush = millis();
+    if (!nodeJournal.wantsCompaction(lastSnapshotBytes) &&
+        nodeJournal.flush([this](NodeNum n) -> const meshtastic_NodeInfoLite * { return getMeshNode(n); }, parts))
+        return true;
+    return saveToDisk(SEGMENT_NODEDATABASE);
 }
 
 bool NodeDB::saveToDiskNoRetry(int saveWhat)
@@ -1367,6 +1410,10 @@ bool NodeDB::saveToDiskNoRetry(int saveWhat)
 bool NodeDB::saveToDisk(int saveWhat)
 {
     LOG_DEBUG("Save to disk %d", saveWhat);
+#if FROMRADIO_CACHE
+    // Nodes are touched one at a time as they change, the node database is saved far too often to invalidate them all here
+    fromRadioCache.touchSegments(saveWhat & ~SEGMENT_NODEDATABASE);
+#endif
     bool success = saveToDiskNoRetry(saveWhat);
 
     if (!success) {
@@ -1477,6 +1524,10 @@ void NodeDB::updatePosition(uint32_t nodeId, const meshtastic_Position &p, RxSou
             info->position.time = tmp_time;
     }
     info->has_position = true;
+    nodeJournal.mark(nodeId, NodeDBJournal::POSITION);
+#if FROMRADIO_CACHE
+    fromRadioCache.touchNode(nodeId);
+#endif
     updateGUIforNode = info;
     notifyObservers(true); // Force an update whether or not our node counts have changed
 }
@@ -1500,6 +1551,10 @@ void NodeDB::updateTelemetry(uint32_t nodeId, const meshtastic_Telemetry &t, RxS
     }
     info->device_metrics = t.variant.device_metrics;
     info->has_device_metrics = true;
+    nodeJournal.mark(nodeId, NodeDBJournal::METRICS);
+#if FROMRADIO_CACHE
+    fromRadioCache.touchNode(nodeId);
+#endif
     updateGUIforNode = info;
     notifyObservers(true); // Force an update whether or not our node counts have changed
 }
@@ -1523,7 +1578,11 @@ void NodeDB::addFromContact(meshtastic_SharedContact contact)
     updateGUIforNode = info;
     powerFSM.trigger(EVENT_NODEDB_UPDATED);
     notifyObservers(true); // Force an update whether or not our node counts have changed
-    saveNodeDatabaseToDisk();
+    nodeJournal.mark(contact.node_num, NodeDBJournal::NODE);
+#if FROMRADIO_CACHE
+    fromRadioCache.touchNode(contact.node_num);
+#endif
+    flushNodeJournal();
 }
 
 /** Update user info and channel for this node based on received user data
@@ -1552,6 +1611,11 @@ bool NodeDB::updateUser(uint32_t nodeId, meshtastic_User &p, uint8_t channelInde
     // Both of info->user and p start as filled with zero so I think this is okay
     auto lite = TypeConversions::ConvertToUserLite(p);
     bool changed = memcmp(&info->user, &lite, sizeof(info->user)) || (info->channel != channelIndex);
+#if !(MESHTASTIC_EXCLUDE_PKI)
+    if (info->user.public_key.size != lite.public_key.size ||
+        memcmp(info->user.public_key.bytes, lite.public_key.bytes, sizeof(lite.public_key.bytes)) != 0)
+        crypto->invalidateSharedKey(nodeId); // Don't keep a shared key derived from the old public key around
+#endif
 
     info->user = lite;
     if (info->user.public_key.size == 32) {
@@ -1567,12 +1631,16 @@ bool NodeDB::updateUser(uint32_t nodeId, meshtastic_User &p, uint8_t channelInde
         updateGUIforNode = info;
         powerFSM.trigger(EVENT_NODEDB_UPDATED);
         notifyObservers(true); // Force an update whether or not our node counts have changed
+        nodeJournal.mark(nodeId, NodeDBJournal::USER);
+#if FROMRADIO_CACHE
+        fromRadioCache.touchNode(nodeId);
+#endif
 
         // We just changed something about a User,
-        // store our DB unless we just did so less than a minute ago
+        // store our DB unless we just did so less than a minute ago.  Who we heard when waits for the periodic flush.
 
         if (!Throttle::isWithinTimespanMs(lastNodeDbSave, ONE_MINUTE_MS)) {
-            saveToDisk(SEGMENT_NODEDATABASE);
+            flushNodeJournal((uint8_t)~NodeDBJournal::HEARD);
             lastNodeDbSave = millis();
         } else {
             LOG_DEBUG("Defer NodeDB saveToDisk for now");
@@ -1611,6 +1679,13 @@ void NodeDB::updateFrom(const meshtastic_MeshPacket &mp)
             info->has_hops_away = true;
             info->hops_away = mp.hop_start - mp.hop_limit;
         }
+
+        nodeJournal.mark(info->num, NodeDBJournal::HEARD);
+#if FROMRADIO_CACHE
+        fromRadioCache.touchNode(info->num);
+#endif
+        if (!Throttle::isWithinTimespanMs(lastJournalFlush, NODEDB_JOURNAL_FLUSH_MSEC))
+            flushNodeJournal();
     }
 }
 
@@ -1627,11 +1702,144 @@ uint8_t NodeDB::getMeshNodeChannel(NodeNum n)
 /// NOTE: This function might be called from an ISR
 meshtastic_NodeInfoLite *NodeDB::getMeshNode(NodeNum n)
 {
-    for (int i = 0; i < numMeshNodes; i++)
-        if (meshNodes->at(i).num == n)
-            return &meshNodes->at(i);
+    if (nodeIndex.empty())
+        return NULL;
+
+    pb_size_t pos = nodeIndex[findIndexBucket(n)];
+    if (pos == NODEDB_INDEX_EMPTY)
+        return NULL;
+
+    return &meshNodes->at(pos);
+}
+
+size_t NodeDB::findIndexBucket(NodeNum n) const
+{
+    // Fibonacci hashing, node numbers are often derived from MAC addresses and share their upper bits
+    size_t mask = nodeIndex.size() - 1;
+    size_t bucket = (n * 0x9E3779B1u) & mask;
+    while (nodeIndex[bucket] != NODEDB_INDEX_EMPTY && meshNodes->at(nodeIndex[bucket]).num != n)
+        bucket = (bucket + 1) & mask;
+    return bucket;
+}
+
+void NodeDB::rebuildNodeIndex()
+{
+    // Keep the load factor at or below 50% so probe runs stay short
+    size_t size = 8;
+    while (size < meshNodes->size() * 2)
+        size <<= 1;
+    nodeIndex.assign(size, NODEDB_INDEX_EMPTY);
 
-    return NULL;
+    for (pb_size_t i = 0; i < numMeshNodes; i++) {
+        if (!indexNode(i))
+            LOG_WARN("Duplicate node 0x%x in NodeDB at %u", meshNodes->at(i).num, i);
+    }
+    evictionOrderDirty = true;
+}
+
+bool NodeDB::indexNode(pb_size_t pos)
+{
+    size_t bucket = findIndexBucket(meshNodes->at(pos).num);
+    if (nodeIndex[bucket] != NODEDB_INDEX_EMPTY)
+        return false;
+    nodeIndex[bucket] = pos;
+    return true;
+}
+
+void NodeDB::unindexNode(NodeNum n)
+{
+    size_t mask = nodeIndex.size() - 1;
+    size_t hole = findIndexBucket(n);
+    if (nodeIndex[hole] == NODEDB_INDEX_EMPTY)
+        return;
+
+    // Backward shift deletion, pull later entries of this probe run into the hole unless that moves them before their home
+    for (size_t next = (hole + 1) & mask; nodeIndex[next] != NODEDB_INDEX_EMPTY; next = (next + 1) & mask) {
+        size_t home = (meshNodes->at(nodeIndex[next]).num * 0x9E3779B1u) & mask;
+        if (((next - home) & mask) >= ((next - hole) & mask)) {
+            nodeIndex[hole] = nodeIndex[next];
+            hole = next;
+        }
+    }
+    nodeIndex[hole] = NODEDB_INDEX_EMPTY;
+}
+
+void NodeDB::removeNodeAt(pb_size_t pos)
+{
+    pb_size_t last = numMeshNodes - 1;
+    nodeJournal.mark(meshNodes->at(pos).num, NodeDBJournal::REMOVED);
+#if FROMRADIO_CACHE
+    fromRadioCache.touchNode(meshNodes->at(pos).num);
+#endif
+    unindexNode(meshNodes->at(pos).num);
+    if (pos != last) {
+        // Move the last node into the hole and point its index bucket at the new position
+        nodeIndex[findIndexBucket(meshNodes->at(last).num)] = pos;
+        meshNodes->at(pos) = meshNodes->at(last);
+    }
+    meshNodes->at(last) = meshtastic_NodeInfoLite();
+    numMeshNodes--;
+}
+
+void NodeDB::rebuildEvictionOrder()
+{
+    evictionHeap.clear();
+    boringEvictionHeap.clear();
+    for (pb_size_t i = 1; i < numMeshNodes; i++) {
+        const meshtastic_NodeInfoLite &node = meshNodes->at(i);
+        if (node.is_favorite || node.is_ignored)
+            continue;
+        if (!(node.bitfield & NODEINFO_BITFIELD_IS_KEY_MANUALLY_VERIFIED_MASK))
+            evictionHeap.emplace_back(node.last_heard, node.num);
+        if (node.user.public_key.size == 0)
+            boringEvictionHeap.emplace_back(node.last_heard, node.num);
+    }
+    std::make_heap(evictionHeap.begin(), evictionHeap.end(), std::greater<std::pair<uint32_t, NodeNum>>());
+    std::make_heap(boringEvictionHeap.begin(), boringEvictionHeap.end(), std::greater<std::pair<uint32_t, NodeNum>>());
+    evictionOrderDirty = false;
+}
+
+int NodeDB::popEvictionCandidate(std::vector<std::pair<uint32_t, NodeNum>> &heap, bool boring)
+{
+    auto cmp = std::greater<std::pair<uint32_t, NodeNum>>();
+    while (!heap.empty()) {
+        std::pop_heap(heap.begin(), heap.end(), cmp);
+        std::pair<uint32_t, NodeNum> entry = heap.back();
+        heap.pop_back();
+
+        pb_size_t pos = nodeIndex[findIndexBucket(entry.second)];
+        if (pos == NODEDB_INDEX_EMPTY || pos == 0)
+            continue; // Node is gone, or it is us
+
+        const meshtastic_NodeInfoLite &node = meshNodes->at(pos);
+        if (node.is_favorite || node.is_ignored)
+            continue; // Protected now, rebuildEvictionOrder() adds it back once it is evictable again
+        if (boring ? node.user.public_key.size != 0 : (node.bitfield & NODEINFO_BITFIELD_IS_KEY_MANUALLY_VERIFIED_MASK))
+            continue;
+
+        if (node.last_heard > entry.first) {
+            // Heard from since this entry was pushed, requeue with the current time
+            heap.emplace_back(node.last_heard, node.num);
+            std::push_heap(heap.begin(), heap.end(), cmp);
+            continue;
+        }
+        return pos;
+    }
+    return -1;
+}
+
+int NodeDB::pickNodeToEvict()
+{
+    // Lazy entries accumulate as nodes come and go, start over once they clearly outnumber the nodes
+    if (evictionOrderDirty || evictionHeap.size() > 2 * (size_t)numMeshNodes + 16 ||
+        boringEvictionHeap.size() > 2 * (size_t)numMeshNodes + 16)
+        rebuildEvictionOrder();
+
+    // Prefer the oldest "boring" node, otherwise simply the oldest non-favorite, non-ignored, non-verified node
+    int pos = popEvictionCandidate(boringEvictionHeap, true);
+    if (pos < 0)
+        pos = popEvictionCandidate(evictionHeap, false);
+    return pos;
 }
 
 // returns true if the maximum number of nodes is reached or we are running low on memory
@@ -1650,44 +1858,26 @@ meshtastic_NodeInfoLite *NodeDB::getOrCreateMeshNode(NodeNum n)
             LOG_INFO("Node database full with %i nodes and %u bytes free. Erasing oldest entry", numMeshNodes,
                      memGet.getFreeHeap());
             // look for oldest node and erase it
-            uint32_t oldest = UINT32_MAX;
-            uint32_t oldestBoring = UINT32_MAX;
-            int oldestIndex = -1;
-            int oldestBoringIndex = -1;
-            for (int i = 1; i < numMeshNodes; i++) {
-                // Simply the oldest non-favorite, non-ignored, non-verified node
-                if (!meshNodes->at(i).is_favorite && !meshNodes->at(i).is_ignored &&
-                    !(meshNodes->at(i).bitfield & NODEINFO_BITFIELD_IS_KEY_MANUALLY_VERIFIED_MASK) &&
-                    meshNodes->at(i).last_heard < oldest) {
-                    oldest = meshNodes->at(i).last_heard;
-                    oldestIndex = i;
-                }
-                // The oldest "boring" node
-                if (!meshNodes->at(i).is_favorite && !meshNodes->at(i).is_ignored && meshNodes->at(i).user.public_key.size == 0 &&
-                    meshNodes->at(i).last_heard < oldestBoring) {
-                    oldestBoring = meshNodes->at(i).last_heard;
-                    oldestBoringIndex = i;
-                }
-            }
-            // if we found a "boring" node, evict it
-            if (oldestBoringIndex != -1) {
-                oldestIndex = oldestBoringIndex;
-            }
-
+            int oldestIndex = pickNodeToEvict();
             if (oldestIndex != -1) {
-                // Shove the remaining nodes down the chain
-                for (int i = oldestIndex; i < numMeshNodes - 1; i++) {
-                    meshNodes->at(i) = meshNodes->at(i + 1);
-                }
-                (numMeshNodes)--;
+                removeNodeAt(oldestIndex);
             }
         }
         // add the node at the end
-        lite = &meshNodes->at((numMeshNodes)++);
+        pb_size_t pos = numMeshNodes++;
+        lite = &meshNodes->at(pos);
 
         // everything is missing except the nodenum
         memset(lite, 0, sizeof(*lite));
         lite->num = n;
+        indexNode(pos);
+
+        // New nodes are candidates for both heaps, entries that don't apply anymore get dropped lazily
+        auto cmp = std::greater<std::pair<uint32_t, NodeNum>>();
+        evictionHeap.emplace_back(0, n);
+        std::push_heap(evictionHeap.begin(), evictionHeap.end(), cmp);
+        boringEvictionHeap.emplace_back(0, n);
+        std::push_heap(boringEvictionHeap.begin(), boringEvictionHeap.end(), cmp);
         LOG_INFO("Adding node to database with %i nodes and %u bytes free!", numMeshNodes, memGet.getFreeHeap());
     }
 
@@ -5,9 +5,11 @@
 #include <algorithm>
 #include <assert.h>
 #include <pb_encode.h>
+#include <utility>
 #include <vector>
 
 #include "MeshTypes.h"
+#include "NodeDBJournal.h"
 #include "NodeStatus.h"
 #include "configuration.h"
 #include "mesh-pb-constants.h"
@@ -44,6 +46,7 @@ extern meshtastic_Position localPosition;
 static constexpr const char *deviceStateFileName = "/prefs/device.proto";
 static constexpr const char *legacyPrefFileName = "/prefs/db.proto";
 static constexpr const char *nodeDatabaseFileName = "/prefs/nodes.proto";
+static constexpr const char *nodeJournalFileName = "/prefs/nodes.journal";
 static constexpr const char *configFileName = "/prefs/config.proto";
 static constexpr const char *uiconfigFileName = "/prefs/uiconfig.proto";
 static constexpr const char *moduleConfigFileName = "/prefs/module.proto";
@@ -71,14 +74,16 @@ enum LoadFileResult {
 
 enum UserLicenseStatus { NotKnown, NotLicensed, Licensed };
 
+/// Marks an unused bucket in the NodeNum index
+#define NODEDB_INDEX_EMPTY ((pb_size_t)-1)
+
 class NodeDB
 {
     // NodeNum provisionalNodeNum; // if we are trying to find a node num this is our current attempt
 
     // A NodeInfo for every node we've seen
-    // Eventually use a smarter datastructure
-    // HashMap<NodeNum, NodeInfo> nodes;
-    // Note: these two references just point into our static array we serialize to/from disk
+    // Note: these two references just point into our static array we serialize to/from disk.
+    // Lookups by NodeNum go through nodeIndex, an open addressing hash table of positions in meshNodes.
 
   public:
     std::vector<meshtastic_NodeInfoLite> *meshNodes;
@@ -188,6 +193,9 @@ class NodeDB
     // returns true if the maximum number of nodes is reached or we are running low on memory
     bool isFull();
 
+    /// Call after making a node evictable again (e.g. clearing is_favorite or is_ignored), so the eviction order picks it up
+    void invalidateEvictionOrder() { evictionOrderDirty = true; }
+
     void clearLocalPosition();
 
     void setLocalPosition(meshtastic_Position position, bool timeOnly = false)
@@ -212,9 +220,46 @@ class NodeDB
   private:
     uint32_t lastNodeDbSave = 0;    // when we last saved our db to flash
     uint32_t lastBackupAttempt = 0; // when we last tried a backup automatically or manually
+    uint32_t lastJournalFlush = 0;  // when we last appended node changes to the journal
+    size_t lastSnapshotBytes = 0;   // size of the node database file the journal applies to
+
+    /// Node changes made since the node database file was written
+    NodeDBJournal nodeJournal{nodeJournalFileName};
     /// Find a node in our DB, create an empty NodeInfoLite if missing
     meshtastic_NodeInfoLite *getOrCreateMeshNode(NodeNum n);
 
+    /// Open addressing index (linear probing) of positions in meshNodes, NODEDB_INDEX_EMPTY for unused buckets
+    std::vector<pb_size_t> nodeIndex;
+
+    /// Min-heaps of (last_heard, num) candidates for eviction when the DB is full, one for all evictable nodes and one for
+    /// "boring" nodes without a public key. Maintained lazily: stale entries are fixed up or dropped when popped.
+    std::vector<std::pair<uint32_t, NodeNum>> evictionHeap, boringEvictionHeap;
+    bool evictionOrderDirty = true;
+
+    /// Bucket in nodeIndex holding n, or the empty bucket where n would go
+    size_t findIndexBucket(NodeNum n) const;
+
+    /// Recreate nodeIndex from the first numMeshNodes entries of meshNodes
+    void rebuildNodeIndex();
+
+    /// Add the node at position pos to nodeIndex, returns false if its NodeNum is already indexed
+    bool indexNode(pb_size_t pos);
+
+    /// Remove n from nodeIndex, shifting back following buckets of the same probe run
+    void unindexNode(NodeNum n);
+
+    /// Remove the node at position pos by moving the last node into its place, nothing else is shifted
+    void removeNodeAt(pb_size_t pos);
+
+    /// Recreate the eviction heaps from all nodes
+    void rebuildEvictionOrder();
+
+    /// Position of the node to evict, or -1 if every node is protected (favorite, ignored or verified)
+    int pickNodeToEvict();
+
+    /// Pop heap entries until we find a node that is still a valid candidate, returns its position or -1
+    int popEvictionCandidate(std::vector<std::pair<uint32_t, NodeNum>> &heap, bool boring);
+
     /// Notify observers of changes to the DB
     void notifyObservers(bool forceUpdate = false)
     {
@@ -240,6 +285,10 @@ class NodeDB
     bool saveChannelsToDisk();
     bool saveDeviceStateToDisk();
     bool saveNodeDatabaseToDisk();
+
+    /// Append the node changes in the given parts to the journal, or write a fresh node database file once the journal has
+    /// grown larger than that file
+    bool flushNodeJournal(uint8_t parts = 0xFF);
 };
 
 extern NodeDB *nodeDB;
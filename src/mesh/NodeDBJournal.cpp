@@ -0,0 +1,183 @@
+#include "NodeDBJournal.h"
+#include "FSCommon.h"
+#include "SPILock.h"
+#include "mesh-pb-constants.h"
+#include <ErriezCRC32.h>
+
+#include <algorithm>
+
+static const uint8_t recordMagic = 0x4A;
+
+/// The CRC a record of len bytes should have, everything after the crc field itself
+static uint32_t recordCrc(const uint8_t *record, size_t len)
+{
+    return crc32Buffer(record + sizeof(uint32_t), len - sizeof(uint32_t));
+}
+
+void NodeDBJournal::mark(NodeNum n, uint8_t parts)
+{
+    // Whatever else changed about a removed node doesn't matter any more
+    if (parts & REMOVED)
+        dirty[n] = REMOVED;
+    else
+        dirty[n] |= parts;
+}
+
+bool NodeDBJournal::flush(const Lookup &lookup, uint8_t parts)
+{
+    if (dirty.empty())
+        return true;
+#ifdef FSCom
+    concurrency::LockGuard g(spiLock);
+    File f = FSCom.open(filename, FILE_O_APPEND);
+    if (!f) {
+        LOG_ERROR("Can't open %s", filename);
+        return false;
+    }
+
+    uint8_t record[sizeof(RecordHeader) + meshtastic_NodeInfoLite_size];
+    size_t expected = 0, written = 0;
+    // Removals go first, so a node that was removed and then heard again comes back on replay
+    for (int pass = 0; pass < 2; pass++) {
+        for (auto &d : dirty) {
+            RecordHeader header = {0, recordMagic, 0, 0, d.first};
+            if (pass == 0) {
+                if (!(d.second & REMOVED))
+                    continue;
+                header.parts = REMOVED;
+            } else {
+                header.parts = d.second & parts & ~REMOVED;
+                const meshtastic_NodeInfoLite *node = header.parts ? lookup(d.first) : NULL;
+                if (!node)
+                    continue;
+                meshtastic_NodeInfoLite changed = meshtastic_NodeInfoLite_init_zero;
+                changed.num = d.first;
+                copyParts(changed, *node, header.parts);
+                header.len = pb_encode_to_bytes(record + sizeof(header), meshtastic_NodeInfoLite_size,
+                                                &meshtastic_NodeInfoLite_msg, &changed);
+            }
+            const size_t len = sizeof(header) + header.len;
+            memcpy(record, &header, sizeof(header));
+            header.crc = recordCrc(record, len);
+            memcpy(record, &header, sizeof(header));
+            expected += len;
+            written += f.write(record, len);
+        }
+    }
+    f.close();
+    fileBytes += written;
+    bytesWritten += written;
+
+    if (written != expected) {
+        // Replay stops at the torn record, so nothing may be appended after it
+        LOG_ERROR("Can't append to %s", filename);
+        return false;
+    }
+    for (auto it = dirty.begin(); it != dirty.end();) {
+        it->second &= ~(parts | REMOVED);
+        if (it->second)
+            ++it;
+        else
+            it = dirty.erase(it);
+    }
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool NodeDBJournal::replay(const GetOrCreate &getOrCreate, const Remove &remove)
+{
+    fileBytes = 0;
+    bool ok = true;
+#ifdef FSCom
+    concurrency::LockGuard g(spiLock);
+    File f = FSCom.open(filename, FILE_O_READ);
+    if (!f)
+        return true; // nothing changed since the snapshot
+
+    const uint32_t size = f.size();
+    uint32_t records = 0;
+    uint8_t record[sizeof(RecordHeader) + meshtastic_NodeInfoLite_size];
+    while (fileBytes < size) {
+        RecordHeader header;
+        if (f.read(record, sizeof(header)) != sizeof(header)) {
+            ok = false;
+            break;
+        }
+        memcpy(&header, record, sizeof(header));
+        const size_t len = sizeof(header) + header.len;
+        if (header.magic != recordMagic || header.len > meshtastic_NodeInfoLite_size ||
+            f.read(record + sizeof(header), header.len) != header.len || recordCrc(record, len) != header.crc) {
+            ok = false;
+            break;
+        }
+        fileBytes += len;
+        records++;
+
+        if (header.parts & REMOVED) {
+            remove(header.num);
+            continue;
+        }
+        meshtastic_NodeInfoLite changed = meshtastic_NodeInfoLite_init_zero;
+        if (!pb_decode_from_bytes(record + sizeof(header), header.len, &meshtastic_NodeInfoLite_msg, &changed))
+            continue;
+        changed.num = header.num;
+        meshtastic_NodeInfoLite *node = getOrCreate(header.num);
+        if (node)
+            copyParts(*node, changed, header.parts);
+    }
+    f.close();
+
+    if (!ok)
+        LOG_WARN("Ignore %u damaged bytes at the end of %s", size - fileBytes, filename);
+    LOG_INFO("Replayed %u node changes from %s", records, filename);
+#endif
+    // Replaying marks nodes the journal already has
+    dirty.clear();
+    return ok;
+}
+
+bool NodeDBJournal::wantsCompaction(size_t snapshotBytes) const
+{
+    return fileBytes > std::max<size_t>(NODEDB_JOURNAL_MIN_COMPACT_BYTES, snapshotBytes);
+}
+
+void NodeDBJournal::reset()
+{
+#ifdef FSCom
+    concurrency::LockGuard g(spiLock);
+    FSCom.remove(filename);
+#endif
+    fileBytes = 0;
+    dirty.clear();
+}
+
+void NodeDBJournal::copyParts(meshtastic_NodeInfoLite &dst, const meshtastic_NodeInfoLite &src, uint8_t parts)
+{
+    if (parts & NODE) {
+        dst = src;
+        return;
+    }
+    if (parts & HEARD) {
+        dst.last_heard = src.last_heard;
+        dst.snr = src.snr;
+        dst.via_mqtt = src.via_mqtt;
+        dst.has_hops_away = src.has_hops_away;
+        dst.hops_away = src.hops_away;
+        dst.next_hop = src.next_hop;
+    }
+    if (parts & POSITION) {
+        dst.has_position = src.has_position;
+        dst.position = src.position;
+    }
+    if (parts & METRICS) {
+        dst.has_device_metrics = src.has_device_metrics;
+        dst.device_metrics = src.device_metrics;
+    }
+    if (parts & USER) {
+        dst.has_user = src.has_user;
+        dst.user = src.user;
+        dst.channel = src.channel;
+    }
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include "MeshTypes.h"
+#include "mesh/generated/meshtastic/deviceonly.pb.h"
+
+#include <functional>
+#include <unordered_map>
+
+/// Don't bother compacting a journal smaller than this, however small the snapshot is
+#ifndef NODEDB_JOURNAL_MIN_COMPACT_BYTES
+#define NODEDB_JOURNAL_MIN_COMPACT_BYTES 4096
+#endif
+
+/// How often NodeDB writes out changes that are only about when a node was last heard
+#ifndef NODEDB_JOURNAL_FLUSH_MSEC
+#define NODEDB_JOURNAL_FLUSH_MSEC (15 * 60 * 1000)
+#endif
+
+/**
+ * Append-only journal of the NodeDB changes made since the last snapshot of the node database was written.
+ *
+ * Callers mark() which parts of a node changed.  flush() appends one small record per changed node, holding just those
+ * parts, instead of rewriting every node.  At boot, replay() applies the records on top of the snapshot.  Every record has
+ * a CRC, and replay stops at the first one that doesn't check out, which is where a write was cut short.  Records set
+ * fields to absolute values, so replaying a journal onto a snapshot that already holds its changes (a crash between
+ * writing the snapshot and reset()) does no harm.
+ */
+class NodeDBJournal
+{
+  public:
+    /// What changed about a node
+    enum Part : uint8_t {
+        HEARD = 1,    // last_heard, snr, via_mqtt, hops_away and next_hop
+        POSITION = 2, // position
+        METRICS = 4,  // device_metrics
+        USER = 8,     // user and channel
+        NODE = 16,    // everything
+        REMOVED = 32  // the node is gone
+    };
+
+    typedef std::function<const meshtastic_NodeInfoLite *(NodeNum)> Lookup;
+    typedef std::function<meshtastic_NodeInfoLite *(NodeNum)> GetOrCreate;
+    typedef std::function<void(NodeNum)> Remove;
+
+    explicit NodeDBJournal(const char *filename) : filename(filename) {}
+
+    /// Remember that parts of node n changed, the next flush() writes them
+    void mark(NodeNum n, uint8_t parts);
+
+    bool isDirty() const { return !dirty.empty(); }
+
+    /**
+     * Append a record for every node marked since the last flush
+     *
+     * @param lookup gives the current state of a node, NULL if it is gone
+     * @param parts only write these parts, the others stay marked.  Removals are always written.
+     * @return false if the records couldn't be written, the caller should write a snapshot instead
+     */
+    bool flush(const Lookup &lookup, uint8_t parts = 0xFF);
+
+    /**
+     * Apply the journal on top of the nodes loaded from the snapshot
+     *
+     * @param getOrCreate gives the node a record is about, NULL if there is no room for it
+     * @param remove drops a node
+     * @return false if the journal ends in a damaged record, the caller should write a snapshot so new records don't end up
+     * behind it
+     */
+    bool replay(const GetOrCreate &getOrCreate, const Remove &remove);
+
+    /// Whether replaying the journal now costs more than loading a snapshot of snapshotBytes
+    bool wantsCompaction(size_t snapshotBytes) const;
+
+    /// Forget the journal, call after writing a snapshot that holds everything in it
+    void reset();
+
+    /// Size of the journal file
+    uint32_t size() const { return fileBytes; }
+
+    /// Bytes appended since boot
+    uint32_t getBytesWritten() const { return bytesWritten; }
+
+  private:
+    /// What the journal holds in front of each record's payload, an encoded NodeInfoLite with just the parts that changed
+    struct RecordHeader {
+        uint32_t crc; // of the rest of the record
+        uint8_t magic;
+        uint8_t parts;
+        uint16_t len;
+        uint32_t num;
+    };
+
+    const char *filename;
+    std::unordered_map<NodeNum, uint8_t> dirty;
+    uint32_t fileBytes = 0;
+    uint32_t bytesWritten = 0;
+
+    static void copyParts(meshtastic_NodeInfoLite &dst, const meshtastic_NodeInfoLite &src, uint8_t parts);
+};
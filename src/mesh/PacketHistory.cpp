@@ -7,10 +7,122 @@
 #endif
 #include "Throttle.h"
 
-PacketHistory::PacketHistory()
+/// Max number of occupied slots we look at to find the oldest record to evict when the table is at capacity
+#define PACKETHISTORY_EVICT_WINDOW 16
+
+PacketHistory::PacketHistory(uint32_t capacity)
+{
+    if (capacity == 0) {
+        capacity = PACKETHISTORY_MAX;
+#ifdef ARCH_PORTDUINO
+        if (settingsMap[maxpackethistory] > 0)
+            capacity = settingsMap[maxpackethistory];
+#endif
+    }
+    recentPacketsCapacity = capacity;
+
+    // Keep the load factor at or below 75%, so probe runs stay short
+    uint32_t size = 8;
+    while (size < capacity + capacity / 3 + 1)
+        size <<= 1;
+    recentPacketsMask = size - 1;
+
+    // Prealloc the worst case # of records - to prevent heap fragmentation
+    recentPackets = new PacketRecord[size];
+    memset(recentPackets, 0, sizeof(PacketRecord) * size);
+}
+
+PacketHistory::~PacketHistory()
+{
+    delete[] recentPackets;
+}
+
+uint32_t PacketHistory::slotFor(NodeNum sender, PacketId id) const
+{
+    // Packet ids are random but senders are not, mix both so neighbouring node numbers spread over the table
+    uint32_t h = (sender * 0x9E3779B1u) ^ id;
+    h ^= h >> 16;
+    h *= 0x85EBCA6Bu;
+    h ^= h >> 13;
+    return h & recentPacketsMask;
+}
+
+PacketRecord *PacketHistory::find(NodeNum sender, PacketId id)
+{
+    if (id == 0)
+        return nullptr;
+
+    for (uint32_t slot = slotFor(sender, id);; slot = (slot + 1) & recentPacketsMask) {
+        PacketRecord *r = &recentPackets[slot];
+        if (r->id == 0)
+            return nullptr; // Reached the end of the probe run
+        if (r->id == id && r->sender == sender)
+            return r;
+    }
+}
+
+PacketRecord *PacketHistory::insert(const PacketRecord &r)
+{
+    if (recentPacketsCount >= recentPacketsCapacity && !sweepExpired(PACKETHISTORY_EVICT_WINDOW)) {
+        // Nothing has expired near the clock hand, so evict the oldest record in the next few occupied slots
+        uint32_t now = millis();
+        uint32_t oldestSlot = sweepHand;
+        uint32_t oldestAge = 0;
+        uint32_t slot = sweepHand;
+        for (uint32_t seen = 0; seen < PACKETHISTORY_EVICT_WINDOW && seen < recentPacketsCount;
+             slot = (slot + 1) & recentPacketsMask) {
+            if (recentPackets[slot].id == 0)
+                continue;
+            uint32_t age = now - recentPackets[slot].rxTimeMsec;
+            if (seen == 0 || age > oldestAge) {
+                oldestAge = age;
+                oldestSlot = slot;
+            }
+            seen++;
+        }
+        LOG_DEBUG("Packet history full, evict id=0x%x age=%ums", recentPackets[oldestSlot].id, oldestAge);
+        eraseSlot(oldestSlot);
+        sweepHand = slot;
+    }
+
+    uint32_t slot = slotFor(r.sender, r.id);
+    while (recentPackets[slot].id != 0)
+        slot = (slot + 1) & recentPacketsMask;
+    recentPackets[slot] = r;
+    recentPacketsCount++;
+    return &recentPackets[slot];
+}
+
+void PacketHistory::eraseSlot(uint32_t slot)
 {
-    recentPackets.reserve(MAX_NUM_NODES); // Prealloc the worst case # of records - to prevent heap fragmentation
-                                          // setup our periodic task
+    // Backward shift deletion: pull later records of this probe run into the hole, unless that would move them in front of
+    // their home slot
+    uint32_t hole = slot;
+    for (uint32_t next = (hole + 1) & recentPacketsMask; recentPackets[next].id != 0; next = (next + 1) & recentPacketsMask) {
+        uint32_t home = slotFor(recentPackets[next].sender, recentPackets[next].id);
+        // Distance from home to next and from home to the hole, modulo the table size
+        if (((next - home) & recentPacketsMask) >= ((next - hole) & recentPacketsMask)) {
+            recentPackets[hole] = recentPackets[next];
+            hole = next;
+        }
+    }
+    memset(&recentPackets[hole], 0, sizeof(PacketRecord));
+    recentPacketsCount--;
+}
+
+bool PacketHistory::sweepExpired(uint32_t numSlots)
+{
+    bool removed = false;
+    for (uint32_t i = 0; i < numSlots && recentPacketsCount > 0; i++) {
+        PacketRecord *r = &recentPackets[sweepHand];
+        if (r->id != 0 && !Throttle::isWithinTimespanMs(r->rxTimeMsec, FLOOD_EXPIRE_TIME)) {
+            eraseSlot(sweepHand); // A later record may have been shifted into this slot, so look at it again
+            removed = true;
+        } else {
+            sweepHand = (sweepHand + 1) & recentPacketsMask;
+        }
+    }
+    return removed;
 }
 
 /**
@@ -23,23 +135,17 @@ bool PacketHistory::wasSeenRecently(const meshtastic_MeshPacket *p, bool withUpd
         return false; // Not a floodable message ID, so we don't care
     }
 
-    PacketRecord r;
-    r.id = p->id;
-    r.sender = getFrom(p);
-    r.rxTimeMsec = millis();
-    r.next_hop = p->next_hop;
-    r.relayed_by[0] = p->relay_node;
-    // LOG_INFO("Add relayed_by 0x%x for id=0x%x", p->relay_node, r.id);
-
-    auto found = recentPackets.find(r);
-    bool seenRecently = (found != recentPackets.end()); // found not equal to .end() means packet was seen recently
-
-    if (seenRecently &&
-        !Throttle::isWithinTimespanMs(found->rxTimeMsec, FLOOD_EXPIRE_TIME)) { // Check whether found packet has already expired
-        recentPackets.erase(found); // Erase and pretend packet has not been seen recently
-        found = recentPackets.end();
-        seenRecently = false;
+    // Age out a few records per call, so expiry never needs a full sweep
+    sweepExpired(PACKETHISTORY_SWEEP_STEPS);
+
+    NodeNum sender = getFrom(p);
+    PacketRecord *found = find(sender, p->id);
+
+    if (found && !Throttle::isWithinTimespanMs(found->rxTimeMsec, FLOOD_EXPIRE_TIME)) { // Check whether found packet has expired
+        eraseSlot(found - recentPackets); // Erase and pretend packet has not been seen recently
+        found = nullptr;
     }
+    bool seenRecently = (found != nullptr);
 
     if (seenRecently) {
         LOG_DEBUG("Found existing packet record for fr=0x%x,to=0x%x,id=0x%x", p->from, p->to, p->id);
@@ -62,46 +168,29 @@ bool PacketHistory::wasSeenRecently(const meshtastic_MeshPacket *p, bool withUpd
     }
 
     if (withUpdate) {
-        if (found != recentPackets.end()) { // delete existing to updated timestamp and relayed_by (re-insert)
-            // Add the existing relayed_by to the new record
-            for (uint8_t i = 0; i < NUM_RELAYERS - 1; i++) {
-                if (found->relayed_by[i])
-                    r.relayed_by[i + 1] = found->relayed_by[i];
-            }
-            r.next_hop = found->next_hop; // keep the original next_hop (such that we check whether we were originally asked)
-            recentPackets.erase(found);   // as unsorted_set::iterator is const (can't update - so re-insert..)
+        if (found) {
+            // Update in place: refresh the timestamp and push the new relayer in front of the existing ones. We keep the
+            // original next_hop (such that we check whether we were originally asked)
+            for (uint8_t i = NUM_RELAYERS - 1; i > 0; i--)
+                found->relayed_by[i] = found->relayed_by[i - 1];
+            found->relayed_by[0] = p->relay_node;
+            found->rxTimeMsec = millis();
+        } else {
+            PacketRecord r = {};
+            r.id = p->id;
+            r.sender = sender;
+            r.rxTimeMsec = millis();
+            r.next_hop = p->next_hop;
+            r.relayed_by[0] = p->relay_node;
+            // LOG_INFO("Add relayed_by 0x%x for id=0x%x", p->relay_node, r.id);
+            insert(r);
         }
-        recentPackets.insert(r);
         LOG_DEBUG("Add packet record fr=0x%x, id=0x%x", p->from, p->id);
     }
 
-    // Capacity is reerved, so only purge expired packets if recentPackets fills past 90% capacity
-    // Expiry is normally dealt with after having searched/found a packet (above)
-    if (recentPackets.size() > (MAX_NUM_NODES * 0.9)) {
-        clearExpiredRecentPackets();
-    }
-
     return seenRecently;
 }
 
-/**
- * Iterate through all recent packets, and remove all older than FLOOD_EXPIRE_TIME
- */
-void PacketHistory::clearExpiredRecentPackets()
-{
-    LOG_DEBUG("recentPackets size=%ld", recentPackets.size());
-
-    for (auto it = recentPackets.begin(); it != recentPackets.end();) {
-        if (!Throttle::isWithinTimespanMs(it->rxTimeMsec, FLOOD_EXPIRE_TIME)) {
-            it = recentPackets.erase(it); // erase returns iterator pointing to element immediately following the one erased
-        } else {
-            ++it;
-        }
-    }
-
-    LOG_DEBUG("recentPackets size=%ld (after clearing expired packets)", recentPackets.size());
-}
-
 /* Check if a certain node was a relayer of a packet in the history given an ID and sender
  * @return true if node was indeed a relayer, false if not */
 bool PacketHistory::wasRelayer(const uint8_t relayer, const uint32_t id, const NodeNum sender)
@@ -109,19 +198,18 @@ bool PacketHistory::wasRelayer(const uint8_t relayer, const uint32_t id, const N
     if (relayer == 0)
         return false;
 
-    PacketRecord r = {.sender = sender, .id = id, .rxTimeMsec = 0, .next_hop = 0};
-    auto found = recentPackets.find(r);
+    const PacketRecord *found = find(sender, id);
 
-    if (found == recentPackets.end()) {
+    if (!found) {
         return false;
     }
 
     return wasRelayer(relayer, found);
 }
 
-/* Check if a certain node was a relayer of a packet in the history given iterator
+/* Check if a certain node was a relayer of a packet in the history given a record
  * @return true if node was indeed a relayer, false if not */
-bool PacketHistory::wasRelayer(const uint8_t relayer, std::unordered_set<PacketRecord, PacketRecordHashFunction>::iterator r)
+bool PacketHistory::wasRelayer(const uint8_t relayer, const PacketRecord *r)
 {
     for (uint8_t i = 0; i < NUM_RELAYERS; i++) {
         if (r->relayed_by[i] == relayer) {
@@ -134,25 +222,20 @@ bool PacketHistory::wasRelayer(const uint8_t relayer, std::unordered_set<PacketR
 // Remove a relayer from the list of relayers of a packet in the history given an ID and sender
 void PacketHistory::removeRelayer(const uint8_t relayer, const uint32_t id, const NodeNum sender)
 {
-    PacketRecord r = {.sender = sender, .id = id, .rxTimeMsec = 0, .next_hop = 0};
-    auto found = recentPackets.find(r);
+    PacketRecord *found = find(sender, id);
 
-    if (found == recentPackets.end()) {
+    if (!found) {
         return;
     }
-    // Make a copy of the found record
-    r.next_hop = found->next_hop;
-    r.rxTimeMsec = found->rxTimeMsec;
 
-    // Only add the relayers that are not the one we want to remove
+    // Only keep the relayers that are not the one we want to remove, compacting them to the front
     uint8_t j = 0;
     for (uint8_t i = 0; i < NUM_RELAYERS; i++) {
         if (found->relayed_by[i] != relayer) {
-            r.relayed_by[j] = found->relayed_by[i];
+            found->relayed_by[j] = found->relayed_by[i];
             j++;
         }
     }
-
-    recentPackets.erase(found);
-    recentPackets.insert(r);
-}
\ No newline at end of file
+    for (; j < NUM_RELAYERS; j++)
+        found->relayed_by[j] = 0;
+}
@@ -1,7 +1,6 @@
 #pragma once
 
 #include "NodeDB.h"
-#include <unordered_set>
 
 /// We clear our old flood record 10 minutes after we see the last of it
 #ifdef FUZZING_BUILD_MODE_UNSAFE_FOR_PRODUCTION
@@ -10,6 +9,24 @@
 #define FLOOD_EXPIRE_TIME (10 * 60 * 1000L)
 #endif
 
+/// Number of packet records we keep track of. Independent of MAX_NUM_NODES, since busy meshes see far more packets than nodes.
+/// The table is the next power of two above 4/3 of this many 16 byte records: 256 records take 8 KB, 80 records 2 KB.
+/// On portduino this can be overridden with General.MaxPacketHistory in config.yaml
+#ifndef PACKETHISTORY_MAX
+#if defined(ARCH_STM32WL)
+#define PACKETHISTORY_MAX 32
+#elif defined(ARCH_NRF52)
+#define PACKETHISTORY_MAX 80
+#elif defined(ARCH_PORTDUINO)
+#define PACKETHISTORY_MAX 4096
+#else
+#define PACKETHISTORY_MAX 256
+#endif
+#endif
+
+/// Number of slots the clock hand inspects for expired records on every update, keeps the aging cost bounded and incremental
+#define PACKETHISTORY_SWEEP_STEPS 4
+
 #define NUM_RELAYERS                                                                                                             \
     3 // Number of relayer we keep track of. Use 3 to be efficient with memory alignment of PacketRecord to 16 bytes
 
@@ -18,7 +35,7 @@
  */
 struct PacketRecord {
     NodeNum sender;
-    PacketId id;
+    PacketId id;                      // 0 marks an unused slot, packets with id 0 are never recorded
     uint32_t rxTimeMsec;              // Unix time in msecs - the time we received it
     uint8_t next_hop;                 // The next hop asked for this packet
     uint8_t relayed_by[NUM_RELAYERS]; // Array of nodes that relayed this packet
@@ -26,24 +43,46 @@ struct PacketRecord {
     bool operator==(const PacketRecord &p) const { return sender == p.sender && id == p.id; }
 };
 
-class PacketRecordHashFunction
-{
-  public:
-    size_t operator()(const PacketRecord &p) const { return (std::hash<NodeNum>()(p.sender)) ^ (std::hash<PacketId>()(p.id)); }
-};
+static_assert(sizeof(PacketRecord) == 16, "PacketRecord should stay 16 bytes so four records share a cache line");
 
 /**
  * This is a mixin that adds a record of past packets we have seen
+ *
+ * Records live in a preallocated open-addressing table (linear probing, power of two size, at most 75% full).
+ * Records are updated in place, deletion uses backward shifting so no tombstones accumulate, and expired records are
+ * reclaimed incrementally by a clock hand that advances a few slots on every update instead of a full sweep.
  */
 class PacketHistory
 {
   private:
-    std::unordered_set<PacketRecord, PacketRecordHashFunction> recentPackets;
+    PacketRecord *recentPackets = nullptr; // Fixed size table, allocated once in the constructor
+    uint32_t recentPacketsMask = 0;        // Table size - 1, table size is a power of two
+    uint32_t recentPacketsCapacity = 0;    // Max number of records we keep before evicting the oldest
+    uint32_t recentPacketsCount = 0;       // Number of slots in use
+    uint32_t sweepHand = 0;                // Next slot inspected by the incremental expiry
 
-    void clearExpiredRecentPackets(); // clear all recentPackets older than FLOOD_EXPIRE_TIME
+    /// Home slot of a (sender, id) pair
+    uint32_t slotFor(NodeNum sender, PacketId id) const;
+
+    /// Find the record for this sender and id, or nullptr if we have none
+    PacketRecord *find(NodeNum sender, PacketId id);
+
+    /// Insert a new record, evicting an expired or the oldest nearby record if we are at capacity
+    PacketRecord *insert(const PacketRecord &r);
+
+    /// Remove the record in the given slot, shifting back following records of the same probe run
+    void eraseSlot(uint32_t slot);
+
+    /// Advance the clock hand by up to numSlots slots, removing records older than FLOOD_EXPIRE_TIME
+    /// @return true if at least one record was removed
+    bool sweepExpired(uint32_t numSlots);
 
   public:
-    PacketHistory();
+    explicit PacketHistory(uint32_t capacity = 0);
+    ~PacketHistory();
+
+    PacketHistory(const PacketHistory &) = delete;
+    PacketHistory &operator=(const PacketHistory &) = delete;
 
     /**
      * Update recentBroadcasts and return true if we have already seen this packet
@@ -59,10 +98,16 @@ class PacketHistory
      * @return true if node was indeed a relayer, false if not */
     bool wasRelayer(const uint8_t relayer, const uint32_t id, const NodeNum sender);
 
-    /* Check if a certain node was a relayer of a packet in the history given iterator
+    /* Check if a certain node was a relayer of a packet in the history given a record
      * @return true if node was indeed a relayer, false if not */
-    bool wasRelayer(const uint8_t relayer, std::unordered_set<PacketRecord, PacketRecordHashFunction>::iterator r);
+    bool wasRelayer(const uint8_t relayer, const PacketRecord *r);
 
     // Remove a relayer from the list of relayers of a packet in the history given an ID and sender
     void removeRelayer(const uint8_t relayer, const uint32_t id, const NodeNum sender);
-};
\ No newline at end of file
+
+    /// Number of packet records currently held
+    uint32_t getNumRecords() const { return recentPacketsCount; }
+
+    /// Max number of packet records held before the oldest gets evicted
+    uint32_t getCapacity() const { return recentPacketsCapacity; }
+};
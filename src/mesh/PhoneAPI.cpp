@@ -6,6 +6,7 @@
 #include "Channels.h"
 #include "Default.h"
 #include "FSCommon.h"
+#include "FromRadioCache.h"
 #include "MeshService.h"
 #include "NodeDB.h"
 #include "PacketHistory.h"
@@ -194,6 +195,23 @@ size_t PhoneAPI::getFromRadio(uint8_t *buf)
     // In case we send a FromRadio packet
     memset(&fromRadioScratch, 0, sizeof(fromRadioScratch));
 
+#if FROMRADIO_CACHE
+    // The bulk of want_config is the same from one connection to the next, remember where this message sits in it
+    FromRadioCache::Section cacheSection = FromRadioCache::NONE;
+    uint32_t cacheIndex = config_state;
+    if (state == STATE_SEND_CHANNELS) {
+        cacheSection = FromRadioCache::CHANNELS;
+    } else if (state == STATE_SEND_CONFIG) {
+        cacheSection = FromRadioCache::CONFIG;
+    } else if (state == STATE_SEND_MODULECONFIG) {
+        cacheSection = FromRadioCache::MODULECONFIG;
+    } else if (state == STATE_SEND_OTHER_NODEINFOS && nodeInfoForPhone.num != nodeDB->getNodeNum()) {
+        // Our own entry carries the current time, so it is never the same twice
+        cacheSection = FromRadioCache::NODES;
+        cacheIndex = nodeInfoForPhone.num;
+    }
+#endif
+
     // Advance states as needed
     switch (state) {
     case STATE_SEND_NOTHING:
@@ -488,6 +506,10 @@ size_t PhoneAPI::getFromRadio(uint8_t *buf)
     // Do we have a message from the mesh?
     if (fromRadioScratch.which_payload_variant != 0) {
         // Encapsulate as a FromRadio packet
+#if FROMRADIO_CACHE
+        if (cacheSection != FromRadioCache::NONE)
+            return fromRadioCache.encode(cacheSection, cacheIndex, fromRadioScratch, buf);
+#endif
         size_t numbytes = pb_encode_to_bytes(buf, meshtastic_FromRadio_size, &meshtastic_FromRadio_msg, &fromRadioScratch);
 
         // VERY IMPORTANT to not print debug messages while writing to fromRadioScratch - because we use that same buffer
@@ -501,7 +523,11 @@ size_t PhoneAPI::getFromRadio(uint8_t *buf)
 
 void PhoneAPI::sendConfigComplete()
 {
+#if FROMRADIO_CACHE
+    LOG_INFO("Config Send Complete (%u cached, %u encoded so far)", fromRadioCache.hits, fromRadioCache.misses);
+#else
     LOG_INFO("Config Send Complete");
+#endif
     fromRadioScratch.which_payload_variant = meshtastic_FromRadio_config_complete_id_tag;
     fromRadioScratch.config_complete_id = config_nonce;
     config_nonce = 0;
@@ -509,10 +535,20 @@ void PhoneAPI::sendConfigComplete()
     pauseBluetoothLogging = false;
 }
 
+meshtastic_MeshPacket *PhoneAPI::getPacketForPhone()
+{
+    return service->getForPhone();
+}
+
+void PhoneAPI::releasePacketForPhone(meshtastic_MeshPacket *p)
+{
+    service->releaseToPool(p);
+}
+
 void PhoneAPI::releasePhonePacket()
 {
     if (packetForPhone) {
-        service->releaseToPool(packetForPhone); // we just copied the bytes, so don't need this buffer anymore
+        releasePacketForPhone(packetForPhone); // we just copied the bytes, so don't need this buffer anymore
         packetForPhone = NULL;
     }
 }
@@ -603,7 +639,7 @@ bool PhoneAPI::available()
 #endif
 
         if (!packetForPhone)
-            packetForPhone = service->getForPhone();
+            packetForPhone = getPacketForPhone();
         hasPacket = !!packetForPhone;
         return hasPacket;
     }
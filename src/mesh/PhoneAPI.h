@@ -153,6 +153,12 @@ class PhoneAPI
     /// begin a new connection
     void handleStartConfig();
 
+    /// Fetch the next mesh packet for the client, by default by dequeuing it from MeshService
+    virtual meshtastic_MeshPacket *getPacketForPhone();
+
+    /// Give back a packet (from getPacketForPhone or StoreForward) once the client has downloaded it
+    virtual void releasePacketForPhone(meshtastic_MeshPacket *p);
+
   private:
     void releasePhonePacket();
 
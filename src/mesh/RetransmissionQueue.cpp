@@ -0,0 +1,122 @@
+#include "RetransmissionQueue.h"
+#include <assert.h>
+
+PendingPacket::PendingPacket(meshtastic_MeshPacket *p, uint8_t numRetransmissions)
+{
+    packet = p;
+    this->numRetransmissions = numRetransmissions - 1; // We subtract one, because we assume the user just did the first send
+}
+
+PendingPacket *RetransmissionQueue::find(const GlobalPacketId &key)
+{
+    auto it = records.find(key);
+    return it != records.end() ? &it->second : NULL;
+}
+
+PendingPacket *RetransmissionQueue::add(const GlobalPacketId &key, const PendingPacket &rec)
+{
+    remove(key);
+
+    // unordered_map never moves its nodes, so the heap can point straight at them
+    Entry *e = &*records.emplace(key, rec).first;
+    heap.push_back(e);
+    place(heap.size() - 1, e);
+    siftUp(heap.size() - 1);
+    return &e->second;
+}
+
+bool RetransmissionQueue::remove(const GlobalPacketId &key)
+{
+    auto it = records.find(key);
+    if (it == records.end())
+        return false;
+
+    size_t pos = it->second.heapPos;
+    assert(pos < heap.size() && heap[pos] == &*it);
+    Entry *last = heap.back();
+    heap.pop_back();
+    if (pos < heap.size()) {
+        place(pos, last);
+        siftUp(pos);
+        siftDown(last->second.heapPos);
+    }
+    records.erase(it);
+    return true;
+}
+
+void RetransmissionQueue::reschedule(PendingPacket *rec)
+{
+    size_t pos = rec->heapPos;
+    assert(pos < heap.size() && &heap[pos]->second == rec);
+    siftUp(pos);
+    siftDown(rec->heapPos);
+}
+
+void RetransmissionQueue::delayAll(uint32_t msec, const PacketId *exceptId)
+{
+    bool skipped = false;
+    for (auto e : heap) {
+        if (exceptId && e->first.id == *exceptId)
+            skipped = true;
+        else
+            e->second.nextTxMsec += msec;
+    }
+
+    // Moving everyone by the same amount keeps the order, unless we left some behind
+    if (skipped) {
+        for (size_t pos = heap.size() / 2; pos-- > 0;)
+            siftDown(pos);
+    }
+}
+
+RetransmissionQueue::Entry *RetransmissionQueue::nextDue(uint32_t now)
+{
+    if (heap.empty() || (int32_t)(now - heap[0]->second.nextTxMsec) < 0)
+        return NULL;
+    return heap[0];
+}
+
+int32_t RetransmissionQueue::msecUntilNext(uint32_t now) const
+{
+    if (heap.empty())
+        return INT32_MAX;
+    int32_t d = heap[0]->second.nextTxMsec - now;
+    return d > 0 ? d : 0;
+}
+
+void RetransmissionQueue::place(size_t pos, Entry *e)
+{
+    heap[pos] = e;
+    e->second.heapPos = pos;
+}
+
+void RetransmissionQueue::siftUp(size_t pos)
+{
+    Entry *e = heap[pos];
+    while (pos > 0) {
+        size_t parent = (pos - 1) / 2;
+        if (!before(e, heap[parent]))
+            break;
+        place(pos, heap[parent]);
+        pos = parent;
+    }
+    place(pos, e);
+}
+
+void RetransmissionQueue::siftDown(size_t pos)
+{
+    Entry *e = heap[pos];
+    size_t n = heap.size();
+    while (true) {
+        size_t child = 2 * pos + 1;
+        if (child >= n)
+            break;
+        if (child + 1 < n && before(heap[child + 1], heap[child]))
+            child++;
+        if (!before(heap[child], e))
+            break;
+        place(pos, heap[child]);
+        pos = child;
+    }
+    place(pos, e);
+}
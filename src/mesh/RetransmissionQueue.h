@@ -0,0 +1,102 @@
+#pragma once
+
+#include "MeshTypes.h"
+
+#include <unordered_map>
+#include <vector>
+
+/**
+ * An identifier for a globally unique message - a pair of the sending nodenum and the packet id assigned
+ * to that message
+ */
+struct GlobalPacketId {
+    NodeNum node;
+    PacketId id;
+
+    bool operator==(const GlobalPacketId &p) const { return node == p.node && id == p.id; }
+
+    explicit GlobalPacketId(const meshtastic_MeshPacket *p)
+    {
+        node = getFrom(p);
+        id = p->id;
+    }
+
+    GlobalPacketId(NodeNum _from, PacketId _id)
+    {
+        node = _from;
+        id = _id;
+    }
+};
+
+/**
+ * A packet queued for retransmission
+ */
+struct PendingPacket {
+    meshtastic_MeshPacket *packet;
+
+    /** The next time we should try to retransmit this packet, call RetransmissionQueue::reschedule() after changing it */
+    uint32_t nextTxMsec = 0;
+
+    /** Starts at NUM_RETRANSMISSIONS -1 and counts down.  Once zero it will be removed from the list */
+    uint8_t numRetransmissions = 0;
+
+    /** Our position in RetransmissionQueue's deadline heap */
+    size_t heapPos = 0;
+
+    PendingPacket() {}
+    explicit PendingPacket(meshtastic_MeshPacket *p, uint8_t numRetransmissions);
+};
+
+class GlobalPacketIdHashFunction
+{
+  public:
+    size_t operator()(const GlobalPacketId &p) const { return (std::hash<NodeNum>()(p.node)) ^ (std::hash<PacketId>()(p.id)); }
+};
+
+/**
+ * Pending retransmissions, keyed by packet id and ordered by when they are due
+ *
+ * Records live in a hash map (so lookups and removals by id are O(1)), and a binary heap of pointers into that map keeps
+ * them in nextTxMsec order, so finding the due ones and the next deadline doesn't walk every record.  Deadlines are compared
+ * as signed differences, which keeps working across the 49 day millis() rollover as long as they are within 24 days of
+ * each other.
+ */
+class RetransmissionQueue
+{
+  public:
+    typedef std::pair<const GlobalPacketId, PendingPacket> Entry;
+
+    /// @return the record for this id, or NULL
+    PendingPacket *find(const GlobalPacketId &key);
+
+    /// Add a record (with its nextTxMsec already set), replacing any old one with the same id
+    PendingPacket *add(const GlobalPacketId &key, const PendingPacket &rec);
+
+    /// @return true if we found and removed a record with this id
+    bool remove(const GlobalPacketId &key);
+
+    /// Move a record to its place in the deadline order after its nextTxMsec changed
+    void reschedule(PendingPacket *rec);
+
+    /// Push every deadline back by msec, except for the records of packet exceptId (if not NULL)
+    void delayAll(uint32_t msec, const PacketId *exceptId = NULL);
+
+    /// @return the earliest record that is due at now, or NULL.  It stays queued until rescheduled or removed.
+    Entry *nextDue(uint32_t now);
+
+    /// @return msecs until the earliest record is due (0 if overdue), or INT32_MAX if there are none
+    int32_t msecUntilNext(uint32_t now) const;
+
+    size_t size() const { return heap.size(); }
+    bool empty() const { return heap.empty(); }
+
+  private:
+    std::unordered_map<GlobalPacketId, PendingPacket, GlobalPacketIdHashFunction> records;
+    std::vector<Entry *> heap;
+
+    static bool before(const Entry *a, const Entry *b) { return (int32_t)(a->second.nextTxMsec - b->second.nextTxMsec) < 0; }
+
+    void place(size_t pos, Entry *e);
+    void siftUp(size_t pos);
+    void siftDown(size_t pos);
+};
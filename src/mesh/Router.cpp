@@ -22,8 +22,15 @@
 #include "serialization/MeshPacketSerializer.h"
 #endif
 
-#define MAX_RX_FROMRADIO                                                                                                         \
-    4 // max number of packets destined to our queue, we dispatch packets quickly so it doesn't need to be big
+// max number of packets destined to our queue, we dispatch packets quickly so it doesn't need to be big.  Portduino can sit on
+// a concentrator or a busy simulated mesh, so it gets room for bursts.
+#ifndef MAX_RX_FROMRADIO
+#ifdef ARCH_PORTDUINO
+#define MAX_RX_FROMRADIO 16
+#else
+#define MAX_RX_FROMRADIO 4
+#endif
+#endif
 
 // I think this is right, one packet for each of the three fifos + one packet being currently assembled for TX or RX
 // And every TX packet might have a retransmission packet or an ack alive at any moment
@@ -31,13 +38,41 @@
     (MAX_RX_TOPHONE + MAX_RX_FROMRADIO + 2 * MAX_TX_QUEUE +                                                                      \
      2) // max number of packets which can be in flight (either queued from reception or queued for sending)
 
-// static MemoryPool<MeshPacket> staticPool(MAX_PACKETS);
-static MemoryDynamic<meshtastic_MeshPacket> staticPool;
+// Each pool block is a whole MeshPacket (~350 bytes) of .bss, so only Portduino reserves room for every packet in flight.  The
+// others keep enough for the usual traffic and lean on the heap overflow for bursts.
+#ifndef PACKET_POOL_SIZE
+#if defined(ARCH_PORTDUINO)
+#define PACKET_POOL_SIZE MAX_PACKETS
+#elif defined(ARCH_ESP32)
+#define PACKET_POOL_SIZE 16
+#else
+#define PACKET_POOL_SIZE 8
+#endif
+#endif
+
+static MemoryPool<meshtastic_MeshPacket, PACKET_POOL_SIZE> staticPool;
 
 Allocator<meshtastic_MeshPacket> &packetPool = staticPool;
 
+MemoryPoolStats getPacketPoolStats()
+{
+    return staticPool.getStats();
+}
+
 static uint8_t bytes[MAX_LORA_PAYLOAD_LEN + 1] __attribute__((__aligned__));
 
+DecodeStats decodeStats;
+
+/**
+ * Cheap check whether decrypted bytes can be an encoded meshtastic_Data, before running the full nanopb decode.
+ * Encoders emit fields in field number order, so a valid Data starts with field 1 (portnum, varint) and a nonzero portnum,
+ * anything else would fail with an invalid portnum anyway.
+ */
+static inline bool looksLikeEncodedData(const uint8_t *plaintext, size_t len)
+{
+    return len >= 2 && plaintext[0] == ((meshtastic_Data_portnum_tag << 3) | PB_WT_VARINT) && plaintext[1] != 0;
+}
+
 /**
  * Constructor
  *
@@ -64,10 +99,18 @@ Router::Router() : concurrency::OSThread("Router"), fromRadioQueue(MAX_RX_FROMRA
  */
 int32_t Router::runOnce()
 {
-    meshtastic_MeshPacket *mp;
-    while ((mp = fromRadioQueue.dequeuePtr(0)) != NULL) {
-        // printPacket("handle fromRadioQ", mp);
-        perhapsHandleReceived(mp);
+    meshtastic_MeshPacket *batch[ROUTER_RX_BATCH_MAX];
+    int depth;
+    while ((depth = fromRadioQueue.numUsed()) > 0) {
+        rxStats.queueDepth.add(depth);
+
+        size_t count = 0;
+        meshtastic_MeshPacket *mp;
+        while (count < ROUTER_RX_BATCH_MAX && (mp = fromRadioQueue.dequeuePtr(0)) != NULL)
+            batch[count++] = mp;
+        if (!count)
+            break;
+        handleReceivedBatch(batch, count);
     }
 
     // LOG_DEBUG("Sleep forever!");
@@ -271,6 +314,9 @@ ErrorCode Router::send(meshtastic_MeshPacket *p)
 
     fixPriority(p); // Before encryption, fix the priority if it's unset
 
+    if (p->which_payload_variant == meshtastic_MeshPacket_decoded_tag && airTime)
+        airTime->notePortnum(p); // Once encrypted the radio can't tell which portnum its airtime goes to
+
     // If the packet is not yet encrypted, do so now
     if (p->which_payload_variant == meshtastic_MeshPacket_decoded_tag) {
         ChannelIndex chIndex = p->channel; // keep as a local because we are about to change it
@@ -336,8 +382,10 @@ DecodeState perhapsDecode(meshtastic_MeshPacket *p)
         config.device.rebroadcast_mode == meshtastic_Config_DeviceConfig_RebroadcastMode_ALL_SKIP_DECODING)
         return DecodeState::DECODE_FAILURE;
 
+    // One lookup of the sender serves the KNOWN_ONLY check and PKI decryption
+    const meshtastic_NodeInfoLite *sender = nodeDB->getMeshNode(p->from);
     if (config.device.rebroadcast_mode == meshtastic_Config_DeviceConfig_RebroadcastMode_KNOWN_ONLY &&
-        (nodeDB->getMeshNode(p->from) == NULL || !nodeDB->getMeshNode(p->from)->has_user)) {
+        (sender == NULL || !sender->has_user)) {
         LOG_DEBUG("Node 0x%x not in nodeDB-> Rebroadcast mode KNOWN_ONLY will ignore packet", p->from);
         return DecodeState::DECODE_FAILURE;
     }
@@ -354,13 +402,12 @@ DecodeState perhapsDecode(meshtastic_MeshPacket *p)
     ChannelIndex chIndex = 0;
 #if !(MESHTASTIC_EXCLUDE_PKI)
     // Attempt PKI decryption first
-    if (p->channel == 0 && isToUs(p) && p->to > 0 && !isBroadcast(p->to) && nodeDB->getMeshNode(p->from) != nullptr &&
-        nodeDB->getMeshNode(p->from)->user.public_key.size > 0 && nodeDB->getMeshNode(p->to)->user.public_key.size > 0 &&
+    if (p->channel == 0 && isToUs(p) && p->to > 0 && !isBroadcast(p->to) && sender != nullptr &&
+        sender->user.public_key.size > 0 && nodeDB->getMeshNode(p->to)->user.public_key.size > 0 &&
         rawSize > MESHTASTIC_PKC_OVERHEAD) {
         LOG_DEBUG("Attempt PKI decryption");
 
-        if (crypto->decryptCurve25519(p->from, nodeDB->getMeshNode(p->from)->user.public_key, p->id, rawSize, p->encrypted.bytes,
-                                      bytes)) {
+        if (crypto->decryptCurve25519(p->from, sender->user.public_key, p->id, rawSize, p->encrypted.bytes, bytes)) {
             LOG_INFO("PKI Decryption worked!");
 
             meshtastic_Data decodedtmp;
@@ -371,7 +418,7 @@ DecodeState perhapsDecode(meshtastic_MeshPacket *p)
                 decrypted = true;
                 LOG_INFO("Packet decrypted using PKI!");
                 p->pki_encrypted = true;
-                memcpy(&p->public_key.bytes, nodeDB->getMeshNode(p->from)->user.public_key.bytes, 32);
+                memcpy(&p->public_key.bytes, sender->user.public_key.bytes, 32);
                 p->public_key.size = 32;
                 p->decoded = decodedtmp;
                 p->which_payload_variant = meshtastic_MeshPacket_decoded_tag; // change type to decoded
@@ -387,10 +434,16 @@ DecodeState perhapsDecode(meshtastic_MeshPacket *p)
 
     // assert(p->which_payloadVariant == MeshPacket_encrypted_tag);
     if (!decrypted) {
-        // Try to find a channel that works with this hash
-        for (chIndex = 0; chIndex < channels.getNumChannels(); chIndex++) {
+        // Only try the channels whose precomputed hash matches this packet
+        uint8_t candidates = channels.getChannelsForHash(p->channel);
+        if (!candidates)
+            decodeStats.noChannelForHash++;
+        for (chIndex = 0; candidates && chIndex < channels.getNumChannels(); chIndex++) {
+            if (!(candidates & (1 << chIndex)))
+                continue;
             // Try to use this hash/channel pair
             if (channels.decryptForHash(chIndex, p->channel)) {
+                decodeStats.channelDecrypts++;
                 // we have to copy into a scratch buffer, because these bytes are a union with the decoded protobuf. Create a
                 // fresh copy for each decrypt attempt.
                 memcpy(bytes, p->encrypted.bytes, rawSize);
@@ -399,12 +452,20 @@ DecodeState perhapsDecode(meshtastic_MeshPacket *p)
 
                 // printBytes("plaintext", bytes, p->encrypted.size);
 
+                if (!looksLikeEncodedData(bytes, rawSize)) {
+                    decodeStats.precheckRejected++;
+                    LOG_DEBUG("Decrypted bytes on channel %d are not a Data message (bad psk?)", chIndex);
+                    continue;
+                }
+
                 // Take those raw bytes and convert them back into a well structured protobuf we can understand
                 meshtastic_Data decodedtmp;
                 memset(&decodedtmp, 0, sizeof(decodedtmp));
                 if (!pb_decode_from_bytes(bytes, rawSize, &meshtastic_Data_msg, &decodedtmp)) {
+                    decodeStats.decodeRejected++;
                     LOG_ERROR("Invalid protobufs in received mesh packet id=0x%08x (bad psk?)!", p->id);
                 } else if (decodedtmp.portnum == meshtastic_PortNum_UNKNOWN_APP) {
+                    decodeStats.decodeRejected++;
                     LOG_ERROR("Invalid portnum (bad psk?)!");
                 } else {
                     p->decoded = decodedtmp;
@@ -598,16 +659,23 @@ NodeNum Router::getNodeNum()
  * Handle any packet that is received by an interface on this node.
  * Note: some packets may merely being passed through this node and will be forwarded elsewhere.
  */
-void Router::handleReceived(meshtastic_MeshPacket *p, RxSource src)
+void Router::handleReceived(meshtastic_MeshPacket *p, RxSource src, bool batched)
 {
     bool skipHandle = false;
     // Also, we should set the time from the ISR and it should have msec level resolution
-    p->rx_time = getValidTime(RTCQualityFromNet); // store the arrival timestamp for the phone
+    if (!batched)
+        p->rx_time = getValidTime(RTCQualityFromNet); // store the arrival timestamp for the phone, a batch already did
     // Store a copy of encrypted packet for MQTT
     meshtastic_MeshPacket *p_encrypted = packetPool.allocCopy(*p);
 
     // Take those raw bytes and convert them back into a well structured protobuf we can understand
+    uint32_t start = micros();
     auto decodedState = perhapsDecode(p);
+    uint32_t decoded = micros();
+    if (batched)
+        rxStats.decodeUsec.add(decoded - start);
+    if (decodedState == DecodeState::DECODE_SUCCESS && airTime)
+        airTime->notePortnum(p); // Charge the airtime of this packet and its rebroadcasts to its portnum
     if (decodedState == DecodeState::DECODE_FATAL) {
         // Fatal decoding error, we can't do anything with this packet
         LOG_WARN("Fatal decode error, dropping packet");
@@ -651,7 +719,7 @@ void Router::handleReceived(meshtastic_MeshPacket *p, RxSource src)
 
     // call modules here
     if (!skipHandle) {
-        MeshModule::callModules(*p, src);
+        MeshModule::callModules(*p, src, batched);
 
 #if !MESHTASTIC_EXCLUDE_MQTT
         // Mark as pki_encrypted if it is not yet decoded and MQTT encryption is also enabled, hash matches and it's a DM not to
@@ -667,55 +735,79 @@ void Router::handleReceived(meshtastic_MeshPacket *p, RxSource src)
     }
 
     packetPool.release(p_encrypted); // Release the encrypted packet
+    if (batched)
+        rxStats.dispatchUsec.add(micros() - decoded);
 }
 
-void Router::perhapsHandleReceived(meshtastic_MeshPacket *p)
+void Router::handleReceivedBatch(meshtastic_MeshPacket **batch, size_t count)
 {
+    rxStats.batches++;
+
+    // Packets of one wakeup arrived within moments of each other, one timestamp serves them all
+    uint32_t rxTime = getValidTime(RTCQualityFromNet);
 #if ENABLE_JSON_LOGGING
-    // Even ignored packets get logged in the trace
-    p->rx_time = getValidTime(RTCQualityFromNet); // store the arrival timestamp for the phone
-    LOG_TRACE("%s", MeshPacketSerializer::JsonSerializeEncrypted(p).c_str());
+    bool trace = true;
 #elif ARCH_PORTDUINO
+    bool trace = settingsStrings[traceFilename] != "" || settingsMap[logoutputlevel] == level_trace;
+#else
+    bool trace = false;
+#endif
+
+    // Packets the modules saw stay alive until the batch aware modules had them too
+    size_t handled = 0;
+    for (size_t i = 0; i < count; i++) {
+        meshtastic_MeshPacket *p = batch[i];
+        // printPacket("handle fromRadioQ", p);
+        if (perhapsHandleReceived(p, rxTime, trace))
+            batch[handled++] = p;
+        else
+            packetPool.release(p);
+    }
+
+    if (handled) {
+        uint32_t start = micros();
+        MeshModule::callBatchModules();
+        rxStats.batchUsec.add(micros() - start);
+    }
+
+    for (size_t i = 0; i < handled; i++)
+        packetPool.release(batch[i]);
+}
+
+bool Router::perhapsHandleReceived(meshtastic_MeshPacket *p, uint32_t rxTime, bool trace)
+{
+    uint32_t start = micros();
+
+    p->rx_time = rxTime; // store the arrival timestamp for the phone
+#if ENABLE_JSON_LOGGING || ARCH_PORTDUINO
     // Even ignored packets get logged in the trace
-    if (settingsStrings[traceFilename] != "" || settingsMap[logoutputlevel] == level_trace) {
-        p->rx_time = getValidTime(RTCQualityFromNet); // store the arrival timestamp for the phone
+    if (trace)
         LOG_TRACE("%s", MeshPacketSerializer::JsonSerializeEncrypted(p).c_str());
-    }
 #endif
+
     // assert(radioConfig.has_preferences);
+    bool ignore = true;
     if (is_in_repeated(config.lora.ignore_incoming, p->from)) {
         LOG_DEBUG("Ignore msg, 0x%x is in our ignore list", p->from);
-        packetPool.release(p);
-        return;
-    }
-
-    meshtastic_NodeInfoLite const *node = nodeDB->getMeshNode(p->from);
-    if (node != NULL && node->is_ignored) {
-        LOG_DEBUG("Ignore msg, 0x%x is ignored", p->from);
-        packetPool.release(p);
-        return;
-    }
-
-    if (p->from == NODENUM_BROADCAST) {
+    } else if (p->from == NODENUM_BROADCAST) {
         LOG_DEBUG("Ignore msg from broadcast address");
-        packetPool.release(p);
-        return;
-    }
-
-    if (config.lora.ignore_mqtt && p->via_mqtt) {
+    } else if (config.lora.ignore_mqtt && p->via_mqtt) {
         LOG_DEBUG("Msg came in via MQTT from 0x%x", p->from);
-        packetPool.release(p);
-        return;
-    }
-
-    if (shouldFilterReceived(p)) {
-        LOG_DEBUG("Incoming msg was filtered from 0x%x", p->from);
-        packetPool.release(p);
-        return;
+    } else {
+        meshtastic_NodeInfoLite const *node = nodeDB->getMeshNode(p->from);
+        if (node != NULL && node->is_ignored)
+            LOG_DEBUG("Ignore msg, 0x%x is ignored", p->from);
+        else if (shouldFilterReceived(p))
+            LOG_DEBUG("Incoming msg was filtered from 0x%x", p->from);
+        else
+            ignore = false;
     }
+    rxStats.screenUsec.add(micros() - start);
+    if (ignore)
+        return false;
 
     // Note: we avoid calling shouldFilterReceived if we are supposed to ignore certain nodes - because some overrides might
     // cache/learn of the existence of nodes (i.e. FloodRouter) that they should not
-    handleReceived(p);
-    packetPool.release(p);
+    handleReceived(p, RX_SRC_RADIO, true);
+    return true;
 }
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "Channels.h"
+#include "Histogram.h"
 #include "MemoryPool.h"
 #include "MeshTypes.h"
 #include "Observer.h"
@@ -9,6 +10,21 @@
 #include "RadioInterface.h"
 #include "concurrency/OSThread.h"
 
+/// Max packets taken from fromRadioQueue per router wakeup
+#ifndef ROUTER_RX_BATCH_MAX
+#define ROUTER_RX_BATCH_MAX 16
+#endif
+
+/// Tuning data for the receive pipeline, see Router::getRxStats().  Stage times are per packet, in microseconds.
+struct RouterRxStats {
+    uint32_t batches;
+    Log2Histogram<8> queueDepth;    // Packets waiting in fromRadioQueue when the router woke up
+    Log2Histogram<20> screenUsec;   // Ignore lists and shouldFilterReceived
+    Log2Histogram<20> decodeUsec;   // perhapsDecode
+    Log2Histogram<20> dispatchUsec; // Modules and MQTT
+    Log2Histogram<20> batchUsec;    // Batch aware modules, once per batch
+};
+
 /**
  * A mesh aware router that supports multiple interfaces.
  */
@@ -91,6 +107,8 @@ class Router : protected concurrency::OSThread, protected PacketHistory
         before us */
     uint32_t rxDupe = 0, txRelayCanceled = 0;
 
+    const RouterRxStats &getRxStats() const { return rxStats; }
+
   protected:
     friend class RoutingModule;
 
@@ -116,15 +134,30 @@ class Router : protected concurrency::OSThread, protected PacketHistory
     void sendAckNak(meshtastic_Routing_Error err, NodeNum to, PacketId idFrom, ChannelIndex chIndex, uint8_t hopLimit = 0);
 
   private:
+    RouterRxStats rxStats = {};
+
+    /**
+     * Called from runOnce() with the packets drained from fromRadioQueue in one wakeup.
+     *
+     * Each packet still goes through perhapsHandleReceived() on its own and in order, because shouldFilterReceived() may
+     * cancel a rebroadcast queued by an earlier packet.  What the batch shares: one clock read for rx_time, one check of the
+     * trace settings and one call to the batch aware modules at the end.
+     *
+     * Note: this method will free the provided packets.
+     */
+    void handleReceivedBatch(meshtastic_MeshPacket **batch, size_t count);
+
     /**
-     * Called from loop()
+     * Called from handleReceivedBatch()
      * Handle any packet that is received by an interface on this node.
      * Note: some packets may merely being passed through this node and will be forwarded elsewhere.
      *
      * Note: this packet will never be called for messages sent/generated by this node.
-     * Note: this method will free the provided packet.
+     * Note: the caller frees the packet.
+     *
+     * @return false if the packet was ignored or filtered
      */
-    void perhapsHandleReceived(meshtastic_MeshPacket *p);
+    bool perhapsHandleReceived(meshtastic_MeshPacket *p, uint32_t rxTime, bool trace);
 
     /**
      * Called from perhapsHandleReceived() - allows subclass message delivery behavior.
@@ -132,9 +165,12 @@ class Router : protected concurrency::OSThread, protected PacketHistory
      * Note: some packets may merely being passed through this node and will be forwarded elsewhere.
      *
      * Note: this packet will never be called for messages sent/generated by this node.
-     * Note: this method will free the provided packet.
+     * Note: the caller frees the packet.
+     *
+     * @param batched true if p is part of a handleReceivedBatch() batch, so batch aware modules get it at the end of the batch
+     * instead of right away.  p then has to stay alive until MeshModule::callBatchModules() ran.
      */
-    void handleReceived(meshtastic_MeshPacket *p, RxSource src = RX_SRC_RADIO);
+    void handleReceived(meshtastic_MeshPacket *p, RxSource src = RX_SRC_RADIO, bool batched = false);
 
     /** Frees the provided packet, and generates a NAK indicating the specifed error while sending */
     void abortSendAndNak(meshtastic_Routing_Error err, meshtastic_MeshPacket *p);
@@ -142,6 +178,16 @@ class Router : protected concurrency::OSThread, protected PacketHistory
 
 enum DecodeState { DECODE_SUCCESS, DECODE_FAILURE, DECODE_FATAL };
 
+/// Counters for perhapsDecode, show how much work the channel hash table and plaintext precheck save
+struct DecodeStats {
+    uint32_t noChannelForHash; // Packets whose channel hash matches none of our channels, so no decrypt was attempted
+    uint32_t channelDecrypts;  // Channel decrypt attempts
+    uint32_t precheckRejected; // Channel decrypts rejected by the plaintext precheck, without running pb_decode
+    uint32_t decodeRejected;   // Channel decrypts rejected by pb_decode or because of an invalid portnum
+};
+
+extern DecodeStats decodeStats;
+
 /** FIXME - move this into a mesh packet class
  * Remove any encryption and decode the protobufs inside this packet (if necessary).
  *
@@ -0,0 +1,173 @@
+#include "StaticAssetManifest.h"
+#if !MESHTASTIC_EXCLUDE_WEBSERVER && (defined(ARCH_ESP32) || defined(ARCH_PORTDUINO))
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+StaticAssetManifest staticAssets;
+
+static bool endsWith(const std::string &s, const char *suffix)
+{
+    size_t n = strlen(suffix);
+    return s.size() >= n && s.compare(s.size() - n, n, suffix) == 0;
+}
+
+bool StaticAssetManifest::add(const std::string &name, const std::string &file, uint32_t size, uint32_t hash)
+{
+    if (files >= STATIC_ASSET_MAX_FILES)
+        return false;
+
+    bool gzip = endsWith(name, ".gz");
+    std::string key = gzip ? name.substr(0, name.size() - 3) : name;
+    Entry &entry = entries[key];
+
+    StaticAsset &asset = gzip ? entry.gzip : entry.plain;
+    asset.file = file;
+    asset.size = size;
+    snprintf(asset.etag, sizeof(asset.etag), "\"%08x-%x\"", (unsigned)hash, (unsigned)size);
+    asset.gzip = gzip;
+    asset.immutable = isHashedName(key);
+    (gzip ? entry.hasGzip : entry.hasPlain) = true;
+    files++;
+    return true;
+}
+
+bool StaticAssetManifest::find(const std::string &name, bool acceptGzip, StaticAsset &asset) const
+{
+    auto it = entries.find(name);
+    if (it != entries.end()) {
+        const Entry &entry = it->second;
+        if (entry.hasGzip && (acceptGzip || !entry.hasPlain))
+            asset = entry.gzip;
+        else if (entry.hasPlain)
+            asset = entry.plain;
+        else
+            return false;
+        return true;
+    }
+
+    // Asked for a .gz by its name, send it as it is
+    if (endsWith(name, ".gz")) {
+        it = entries.find(name.substr(0, name.size() - 3));
+        if (it != entries.end() && it->second.hasGzip) {
+            asset = it->second.gzip;
+            asset.gzip = false;
+            return true;
+        }
+    }
+    return false;
+}
+
+void StaticAssetManifest::clear()
+{
+    entries.clear();
+    files = 0;
+    built = false;
+}
+
+void StaticAssetManifest::setBuilt(uint32_t msec)
+{
+    built = true;
+    buildMsec = msec;
+}
+
+void StaticAssetManifest::count(const StaticAsset *asset, bool notModified, uint32_t bytes, uint32_t usec)
+{
+    std::lock_guard<std::mutex> guard(statsLock);
+    stats.requests++;
+    if (!asset)
+        stats.notFound++;
+    else if (notModified)
+        stats.notModified++;
+    else if (asset->gzip)
+        stats.gzipSent++;
+    stats.bytesSent += bytes;
+    stats.sendUsec += usec;
+}
+
+StaticAssetStats StaticAssetManifest::getStats()
+{
+    std::lock_guard<std::mutex> guard(statsLock);
+    return stats;
+}
+
+bool StaticAssetManifest::isHashedName(const std::string &name)
+{
+    size_t base = name.find_last_of('/');
+    base = base == std::string::npos ? 0 : base + 1;
+    size_t ext = name.find_last_of('.');
+    if (ext == std::string::npos || ext <= base)
+        return false;
+
+    // The hash is the part after the last - or . before the extension
+    size_t sep = name.find_last_of("-.", ext - 1);
+    if (sep == std::string::npos || sep < base || ext - sep - 1 < 8)
+        return false;
+
+    bool digit = false;
+    for (size_t i = sep + 1; i < ext; i++) {
+        char c = name[i];
+        if (!isalnum((unsigned char)c) && c != '_')
+            return false;
+        digit |= isdigit((unsigned char)c) != 0;
+    }
+    return digit; // Otherwise it is more likely a word, "app-settings.js"
+}
+
+bool StaticAssetManifest::etagMatches(const char *ifNoneMatch, const char *etag)
+{
+    if (!ifNoneMatch || !etag)
+        return false;
+    size_t etagLen = strlen(etag);
+
+    const char *p = ifNoneMatch;
+    while (*p) {
+        while (*p == ' ' || *p == '\t' || *p == ',')
+            p++;
+        if (*p == '*')
+            return true;
+        if (p[0] == 'W' && p[1] == '/')
+            p += 2;
+        if (*p != '"')
+            return false; // Not a list of entity tags
+        const char *end = strchr(p + 1, '"');
+        if (!end)
+            return false;
+        if ((size_t)(end + 1 - p) == etagLen && strncmp(p, etag, etagLen) == 0)
+            return true;
+        p = end + 1;
+    }
+    return false;
+}
+
+bool StaticAssetManifest::acceptsGzip(const char *acceptEncoding)
+{
+    if (!acceptEncoding)
+        return false;
+
+    const char *p = acceptEncoding;
+    while (*p) {
+        while (*p == ' ' || *p == '\t' || *p == ',')
+            p++;
+        const char *token = p;
+        while (*p && *p != ',' && *p != ';' && *p != ' ')
+            p++;
+        size_t len = p - token;
+        bool isGzip = (len == 4 && strncasecmp(token, "gzip", 4) == 0) || (len == 1 && *token == '*');
+
+        // Parameters, only q matters: q=0 refuses the coding
+        bool refused = false;
+        while (*p && *p != ',') {
+            if (*p == 'q' && p[1] == '=')
+                refused = strtof(p + 2, NULL) <= 0;
+            p++;
+        }
+        if (isGzip && !refused)
+            return true;
+    }
+    return false;
+}
+
+#endif
@@ -0,0 +1,138 @@
+#pragma once
+
+#include "configuration.h"
+#if !MESHTASTIC_EXCLUDE_WEBSERVER && (defined(ARCH_ESP32) || defined(ARCH_PORTDUINO))
+
+#include <map>
+#include <mutex>
+#include <stdint.h>
+#include <string>
+
+/// Most files the manifest keeps track of, anything past that is still served, just without an ETag
+#ifndef STATIC_ASSET_MAX_FILES
+#define STATIC_ASSET_MAX_FILES 128
+#endif
+
+/// Cache-Control for assets whose name carries a content hash, they never change under the same name
+#define STATIC_ASSET_CACHE_IMMUTABLE "public, max-age=31536000, immutable"
+
+/// Cache-Control for everything else (index.html above all), keep it but check the ETag before using it
+#define STATIC_ASSET_CACHE_REVALIDATE "no-cache"
+
+/// One file under the web root, either the asset itself or its pre-compressed .gz sibling
+struct StaticAsset {
+    std::string file; // Path to open, on flash or on disk
+    uint32_t size;
+    char etag[20];  // Strong validator with its quotes, from the content hash and size
+    bool gzip;      // file holds the gzip Content-Encoding of the asset
+    bool immutable; // The name carries a content hash, see StaticAssetManifest::isHashedName()
+};
+
+/// Counters to see what the caching saves, bytes per visit is bytesSent over the visits
+struct StaticAssetStats {
+    uint32_t requests;    // Static file requests
+    uint32_t notModified; // ... answered 304 from the client's cache
+    uint32_t notFound;    // ... with nothing to send, not even index.html
+    uint32_t gzipSent;    // ... answered with a .gz file
+    uint64_t bytesSent;   // Body bytes sent
+    uint64_t sendUsec;    // Time spent answering, including the body on the ESP32
+};
+
+/// FNV-1a over a file's content, fed a chunk at a time while building the manifest
+class StaticAssetHasher
+{
+  public:
+    void update(const uint8_t *buf, size_t len)
+    {
+        for (size_t i = 0; i < len; i++)
+            hash = (hash ^ buf[i]) * 16777619u;
+    }
+
+    uint32_t get() const { return hash; }
+
+  private:
+    uint32_t hash = 2166136261u;
+};
+
+/**
+ * What the web client bundle on flash (or the web root on Linux) consists of: every file with its size, a hash of its content
+ * and whether a pre-compressed .gz of it exists.  The web servers walk the files once and then answer each request from here
+ * without probing the filesystem: with a strong ETag, a 304 when the browser already has that version, and Cache-Control
+ * that lets it keep hashed bundle files for good.
+ *
+ * Whoever changes the files (an upload, a delete) calls clear(), the server rebuilds the manifest on the next request.
+ *
+ * Lookups may come from the web server's threads, building happens before they start or on the only one there is.
+ */
+class StaticAssetManifest
+{
+  public:
+    /**
+     * Add a file found under the web root.
+     * @param name its path relative to the web root, e.g. "assets/index-3f2a9c1b.js.gz"
+     * @param file the path to open it by
+     * @return false if the manifest is full
+     */
+    bool add(const std::string &name, const std::string &file, uint32_t size, uint32_t hash);
+
+    /**
+     * The file to send for a request of name (relative to the web root, without a leading /).  The .gz is preferred if the
+     * client accepts gzip, the plain file otherwise.  When there is only one of them that is it, like before.
+     * @return false if name isn't in the manifest
+     */
+    bool find(const std::string &name, bool acceptGzip, StaticAsset &asset) const;
+
+    /// Forget all files, they changed
+    void clear();
+
+    /// Mark the manifest complete after adding all files, buildMsec is how long walking and hashing them took
+    void setBuilt(uint32_t buildMsec);
+
+    bool isBuilt() const { return built; }
+
+    size_t getFileCount() const { return files; }
+
+    uint32_t getBuildMsec() const { return buildMsec; }
+
+    /// Count a request, from any thread
+    void count(const StaticAsset *asset, bool notModified, uint32_t bytes, uint32_t usec);
+
+    StaticAssetStats getStats();
+
+    /**
+     * Whether a file name carries a content hash, like the bundles of the web client: "index-3f2a9c1b.js",
+     * "main.5b1e0f2c.css".  Those can be cached for good, a new build comes with new names.
+     */
+    static bool isHashedName(const std::string &name);
+
+    /// Whether an If-None-Match header lists etag (or is *), compared weakly like RFC 9110 says for GET
+    static bool etagMatches(const char *ifNoneMatch, const char *etag);
+
+    /// Whether an Accept-Encoding header allows gzip
+    static bool acceptsGzip(const char *acceptEncoding);
+
+    static const char *cacheControl(const StaticAsset &asset)
+    {
+        return asset.immutable ? STATIC_ASSET_CACHE_IMMUTABLE : STATIC_ASSET_CACHE_REVALIDATE;
+    }
+
+  private:
+    struct Entry {
+        StaticAsset plain;
+        StaticAsset gzip;
+        bool hasPlain = false;
+        bool hasGzip = false;
+    };
+
+    std::map<std::string, Entry> entries;
+    size_t files = 0;
+    bool built = false;
+    uint32_t buildMsec = 0;
+
+    std::mutex statsLock;
+    StaticAssetStats stats = {};
+};
+
+extern StaticAssetManifest staticAssets;
+
+#endif
@@ -83,18 +83,22 @@ void StreamAPI::writeStream()
 {
     if (canWrite) {
         uint32_t len;
+        bool wrote = false;
         do {
-            // Send every packet we can
+            // Send every packet we can, flushing once at the end so a burst (e.g. want_config) goes out in large writes
             len = getFromRadio(txBuf + HEADER_LEN);
-            emitTxBuffer(len);
+            emitTxBuffer(len, false);
+            wrote |= len != 0;
         } while (len);
+        if (wrote)
+            stream->flush();
     }
 }
 
 /**
  * Send the current txBuffer over our stream
  */
-void StreamAPI::emitTxBuffer(size_t len)
+void StreamAPI::emitTxBuffer(size_t len, bool flush)
 {
     if (len != 0) {
         txBuf[0] = START1;
@@ -104,7 +108,8 @@ void StreamAPI::emitTxBuffer(size_t len)
 
         auto totalLen = len + HEADER_LEN;
         stream->write(txBuf, totalLen);
-        stream->flush();
+        if (flush)
+            stream->flush();
     }
 }
 
@@ -0,0 +1,101 @@
+#include "PhonePacketFanout.h"
+#include "MeshService.h"
+#include "configuration.h"
+
+#define RING_MASK (PHONE_FANOUT_RING_SIZE - 1)
+
+PhonePacketFanout phonePacketFanout;
+
+void PhonePacketFanout::attach(PhonePacketReader *reader)
+{
+    if (reader->attached)
+        return;
+
+    for (auto &r : readers) {
+        if (!r) {
+            r = reader;
+            reader->cursor = head;
+            reader->attached = true;
+            reader->overrun = false;
+            return;
+        }
+    }
+    LOG_WARN("No free phone packet reader slot");
+}
+
+void PhonePacketFanout::detach(PhonePacketReader *reader)
+{
+    for (auto &r : readers) {
+        if (r == reader)
+            r = NULL;
+    }
+    reader->attached = false;
+    reclaim();
+}
+
+bool PhonePacketFanout::pull()
+{
+    if (head - tail >= PHONE_FANOUT_RING_SIZE)
+        return false;
+
+    meshtastic_MeshPacket *p = service->getForPhone();
+    if (!p)
+        return false;
+
+    ring[head & RING_MASK] = p;
+    head++;
+    return true;
+}
+
+void PhonePacketFanout::dropSlowestReaders()
+{
+    for (auto &r : readers) {
+        if (r && r->cursor == tail) {
+            LOG_WARN("API client fell %d packets behind, drop it", PHONE_FANOUT_RING_SIZE);
+            r->attached = false;
+            r->overrun = true;
+            r = NULL;
+        }
+    }
+    reclaim();
+}
+
+meshtastic_MeshPacket *PhonePacketFanout::peek(PhonePacketReader *reader)
+{
+    if (!reader->attached)
+        return NULL;
+
+    if (reader->cursor == head) {
+        // Nothing buffered for this reader - fetch more from MeshService, making room if someone is hogging the ring
+        if (head - tail >= PHONE_FANOUT_RING_SIZE)
+            dropSlowestReaders();
+        if (!pull())
+            return NULL;
+    }
+    return ring[reader->cursor & RING_MASK];
+}
+
+void PhonePacketFanout::advance(PhonePacketReader *reader)
+{
+    if (!reader->attached || reader->cursor == head)
+        return;
+
+    reader->cursor++;
+    reclaim();
+}
+
+void PhonePacketFanout::reclaim()
+{
+    // Everything before the slowest attached cursor has been seen by all readers (or by none, if nobody is left)
+    uint32_t oldest = head;
+    for (auto r : readers) {
+        if (r && (head - r->cursor) > (head - oldest))
+            oldest = r->cursor;
+    }
+
+    while (tail != oldest) {
+        service->releaseToPool(ring[tail & RING_MASK]);
+        ring[tail & RING_MASK] = NULL;
+        tail++;
+    }
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include "MeshTypes.h"
+#include <stdint.h>
+
+#ifndef PHONE_FANOUT_RING_SIZE
+#ifdef ARCH_PORTDUINO
+#define PHONE_FANOUT_RING_SIZE 64
+#else
+#define PHONE_FANOUT_RING_SIZE 16
+#endif
+#endif
+
+static_assert((PHONE_FANOUT_RING_SIZE & (PHONE_FANOUT_RING_SIZE - 1)) == 0, "PHONE_FANOUT_RING_SIZE must be a power of two");
+
+#ifndef PHONE_FANOUT_MAX_READERS
+#define PHONE_FANOUT_MAX_READERS 12
+#endif
+
+/**
+ * A reader of the shared phone packet ring.  Each API session that wants to see every packet (rather than compete with the
+ * other sessions for them) owns one of these.
+ */
+struct PhonePacketReader {
+    /// Sequence number of the next packet this reader will be handed
+    uint32_t cursor = 0;
+
+    /// True while this reader holds a slot in the fanout
+    bool attached = false;
+
+    /// Set when this reader fell a whole ring behind the others and was detached; the owning session should close
+    bool overrun = false;
+};
+
+/**
+ * Shares the MeshService toPhone queue between several API sessions.
+ *
+ * MeshService::getForPhone() has a single consumer: whoever dequeues a packet owns it.  With more than one TCP client
+ * connected they would steal packets from each other, so instead packets are moved from the MeshService queue into a
+ * sequence numbered ring which every attached reader walks with its own cursor.  The packet itself is shared, not copied;
+ * it is returned to the pool once the last reader has passed it.
+ *
+ * Packets are only pulled out of MeshService when a reader asks for one, so a single client sees exactly the backpressure
+ * it had before.  If a reader wants a packet while the ring is full, the reader holding the oldest entry is a whole ring
+ * behind: it is detached (and flagged overrun) rather than holding up everybody else.
+ */
+class PhonePacketFanout
+{
+  public:
+    /// Start handing packets to reader, beginning with the next one that arrives
+    void attach(PhonePacketReader *reader);
+
+    /// Stop handing packets to reader and release anything only it was still holding
+    void detach(PhonePacketReader *reader);
+
+    /// Return the next packet for reader without consuming it, or NULL if there is nothing new.  The packet is shared with
+    /// the other readers, so it must not be modified or freed.
+    meshtastic_MeshPacket *peek(PhonePacketReader *reader);
+
+    /// Mark the packet returned by peek() as consumed by reader
+    void advance(PhonePacketReader *reader);
+
+    /// Number of packets currently buffered in the ring
+    uint32_t numBuffered() const { return head - tail; }
+
+  private:
+    meshtastic_MeshPacket *ring[PHONE_FANOUT_RING_SIZE] = {};
+
+    /// Sequence numbers of the oldest still referenced and the next to be written packets
+    uint32_t tail = 0, head = 0;
+
+    PhonePacketReader *readers[PHONE_FANOUT_MAX_READERS] = {};
+
+    /// Move one packet from MeshService into the ring, returns false if none was waiting
+    bool pull();
+
+    /// Detach whichever readers still hold the oldest packet in the ring
+    void dropSlowestReaders();
+
+    /// Release packets every attached reader has moved past
+    void reclaim();
+};
+
+extern PhonePacketFanout phonePacketFanout;
@@ -10,13 +10,15 @@ ServerAPI<T>::ServerAPI(T &_client) : StreamAPI(&client), concurrency::OSThread(
 
 template <typename T> ServerAPI<T>::~ServerAPI()
 {
-    client.stop();
+    close(); // must run here, the PhoneAPI destructor would hand our shared packet straight back to the pool
 }
 
 template <typename T> void ServerAPI<T>::close()
 {
     client.stop(); // drop tcp connection
     StreamAPI::close();
+    phonePacketFanout.detach(&packetReader);
+    fanoutPacket = NULL;
 }
 
 /// Check the current underlying physical link to see if the client is currently connected
@@ -25,8 +27,33 @@ template <typename T> bool ServerAPI<T>::checkIsConnected()
     return client.connected();
 }
 
+template <typename T> meshtastic_MeshPacket *ServerAPI<T>::getPacketForPhone()
+{
+    if (!packetReader.attached && !packetReader.overrun)
+        phonePacketFanout.attach(&packetReader);
+
+    fanoutPacket = phonePacketFanout.peek(&packetReader);
+    return fanoutPacket;
+}
+
+template <typename T> void ServerAPI<T>::releasePacketForPhone(meshtastic_MeshPacket *p)
+{
+    if (p == fanoutPacket) {
+        phonePacketFanout.advance(&packetReader);
+        fanoutPacket = NULL;
+    } else {
+        StreamAPI::releasePacketForPhone(p); // e.g. from StoreForward, which is ours alone
+    }
+}
+
 template <class T> int32_t ServerAPI<T>::runOnce()
 {
+    if (packetReader.overrun) {
+        LOG_WARN("API client too slow to keep up with packets, close it");
+        packetReader.overrun = false;
+        close();
+    }
+
     if (client.connected()) {
         return StreamAPI::runOncePart();
     } else {
@@ -56,24 +83,42 @@ template <class T, class U> int32_t APIServerPort<T, U>::runOnce()
 #else
     auto client = U::available();
 #endif
+    // Reap sessions whose client went away so their slot can be reused
+    int freeSlot = -1;
+    for (int i = 0; i < MAX_API_CLIENTS; i++) {
+        if (openAPI[i] && !openAPI[i]->isOpen()) {
+            delete openAPI[i];
+            openAPI[i] = NULL;
+        }
+        if (!openAPI[i] && freeSlot < 0)
+            freeSlot = i;
+    }
+
     if (client) {
-        // Close any previous connection (see FIXME in header file)
-        if (openAPI) {
+        if (freeSlot < 0) {
 #if RAK_4631
             // RAK13800 Ethernet requests periodically take more time
             // This backoff addresses most cases keeping max wait < 1s
             // Reconnections are delayed by full wait time
             if (waitTime < 400) {
                 waitTime *= 2;
-                LOG_INFO("Previous TCP connection still open, try again in %dms", waitTime);
+                LOG_INFO("All TCP connections still open, try again in %dms", waitTime);
                 return waitTime;
             }
 #endif
-            LOG_INFO("Force close previous TCP connection");
-            delete openAPI;
+            // All slots busy, make room by dropping whoever we heard from least recently
+            int stalest = 0;
+            for (int i = 1; i < MAX_API_CLIENTS; i++) {
+                if ((int32_t)(openAPI[i]->getLastContactMsec() - openAPI[stalest]->getLastContactMsec()) < 0)
+                    stalest = i;
+            }
+            LOG_INFO("Force close least recently active TCP connection");
+            delete openAPI[stalest];
+            openAPI[stalest] = NULL;
+            freeSlot = stalest;
         }
 
-        openAPI = new T(client);
+        openAPI[freeSlot] = new T(client);
     }
 
 #if RAK_4631
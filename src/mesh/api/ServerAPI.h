@@ -1,9 +1,23 @@
 #pragma once
 
+#include "PhonePacketFanout.h"
 #include "StreamAPI.h"
 
 #define SERVER_API_DEFAULT_PORT 4403
 
+/// How many TCP API clients may be connected at once
+#ifndef MAX_API_CLIENTS
+#if defined(ARCH_PORTDUINO)
+#define MAX_API_CLIENTS 8
+#elif defined(ARCH_ESP32)
+#define MAX_API_CLIENTS 4
+#else
+#define MAX_API_CLIENTS 2
+#endif
+#endif
+
+static_assert(MAX_API_CLIENTS <= PHONE_FANOUT_MAX_READERS, "Every API session needs its own phone packet reader");
+
 /**
  * Provides both debug printing and, if the client starts sending protobufs to us, switches to send/receive protobufs
  * (and starts dropping debug printing - FIXME, eventually those prints should be encapsulated in protobufs).
@@ -13,6 +27,12 @@ template <class T> class ServerAPI : public StreamAPI, private concurrency::OSTh
   private:
     T client;
 
+    /// Our position in the packet stream shared with the other API sessions
+    PhonePacketReader packetReader;
+
+    /// The shared packet currently sitting in packetForPhone, if any
+    meshtastic_MeshPacket *fanoutPacket = NULL;
+
   public:
     explicit ServerAPI(T &_client);
 
@@ -21,6 +41,12 @@ template <class T> class ServerAPI : public StreamAPI, private concurrency::OSTh
     /// override close to also shutdown the TCP link
     virtual void close();
 
+    /// Return false once the client has dropped the connection and this session can be deleted
+    bool isOpen() { return enabled; }
+
+    /// The last msec we heard from the client, used to pick a session to evict when all slots are busy
+    uint32_t getLastContactMsec() const { return lastContactMsec; }
+
   protected:
     /// We override this method to prevent publishing EVENT_SERIAL_CONNECTED/DISCONNECTED for wifi links (we want the board to
     /// stay in the POWERED state to prevent disabling wifi)
@@ -30,19 +56,23 @@ template <class T> class ServerAPI : public StreamAPI, private concurrency::OSTh
 
     /// Check the current underlying physical link to see if the client is currently connected
     virtual bool checkIsConnected() override;
+
+    /// Read packets from the fanout so every connected client sees every packet
+    virtual meshtastic_MeshPacket *getPacketForPhone() override;
+
+    virtual void releasePacketForPhone(meshtastic_MeshPacket *p) override;
 };
 
 /**
  * Listens for incoming connections and does accepts and creates instances of ServerAPI as needed
+ *
+ * Each connection is its own ServerAPI thread, so up to MAX_API_CLIENTS clients can be served at once.  When all slots are
+ * busy the least recently active client is closed to make room for the new one.
  */
 template <class T, class U> class APIServerPort : public U, private concurrency::OSThread
 {
-    /** The currently open port
-     *
-     * FIXME: We currently only allow one open TCP connection at a time, because we depend on the loop() call in this class to
-     * delegate to the worker.  Once coroutines are implemented we can relax this restriction.
-     */
-    T *openAPI = NULL;
+    /** The currently open sessions, NULL for free slots */
+    T *openAPI[MAX_API_CLIENTS] = {};
 #if defined(RAK_4631) || defined(RAK11310)
     // Track wait time for RAK13800 Ethernet requests
     int32_t waitTime = 100;
@@ -0,0 +1,201 @@
+#include "WebsocketAPI.h"
+#if !MESHTASTIC_EXCLUDE_WEBSERVER && (defined(ARCH_ESP32) || defined(ARCH_PORTDUINO))
+#include "ServerAPI.h"
+#include "concurrency/OSThread.h"
+#include "serialization/JSON.h"
+
+static_assert(MAX_API_CLIENTS + MAX_WEBSOCKET_CLIENTS <= PHONE_FANOUT_MAX_READERS,
+              "Every API session needs its own phone packet reader");
+
+/// How often to look for new frames while clients are connected, and while none are
+#define PUMP_INTERVAL_MS 5
+#define IDLE_INTERVAL_MS 50
+
+HttpAPIStats httpAPIStats;
+
+JSONValue *httpAPIStatsToJson()
+{
+    JSONObject jsonObj;
+    jsonObj["polls"] = new JSONValue((int)httpAPIStats.polls);
+    jsonObj["empty_polls"] = new JSONValue((int)httpAPIStats.emptyPolls);
+    jsonObj["poll_frames"] = new JSONValue((int)httpAPIStats.pollFrames);
+    jsonObj["poll_ms"] = new JSONValue((int)(httpAPIStats.pollUsec / 1000));
+    jsonObj["stream_clients"] = new JSONValue((int)httpAPIStats.streamClients);
+    jsonObj["stream_sessions"] = new JSONValue((int)httpAPIStats.streamSessions);
+    jsonObj["stream_frames"] = new JSONValue((int)httpAPIStats.streamFrames);
+    jsonObj["stream_overruns"] = new JSONValue((int)httpAPIStats.streamOverruns);
+    jsonObj["stream_ms"] = new JSONValue((int)(httpAPIStats.streamUsec / 1000));
+    return new JSONValue(jsonObj);
+}
+
+std::recursive_mutex WebsocketAPI::lock;
+WebsocketAPI *WebsocketAPI::sessions[MAX_WEBSOCKET_CLIENTS];
+
+/// Runs WebsocketAPI::pump() for every session on the main loop, and deletes the sessions whose connection went away
+class WebsocketAPIPump : private concurrency::OSThread
+{
+  public:
+    WebsocketAPIPump() : concurrency::OSThread("WebsocketAPI") {}
+
+    void wake() { setIntervalFromNow(0); }
+
+  protected:
+    virtual int32_t runOnce() override
+    {
+        std::vector<WebsocketAPI *> gone;
+        WebsocketAPI *open[MAX_WEBSOCKET_CLIENTS];
+        uint32_t numOpen = 0;
+        {
+            std::lock_guard<std::recursive_mutex> guard(WebsocketAPI::lock);
+            for (auto &session : WebsocketAPI::sessions) {
+                if (!session)
+                    continue;
+                if (!session->connected) {
+                    gone.push_back(session);
+                    session = NULL;
+                    continue;
+                }
+                open[numOpen++] = session;
+            }
+        }
+        httpAPIStats.streamClients = numOpen;
+        for (WebsocketAPI *session : gone)
+            delete session;
+
+        // Only we delete sessions, so the snapshot stays valid without the lock even if a client goes away meanwhile
+        bool more = false;
+        for (uint32_t i = 0; i < numOpen; i++)
+            more |= open[i]->pump();
+
+        if (more)
+            return 0; // Rest of a config download, let the other threads run and come straight back
+        return numOpen ? PUMP_INTERVAL_MS : IDLE_INTERVAL_MS;
+    }
+};
+
+static WebsocketAPIPump *websocketAPIPump;
+
+void initWebsocketAPI()
+{
+    if (!websocketAPIPump)
+        websocketAPIPump = new WebsocketAPIPump();
+}
+
+WebsocketAPI::WebsocketAPI() {}
+
+WebsocketAPI::~WebsocketAPI()
+{
+    close(); // must run here, the PhoneAPI destructor would hand our shared packet straight back to the pool
+    phonePacketFanout.detach(&packetReader);
+    fanoutPacket = NULL;
+}
+
+bool WebsocketAPI::add(WebsocketAPI *session)
+{
+    std::lock_guard<std::recursive_mutex> guard(lock);
+    for (auto &s : sessions) {
+        if (!s) {
+            s = session;
+            httpAPIStats.streamSessions++;
+            LOG_INFO("Incoming WebSocket API connection");
+            return true;
+        }
+    }
+    LOG_WARN("All %d WebSocket API slots busy, refuse connection", MAX_WEBSOCKET_CLIENTS);
+    return false;
+}
+
+bool WebsocketAPI::hasRoom()
+{
+    std::lock_guard<std::recursive_mutex> guard(lock);
+    for (auto &s : sessions) {
+        if (!s)
+            return true;
+    }
+    return false;
+}
+
+bool WebsocketAPI::queueToRadio(const uint8_t *buf, size_t len)
+{
+    std::lock_guard<std::recursive_mutex> guard(lock);
+    if (!connected || inbound.size() >= WEBSOCKET_MAX_INBOUND || len > MAX_TO_FROM_RADIO_SIZE)
+        return false;
+    inbound.emplace_back(buf, buf + len);
+    return true;
+}
+
+void WebsocketAPI::disconnect()
+{
+    std::lock_guard<std::recursive_mutex> guard(lock);
+    if (connected)
+        LOG_INFO("WebSocket API client disconnected");
+    connected = false;
+    dropConnection();
+}
+
+void WebsocketAPI::onNowHasData(uint32_t fromRadioNum)
+{
+    if (websocketAPIPump)
+        websocketAPIPump->wake();
+}
+
+meshtastic_MeshPacket *WebsocketAPI::getPacketForPhone()
+{
+    if (!packetReader.attached && !packetReader.overrun)
+        phonePacketFanout.attach(&packetReader);
+
+    fanoutPacket = phonePacketFanout.peek(&packetReader);
+    return fanoutPacket;
+}
+
+void WebsocketAPI::releasePacketForPhone(meshtastic_MeshPacket *p)
+{
+    if (p == fanoutPacket) {
+        phonePacketFanout.advance(&packetReader);
+        fanoutPacket = NULL;
+    } else {
+        PhoneAPI::releasePacketForPhone(p); // e.g. from StoreForward, which is ours alone
+    }
+}
+
+bool WebsocketAPI::pump()
+{
+    if (closing)
+        return false;
+    if (packetReader.overrun) {
+        LOG_WARN("WebSocket API client too slow to keep up with packets, close it");
+        httpAPIStats.streamOverruns++;
+        closing = true;
+        close();
+        closeConnection();
+        return false;
+    }
+
+    uint32_t start = micros();
+    std::deque<std::vector<uint8_t>> toRadio;
+    {
+        std::lock_guard<std::recursive_mutex> guard(lock);
+        toRadio.swap(inbound);
+    }
+    bool busy = !toRadio.empty();
+    // ToRadio first, so the answer to a want_config starts going out in this same pump
+    for (auto &msg : toRadio)
+        handleToRadio(msg.data(), msg.size());
+
+    static uint8_t txBuf[MAX_TO_FROM_RADIO_SIZE];
+    int sent = 0;
+    while (sent < WEBSOCKET_FRAMES_PER_PUMP && canSend()) {
+        size_t len = getFromRadio(txBuf);
+        if (!len)
+            break;
+        if (!sendFrame(txBuf, len))
+            break;
+        sent++;
+    }
+    httpAPIStats.streamFrames += sent;
+    if (busy || sent)
+        httpAPIStats.streamUsec += micros() - start;
+    return sent == WEBSOCKET_FRAMES_PER_PUMP;
+}
+
+#endif
@@ -0,0 +1,144 @@
+#pragma once
+
+#include "configuration.h"
+#if !MESHTASTIC_EXCLUDE_WEBSERVER && (defined(ARCH_ESP32) || defined(ARCH_PORTDUINO))
+
+#include "PhoneAPI.h"
+#include "PhonePacketFanout.h"
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+/// How many WebSocket API clients may be connected at once
+#ifndef MAX_WEBSOCKET_CLIENTS
+#define MAX_WEBSOCKET_CLIENTS 4
+#endif
+
+/// Most FromRadio frames pushed to one client per pump, so a client being sent the whole node database doesn't hold up the
+/// others or the main loop
+#ifndef WEBSOCKET_FRAMES_PER_PUMP
+#define WEBSOCKET_FRAMES_PER_PUMP 8
+#endif
+
+/// ToRadio messages a client may have waiting for the next pump, more are dropped
+#ifndef WEBSOCKET_MAX_INBOUND
+#define WEBSOCKET_MAX_INBOUND 8
+#endif
+
+/// FromRadio frames a client may have waiting for a web server that sends on a thread of its own, the pump holds back the
+/// rest until there is room
+#ifndef WEBSOCKET_MAX_OUTBOUND
+#define WEBSOCKET_MAX_OUTBOUND 16
+#endif
+
+/// Counters to compare polling /api/v1/fromradio with streaming over /api/v1/stream.  The Linux web server counts polls on
+/// its own threads, so they are atomic.
+struct HttpAPIStats {
+    std::atomic<uint32_t> polls;          // GETs of /api/v1/fromradio
+    std::atomic<uint32_t> emptyPolls;     // ... that had nothing to return
+    std::atomic<uint32_t> pollFrames;     // FromRadio returned by polls
+    std::atomic<uint64_t> pollUsec;       // Time spent answering polls
+    std::atomic<uint32_t> streamClients;  // WebSocket clients connected now
+    std::atomic<uint32_t> streamSessions; // WebSocket clients since boot
+    std::atomic<uint32_t> streamFrames;   // FromRadio pushed to WebSocket clients
+    std::atomic<uint32_t> streamOverruns; // WebSocket clients closed for falling behind
+    std::atomic<uint64_t> streamUsec;     // Time spent pushing frames and handling ToRadio from WebSocket clients
+};
+
+extern HttpAPIStats httpAPIStats;
+
+class JSONValue;
+
+/// httpAPIStats as the "http_api" object of the web servers' /json/report, the caller owns it
+JSONValue *httpAPIStatsToJson();
+
+/**
+ * The phone API over a WebSocket: every FromRadio is pushed to the client as one binary message as soon as PhoneAPI has it,
+ * and every binary message from the client is a ToRadio.  This saves a client polling /api/v1/fromradio (and the latency of
+ * the poll interval, and a request per frame).
+ *
+ * The web servers subclass this for their WebSocket library.  The library may run on a thread of its own, so messages from
+ * the client are only queued there.  The pump runs on the main loop like the other PhoneAPIs, it handles them and pushes
+ * whatever PhoneAPI has, a few frames per client at a time.  The shared lock only covers the session table, the queued
+ * ToRadio and the connection state: the pump takes a snapshot of the sessions under it, then encodes and sends outside it,
+ * so a slow client never stalls the web server's threads.
+ *
+ * Packets come from phonePacketFanout like for the TCP API, so each client sees every packet.  A client is only handed frames
+ * as fast as they are sent to it.  One that falls a whole fanout ring behind is closed.
+ *
+ * Sessions are owned by pumpAll(): once the web server reports the connection gone with disconnect(), the next pump deletes
+ * the session.
+ */
+class WebsocketAPI : public PhoneAPI
+{
+  public:
+    virtual ~WebsocketAPI();
+
+    /// Start serving session, from any thread.  @return false (and the caller still owns session) if all slots are busy
+    static bool add(WebsocketAPI *session);
+
+    /// Whether add() would find a free slot
+    static bool hasRoom();
+
+    /// Queue a ToRadio from the client, from any thread.  @return false if too many are waiting
+    bool queueToRadio(const uint8_t *buf, size_t len);
+
+    /// The web server's connection went away, from any thread.  Nothing is sent after this returns
+    void disconnect();
+
+  protected:
+    WebsocketAPI();
+
+    /// Send (or queue) one FromRadio as a binary message, called without the session lock.  @return false if the connection
+    /// is gone
+    virtual bool sendFrame(const uint8_t *buf, size_t len) = 0;
+
+    /// Whether sendFrame() would take another frame now, the pump leaves the rest with PhoneAPI until it does
+    virtual bool canSend() { return true; }
+
+    /// Ask the web server to close the connection, it calls disconnect() once it has
+    virtual void closeConnection() = 0;
+
+    /// Forget the web server's connection, called by disconnect() with the session lock held
+    virtual void dropConnection() = 0;
+
+    virtual bool checkIsConnected() override { return connected; }
+
+    /// Like ServerAPI, don't publish EVENT_SERIAL_CONNECTED/DISCONNECTED for a network client
+    virtual void onConnectionChanged(bool connected) override {}
+
+    /// Wake the pump, so a new packet goes out now rather than on the next poll
+    virtual void onNowHasData(uint32_t fromRadioNum) override;
+
+    virtual meshtastic_MeshPacket *getPacketForPhone() override;
+
+    virtual void releasePacketForPhone(meshtastic_MeshPacket *p) override;
+
+  private:
+    friend class WebsocketAPIPump;
+
+    /// Our position in the packet stream shared with the other API sessions
+    PhonePacketReader packetReader;
+
+    /// The shared packet currently sitting in packetForPhone, if any
+    meshtastic_MeshPacket *fanoutPacket = NULL;
+
+    std::deque<std::vector<uint8_t>> inbound;
+
+    volatile bool connected = true;
+
+    /// Closed for falling behind, waiting for the web server to finish closing it
+    bool closing = false;
+
+    /// Handle the queued ToRadio and send up to WEBSOCKET_FRAMES_PER_PUMP frames.  @return true if there may be more to send
+    bool pump();
+
+    static std::recursive_mutex lock;
+    static WebsocketAPI *sessions[MAX_WEBSOCKET_CLIENTS];
+};
+
+/// Start the thread that pumps the WebSocket sessions, call once when the web server starts
+void initWebsocketAPI();
+
+#endif
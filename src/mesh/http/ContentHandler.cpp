@@ -1,9 +1,13 @@
 #if !MESHTASTIC_EXCLUDE_WEBSERVER
+#include "MeshModule.h"
 #include "NodeDB.h"
 #include "PowerFSM.h"
 #include "RadioLibInterface.h"
+#include "Router.h"
 #include "airtime.h"
 #include "main.h"
+#include "mesh/StaticAssetManifest.h"
+#include "mesh/api/WebsocketAPI.h"
 #include "mesh/http/ContentHelper.h"
 #include "mesh/http/WebServer.h"
 #if HAS_WIFI
@@ -41,11 +45,14 @@
 #include <HTTPSServer.hpp>
 #include <HTTPServer.hpp>
 #include <SSLCert.hpp>
+#include <WebsocketHandler.hpp>
+#include <WebsocketNode.hpp>
 
 // The HTTPS Server comes in a separate namespace. For easier use, include it here.
 using namespace httpsserver;
 
 #include "mesh/http/ContentHandler.h"
+#include <sstream>
 
 #include <HTTPClient.h>
 #include <WiFiClientSecure.h>
@@ -62,11 +69,87 @@ char contentTypes[][2][32] = {{".txt", "text/plain"},     {".html", "text/html"}
                               {".css", "text/css"},       {".ico", "image/vnd.microsoft.icon"},
                               {".svg", "image/svg+xml"},  {"", ""}};
 
+/// Files are read and sent in chunks of this size, one buffer is enough as the server handles one request at a time
+#ifndef STATIC_ASSET_CHUNK
+#define STATIC_ASSET_CHUNK 2048
+#endif
+static uint8_t staticChunk[STATIC_ASSET_CHUNK];
+
 // const char *certificate = NULL; // change this as needed, leave as is for no TLS check (yolo security)
 
 // Our API to handle messages to and from the radio.
 HttpAPI webAPI;
 
+/// A WebsocketAPI session on a WebSocket of the https server, which owns the handler.  The server runs on the main loop
+/// like the pump, so the handler can be used without the session lock
+class WebsocketStreamAPI : public WebsocketAPI
+{
+  public:
+    explicit WebsocketStreamAPI(WebsocketHandler *_handler) : handler(_handler) {}
+
+  protected:
+    virtual bool sendFrame(const uint8_t *buf, size_t len) override
+    {
+        if (!handler)
+            return false;
+        handler->send((uint8_t *)buf, len, WebsocketHandler::SEND_TYPE_BINARY);
+        return true;
+    }
+
+    virtual void closeConnection() override
+    {
+        if (handler)
+            handler->close();
+    }
+
+    virtual void dropConnection() override { handler = NULL; }
+
+  private:
+    WebsocketHandler *handler;
+};
+
+/// Created by the server for every connection to /api/v1/stream
+class WebsocketStreamHandler : public WebsocketHandler
+{
+  public:
+    static WebsocketHandler *create() { return new WebsocketStreamHandler(); }
+
+    WebsocketStreamHandler() : session(new WebsocketStreamAPI(this))
+    {
+        if (!WebsocketAPI::add(session)) {
+            delete session;
+            session = NULL;
+        }
+    }
+
+    virtual ~WebsocketStreamHandler() { onClose(); }
+
+    virtual void onMessage(WebsocketInputStreambuf *input) override
+    {
+        std::ostringstream ss;
+        ss << input;
+        std::string msg = ss.str();
+        if (!session) {
+            close(); // There was no free slot for it
+        } else if (!session->queueToRadio((const uint8_t *)msg.data(), msg.size())) {
+            LOG_WARN("WebSocket API client sends faster than we handle it, drop ToRadio");
+        }
+    }
+
+    virtual void onClose() override
+    {
+        // The session is deleted by the WebsocketAPI pump
+        if (session)
+            session->disconnect();
+        session = NULL;
+    }
+
+  private:
+    WebsocketAPI *session;
+};
+
+static void buildStaticAssets();
+
 void registerHandlers(HTTPServer *insecureServer, HTTPSServer *secureServer)
 {
 
@@ -77,6 +160,7 @@ void registerHandlers(HTTPServer *insecureServer, HTTPSServer *secureServer)
     ResourceNode *nodeAPIv1ToRadio = new ResourceNode("/api/v1/toradio", "PUT", &handleAPIv1ToRadio);
     ResourceNode *nodeAPIv1FromRadioOptions = new ResourceNode("/api/v1/fromradio", "OPTIONS", &handleAPIv1FromRadio);
     ResourceNode *nodeAPIv1FromRadio = new ResourceNode("/api/v1/fromradio", "GET", &handleAPIv1FromRadio);
+    WebsocketNode *nodeAPIv1Stream = new WebsocketNode("/api/v1/stream", &WebsocketStreamHandler::create);
 
     //    ResourceNode *nodeHotspotApple = new ResourceNode("/hotspot-detect.html", "GET", &handleHotspot);
     //    ResourceNode *nodeHotspotAndroid = new ResourceNode("/generate_204", "GET", &handleHotspot);
@@ -105,6 +189,7 @@ void registerHandlers(HTTPServer *insecureServer, HTTPSServer *secureServer)
     secureServer->registerNode(nodeAPIv1ToRadio);
     secureServer->registerNode(nodeAPIv1FromRadioOptions);
     secureServer->registerNode(nodeAPIv1FromRadio);
+    secureServer->registerNode(nodeAPIv1Stream);
     //    secureServer->registerNode(nodeHotspotApple);
     //    secureServer->registerNode(nodeHotspotAndroid);
     secureServer->registerNode(nodeRestart);
@@ -128,6 +213,7 @@ void registerHandlers(HTTPServer *insecureServer, HTTPSServer *secureServer)
     insecureServer->registerNode(nodeAPIv1ToRadio);
     insecureServer->registerNode(nodeAPIv1FromRadioOptions);
     insecureServer->registerNode(nodeAPIv1FromRadio);
+    insecureServer->registerNode(nodeAPIv1Stream);
     //    insecureServer->registerNode(nodeHotspotApple);
     //    insecureServer->registerNode(nodeHotspotAndroid);
     insecureServer->registerNode(nodeRestart);
@@ -144,6 +230,9 @@ void registerHandlers(HTTPServer *insecureServer, HTTPSServer *secureServer)
     //    insecureServer->registerNode(nodeAdminSettings);
     //    insecureServer->registerNode(nodeAdminSettingsApply);
     insecureServer->registerNode(nodeRoot); // This has to be last
+
+    concurrency::LockGuard g(spiLock);
+    buildStaticAssets();
 }
 
 void handleAPIv1FromRadio(HTTPRequest *req, HTTPResponse *res)
@@ -177,6 +266,8 @@ void handleAPIv1FromRadio(HTTPRequest *req, HTTPResponse *res)
 
     uint8_t txBuf[MAX_STREAM_BUF_SIZE];
     uint32_t len = 1;
+    uint32_t start = micros();
+    uint32_t frames = 0;
 
     if (params->getQueryParameter("all", valueAll)) {
 
@@ -186,20 +277,27 @@ void handleAPIv1FromRadio(HTTPRequest *req, HTTPResponse *res)
             while (len) {
                 len = webAPI.getFromRadio(txBuf);
                 res->write(txBuf, len);
+                frames += len != 0;
             }
 
             // Otherwise, just return one protobuf
         } else {
             len = webAPI.getFromRadio(txBuf);
             res->write(txBuf, len);
+            frames += len != 0;
         }
 
         // the param "all" was not specified. Return just one protobuf
     } else {
         len = webAPI.getFromRadio(txBuf);
         res->write(txBuf, len);
+        frames += len != 0;
     }
 
+    httpAPIStats.polls++;
+    httpAPIStats.emptyPolls += frames == 0;
+    httpAPIStats.pollFrames += frames;
+    httpAPIStats.pollUsec += micros() - start;
     LOG_DEBUG("webAPI handleAPIv1FromRadio, len %d", len);
 }
 
@@ -356,6 +454,7 @@ void handleFsDeleteStatic(HTTPRequest *req, HTTPResponse *res)
     if (params->getQueryParameter("delete", paramValDelete)) {
         std::string pathDelete = "/" + paramValDelete;
         concurrency::LockGuard g(spiLock);
+        staticAssets.clear();
         if (FSCom.remove(pathDelete.c_str())) {
 
             LOG_INFO("%s", pathDelete.c_str());
@@ -378,6 +477,49 @@ void handleFsDeleteStatic(HTTPRequest *req, HTTPResponse *res)
     }
 }
 
+/// Walk /static and hash every file into staticAssets, with spiLock held
+static void buildStaticAssets()
+{
+    uint32_t start = millis();
+    staticAssets.clear();
+    for (const meshtastic_FileInfo &info : getFiles("/static", 10)) {
+        if (strncmp(info.file_name, "/static/", 8) != 0)
+            continue;
+        File file = FSCom.open(info.file_name, FILE_O_READ);
+        if (!file)
+            continue;
+        StaticAssetHasher hasher;
+        size_t length;
+        while ((length = file.read(staticChunk, sizeof(staticChunk))) > 0)
+            hasher.update(staticChunk, length);
+        file.close();
+        esp_task_wdt_reset();
+
+        if (!staticAssets.add(info.file_name + 8, info.file_name, info.size, hasher.get())) {
+            LOG_WARN("More than %d files in /static, serve the rest without ETag", STATIC_ASSET_MAX_FILES);
+            break;
+        }
+    }
+    staticAssets.setBuilt(millis() - start);
+    LOG_INFO("Static asset manifest: %u files hashed in %u ms", (unsigned)staticAssets.getFileCount(),
+             staticAssets.getBuildMsec());
+}
+
+/// A file the manifest had no room for, sent like before: without a validator
+static bool findUnlistedAsset(const std::string &name, StaticAsset &asset)
+{
+    for (bool gzip : {false, true}) {
+        std::string path = "/static/" + name + (gzip ? ".gz" : "");
+        if (FSCom.exists(path.c_str())) {
+            File file = FSCom.open(path.c_str(), FILE_O_READ);
+            asset = {path, (uint32_t)file.size(), "", gzip, false};
+            file.close();
+            return true;
+        }
+    }
+    return false;
+}
+
 void handleStatic(HTTPRequest *req, HTTPResponse *res)
 {
     // Get access to the parameters
@@ -386,57 +528,72 @@ void handleStatic(HTTPRequest *req, HTTPResponse *res)
     std::string parameter1;
     // Print the first parameter value
     if (params->getPathParameter(0, parameter1)) {
-
-        std::string filename = "/static/" + parameter1;
-        std::string filenameGzip = "/static/" + parameter1 + ".gz";
-
-        // Try to open the file
-        File file;
-
+        uint32_t start = micros();
+        std::string name = parameter1.empty() ? "index.html" : parameter1;
+        bool acceptGzip = StaticAssetManifest::acceptsGzip(req->getHeader("Accept-Encoding").c_str());
         bool has_set_content_type = false;
 
-        if (filename == "/static/") {
-            filename = "/static/index.html";
-            filenameGzip = "/static/index.html.gz";
-        }
-
         concurrency::LockGuard g(spiLock);
+        if (!staticAssets.isBuilt())
+            buildStaticAssets();
 
-        if (FSCom.exists(filename.c_str())) {
-            file = FSCom.open(filename.c_str());
-            if (!file.available()) {
-                LOG_WARN("File not available - %s", filename.c_str());
+        StaticAsset asset;
+        File file;
+        for (int attempt = 0;; attempt++) {
+            has_set_content_type = false;
+            bool found = staticAssets.find(name, acceptGzip, asset);
+            if (!found && staticAssets.getFileCount() >= STATIC_ASSET_MAX_FILES)
+                found = findUnlistedAsset(name, asset);
+            if (!found) {
+                // Anything else gets the web client, which has routes of its own
+                has_set_content_type = true;
+                res->setHeader("Content-Type", "text/html");
+                found = staticAssets.find("index.html", acceptGzip, asset);
             }
-        } else if (FSCom.exists(filenameGzip.c_str())) {
-            file = FSCom.open(filenameGzip.c_str());
-            res->setHeader("Content-Encoding", "gzip");
-            if (!file.available()) {
-                LOG_WARN("File not available - %s", filenameGzip.c_str());
+            if (found) {
+                file = FSCom.open(asset.file.c_str(), FILE_O_READ);
+                // XModem and AdminMessage can change /static behind the manifest's back
+                if (file && file.size() == asset.size)
+                    break;
+                if (file)
+                    file.close();
             }
-        } else {
-            has_set_content_type = true;
-            filenameGzip = "/static/index.html.gz";
-            file = FSCom.open(filenameGzip.c_str());
-            res->setHeader("Content-Type", "text/html");
-            if (!file.available()) {
-
-                LOG_WARN("File not available - %s", filenameGzip.c_str());
+            if (!found || attempt > 0) {
+                LOG_WARN("File not available - /static/%s", name.c_str());
+                res->setHeader("Content-Type", "text/html");
                 res->println("Web server is running.<br><br>The content you are looking for can't be found. Please see: <a "
                              "href=https://meshtastic.org/docs/software/web-client/>FAQ</a>.<br><br><a "
                              "href=/admin>admin</a>");
+                staticAssets.count(NULL, false, 0, micros() - start);
+                return;
+            }
+            LOG_DEBUG("Static %s changed since the manifest was built, rebuild it", asset.file.c_str());
+            buildStaticAssets();
+        }
 
+        res->setHeader("Cache-Control", StaticAssetManifest::cacheControl(asset));
+        res->setHeader("Vary", "Accept-Encoding");
+        if (asset.etag[0]) {
+            res->setHeader("ETag", asset.etag);
+            if (StaticAssetManifest::etagMatches(req->getHeader("If-None-Match").c_str(), asset.etag)) {
+                // The browser has this very version already
+                file.close();
+                res->setStatusCode(304);
+                res->setStatusText("Not Modified");
+                staticAssets.count(&asset, true, 0, micros() - start);
                 return;
-            } else {
-                res->setHeader("Content-Encoding", "gzip");
             }
         }
 
-        res->setHeader("Content-Length", httpsserver::intToString(file.size()));
+        if (asset.gzip) {
+            res->setHeader("Content-Encoding", "gzip");
+        }
+        res->setHeader("Content-Length", httpsserver::intToString(asset.size));
 
         // Content-Type is guessed using the definition of the contentTypes-table defined above
         int cTypeIdx = 0;
         do {
-            if (filename.rfind(contentTypes[cTypeIdx][0]) != std::string::npos) {
+            if (!has_set_content_type && name.rfind(contentTypes[cTypeIdx][0]) != std::string::npos) {
                 res->setHeader("Content-Type", contentTypes[cTypeIdx][1]);
                 has_set_content_type = true;
                 break;
@@ -451,14 +608,16 @@ void handleStatic(HTTPRequest *req, HTTPResponse *res)
 
         // Read the file and write it to the HTTP response body
         size_t length = 0;
-        do {
-            char buffer[256];
-            length = file.read((uint8_t *)buffer, 256);
-            std::string bufferString(buffer, length);
-            res->write((uint8_t *)bufferString.c_str(), bufferString.size());
-        } while (length > 0);
+        uint32_t sent = 0;
+        while ((length = file.read(staticChunk, sizeof(staticChunk))) > 0) {
+            res->write(staticChunk, length);
+            sent += length;
+        }
 
         file.close();
+        staticAssets.count(&asset, false, sent, micros() - start);
+        LOG_DEBUG("Static %s: %s, %u bytes in %u ms", name.c_str(), asset.file.c_str(), (unsigned)sent,
+                  (unsigned)((micros() - start) / 1000));
 
         return;
     } else {
@@ -546,6 +705,7 @@ void handleFormUpload(HTTPRequest *req, HTTPResponse *res)
         std::string pathname = "/static/" + filename;
 
         concurrency::LockGuard g(spiLock);
+        staticAssets.clear(); // Rebuilt with the new file on the next request
         // Create a new file to stream the data into
         File file = FSCom.open(pathname.c_str(), FILE_O_WRITE);
         size_t fileLength = 0;
@@ -592,6 +752,15 @@ void handleFormUpload(HTTPRequest *req, HTTPResponse *res)
     delete parser;
 }
 
+/// Bucket counts of a Log2Histogram, bucket i counts values up to 2^i - 1
+template <uint8_t N> static JSONValue *histogramToJson(const Log2Histogram<N> &histogram)
+{
+    JSONArray counts;
+    for (uint8_t i = 0; i < N; i++)
+        counts.push_back(new JSONValue((int)histogram.getCount(i)));
+    return new JSONValue(counts);
+}
+
 void handleReport(HTTPRequest *req, HTTPResponse *res)
 {
     ResourceParameters *params = req->getParams();
@@ -632,6 +801,25 @@ void handleReport(HTTPRequest *req, HTTPResponse *res)
         rxAllLogValues.push_back(new JSONValue((int)logArray[i]));
     }
 
+    // data->airtime->top_nodes and top_portnums, airtime over the last hour
+    AirtimeShare shares[AIRTIME_TRACKED_NODES];
+    JSONArray topNodes;
+    size_t numShares = airTime->getTopNodes(shares, AIRTIME_TRACKED_NODES);
+    for (size_t i = 0; i < numShares; i++) {
+        JSONObject share;
+        share["node"] = new JSONValue((unsigned int)shares[i].key);
+        share["airtime_ms"] = new JSONValue((int)shares[i].msec);
+        topNodes.push_back(new JSONValue(share));
+    }
+    JSONArray topPortnums;
+    numShares = airTime->getTopPortnums(shares, AIRTIME_TRACKED_NODES);
+    for (size_t i = 0; i < numShares; i++) {
+        JSONObject share;
+        share["portnum"] = new JSONValue((int)shares[i].key);
+        share["airtime_ms"] = new JSONValue((int)shares[i].msec);
+        topPortnums.push_back(new JSONValue(share));
+    }
+
     // data->airtime
     JSONObject jsonObjAirtime;
     jsonObjAirtime["tx_log"] = new JSONValue(txLogValues);
@@ -642,6 +830,8 @@ void handleReport(HTTPRequest *req, HTTPResponse *res)
     jsonObjAirtime["seconds_since_boot"] = new JSONValue(int(airTime->getSecondsSinceBoot()));
     jsonObjAirtime["seconds_per_period"] = new JSONValue(int(airTime->getSecondsPerPeriod()));
     jsonObjAirtime["periods_to_log"] = new JSONValue(airTime->getPeriodsToLog());
+    jsonObjAirtime["top_nodes"] = new JSONValue(topNodes);
+    jsonObjAirtime["top_portnums"] = new JSONValue(topPortnums);
 
     // data->wifi
     JSONObject jsonObjWifi;
@@ -677,6 +867,61 @@ void handleReport(HTTPRequest *req, HTTPResponse *res)
     jsonObjRadio["frequency"] = new JSONValue(RadioLibInterface::instance->getFreq());
     jsonObjRadio["lora_channel"] = new JSONValue((int)RadioLibInterface::instance->getChannelNum() + 1);
 
+    // data->threads
+    JSONArray jsonThreads;
+    for (int i = 0; i < MAX_THREADS; i++) {
+        auto thread = static_cast<concurrency::OSThread *>(concurrency::mainController.get(i));
+        if (thread == nullptr)
+            continue;
+        const concurrency::OSThreadStats &stats = thread->getStats();
+        JSONObject jsonObjThread;
+        jsonObjThread["name"] = new JSONValue(thread->ThreadName.c_str());
+        jsonObjThread["enabled"] = new JSONValue(BoolToString(thread->enabled));
+        jsonObjThread["runs"] = new JSONValue((int)stats.runs);
+        jsonObjThread["overruns"] = new JSONValue((int)stats.overruns);
+        jsonObjThread["max_run_us"] = new JSONValue((int)stats.maxRunUsec);
+        jsonObjThread["total_run_ms"] = new JSONValue((int)(stats.totalRunUsec / 1000));
+        jsonThreads.push_back(new JSONValue(jsonObjThread));
+    }
+
+    // data->router
+    JSONObject jsonObjRouter;
+    if (router) {
+        const RouterRxStats &rxStats = router->getRxStats();
+        jsonObjRouter["rx_batches"] = new JSONValue((int)rxStats.batches);
+        jsonObjRouter["rx_queue_depth"] = histogramToJson(rxStats.queueDepth);
+        jsonObjRouter["rx_screen_us"] = histogramToJson(rxStats.screenUsec);
+        jsonObjRouter["rx_decode_us"] = histogramToJson(rxStats.decodeUsec);
+        jsonObjRouter["rx_dispatch_us"] = histogramToJson(rxStats.dispatchUsec);
+        jsonObjRouter["rx_batch_modules_us"] = histogramToJson(rxStats.batchUsec);
+    }
+
+    // data->modules, the ones that spent the most time handling received packets first
+    JSONArray jsonModules;
+    std::vector<const MeshModule *> busiestModules(MeshModule::getNumModules());
+    size_t numModules = MeshModule::getBusiestModules(busiestModules.data(), busiestModules.size());
+    for (size_t i = 0; i < numModules; i++) {
+        const MeshModuleStats &stats = busiestModules[i]->getStats();
+        JSONObject jsonObjModule;
+        jsonObjModule["name"] = new JSONValue(busiestModules[i]->getName());
+        jsonObjModule["calls"] = new JSONValue((int)stats.calls);
+        jsonObjModule["max_handle_us"] = new JSONValue((int)stats.maxUsec);
+        jsonObjModule["total_handle_ms"] = new JSONValue((int)(stats.totalUsec / 1000));
+        jsonModules.push_back(new JSONValue(jsonObjModule));
+    }
+
+    // data->static_assets, what the ETags and the .gz files save on loading the web client
+    StaticAssetStats staticStats = staticAssets.getStats();
+    JSONObject jsonObjStatic;
+    jsonObjStatic["files"] = new JSONValue((int)staticAssets.getFileCount());
+    jsonObjStatic["manifest_ms"] = new JSONValue((int)staticAssets.getBuildMsec());
+    jsonObjStatic["requests"] = new JSONValue((int)staticStats.requests);
+    jsonObjStatic["not_modified"] = new JSONValue((int)staticStats.notModified);
+    jsonObjStatic["not_found"] = new JSONValue((int)staticStats.notFound);
+    jsonObjStatic["gzip_sent"] = new JSONValue((int)staticStats.gzipSent);
+    jsonObjStatic["kb_sent"] = new JSONValue((int)(staticStats.bytesSent / 1024));
+    jsonObjStatic["send_ms"] = new JSONValue((int)(staticStats.sendUsec / 1000));
+
     // collect data to inner data object
     JSONObject jsonObjInner;
     jsonObjInner["airtime"] = new JSONValue(jsonObjAirtime);
@@ -685,6 +930,11 @@ void handleReport(HTTPRequest *req, HTTPResponse *res)
     jsonObjInner["power"] = new JSONValue(jsonObjPower);
     jsonObjInner["device"] = new JSONValue(jsonObjDevice);
     jsonObjInner["radio"] = new JSONValue(jsonObjRadio);
+    jsonObjInner["threads"] = new JSONValue(jsonThreads);
+    jsonObjInner["router"] = new JSONValue(jsonObjRouter);
+    jsonObjInner["modules"] = new JSONValue(jsonModules);
+    jsonObjInner["http_api"] = httpAPIStatsToJson(); // Polling /api/v1/fromradio against streaming over /api/v1/stream
+    jsonObjInner["static_assets"] = new JSONValue(jsonObjStatic);
 
     // create json output structure
     JSONObject jsonObjOuter;
@@ -802,6 +1052,7 @@ void handleDeleteFsContent(HTTPRequest *req, HTTPResponse *res)
 
     concurrency::LockGuard g(spiLock);
     htmlDeleteDir("/static");
+    staticAssets.clear();
 
     res->println("<p><hr><p><a href=/admin>Back to admin</a>");
 }
@@ -3,6 +3,7 @@
 #include "NodeDB.h"
 #include "graphics/Screen.h"
 #include "main.h"
+#include "mesh/api/WebsocketAPI.h"
 #include "mesh/http/WebServer.h"
 #include "mesh/wifi/WiFiAPClient.h"
 #include "sleep.h"
@@ -201,6 +202,7 @@ void initWebServer()
     insecureServer = new HTTPServer();
 
     registerHandlers(insecureServer, secureServer);
+    initWebsocketAPI();
 
     if (secureServer) {
         LOG_INFO("Start Secure Web Server");
@@ -44,7 +44,10 @@ mail:   marchammermann@googlemail.com
 #include "airtime.h"
 #include "graphics/Screen.h"
 #include "main.h"
+#include "mesh/StaticAssetManifest.h"
+#include "mesh/api/WebsocketAPI.h"
 #include "mesh/wifi/WiFiAPClient.h"
+#include "serialization/JSON.h"
 #include "sleep.h"
 #include <openssl/bn.h>
 #include <openssl/evp.h>
@@ -56,8 +59,12 @@ mail:   marchammermann@googlemail.com
 #include <ulfius.h>
 #include <yder.h>
 
+#include <chrono>
+#include <condition_variable>
 #include <cstring>
+#include <dirent.h>
 #include <string>
+#include <sys/stat.h>
 
 #include "PortduinoFS.h"
 #include "platform/portduino/PortduinoGlue.h"
@@ -126,6 +133,97 @@ static void callback_static_file_stream_free(void *cls)
     }
 }
 
+/**
+ * Walk the web root and hash every file into staticAssets, before the server starts
+ */
+static void buildStaticAssets(const std::string &root, const std::string &dir, int levels)
+{
+    DIR *d = opendir((root + "/" + dir).c_str());
+    if (!d)
+        return;
+
+    static uint8_t buf[STATIC_FILE_CHUNK];
+    struct dirent *entry;
+    while ((entry = readdir(d)) != NULL) {
+        if (entry->d_name[0] == '.')
+            continue;
+        std::string name = dir.empty() ? entry->d_name : dir + "/" + entry->d_name;
+        std::string path = root + "/" + name;
+        struct stat st;
+        if (lstat(path.c_str(), &st) != 0 || S_ISLNK(st.st_mode))
+            continue; // Links may lead out of the root, those still go through the realpath() check
+        if (S_ISDIR(st.st_mode)) {
+            if (levels)
+                buildStaticAssets(root, name, levels - 1);
+            continue;
+        }
+
+        FILE *f = fopen(path.c_str(), "rb");
+        if (!f)
+            continue;
+        StaticAssetHasher hasher;
+        size_t length;
+        while ((length = fread(buf, 1, sizeof(buf), f)) > 0)
+            hasher.update(buf, length);
+        fclose(f);
+        if (!staticAssets.add(name, path, st.st_size, hasher.get())) {
+            LOG_WARN("More than %d files in the web root, serve the rest without ETag", STATIC_ASSET_MAX_FILES);
+            break;
+        }
+    }
+    closedir(d);
+}
+
+/**
+ * Answer from the manifest: a 304 if the browser has this version, the file (or its .gz) otherwise.
+ * @return false, having answered nothing, if the file is gone or its size changed since the manifest was built
+ */
+static bool serveStaticAsset(const struct _u_request *request, struct _u_response *response, const char *name,
+                             const StaticAsset &asset)
+{
+    uint32_t start = micros();
+    // Nothing rebuilds the manifest while we run, so make sure its size and ETag still describe the file
+    FILE *f = fopen(asset.file.c_str(), "rb");
+    struct stat st;
+    if (!f || fstat(fileno(f), &st) != 0 || (uint64_t)st.st_size != asset.size) {
+        if (f)
+            fclose(f);
+        LOG_DEBUG("Static File Server - %s changed since the manifest was built", asset.file.c_str());
+        return false;
+    }
+
+    u_map_put(response->map_header, "Cache-Control", StaticAssetManifest::cacheControl(asset));
+    u_map_put(response->map_header, "Vary", "Accept-Encoding");
+    u_map_put(response->map_header, "ETag", asset.etag);
+    u_map_copy_into(response->map_header, &configWeb.map_header);
+
+    if (StaticAssetManifest::etagMatches(u_map_get_case(request->map_header, "If-None-Match"), asset.etag)) {
+        fclose(f);
+        ulfius_set_empty_body_response(response, 304);
+        staticAssets.count(&asset, true, 0, micros() - start);
+        return true;
+    }
+
+    const char *content_type = u_map_get_case(&configWeb.mime_types, get_filename_ext(name));
+    if (content_type == NULL) {
+        content_type = u_map_get(&configWeb.mime_types, "*");
+        LOG_DEBUG("Static File Server - Unknown mime type for extension %s ", get_filename_ext(name));
+    }
+    u_map_put(response->map_header, "Content-Type", content_type);
+    if (asset.gzip) {
+        u_map_put(response->map_header, "Content-Encoding", "gzip");
+    }
+
+    if (ulfius_set_stream_response(response, 200, callback_static_file_stream, callback_static_file_stream_free, asset.size,
+                                   STATIC_FILE_CHUNK, f) != U_OK) {
+        LOG_DEBUG("callback_static_file - Error ulfius_set_stream_response");
+        fclose(f);
+        return true;
+    }
+    staticAssets.count(&asset, false, asset.size, micros() - start);
+    return true;
+}
+
 /**
  * static file callback endpoint that delivers the content for WebServer calls
  */
@@ -166,6 +264,13 @@ int callback_static_file(const struct _u_request *request, struct _u_response *r
             url_dup_save = file_requested = o_strdup("index.html");
         }
 
+        StaticAsset asset;
+        bool acceptGzip = StaticAssetManifest::acceptsGzip(u_map_get_case(request->map_header, "Accept-Encoding"));
+        if (staticAssets.find(file_requested, acceptGzip, asset) && serveStaticAsset(request, response, file_requested, asset)) {
+            o_free(url_dup_save);
+            return U_CALLBACK_CONTINUE;
+        }
+
         file_path = msprintf("%s/%s", configWeb.files_path, file_requested);
         real_path = realpath(file_path, NULL);
         if (0 == o_strncmp(configWeb.files_path, real_path, o_strlen(configWeb.files_path))) {
@@ -277,6 +382,7 @@ int handleAPIv1FromRadio(const struct _u_request *req, struct _u_response *res,
 
     uint8_t txBuf[MAX_STREAM_BUF_SIZE];
     uint32_t len = 1;
+    uint32_t start = micros();
 
     if (valueAll == "true") {
         while (len) {
@@ -298,10 +404,158 @@ int handleAPIv1FromRadio(const struct _u_request *req, struct _u_response *res,
         // LOG_DEBUG("");
     }
 
+    httpAPIStats.polls++;
+    httpAPIStats.emptyPolls += len == 0;
+    httpAPIStats.pollFrames += len != 0;
+    httpAPIStats.pollUsec += micros() - start;
+
     // LOG_DEBUG("end radio->web", len);
     return U_CALLBACK_COMPLETE;
 }
 
+/*
+ * The part of the ESP32 /json/report that applies here, in the same shape so the same tools read both
+ */
+int handleJSONReport(const struct _u_request *req, struct _u_response *res, void *user_data)
+{
+    JSONObject jsonObjInner;
+    jsonObjInner["http_api"] = httpAPIStatsToJson();
+
+    JSONObject jsonObjOuter;
+    jsonObjOuter["data"] = new JSONValue(jsonObjInner);
+    jsonObjOuter["status"] = new JSONValue("ok");
+    JSONValue *value = new JSONValue(jsonObjOuter);
+    std::string body = value->Stringify();
+    delete value;
+
+    ulfius_add_header_to_response(res, "Content-Type", "application/json");
+    ulfius_add_header_to_response(res, "Access-Control-Allow-Origin", "*");
+    ulfius_set_string_body_response(res, 200, body.c_str());
+    return U_CALLBACK_COMPLETE;
+}
+
+#ifndef U_DISABLE_WEBSOCKET
+/**
+ * A WebsocketAPI session on an ulfius WebSocket.  ulfius calls us on its own threads, the pump on the main one.  The pump
+ * only queues frames here, the ulfius manager thread of the connection sends them, so the main loop never waits on a
+ * client's socket.
+ */
+class PiWebsocketAPI : public WebsocketAPI
+{
+  public:
+    /// Set once the session is in the WebsocketAPI table, from then on the pump deletes it
+    bool added = false;
+
+    /// Send the queued frames until the connection closes or the pump asks to close it, on the ulfius manager thread
+    void serve(struct _websocket_manager *manager)
+    {
+        std::unique_lock<std::mutex> guard(outboundLock);
+        while (ulfius_websocket_status(manager) == U_WEBSOCKET_STATUS_OPEN) {
+            if (outbound.empty() && closeRequested) {
+                guard.unlock();
+                ulfius_websocket_send_close_signal(manager);
+                return;
+            }
+            if (outbound.empty()) {
+                // Time out now and then, so a close from the client is noticed with nothing to send
+                outboundReady.wait_for(guard, std::chrono::seconds(1));
+                continue;
+            }
+            std::vector<uint8_t> frame = std::move(outbound.front());
+            outbound.pop_front();
+            guard.unlock();
+            int res = ulfius_websocket_send_message(manager, U_WEBSOCKET_OPCODE_BINARY, frame.size(), (const char *)frame.data());
+            guard.lock();
+            if (res != U_OK)
+                return;
+        }
+    }
+
+  protected:
+    virtual bool sendFrame(const uint8_t *buf, size_t len) override
+    {
+        std::lock_guard<std::mutex> guard(outboundLock);
+        if (!checkIsConnected() || closeRequested || outbound.size() >= WEBSOCKET_MAX_OUTBOUND)
+            return false;
+        outbound.emplace_back(buf, buf + len);
+        outboundReady.notify_one();
+        return true;
+    }
+
+    virtual bool canSend() override
+    {
+        std::lock_guard<std::mutex> guard(outboundLock);
+        return outbound.size() < WEBSOCKET_MAX_OUTBOUND;
+    }
+
+    virtual void closeConnection() override
+    {
+        std::lock_guard<std::mutex> guard(outboundLock);
+        closeRequested = true;
+        outboundReady.notify_one();
+    }
+
+    /// The manager thread is done with the connection before ulfius reports it closed, nothing to forget
+    virtual void dropConnection() override {}
+
+  private:
+    std::mutex outboundLock;
+    std::condition_variable outboundReady;
+    std::deque<std::vector<uint8_t>> outbound;
+    bool closeRequested = false;
+};
+
+/// Lives as long as the connection and sends everything the pump queued for it
+static void websocketManager(const struct _u_request *req, struct _websocket_manager *manager, void *user_data)
+{
+    PiWebsocketAPI *session = static_cast<PiWebsocketAPI *>(user_data);
+    session->added = WebsocketAPI::add(session);
+    if (!session->added) {
+        ulfius_websocket_send_close_signal(manager);
+        return;
+    }
+    session->serve(manager);
+}
+
+static void websocketIncoming(const struct _u_request *req, struct _websocket_manager *manager,
+                              const struct _websocket_message *message, void *user_data)
+{
+    if (message->opcode != U_WEBSOCKET_OPCODE_BINARY)
+        return;
+    if (!static_cast<PiWebsocketAPI *>(user_data)->queueToRadio((const uint8_t *)message->data, message->data_len))
+        LOG_WARN("WebSocket API client sends faster than we handle it, drop ToRadio");
+}
+
+static void websocketClosed(const struct _u_request *req, struct _websocket_manager *manager, void *user_data)
+{
+    // The pump deletes the session, unless it was never added
+    PiWebsocketAPI *session = static_cast<PiWebsocketAPI *>(user_data);
+    if (session->added)
+        session->disconnect();
+    else
+        delete session;
+}
+
+/*
+ * Upgrade to a WebSocket that streams FromRadio to the client as the radio produces them, instead of polling
+ * handleAPIv1FromRadio
+ */
+int handleAPIv1Stream(const struct _u_request *req, struct _u_response *res, void *user_data)
+{
+    if (!WebsocketAPI::hasRoom()) {
+        ulfius_set_string_body_response(res, 503, "Too many WebSocket API clients");
+        return U_CALLBACK_COMPLETE;
+    }
+    PiWebsocketAPI *session = new PiWebsocketAPI();
+    if (ulfius_set_websocket_response(res, NULL, NULL, &websocketManager, session, &websocketIncoming, session,
+                                      &websocketClosed, session) != U_OK) {
+        delete session;
+        return U_CALLBACK_ERROR;
+    }
+    return U_CALLBACK_CONTINUE;
+}
+#endif
+
 /*
 OpenSSL RSA Key Gen
 */
@@ -491,6 +745,11 @@ PiWebServerThread::PiWebServerThread()
         u_map_put(&configWeb.mime_types, ".svg", "image/svg+xml");
 
         webrootpath = settingsStrings[webserverrootpath];
+        uint32_t manifestStart = millis();
+        buildStaticAssets(webrootpath, "", 10);
+        staticAssets.setBuilt(millis() - manifestStart);
+        LOG_INFO("Static asset manifest: %u files hashed in %u ms", (unsigned)staticAssets.getFileCount(),
+                 staticAssets.getBuildMsec());
 
         configWeb.files_path = (char *)webrootpath.c_str();
         configWeb.url_prefix = "";
@@ -503,6 +762,11 @@ PiWebServerThread::PiWebServerThread()
         ulfius_add_endpoint_by_val(&instanceWeb, "OPTIONS", PREFIX, "/api/v1/fromradio/*", 1, &handleAPIv1FromRadio, &webAPI);
         ulfius_add_endpoint_by_val(&instanceWeb, "PUT", PREFIX, "/api/v1/toradio/*", 1, &handleAPIv1ToRadio, &webAPI);
         ulfius_add_endpoint_by_val(&instanceWeb, "OPTIONS", PREFIX, "/api/v1/toradio/*", 1, &handleAPIv1ToRadio, &webAPI);
+        ulfius_add_endpoint_by_val(&instanceWeb, "GET", PREFIX, "/json/report", 1, &handleJSONReport, NULL);
+#ifndef U_DISABLE_WEBSOCKET
+        ulfius_add_endpoint_by_val(&instanceWeb, "GET", PREFIX, "/api/v1/stream", 1, &handleAPIv1Stream, NULL);
+        initWebsocketAPI();
+#endif
 
         // Add callback function to all endpoints for the Web Server
         ulfius_add_endpoint_by_val(&instanceWeb, "GET", NULL, "/*", 2, &callback_static_file, &configWeb);
@@ -7,7 +7,7 @@
 #include <Arduino.h>
 #include <functional>
 
-#define STATIC_FILE_CHUNK 256
+#define STATIC_FILE_CHUNK 32768
 
 void initWebServer();
 void createSSLCert();
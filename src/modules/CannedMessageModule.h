@@ -93,6 +93,9 @@ class CannedMessageModule : public SinglePortModule, public Observable<const UIF
         }
     }
 
+    // Every packet, so wantPacket() keeps seeing the signal of everything we hear
+    virtual bool getPortNums(std::vector<meshtastic_PortNum> &portNums) override { return false; }
+
   protected:
     virtual int32_t runOnce() override;
 
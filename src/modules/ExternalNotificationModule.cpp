@@ -215,6 +215,12 @@ bool ExternalNotificationModule::wantPacket(const meshtastic_MeshPacket *p)
     return MeshService::isTextPayload(p);
 }
 
+bool ExternalNotificationModule::getPortNums(std::vector<meshtastic_PortNum> &portNums)
+{
+    MeshService::getTextPortNums(portNums);
+    return true;
+}
+
 /**
  * Sets the external notification for the specified index.
  *
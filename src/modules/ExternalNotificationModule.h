@@ -55,6 +55,7 @@ class ExternalNotificationModule : public SinglePortModule, private concurrency:
     virtual int32_t runOnce() override;
 
     virtual bool wantPacket(const meshtastic_MeshPacket *p) override;
+    virtual bool getPortNums(std::vector<meshtastic_PortNum> &portNums) override;
 
     bool isNagging = false;
 
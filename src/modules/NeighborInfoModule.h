@@ -63,6 +63,8 @@ class NeighborInfoModule : public ProtobufModule<meshtastic_NeighborInfo>, priva
       Exception is when the packet came via MQTT */
     virtual bool wantPacket(const meshtastic_MeshPacket *p) override { return enabled && !p->via_mqtt; }
 
+    virtual bool getPortNums(std::vector<meshtastic_PortNum> &portNums) override { return false; }
+
     /* These are for debugging only */
     void printNeighborInfo(const char *header, const meshtastic_NeighborInfo *np);
     void printNodeDBNeighbors();
@@ -128,7 +128,7 @@ void RangeTestModuleRadio::sendPayload(NodeNum dest, bool wantReplies)
     powerFSM.trigger(EVENT_CONTACT_FROM_PHONE);
 }
 
-ProcessMessage RangeTestModuleRadio::handleReceived(const meshtastic_MeshPacket &mp)
+void RangeTestModuleRadio::handleReceivedBatch(const meshtastic_MeshPacket *const *packets, size_t count)
 {
 #if defined(ARCH_ESP32) || defined(ARCH_NRF52) || defined(ARCH_PORTDUINO)
 
@@ -140,51 +140,32 @@ ProcessMessage RangeTestModuleRadio::handleReceived(const meshtastic_MeshPacket
                   LOG_INFO.getNodeNum(), mp.from, mp.to, mp.id, p.payload.size, p.payload.bytes);
         */
 
-        if (!isFromUs(&mp)) {
-
-            if (moduleConfig.range_test.save) {
-                appendFile(mp);
-            }
-
-            /*
-            NodeInfoLite *n = nodeDB->getMeshNode(getFrom(&mp));
-
-            LOG_DEBUG("-----------------------------------------");
-            LOG_DEBUG("p.payload.bytes  \"%s\"", p.payload.bytes);
-            LOG_DEBUG("p.payload.size   %d", p.payload.size);
-            LOG_DEBUG("---- Received Packet:");
-            LOG_DEBUG("mp.from          %d", mp.from);
-            LOG_DEBUG("mp.rx_snr        %f", mp.rx_snr);
-            LOG_DEBUG("mp.hop_limit     %d", mp.hop_limit);
-            LOG_DEBUG("---- Node Information of Received Packet (mp.from):");
-            LOG_DEBUG("n->user.long_name         %s", n->user.long_name);
-            LOG_DEBUG("n->user.short_name        %s", n->user.short_name);
-            LOG_DEBUG("n->has_position           %d", n->has_position);
-            LOG_DEBUG("n->position.latitude_i    %d", n->position.latitude_i);
-            LOG_DEBUG("n->position.longitude_i   %d", n->position.longitude_i);
-            LOG_DEBUG("---- Current device location information:");
-            LOG_DEBUG("gpsStatus->getLatitude()     %d", gpsStatus->getLatitude());
-            LOG_DEBUG("gpsStatus->getLongitude()    %d", gpsStatus->getLongitude());
-            LOG_DEBUG("gpsStatus->getHasLock()      %d", gpsStatus->getHasLock());
-            LOG_DEBUG("gpsStatus->getDOP()          %d", gpsStatus->getDOP());
-            LOG_DEBUG("-----------------------------------------");
-            */
+        if (moduleConfig.range_test.save) {
+            appendFile(packets, count);
         }
     } else {
         LOG_INFO("Range Test Module Disabled");
     }
 
 #endif
-
-    return ProcessMessage::CONTINUE; // Let others look at this message also if they want
 }
 
 bool RangeTestModuleRadio::appendFile(const meshtastic_MeshPacket &mp)
+{
+    const meshtastic_MeshPacket *single = &mp;
+    return appendFile(&single, 1);
+}
+
+bool RangeTestModuleRadio::appendFile(const meshtastic_MeshPacket *const *packets, size_t count)
 {
 #ifdef ARCH_ESP32
-    auto &p = mp.decoded;
+    size_t fromOthers = 0;
+    for (size_t i = 0; i < count; i++)
+        if (!isFromUs(packets[i]))
+            fromOthers++;
+    if (!fromOthers)
+        return 1;
 
-    meshtastic_NodeInfoLite *n = nodeDB->getMeshNode(getFrom(&mp));
     /*
         LOG_DEBUG("-----------------------------------------");
         LOG_DEBUG("p.payload.bytes  \"%s\"", p.payload.bytes);
@@ -248,6 +229,8 @@ bool RangeTestModuleRadio::appendFile(const meshtastic_MeshPacket &mp)
         return 0;
     }
 
+    // The packets of one batch arrived together, they share the time column
+    char timeStr[12] = "??:??:??";
     struct timeval tv;
     if (!gettimeofday(&tv, NULL)) {
         long hms = tv.tv_sec % SEC_PER_DAY;
@@ -258,41 +241,48 @@ bool RangeTestModuleRadio::appendFile(const meshtastic_MeshPacket &mp)
         int min = (hms % SEC_PER_HOUR) / SEC_PER_MIN;
         int sec = (hms % SEC_PER_HOUR) % SEC_PER_MIN; // or hms % SEC_PER_MIN
 
-        fileToAppend.printf("%02d:%02d:%02d,", hour, min, sec); // Time
-    } else {
-        fileToAppend.printf("??:??:??,"); // Time
+        snprintf(timeStr, sizeof(timeStr), "%02d:%02d:%02d", hour, min, sec);
     }
 
-    fileToAppend.printf("%d,", getFrom(&mp));                   // From
-    fileToAppend.printf("%s,", n->user.long_name);              // Long Name
-    fileToAppend.printf("%f,", n->position.latitude_i * 1e-7);  // Sender Lat
-    fileToAppend.printf("%f,", n->position.longitude_i * 1e-7); // Sender Long
-    if (gpsStatus->getIsConnected() || config.position.fixed_position) {
-        fileToAppend.printf("%f,", gpsStatus->getLatitude() * 1e-7);  // RX Lat
-        fileToAppend.printf("%f,", gpsStatus->getLongitude() * 1e-7); // RX Long
-        fileToAppend.printf("%d,", gpsStatus->getAltitude());         // RX Altitude
-    } else {
-        // When the phone API is in use, the node info will be updated with position
-        meshtastic_NodeInfoLite *us = nodeDB->getMeshNode(nodeDB->getNodeNum());
-        fileToAppend.printf("%f,", us->position.latitude_i * 1e-7);  // RX Lat
-        fileToAppend.printf("%f,", us->position.longitude_i * 1e-7); // RX Long
-        fileToAppend.printf("%d,", us->position.altitude);           // RX Altitude
-    }
+    for (size_t i = 0; i < count; i++) {
+        const meshtastic_MeshPacket &mp = *packets[i];
+        if (isFromUs(&mp))
+            continue;
+        auto &p = mp.decoded;
+        meshtastic_NodeInfoLite *n = nodeDB->getMeshNode(getFrom(&mp));
+
+        fileToAppend.printf("%s,", timeStr);                        // Time
+        fileToAppend.printf("%d,", getFrom(&mp));                   // From
+        fileToAppend.printf("%s,", n->user.long_name);              // Long Name
+        fileToAppend.printf("%f,", n->position.latitude_i * 1e-7);  // Sender Lat
+        fileToAppend.printf("%f,", n->position.longitude_i * 1e-7); // Sender Long
+        if (gpsStatus->getIsConnected() || config.position.fixed_position) {
+            fileToAppend.printf("%f,", gpsStatus->getLatitude() * 1e-7);  // RX Lat
+            fileToAppend.printf("%f,", gpsStatus->getLongitude() * 1e-7); // RX Long
+            fileToAppend.printf("%d,", gpsStatus->getAltitude());         // RX Altitude
+        } else {
+            // When the phone API is in use, the node info will be updated with position
+            meshtastic_NodeInfoLite *us = nodeDB->getMeshNode(nodeDB->getNodeNum());
+            fileToAppend.printf("%f,", us->position.latitude_i * 1e-7);  // RX Lat
+            fileToAppend.printf("%f,", us->position.longitude_i * 1e-7); // RX Long
+            fileToAppend.printf("%d,", us->position.altitude);           // RX Altitude
+        }
 
-    fileToAppend.printf("%f,", mp.rx_snr); // RX SNR
+        fileToAppend.printf("%f,", mp.rx_snr); // RX SNR
 
-    if (n->position.latitude_i && n->position.longitude_i && gpsStatus->getLatitude() && gpsStatus->getLongitude()) {
-        float distance = GeoCoord::latLongToMeter(n->position.latitude_i * 1e-7, n->position.longitude_i * 1e-7,
-                                                  gpsStatus->getLatitude() * 1e-7, gpsStatus->getLongitude() * 1e-7);
-        fileToAppend.printf("%f,", distance); // Distance in meters
-    } else {
-        fileToAppend.printf("0,");
-    }
+        if (n->position.latitude_i && n->position.longitude_i && gpsStatus->getLatitude() && gpsStatus->getLongitude()) {
+            float distance = GeoCoord::latLongToMeter(n->position.latitude_i * 1e-7, n->position.longitude_i * 1e-7,
+                                                      gpsStatus->getLatitude() * 1e-7, gpsStatus->getLongitude() * 1e-7);
+            fileToAppend.printf("%f,", distance); // Distance in meters
+        } else {
+            fileToAppend.printf("0,");
+        }
 
-    fileToAppend.printf("%d,", mp.hop_limit); // Packet Hop Limit
+        fileToAppend.printf("%d,", mp.hop_limit); // Packet Hop Limit
 
-    // TODO: If quotes are found in the payload, it has to be escaped.
-    fileToAppend.printf("\"%s\"\n", p.payload.bytes);
+        // TODO: If quotes are found in the payload, it has to be escaped.
+        fileToAppend.printf("\"%s\"\n", p.payload.bytes);
+    }
     fileToAppend.flush();
     fileToAppend.close();
 #endif
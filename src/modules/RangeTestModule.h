@@ -31,7 +31,8 @@ class RangeTestModuleRadio : public SinglePortModule
   public:
     RangeTestModuleRadio() : SinglePortModule("RangeTestModuleRadio", meshtastic_PortNum_RANGE_TEST_APP)
     {
-        loopbackOk = true; // Allow locally generated messages to loop back to the client
+        loopbackOk = true;     // Allow locally generated messages to loop back to the client
+        acceptsBatches = true; // Log a burst of packets with one open of the CSV file
     }
 
     /**
@@ -44,13 +45,15 @@ class RangeTestModuleRadio : public SinglePortModule
      */
     bool appendFile(const meshtastic_MeshPacket &mp);
 
-  protected:
-    /** Called to handle a particular incoming message
+    /**
+     * Append range test data for several packets, opening the file once.  Packets from us are skipped.
+     */
+    bool appendFile(const meshtastic_MeshPacket *const *packets, size_t count);
 
-    @return ProcessMessage::STOP if you've guaranteed you've handled this message and no other handlers should be considered for
-    it
-    */
-    virtual ProcessMessage handleReceived(const meshtastic_MeshPacket &mp) override;
+  protected:
+    /** Called with the range test packets of each receive batch
+     */
+    virtual void handleReceivedBatch(const meshtastic_MeshPacket *const *packets, size_t count) override;
 };
 
 extern RangeTestModuleRadio *rangeTestModuleRadio;
@@ -34,6 +34,8 @@ class RoutingModule : public ProtobufModule<meshtastic_Routing>
 
     /// Override wantPacket to say we want to see all packets, not just those for our port number
     virtual bool wantPacket(const meshtastic_MeshPacket *p) override { return true; }
+
+    virtual bool getPortNums(std::vector<meshtastic_PortNum> &portNums) override { return false; }
 };
 
 extern RoutingModule *routingModule;
\ No newline at end of file
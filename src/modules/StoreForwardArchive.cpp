@@ -0,0 +1,349 @@
+#include "StoreForwardArchive.h"
+#include "FSCommon.h"
+#include "SPILock.h"
+
+#include <algorithm>
+
+static const uint8_t recordMagic = 0x5F;
+static const uint8_t flagEmoji = 0x01;
+
+bool StoreForwardArchive::open(const char *dir, uint32_t maxBytes, uint32_t maxRecords)
+{
+    close();
+    persistent = dir != NULL;
+    if (persistent)
+        strncpy(this->dir, dir, sizeof(this->dir) - 1);
+    maxSegments = std::max<uint32_t>(2, maxBytes / SF_ARCHIVE_SEGMENT_BYTES);
+    this->maxRecords = std::max<uint32_t>(1, maxRecords);
+
+    if (persistent) {
+#ifdef FSCom
+        recover();
+        while (segments.size() > maxSegments)
+            dropSegment();
+        while (entries.size() > this->maxRecords)
+            dropOldest();
+        dropUnusedSegments();
+#else
+        return false;
+#endif
+    }
+    return true;
+}
+
+void StoreForwardArchive::close()
+{
+    for (auto &segment : segments)
+        free(segment.data);
+    segments.clear();
+    entries.clear();
+    broadcasts.clear();
+    directs.clear();
+    headSeq = 0;
+    nextSegmentId = 0;
+    lastTime = 0;
+}
+
+bool StoreForwardArchive::add(const meshtastic_MeshPacket &mp, uint32_t time)
+{
+    const auto &p = mp.decoded;
+    const RecordHeader header = {recordMagic,
+                                 (uint8_t)(p.emoji ? flagEmoji : 0),
+                                 (uint8_t)mp.channel,
+                                 (uint8_t)p.payload.size,
+                                 std::max(time, lastTime),
+                                 mp.to,
+                                 getFrom(&mp),
+                                 mp.id,
+                                 p.reply_id};
+
+    if (entries.size() >= maxRecords) {
+        while (entries.size() >= maxRecords)
+            dropOldest();
+        dropUnusedSegments();
+    }
+
+    Segment *segment = appendSegment(sizeof(header) + header.payloadSize);
+    if (!segment)
+        return false;
+    const uint32_t offset = segment->bytes;
+    if (!write(*segment, header, p.payload.bytes))
+        return false;
+
+    index(header, segment->id, offset);
+    lastTime = header.time;
+    return true;
+}
+
+void StoreForwardArchive::expire(uint32_t before)
+{
+    while (!entries.empty() && entries.front().time < before)
+        dropOldest();
+    dropUnusedSegments();
+}
+
+uint32_t StoreForwardArchive::countFor(NodeNum client, uint32_t seq, uint32_t since) const
+{
+    const uint32_t start = std::max(seq, firstAfter(since));
+    uint32_t count = 0;
+    auto scan = [&](const std::deque<uint32_t> &seqs) {
+        for (auto it = std::lower_bound(seqs.begin(), seqs.end(), start); it != seqs.end(); ++it)
+            if (entry(*it).from != client)
+                count++;
+    };
+
+    scan(broadcasts);
+    auto direct = directs.find(client);
+    if (direct != directs.end())
+        scan(direct->second);
+    return count;
+}
+
+uint32_t StoreForwardArchive::nextFor(NodeNum client, uint32_t seq, uint32_t since) const
+{
+    const uint32_t start = std::max(seq, firstAfter(since));
+    uint32_t next = endSeq();
+    auto scan = [&](const std::deque<uint32_t> &seqs) {
+        for (auto it = std::lower_bound(seqs.begin(), seqs.end(), start); it != seqs.end() && *it < next; ++it)
+            if (entry(*it).from != client) {
+                next = *it;
+                break;
+            }
+    };
+
+    scan(broadcasts);
+    auto direct = directs.find(client);
+    if (direct != directs.end())
+        scan(direct->second);
+    return next;
+}
+
+bool StoreForwardArchive::read(uint32_t seq, Record &record, uint8_t *payload) const
+{
+    if (seq < headSeq || seq >= endSeq())
+        return false;
+    const Entry &e = entry(seq);
+
+    // Straight from the segment into the caller's buffer, usually the packet about to be sent
+    RecordHeader header;
+    bool ok = false;
+    if (persistent) {
+#ifdef FSCom
+        char path[48];
+        segmentPath(path, sizeof(path), e.segment);
+        concurrency::LockGuard g(spiLock);
+        File f = FSCom.open(path, FILE_O_READ);
+        if (f) {
+            ok = f.seek(e.offset) && f.read((uint8_t *)&header, sizeof(header)) == sizeof(header) &&
+                 header.magic == recordMagic && header.payloadSize <= meshtastic_Constants_DATA_PAYLOAD_LEN &&
+                 f.read(payload, header.payloadSize) == header.payloadSize;
+            f.close();
+        }
+#endif
+    } else {
+        const Segment &segment = segments[e.segment - segments.front().id];
+        memcpy(&header, segment.data + e.offset, sizeof(header));
+        memcpy(payload, segment.data + e.offset + sizeof(header), header.payloadSize);
+        ok = true;
+    }
+
+    if (!ok) {
+        LOG_ERROR("S&F - Can't read archived record %u", seq);
+        return false;
+    }
+    record = {e.time, header.to, header.from, header.id, header.replyId, header.channel, (header.flags & flagEmoji) != 0,
+              header.payloadSize};
+    return true;
+}
+
+uint32_t StoreForwardArchive::bytesUsed() const
+{
+    uint32_t bytes = 0;
+    for (const auto &segment : segments)
+        bytes += segment.bytes;
+    return bytes;
+}
+
+void StoreForwardArchive::index(const RecordHeader &header, uint32_t segment, uint32_t offset)
+{
+    const uint32_t seq = endSeq();
+    entries.push_back({header.time, header.to, header.from, segment, offset});
+    if (header.to == NODENUM_BROADCAST)
+        broadcasts.push_back(seq);
+    else
+        directs[header.to].push_back(seq);
+}
+
+/// Sequence number of the first record stored after since
+uint32_t StoreForwardArchive::firstAfter(uint32_t since) const
+{
+    auto it = std::upper_bound(entries.begin(), entries.end(), since, [](uint32_t t, const Entry &e) { return t < e.time; });
+    return headSeq + (it - entries.begin());
+}
+
+/// The segment to append a record of len bytes to, starting a new one if needed
+StoreForwardArchive::Segment *StoreForwardArchive::appendSegment(uint32_t len)
+{
+    if (segments.empty() || segments.back().sealed || segments.back().bytes + len > SF_ARCHIVE_SEGMENT_BYTES) {
+        while (segments.size() >= maxSegments)
+            dropSegment();
+        // Out of memory, make room at the expense of the oldest records
+        while (!openSegment()) {
+            if (segments.empty())
+                return NULL;
+            dropSegment();
+        }
+    }
+    return &segments.back();
+}
+
+bool StoreForwardArchive::openSegment()
+{
+    Segment segment = {nextSegmentId, 0, false, NULL};
+    if (!persistent) {
+#ifdef ARCH_ESP32
+        segment.data = static_cast<uint8_t *>(ps_malloc(SF_ARCHIVE_SEGMENT_BYTES));
+#else
+        segment.data = static_cast<uint8_t *>(malloc(SF_ARCHIVE_SEGMENT_BYTES));
+#endif
+        if (!segment.data) {
+            LOG_WARN("S&F - No memory for another archive segment");
+            return false;
+        }
+    }
+    nextSegmentId++;
+    segments.push_back(segment);
+    return true;
+}
+
+void StoreForwardArchive::dropOldest()
+{
+    const Entry &e = entries.front();
+    if (e.to == NODENUM_BROADCAST) {
+        broadcasts.pop_front();
+    } else {
+        auto direct = directs.find(e.to);
+        direct->second.pop_front();
+        if (direct->second.empty())
+            directs.erase(direct);
+    }
+    entries.pop_front();
+    headSeq++;
+}
+
+/// Drop the oldest segment along with every record in it
+void StoreForwardArchive::dropSegment()
+{
+    LOG_WARN("S&F - Archive full, drop the oldest segment");
+    const uint32_t id = segments.front().id;
+    while (!entries.empty() && entries.front().segment == id)
+        dropOldest();
+    dropUnusedSegments();
+}
+
+void StoreForwardArchive::dropUnusedSegments()
+{
+    while (!segments.empty() && (entries.empty() || segments.front().id < entries.front().segment)) {
+        free(segments.front().data);
+        if (persistent) {
+#ifdef FSCom
+            char path[48];
+            segmentPath(path, sizeof(path), segments.front().id);
+            concurrency::LockGuard g(spiLock);
+            FSCom.remove(path);
+#endif
+        }
+        segments.pop_front();
+    }
+}
+
+void StoreForwardArchive::segmentPath(char *path, size_t size, uint32_t id) const
+{
+    snprintf(path, size, "%s/%08u.log", dir, (unsigned)id);
+}
+
+bool StoreForwardArchive::write(Segment &segment, const RecordHeader &header, const uint8_t *payload)
+{
+    const uint32_t len = sizeof(header) + header.payloadSize;
+    if (!persistent) {
+        memcpy(segment.data + segment.bytes, &header, sizeof(header));
+        memcpy(segment.data + segment.bytes + sizeof(header), payload, header.payloadSize);
+        segment.bytes += len;
+        return true;
+    }
+
+#ifdef FSCom
+    char path[48];
+    segmentPath(path, sizeof(path), segment.id);
+    size_t written = 0;
+    {
+        concurrency::LockGuard g(spiLock);
+        File f = FSCom.open(path, FILE_O_APPEND);
+        if (f) {
+            written = f.write((const uint8_t *)&header, sizeof(header));
+            written += f.write(payload, header.payloadSize);
+            f.close();
+        }
+    }
+    if (written == len) {
+        segment.bytes += len;
+        return true;
+    }
+    // A torn record stays behind in the file, recover() stops reading the segment there
+    LOG_ERROR("S&F - Can't append to %s", path);
+    segment.sealed = true;
+#endif
+    return false;
+}
+
+/// Rebuild the index from the segment files
+void StoreForwardArchive::recover()
+{
+#ifdef FSCom
+    concurrency::LockGuard g(spiLock);
+    FSCom.mkdir(dir);
+
+    std::vector<uint32_t> ids;
+    for (const auto &info : getFiles(dir, 0)) {
+        const char *name = strrchr(info.file_name, '/');
+        name = name ? name + 1 : info.file_name;
+        char *end;
+        unsigned long id = strtoul(name, &end, 10);
+        if (end != name && strcmp(end, ".log") == 0)
+            ids.push_back(id);
+    }
+    std::sort(ids.begin(), ids.end());
+
+    for (uint32_t id : ids) {
+        Segment segment = {id, 0, true, NULL};
+        char path[48];
+        segmentPath(path, sizeof(path), id);
+        File f = FSCom.open(path, FILE_O_READ);
+        if (f) {
+            const uint32_t size = f.size();
+            RecordHeader header;
+            while (segment.bytes + sizeof(header) <= size && f.read((uint8_t *)&header, sizeof(header)) == sizeof(header) &&
+                   header.magic == recordMagic && header.payloadSize <= meshtastic_Constants_DATA_PAYLOAD_LEN &&
+                   segment.bytes + sizeof(header) + header.payloadSize <= size &&
+                   f.seek(segment.bytes + sizeof(header) + header.payloadSize)) {
+                header.time = std::max(header.time, lastTime);
+                lastTime = header.time;
+                index(header, id, segment.bytes);
+                segment.bytes += sizeof(header) + header.payloadSize;
+            }
+            f.close();
+            if (segment.bytes < size)
+                LOG_WARN("S&F - Ignore %u damaged bytes at the end of %s", size - segment.bytes, path);
+            else
+                segment.sealed = false;
+        }
+        segments.push_back(segment);
+        nextSegmentId = id + 1;
+    }
+
+    // Only the newest segment takes more records
+    for (size_t i = 0; i + 1 < segments.size(); i++)
+        segments[i].sealed = true;
+    LOG_INFO("S&F - Resume %u archived records from %u segments", (unsigned)entries.size(), (unsigned)segments.size());
+#endif
+}
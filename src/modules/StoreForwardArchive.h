@@ -0,0 +1,153 @@
+#pragma once
+
+#include "MeshTypes.h"
+#include "configuration.h"
+
+#include <deque>
+#include <unordered_map>
+
+/// Size of one segment of the archive, records never span two segments
+#ifndef SF_ARCHIVE_SEGMENT_BYTES
+#define SF_ARCHIVE_SEGMENT_BYTES (16 * 1024)
+#endif
+
+/// Keep the archive on the filesystem so it survives a restart. ESP32 flash is small and wears out, so there the archive lives
+/// in PSRAM unless a variant asks otherwise.
+#ifndef SF_ARCHIVE_PERSIST
+#ifdef ARCH_PORTDUINO
+#define SF_ARCHIVE_PERSIST 1
+#else
+#define SF_ARCHIVE_PERSIST 0
+#endif
+#endif
+
+/// Most the archive may use on the filesystem
+#ifndef SF_ARCHIVE_MAX_BYTES
+#define SF_ARCHIVE_MAX_BYTES (4 * 1024 * 1024)
+#endif
+
+/**
+ * The Store & Forward message history, as an append-only log of variable length records.
+ *
+ * The log is split into fixed size segments, kept either in RAM or as files in a directory.  Records only take the bytes their
+ * payload needs, and space is given back a whole segment at a time, once everything in the oldest segment has expired or the
+ * archive is full.  A persistent archive rebuilds its index from the segment files when it is opened, ignoring a record torn
+ * by a power loss.
+ *
+ * Every record gets a sequence number.  The index keeps the time, source and destination of each record in sequence order,
+ * plus the sequence numbers of broadcasts and of the direct messages to each node, so a client's history is found by a binary
+ * search and then only walks the records it will actually get.  Record times never go backwards, add() clamps them, so the
+ * records after some time are found the same way.
+ */
+class StoreForwardArchive
+{
+  public:
+    /// A record as it was stored, its payload is read separately
+    struct Record {
+        uint32_t time;
+        NodeNum to;
+        NodeNum from;
+        PacketId id;
+        uint32_t replyId;
+        uint8_t channel;
+        bool emoji;
+        pb_size_t payloadSize;
+    };
+
+    ~StoreForwardArchive() { close(); }
+
+    /**
+     * Start (or with a persistent archive, resume) the archive
+     *
+     * @param dir the directory for the segment files, NULL to keep the archive in RAM
+     * @param maxBytes the most all segments together may use
+     * @param maxRecords the most records to keep, this bounds the RAM used by the index
+     */
+    bool open(const char *dir, uint32_t maxBytes, uint32_t maxRecords);
+
+    /// Forget everything in RAM, a persistent archive stays on the filesystem
+    void close();
+
+    /// Append the text message mp, received at time
+    bool add(const meshtastic_MeshPacket &mp, uint32_t time);
+
+    /// Drop the records stored before time, and the segments that held nothing else
+    void expire(uint32_t before);
+
+    /// How many records client would get from seq onwards, stored after since.  Clients get broadcasts and the messages sent to
+    /// them, but not the ones they sent themselves.
+    uint32_t countFor(NodeNum client, uint32_t seq, uint32_t since) const;
+
+    /// Sequence number of the first record client would get from seq onwards stored after since, or endSeq() if there is none
+    uint32_t nextFor(NodeNum client, uint32_t seq, uint32_t since) const;
+
+    /// Read record seq, and its payload into a buffer of at least meshtastic_Constants_DATA_PAYLOAD_LEN bytes
+    bool read(uint32_t seq, Record &record, uint8_t *payload) const;
+
+    /// Sequence number of the oldest record still stored
+    uint32_t firstSeq() const { return headSeq; }
+    /// Sequence number the next record will get
+    uint32_t endSeq() const { return headSeq + entries.size(); }
+    uint32_t size() const { return entries.size(); }
+    uint32_t bytesUsed() const;
+
+  private:
+    /// What the log holds in front of each payload
+    struct RecordHeader {
+        uint8_t magic;
+        uint8_t flags;
+        uint8_t channel;
+        uint8_t payloadSize;
+        uint32_t time;
+        uint32_t to;
+        uint32_t from;
+        uint32_t id;
+        uint32_t replyId;
+    };
+
+    /// What the index keeps for each record
+    struct Entry {
+        uint32_t time;
+        NodeNum to;
+        NodeNum from;
+        uint32_t segment;
+        uint32_t offset; // of the record header within its segment
+    };
+
+    struct Segment {
+        uint32_t id;
+        uint32_t bytes;
+        bool sealed;   // no more appends, e.g. after a failed write
+        uint8_t *data; // the whole segment when the archive is in RAM
+    };
+
+    bool persistent = false;
+    char dir[32] = "";
+    uint32_t maxSegments = 0;
+    uint32_t maxRecords = 0;
+
+    std::deque<Segment> segments;
+    uint32_t nextSegmentId = 0;
+
+    std::deque<Entry> entries; // entries[i] has sequence number headSeq + i
+    uint32_t headSeq = 0;
+    uint32_t lastTime = 0;
+
+    std::deque<uint32_t> broadcasts;                           // sequence numbers of broadcasts
+    std::unordered_map<NodeNum, std::deque<uint32_t>> directs; // and of the direct messages to each node
+
+    const Entry &entry(uint32_t seq) const { return entries[seq - headSeq]; }
+    void index(const RecordHeader &header, uint32_t segment, uint32_t offset);
+    uint32_t firstAfter(uint32_t since) const;
+
+    Segment *appendSegment(uint32_t len);
+    bool openSegment();
+    void dropOldest();
+    void dropSegment();
+    void dropUnusedSegments();
+
+    void segmentPath(char *path, size_t size, uint32_t id) const;
+    bool write(Segment &segment, const RecordHeader &header, const uint8_t *payload);
+    void recover();
+};
+
@@ -34,6 +34,11 @@ int32_t StoreForwardModule::runOnce()
 {
 #if defined(ARCH_ESP32) || defined(ARCH_PORTDUINO)
     if (moduleConfig.store_forward.enabled && is_server) {
+        // Forget what nobody may ask for anymore
+        uint32_t now = getTime();
+        if (now > this->historyReturnWindow * 60)
+            archive.expire(now - this->historyReturnWindow * 60);
+
         // Send out the message queue.
         if (this->busy) {
             // Only send packets if the channel is less than 25% utilized and until historyReturnMax
@@ -61,34 +66,37 @@ int32_t StoreForwardModule::runOnce()
 }
 
 /**
- * Populates the PSRAM with data to be sent later when a device is out of range.
+ * Opens the message archive, on the filesystem if it is kept there, otherwise in PSRAM.
+ *
+ * @return True if the archive is ready to take messages.
  */
-void StoreForwardModule::populatePSRAM()
+bool StoreForwardModule::openArchive()
 {
+#if SF_ARCHIVE_PERSIST
+    // Records are small, but each one costs some RAM in the index
+    if (!this->records)
+        this->records = SF_ARCHIVE_MAX_BYTES / 64;
+    bool ok = archive.open("/sf", SF_ARCHIVE_MAX_BYTES, this->records);
+#else
     /*
     For PSRAM usage, see:
         https://learn.upesy.com/en/programmation/psram.html#psram-tab
     */
 
-    LOG_DEBUG("Before PSRAM init: heap %d/%d PSRAM %d/%d", memGet.getFreeHeap(), memGet.getHeapSize(), memGet.getFreePsram(),
+    LOG_DEBUG("Before archive init: heap %d/%d PSRAM %d/%d", memGet.getFreeHeap(), memGet.getHeapSize(), memGet.getFreePsram(),
               memGet.getPsramSize());
 
-    /* Use a maximum of 3/4 the available PSRAM unless otherwise specified.
+    /* Use a maximum of 3/4 the available PSRAM for the archive segments, and a quarter of the heap for its index.
         Note: This needs to be done after every thing that would use PSRAM
     */
-    uint32_t numberOfPackets =
-        (this->records ? this->records : (((memGet.getFreePsram() / 4) * 3) / sizeof(PacketHistoryStruct)));
-    this->records = numberOfPackets;
-#if defined(ARCH_ESP32)
-    this->packetHistory = static_cast<PacketHistoryStruct *>(ps_calloc(numberOfPackets, sizeof(PacketHistoryStruct)));
-#elif defined(ARCH_PORTDUINO)
-    this->packetHistory = static_cast<PacketHistoryStruct *>(calloc(numberOfPackets, sizeof(PacketHistoryStruct)));
-
+    uint32_t maxBytes = (memGet.getFreePsram() / 4) * 3;
+    if (!this->records)
+        this->records = (memGet.getFreeHeap() / 4) / 32;
+    bool ok = archive.open(NULL, maxBytes, this->records);
 #endif
 
-    LOG_DEBUG("After PSRAM init: heap %d/%d PSRAM %d/%d", memGet.getFreeHeap(), memGet.getHeapSize(), memGet.getFreePsram(),
-              memGet.getPsramSize());
-    LOG_DEBUG("numberOfPackets for packetHistory - %u", numberOfPackets);
+    LOG_DEBUG("S&F archive keeps up to %u records", this->records);
+    return ok;
 }
 
 /**
@@ -130,20 +138,7 @@ void StoreForwardModule::historySend(uint32_t secAgo, uint32_t to)
  */
 uint32_t StoreForwardModule::getNumAvailablePackets(NodeNum dest, uint32_t last_time)
 {
-    uint32_t count = 0;
-    if (lastRequest.find(dest) == lastRequest.end()) {
-        lastRequest.emplace(dest, 0);
-    }
-    for (uint32_t i = lastRequest[dest]; i < this->packetHistoryTotalCount; i++) {
-        if (this->packetHistory[i].time && (this->packetHistory[i].time > last_time)) {
-            // Client is only interested in packets not from itself and only in broadcast packets or packets towards it.
-            if (this->packetHistory[i].from != dest &&
-                (this->packetHistory[i].to == NODENUM_BROADCAST || this->packetHistory[i].to == dest)) {
-                count++;
-            }
-        }
-    }
-    return count;
+    return archive.countFor(dest, lastRequest[dest], last_time);
 }
 
 /**
@@ -184,27 +179,8 @@ meshtastic_MeshPacket *StoreForwardModule::getForPhone()
  */
 void StoreForwardModule::historyAdd(const meshtastic_MeshPacket &mp)
 {
-    const auto &p = mp.decoded;
-
-    if (this->packetHistoryTotalCount == this->records) {
-        LOG_WARN("S&F - PSRAM Full. Starting overwrite");
-        this->packetHistoryTotalCount = 0;
-        for (auto &i : lastRequest) {
-            i.second = 0; // Clear the last request index for each client device
-        }
-    }
-
-    this->packetHistory[this->packetHistoryTotalCount].time = getTime();
-    this->packetHistory[this->packetHistoryTotalCount].to = mp.to;
-    this->packetHistory[this->packetHistoryTotalCount].channel = mp.channel;
-    this->packetHistory[this->packetHistoryTotalCount].from = getFrom(&mp);
-    this->packetHistory[this->packetHistoryTotalCount].id = mp.id;
-    this->packetHistory[this->packetHistoryTotalCount].reply_id = p.reply_id;
-    this->packetHistory[this->packetHistoryTotalCount].emoji = (bool)p.emoji;
-    this->packetHistory[this->packetHistoryTotalCount].payload_size = p.payload.size;
-    memcpy(this->packetHistory[this->packetHistoryTotalCount].payload, p.payload.bytes, meshtastic_Constants_DATA_PAYLOAD_LEN);
-
-    this->packetHistoryTotalCount++;
+    if (!archive.add(mp, getTime()))
+        LOG_WARN("S&F - Can't archive message");
 }
 
 /**
@@ -235,53 +211,55 @@ bool StoreForwardModule::sendPayload(NodeNum dest, uint32_t last_time)
  */
 meshtastic_MeshPacket *StoreForwardModule::preparePayload(NodeNum dest, uint32_t last_time, bool local)
 {
-    for (uint32_t i = lastRequest[dest]; i < this->packetHistoryTotalCount; i++) {
-        if (this->packetHistory[i].time && (this->packetHistory[i].time > last_time)) {
-            /*  Copy the messages that were received by the server in the last msAgo
-                to the packetHistoryTXQueue structure.
-                Client not interested in packets from itself and only in broadcast packets or packets towards it. */
-            if (this->packetHistory[i].from != dest &&
-                (this->packetHistory[i].to == NODENUM_BROADCAST || this->packetHistory[i].to == dest)) {
-
-                meshtastic_MeshPacket *p = allocDataPacket();
-
-                p->to = local ? this->packetHistory[i].to : dest; // PhoneAPI can handle original `to`
-                p->from = this->packetHistory[i].from;
-                p->id = this->packetHistory[i].id;
-                p->channel = this->packetHistory[i].channel;
-                p->decoded.reply_id = this->packetHistory[i].reply_id;
-                p->rx_time = this->packetHistory[i].time;
-                p->decoded.emoji = (uint32_t)this->packetHistory[i].emoji;
-
-                // Let's assume that if the server received the S&F request that the client is in range.
-                //   TODO: Make this configurable.
-                p->want_ack = false;
-
-                if (local) { // PhoneAPI gets normal TEXT_MESSAGE_APP
-                    p->decoded.portnum = meshtastic_PortNum_TEXT_MESSAGE_APP;
-                    memcpy(p->decoded.payload.bytes, this->packetHistory[i].payload, this->packetHistory[i].payload_size);
-                    p->decoded.payload.size = this->packetHistory[i].payload_size;
-                } else {
-                    meshtastic_StoreAndForward sf = meshtastic_StoreAndForward_init_zero;
-                    sf.which_variant = meshtastic_StoreAndForward_text_tag;
-                    sf.variant.text.size = this->packetHistory[i].payload_size;
-                    memcpy(sf.variant.text.bytes, this->packetHistory[i].payload, this->packetHistory[i].payload_size);
-                    if (this->packetHistory[i].to == NODENUM_BROADCAST) {
-                        sf.rr = meshtastic_StoreAndForward_RequestResponse_ROUTER_TEXT_BROADCAST;
-                    } else {
-                        sf.rr = meshtastic_StoreAndForward_RequestResponse_ROUTER_TEXT_DIRECT;
-                    }
-
-                    p->decoded.payload.size = pb_encode_to_bytes(p->decoded.payload.bytes, sizeof(p->decoded.payload.bytes),
-                                                                 &meshtastic_StoreAndForward_msg, &sf);
-                }
-
-                lastRequest[dest] = i + 1; // Update the last request index for the client device
-
-                return p;
+    meshtastic_MeshPacket *p = nullptr;
+    meshtastic_StoreAndForward sf = meshtastic_StoreAndForward_init_zero;
+    StoreForwardArchive::Record record;
+
+    /*  Client not interested in packets from itself and only in broadcast packets or packets towards it,
+        the archive only returns those. */
+    for (uint32_t seq = archive.nextFor(dest, lastRequest[dest], last_time); seq != archive.endSeq();
+         seq = archive.nextFor(dest, seq + 1, last_time)) {
+        lastRequest[dest] = seq + 1; // Update the last request sequence number for the client device
+
+        if (!p)
+            p = allocDataPacket();
+        // The payload goes straight from the archive into what we are going to send
+        if (!archive.read(seq, record, local ? p->decoded.payload.bytes : sf.variant.text.bytes))
+            continue;
+
+        p->to = local ? record.to : dest; // PhoneAPI can handle original `to`
+        p->from = record.from;
+        p->id = record.id;
+        p->channel = record.channel;
+        p->decoded.reply_id = record.replyId;
+        p->rx_time = record.time;
+        p->decoded.emoji = (uint32_t)record.emoji;
+
+        // Let's assume that if the server received the S&F request that the client is in range.
+        //   TODO: Make this configurable.
+        p->want_ack = false;
+
+        if (local) { // PhoneAPI gets normal TEXT_MESSAGE_APP
+            p->decoded.portnum = meshtastic_PortNum_TEXT_MESSAGE_APP;
+            p->decoded.payload.size = record.payloadSize;
+        } else {
+            sf.which_variant = meshtastic_StoreAndForward_text_tag;
+            sf.variant.text.size = record.payloadSize;
+            if (record.to == NODENUM_BROADCAST) {
+                sf.rr = meshtastic_StoreAndForward_RequestResponse_ROUTER_TEXT_BROADCAST;
+            } else {
+                sf.rr = meshtastic_StoreAndForward_RequestResponse_ROUTER_TEXT_DIRECT;
             }
+
+            p->decoded.payload.size = pb_encode_to_bytes(p->decoded.payload.bytes, sizeof(p->decoded.payload.bytes),
+                                                         &meshtastic_StoreAndForward_msg, &sf);
         }
+
+        return p;
     }
+
+    if (p)
+        packetPool.release(p);
     return nullptr;
 }
 
@@ -362,7 +340,7 @@ void StoreForwardModule::statsSend(uint32_t to)
     sf.rr = meshtastic_StoreAndForward_RequestResponse_ROUTER_STATS;
     sf.which_variant = meshtastic_StoreAndForward_stats_tag;
     sf.variant.stats.messages_total = this->records;
-    sf.variant.stats.messages_saved = this->packetHistoryTotalCount;
+    sf.variant.stats.messages_saved = archive.size();
     sf.variant.stats.messages_max = this->records;
     sf.variant.stats.up_time = millis() / 1000;
     sf.variant.stats.requests = this->requests;
@@ -399,7 +377,7 @@ ProcessMessage StoreForwardModule::handleReceived(const meshtastic_MeshPacket &m
                 }
             } else {
                 storeForwardModule->historyAdd(mp);
-                LOG_INFO("S&F stored. Message history contains %u records now", this->packetHistoryTotalCount);
+                LOG_INFO("S&F stored. Message history contains %u records now", archive.size());
             }
         } else if (!isFromUs(&mp) && mp.decoded.portnum == meshtastic_PortNum_STORE_FORWARD_APP) {
             auto &p = mp.decoded;
@@ -580,38 +558,39 @@ StoreForwardModule::StoreForwardModule()
         // Router
         if ((config.device.role == meshtastic_Config_DeviceConfig_Role_ROUTER || moduleConfig.store_forward.is_server)) {
             LOG_INFO("Init Store & Forward Module in Server mode");
-            if (memGet.getPsramSize() > 0) {
-                if (memGet.getFreePsram() >= 1024 * 1024) {
-
-                    // Do the startup here
+#if !SF_ARCHIVE_PERSIST
+            if (memGet.getPsramSize() == 0) {
+                LOG_INFO("S&F: device doesn't have PSRAM, Disable");
+            } else if (memGet.getFreePsram() < 1024 * 1024) {
+                LOG_INFO("S&F: not enough PSRAM free, Disable");
+            } else
+#endif
+            {
+                // Do the startup here
 
-                    // Maximum number of records to return.
-                    if (moduleConfig.store_forward.history_return_max)
-                        this->historyReturnMax = moduleConfig.store_forward.history_return_max;
+                // Maximum number of records to return.
+                if (moduleConfig.store_forward.history_return_max)
+                    this->historyReturnMax = moduleConfig.store_forward.history_return_max;
 
-                    // Maximum time window for records to return (in minutes)
-                    if (moduleConfig.store_forward.history_return_window)
-                        this->historyReturnWindow = moduleConfig.store_forward.history_return_window;
+                // Maximum time window for records to return (in minutes)
+                if (moduleConfig.store_forward.history_return_window)
+                    this->historyReturnWindow = moduleConfig.store_forward.history_return_window;
 
-                    // Maximum number of records to store in memory
-                    if (moduleConfig.store_forward.records)
-                        this->records = moduleConfig.store_forward.records;
+                // Maximum number of records to store
+                if (moduleConfig.store_forward.records)
+                    this->records = moduleConfig.store_forward.records;
 
-                    // send heartbeat advertising?
-                    if (moduleConfig.store_forward.heartbeat)
-                        this->heartbeat = moduleConfig.store_forward.heartbeat;
-                    else
-                        this->heartbeat = false;
+                // send heartbeat advertising?
+                if (moduleConfig.store_forward.heartbeat)
+                    this->heartbeat = moduleConfig.store_forward.heartbeat;
+                else
+                    this->heartbeat = false;
 
-                    // Popupate PSRAM with our data structures.
-                    this->populatePSRAM();
+                // Open (or resume) the message archive.
+                if (this->openArchive())
                     is_server = true;
-                } else {
-                    LOG_INFO(".");
-                    LOG_INFO("S&F: not enough PSRAM free, Disable");
-                }
-            } else {
-                LOG_INFO("S&F: device doesn't have PSRAM, Disable");
+                else
+                    LOG_ERROR("S&F: can't open the message archive, Disable");
             }
 
             // Client
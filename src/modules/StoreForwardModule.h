@@ -1,6 +1,7 @@
 #pragma once
 
 #include "ProtobufModule.h"
+#include "StoreForwardArchive.h"
 #include "concurrency/OSThread.h"
 #include "mesh/generated/meshtastic/storeforward.pb.h"
 
@@ -9,26 +10,13 @@
 #include <functional>
 #include <unordered_map>
 
-struct PacketHistoryStruct {
-    uint32_t time;
-    uint32_t to;
-    uint32_t from;
-    uint32_t id;
-    uint8_t channel;
-    uint32_t reply_id;
-    bool emoji;
-    uint8_t payload[meshtastic_Constants_DATA_PAYLOAD_LEN];
-    pb_size_t payload_size;
-};
-
 class StoreForwardModule : private concurrency::OSThread, public ProtobufModule<meshtastic_StoreAndForward>
 {
     bool busy = 0;
     uint32_t busyTo = 0;
     char routerMessage[meshtastic_Constants_DATA_PAYLOAD_LEN] = {0};
 
-    PacketHistoryStruct *packetHistory = 0;
-    uint32_t packetHistoryTotalCount = 0;
+    StoreForwardArchive archive;
     uint32_t last_time = 0;
     uint32_t requestCount = 0;
 
@@ -37,7 +25,7 @@ class StoreForwardModule : private concurrency::OSThread, public ProtobufModule<
     bool is_client = false;
     bool is_server = false;
 
-    // Unordered_map stores the last request for each nodeNum (`to` field)
+    // Unordered_map stores the archive sequence number each nodeNum (`to` field) continues from
     std::unordered_map<NodeNum, uint32_t> lastRequest;
 
   public:
@@ -58,13 +46,13 @@ class StoreForwardModule : private concurrency::OSThread, public ProtobufModule<
     /**
      * Send our payload into the mesh
      */
-    bool sendPayload(NodeNum dest = NODENUM_BROADCAST, uint32_t packetHistory_index = 0);
-    meshtastic_MeshPacket *preparePayload(NodeNum dest, uint32_t packetHistory_index, bool local = false);
+    bool sendPayload(NodeNum dest = NODENUM_BROADCAST, uint32_t last_time = 0);
+    meshtastic_MeshPacket *preparePayload(NodeNum dest, uint32_t last_time, bool local = false);
     void sendMessage(NodeNum dest, const meshtastic_StoreAndForward &payload);
     void sendMessage(NodeNum dest, meshtastic_StoreAndForward_RequestResponse rr);
     void sendErrorTextMessage(NodeNum dest, bool want_response);
     meshtastic_MeshPacket *getForPhone();
-    // Returns true if we are configured as server AND we could allocate PSRAM.
+    // Returns true if we are configured as server AND we could open the archive.
     bool isServer() { return is_server; }
 
     /*
@@ -81,13 +69,20 @@ class StoreForwardModule : private concurrency::OSThread, public ProtobufModule<
         }
     }
 
+    virtual bool getPortNums(std::vector<meshtastic_PortNum> &portNums) override
+    {
+        portNums.push_back(meshtastic_PortNum_TEXT_MESSAGE_APP);
+        portNums.push_back(meshtastic_PortNum_STORE_FORWARD_APP);
+        return true;
+    }
+
   private:
-    void populatePSRAM();
+    bool openArchive();
 
     // S&F Defaults
     uint32_t historyReturnMax = 25;     // Return maximum of 25 records by default.
     uint32_t historyReturnWindow = 240; // Return history of last 4 hours by default.
-    uint32_t records = 0;               // Calculated
+    uint32_t records = 0;               // Calculated, the most records the archive keeps
     bool heartbeat = false;             // No heartbeat.
 
     // stats
@@ -1,5 +1,6 @@
 #include "DeviceTelemetry.h"
 #include "../mesh/generated/meshtastic/telemetry.pb.h"
+#include "CryptoEngine.h"
 #include "Default.h"
 #include "MeshService.h"
 #include "NodeDB.h"
@@ -12,6 +13,9 @@
 #include <OLEDDisplay.h>
 #include <OLEDDisplayUi.h>
 #include <meshUtils.h>
+#if !MESHTASTIC_EXCLUDE_GPS
+#include "GPS.h"
+#endif
 
 #define MAGIC_USB_BATTERY_LEVEL 101
 
@@ -146,6 +150,41 @@ meshtastic_Telemetry DeviceTelemetryModule::getLocalStatsTelemetry()
 
     LOG_INFO("num_packets_tx=%i, num_packets_rx=%i, num_packets_rx_bad=%i", telemetry.variant.local_stats.num_packets_tx,
              telemetry.variant.local_stats.num_packets_rx, telemetry.variant.local_stats.num_packets_rx_bad);
+    // LocalStats has no fields for these yet, so only log them
+    LOG_INFO("rx_no_channel_for_hash=%u, rx_channel_decrypts=%u, rx_precheck_rejected=%u, rx_decode_rejected=%u",
+             decodeStats.noChannelForHash, decodeStats.channelDecrypts, decodeStats.precheckRejected, decodeStats.decodeRejected);
+    MemoryPoolStats poolStats = getPacketPoolStats();
+    LOG_INFO("packet_pool_live=%u, packet_pool_high_water=%u/%u, packet_pool_overflows=%u", poolStats.live,
+             poolStats.highWater, poolStats.capacity, poolStats.overflows);
+    AirtimeShare busiest[3];
+    size_t numBusiest = airTime->getTopNodes(busiest, 3);
+    for (size_t i = 0; i < numBusiest; i++)
+        LOG_INFO("airtime_top_node=0x%x, airtime_ms_last_hour=%u", busiest[i].key, busiest[i].msec);
+    if (router) {
+        const RouterRxStats &rx = router->getRxStats();
+        LOG_INFO("rx_batches=%u, rx_queue_depth_p50/p99=%u/%u, rx_usec_p50/p99 screen=%u/%u decode=%u/%u dispatch=%u/%u",
+                 rx.batches, rx.queueDepth.percentile(50), rx.queueDepth.percentile(99), rx.screenUsec.percentile(50),
+                 rx.screenUsec.percentile(99), rx.decodeUsec.percentile(50), rx.decodeUsec.percentile(99),
+                 rx.dispatchUsec.percentile(50), rx.dispatchUsec.percentile(99));
+    }
+    const MeshModule *busiestModules[3];
+    size_t numBusiestModules = MeshModule::getBusiestModules(busiestModules, 3);
+    for (size_t i = 0; i < numBusiestModules; i++) {
+        const MeshModuleStats &stats = busiestModules[i]->getStats();
+        LOG_INFO("module=%s, calls=%u, handle_ms_total=%u, handle_usec_max=%u", busiestModules[i]->getName(), stats.calls,
+                 (uint32_t)(stats.totalUsec / 1000), stats.maxUsec);
+    }
+#if !MESHTASTIC_EXCLUDE_GPS
+    if (gps) {
+        GPSInitStats gpsStats = gps->getInitStats();
+        LOG_INFO("gps_init_ms=%u, gps_from_cache=%d, gps_first_fix_ms=%u, gps_max_run_usec=%u", gpsStats.initMsec,
+                 gpsStats.fromCache, gpsStats.firstFixMsec, gpsStats.maxRunUsec);
+    }
+#endif
+#if !(MESHTASTIC_EXCLUDE_PKI)
+    LOG_INFO("pki_shared_key_cache_hits=%u, pki_shared_key_cache_misses=%u", crypto->sharedKeyCacheHits,
+             crypto->sharedKeyCacheMisses);
+#endif
 
     return telemetry;
 }
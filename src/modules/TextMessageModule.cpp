@@ -26,4 +26,10 @@ ProcessMessage TextMessageModule::handleReceived(const meshtastic_MeshPacket &mp
 bool TextMessageModule::wantPacket(const meshtastic_MeshPacket *p)
 {
     return MeshService::isTextPayload(p);
+}
+
+bool TextMessageModule::getPortNums(std::vector<meshtastic_PortNum> &portNums)
+{
+    MeshService::getTextPortNums(portNums);
+    return true;
 }
\ No newline at end of file
@@ -0,0 +1,215 @@
+#include "JsonDownlink.h"
+#include "mesh-pb-constants.h"
+#include "serialization/JsonReader.h"
+#include <string.h>
+
+namespace
+{
+
+enum PayloadKind : uint8_t { PAYLOAD_NONE, PAYLOAD_STRING, PAYLOAD_OBJECT, PAYLOAD_OTHER };
+
+/// A JSON number that is a whole number in the range of a uint32_t
+bool asUInt32(double v, uint32_t &out)
+{
+    if (!(v >= 0 && v <= UINT32_MAX) || v != (double)(uint32_t)v)
+        return false;
+    out = (uint32_t)v;
+    return true;
+}
+
+/// Same for int32_t, positions are signed
+bool asInt32(double v, int32_t &out)
+{
+    if (!(v >= INT32_MIN && v <= INT32_MAX) || v != (double)(int32_t)v)
+        return false;
+    out = (int32_t)v;
+    return true;
+}
+
+/// Read the "payload" object of a sendposition, the reader is just past its {
+bool readPosition(JsonReader &reader, meshtastic_Position &pos)
+{
+    pos = meshtastic_Position_init_default;
+    while (true) {
+        JsonToken token = reader.next();
+        if (token == JSON_END_OBJECT)
+            return true;
+        if (token != JSON_KEY)
+            return false;
+
+        int32_t *field = NULL;
+        bool *has = NULL;
+        uint32_t *time = NULL;
+        if (reader.keyIs("latitude_i")) {
+            field = &pos.latitude_i;
+            has = &pos.has_latitude_i;
+        } else if (reader.keyIs("longitude_i")) {
+            field = &pos.longitude_i;
+            has = &pos.has_longitude_i;
+        } else if (reader.keyIs("altitude")) {
+            field = &pos.altitude;
+            has = &pos.has_altitude;
+        } else if (reader.keyIs("time")) {
+            time = &pos.time;
+        }
+
+        if (!field && !time) {
+            if (!reader.skipValue())
+                return false;
+            continue;
+        }
+        token = reader.next();
+        if (token == JSON_BEGIN_OBJECT || token == JSON_BEGIN_ARRAY) {
+            // Not a number, ignored like before, but it still has to be read past
+            if (!reader.skipContainer())
+                return false;
+            continue;
+        }
+        if (token == JSON_ERROR || token == JSON_END_OBJECT)
+            return false;
+        if (token != JSON_NUMBER)
+            continue;
+        if (field && asInt32(reader.getNumber(), *field))
+            *has = true;
+        else if (time)
+            asUInt32(reader.getNumber(), *time);
+    }
+}
+
+} // namespace
+
+JsonDownlinkResult decodeJsonDownlink(const char *json, size_t len, NodeNum ourNode, const char *ourId, uint8_t numChannels,
+                                      meshtastic_MeshPacket &p)
+{
+    JsonReader reader(json, len);
+    JsonToken first = reader.next();
+    if (first != JSON_BEGIN_OBJECT) {
+        // Any other JSON value is no envelope, anything else no JSON
+        if (first == JSON_ERROR || (first == JSON_BEGIN_ARRAY && !reader.skipContainer()) || reader.next() != JSON_END)
+            return JSON_DOWNLINK_MALFORMED;
+        return JSON_DOWNLINK_BAD_ENVELOPE;
+    }
+
+    bool hasFrom = false, fromUs = false, fromOurselves = false, badHopLimit = false;
+    bool hasType = false;
+    char type[16] = "";
+    PayloadKind payload = PAYLOAD_NONE;
+    size_t textLength = 0;
+    meshtastic_Position pos = meshtastic_Position_init_default;
+
+    while (true) {
+        JsonToken token = reader.next();
+        if (token == JSON_END_OBJECT)
+            break;
+        if (token != JSON_KEY)
+            return JSON_DOWNLINK_MALFORMED;
+
+        // Members may come in any order and a later one wins, so each only records what it found
+        if (reader.keyIs("payload")) {
+            token = reader.next();
+            if (token == JSON_STRING) {
+                payload = PAYLOAD_STRING;
+                textLength = reader.copyString((char *)p.decoded.payload.bytes, sizeof(p.decoded.payload.bytes));
+            } else if (token == JSON_BEGIN_OBJECT) {
+                payload = PAYLOAD_OBJECT;
+                if (!readPosition(reader, pos))
+                    return JSON_DOWNLINK_MALFORMED;
+            } else if (token == JSON_BEGIN_ARRAY) {
+                payload = PAYLOAD_OTHER;
+                if (!reader.skipContainer())
+                    return JSON_DOWNLINK_MALFORMED;
+            } else if (token == JSON_ERROR || token == JSON_END_OBJECT) {
+                return JSON_DOWNLINK_MALFORMED;
+            } else {
+                payload = PAYLOAD_OTHER;
+            }
+            continue;
+        }
+
+        enum { FROM, TO, CHANNEL, HOP_LIMIT, TYPE, SENDER, OTHER } member = OTHER;
+        if (reader.keyIs("from"))
+            member = FROM;
+        else if (reader.keyIs("to"))
+            member = TO;
+        else if (reader.keyIs("channel"))
+            member = CHANNEL;
+        else if (reader.keyIs("hopLimit"))
+            member = HOP_LIMIT;
+        else if (reader.keyIs("type"))
+            member = TYPE;
+        else if (reader.keyIs("sender"))
+            member = SENDER;
+
+        if (member == OTHER) {
+            if (!reader.skipValue())
+                return JSON_DOWNLINK_MALFORMED;
+            continue;
+        }
+
+        token = reader.next();
+        if (token == JSON_BEGIN_OBJECT || token == JSON_BEGIN_ARRAY) {
+            if (!reader.skipContainer())
+                return JSON_DOWNLINK_MALFORMED;
+        } else if (token == JSON_ERROR || token == JSON_END_OBJECT) {
+            return JSON_DOWNLINK_MALFORMED;
+        }
+        bool isNumber = token == JSON_NUMBER;
+        double number = isNumber ? reader.getNumber() : 0;
+        uint32_t value;
+
+        switch (member) {
+        case FROM:
+            hasFrom = isNumber;
+            fromUs = isNumber && number == (double)ourNode;
+            break;
+        case TO:
+            if (isNumber && asUInt32(number, value))
+                p.to = value;
+            break;
+        case CHANNEL:
+            if (isNumber && asUInt32(number, value) && value < numChannels)
+                p.channel = value;
+            break;
+        case HOP_LIMIT:
+            badHopLimit = !isNumber;
+            if (isNumber && asUInt32(number, value) && value <= UINT8_MAX)
+                p.hop_limit = value;
+            break;
+        case TYPE:
+            hasType = token == JSON_STRING;
+            type[0] = 0;
+            if (hasType && reader.copyString(type, sizeof(type)) >= sizeof(type))
+                type[0] = 0; // Longer than any type we know
+            break;
+        case SENDER: {
+            // A non-string sender never matches, as before
+            char sender[sizeof(meshtastic_User::id)];
+            fromOurselves = token == JSON_STRING && reader.copyString(sender, sizeof(sender)) < sizeof(sender) &&
+                            strcmp(sender, ourId) == 0;
+            break;
+        }
+        default:
+            break;
+        }
+    }
+    if (reader.next() != JSON_END)
+        return JSON_DOWNLINK_MALFORMED;
+
+    if (fromOurselves || badHopLimit || !hasFrom || !fromUs || !hasType || payload == PAYLOAD_NONE)
+        return JSON_DOWNLINK_BAD_ENVELOPE;
+
+    if (strcmp(type, "sendtext") == 0 && payload == PAYLOAD_STRING) {
+        if (textLength > sizeof(p.decoded.payload.bytes))
+            return JSON_DOWNLINK_TOO_LONG;
+        p.decoded.portnum = meshtastic_PortNum_TEXT_MESSAGE_APP;
+        p.decoded.payload.size = textLength;
+        return JSON_DOWNLINK_OK;
+    }
+    if (strcmp(type, "sendposition") == 0 && payload == PAYLOAD_OBJECT) {
+        p.decoded.portnum = meshtastic_PortNum_POSITION_APP;
+        p.decoded.payload.size =
+            pb_encode_to_bytes(p.decoded.payload.bytes, sizeof(p.decoded.payload.bytes), &meshtastic_Position_msg, &pos);
+        return JSON_DOWNLINK_OK;
+    }
+    return JSON_DOWNLINK_UNSUPPORTED;
+}
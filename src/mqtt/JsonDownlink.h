@@ -0,0 +1,24 @@
+#pragma once
+
+#include "MeshTypes.h"
+#include <stddef.h>
+
+enum JsonDownlinkResult : uint8_t {
+    JSON_DOWNLINK_OK,
+    JSON_DOWNLINK_MALFORMED,    // Not valid JSON, too deep or too long
+    JSON_DOWNLINK_BAD_ENVELOPE, // Not from us, from ourselves (sender), or missing from, type or payload
+    JSON_DOWNLINK_UNSUPPORTED,  // A type other than sendtext with a string or sendposition with an object payload
+    JSON_DOWNLINK_TOO_LONG,     // sendtext with more text than fits in a packet
+};
+
+/**
+ * Decode a JSON envelope published to the MQTT json downlink topic, like
+ *   {"from": 123, "type": "sendtext", "payload": "hello", "channel": 0, "to": 4294967295, "hopLimit": 3}
+ * straight into p: decoded.portnum and payload, and to, channel and hop_limit when they are given.  Nothing else of p is
+ * touched, so it can come from Router::allocForSending().  The input is read in place with JsonReader, nothing is allocated.
+ *
+ * Like the JSONValue based decoding this replaces, the envelope must come "from" ourNode, a "sender" equal to ourId marks
+ * a message we published ourselves, and a "channel" of numChannels or more is ignored.
+ */
+JsonDownlinkResult decodeJsonDownlink(const char *json, size_t len, NodeNum ourNode, const char *ourId, uint8_t numChannels,
+                                      meshtastic_MeshPacket &p);
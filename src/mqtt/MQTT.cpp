@@ -25,12 +25,16 @@
 #endif // HAS_ETHERNET
 #include "Default.h"
 #if !defined(ARCH_NRF52) || NRF52_USE_JSON
-#include "serialization/JSON.h"
+#include "JsonDownlink.h"
 #include "serialization/MeshPacketSerializer.h"
 #endif
 #include <Throttle.h>
 #include <assert.h>
 #include <utility>
+#if MQTT_SPILL_QUEUE
+#include "FSCommon.h"
+#include "SPILock.h"
+#endif
 
 #include <IPAddress.h>
 #if defined(ARCH_PORTDUINO)
@@ -51,6 +55,24 @@ static uint8_t bytes[meshtastic_MqttClientProxyMessage_size + 30]; // 12 for cha
 
 static bool isMqttServerAddressPrivate = false;
 
+#if MQTT_SPILL_QUEUE
+static const char *spillFileName = "/mqtt_spill.bin";
+
+// On-disk layout of a spilled QueueEntry, the four strings follow in this order
+struct SpillHeader {
+    uint16_t topicLen;
+    uint16_t envLen;
+    uint16_t jsonTopicLen;
+    uint16_t jsonLen;
+};
+
+template <class S> bool readSpilled(File &f, S &s, size_t len)
+{
+    s.resize(len);
+    return len == 0 || f.read((uint8_t *)&s[0], len) == len;
+}
+#endif
+
 inline void onReceiveProto(char *topic, byte *payload, size_t length)
 {
     const DecodedServiceEnvelope e(payload, length);
@@ -123,90 +145,32 @@ inline void onReceiveProto(char *topic, byte *payload, size_t length)
 }
 
 #if !defined(ARCH_NRF52) || NRF52_USE_JSON
-// returns true if this is a valid JSON envelope which we accept on downlink
-inline bool isValidJsonEnvelope(JSONObject &json)
-{
-    // if "sender" is provided, avoid processing packets we uplinked
-    return (json.find("sender") != json.end() ? (json["sender"]->AsString().compare(owner.id) != 0) : true) &&
-           (json.find("hopLimit") != json.end() ? json["hopLimit"]->IsNumber() : true) && // hop limit should be a number
-           (json.find("from") != json.end()) && json["from"]->IsNumber() &&
-           (json["from"]->AsNumber() == nodeDB->getNodeNum()) &&            // only accept message if the "from" is us
-           (json.find("type") != json.end()) && json["type"]->IsString() && // should specify a type
-           (json.find("payload") != json.end());                            // should have a payload
-}
-
 inline void onReceiveJson(byte *payload, size_t length)
 {
-    char payloadStr[length + 1];
-    memcpy(payloadStr, payload, length);
-    payloadStr[length] = 0; // null terminated string
-    std::unique_ptr<JSONValue> json_value(JSON::Parse(payloadStr));
-    if (json_value == nullptr) {
-        LOG_ERROR("JSON received payload on MQTT but not a valid JSON");
+    meshtastic_MeshPacket *p = router->allocForSending();
+    JsonDownlinkResult result = decodeJsonDownlink((const char *)payload, length, nodeDB->getNodeNum(), owner.id,
+                                                   channels.getNumChannels(), *p);
+    switch (result) {
+    case JSON_DOWNLINK_OK:
+        if (p->decoded.portnum == meshtastic_PortNum_TEXT_MESSAGE_APP)
+            LOG_INFO("JSON payload %.*s, length %u", (int)p->decoded.payload.size, (const char *)p->decoded.payload.bytes,
+                     p->decoded.payload.size);
+        service->sendToMesh(p, RX_SRC_LOCAL);
         return;
-    }
-
-    JSONObject json;
-    json = json_value->AsObject();
-
-    if (!isValidJsonEnvelope(json)) {
+    case JSON_DOWNLINK_MALFORMED:
+        LOG_ERROR("JSON received payload on MQTT but not a valid JSON");
+        break;
+    case JSON_DOWNLINK_BAD_ENVELOPE:
         LOG_ERROR("JSON received payload on MQTT but not a valid envelope");
-        return;
-    }
-
-    // this is a valid envelope
-    if (json["type"]->AsString().compare("sendtext") == 0 && json["payload"]->IsString()) {
-        std::string jsonPayloadStr = json["payload"]->AsString();
-        LOG_INFO("JSON payload %s, length %u", jsonPayloadStr.c_str(), jsonPayloadStr.length());
-
-        // construct protobuf data packet using TEXT_MESSAGE, send it to the mesh
-        meshtastic_MeshPacket *p = router->allocForSending();
-        p->decoded.portnum = meshtastic_PortNum_TEXT_MESSAGE_APP;
-        if (json.find("channel") != json.end() && json["channel"]->IsNumber() &&
-            (json["channel"]->AsNumber() < channels.getNumChannels()))
-            p->channel = json["channel"]->AsNumber();
-        if (json.find("to") != json.end() && json["to"]->IsNumber())
-            p->to = json["to"]->AsNumber();
-        if (json.find("hopLimit") != json.end() && json["hopLimit"]->IsNumber())
-            p->hop_limit = json["hopLimit"]->AsNumber();
-        if (jsonPayloadStr.length() <= sizeof(p->decoded.payload.bytes)) {
-            memcpy(p->decoded.payload.bytes, jsonPayloadStr.c_str(), jsonPayloadStr.length());
-            p->decoded.payload.size = jsonPayloadStr.length();
-            service->sendToMesh(p, RX_SRC_LOCAL);
-        } else {
-            LOG_WARN("Received MQTT json payload too long, drop");
-        }
-    } else if (json["type"]->AsString().compare("sendposition") == 0 && json["payload"]->IsObject()) {
-        // invent the "sendposition" type for a valid envelope
-        JSONObject posit;
-        posit = json["payload"]->AsObject(); // get nested JSON Position
-        meshtastic_Position pos = meshtastic_Position_init_default;
-        if (posit.find("latitude_i") != posit.end() && posit["latitude_i"]->IsNumber())
-            pos.latitude_i = posit["latitude_i"]->AsNumber();
-        if (posit.find("longitude_i") != posit.end() && posit["longitude_i"]->IsNumber())
-            pos.longitude_i = posit["longitude_i"]->AsNumber();
-        if (posit.find("altitude") != posit.end() && posit["altitude"]->IsNumber())
-            pos.altitude = posit["altitude"]->AsNumber();
-        if (posit.find("time") != posit.end() && posit["time"]->IsNumber())
-            pos.time = posit["time"]->AsNumber();
-
-        // construct protobuf data packet using POSITION, send it to the mesh
-        meshtastic_MeshPacket *p = router->allocForSending();
-        p->decoded.portnum = meshtastic_PortNum_POSITION_APP;
-        if (json.find("channel") != json.end() && json["channel"]->IsNumber() &&
-            (json["channel"]->AsNumber() < channels.getNumChannels()))
-            p->channel = json["channel"]->AsNumber();
-        if (json.find("to") != json.end() && json["to"]->IsNumber())
-            p->to = json["to"]->AsNumber();
-        if (json.find("hopLimit") != json.end() && json["hopLimit"]->IsNumber())
-            p->hop_limit = json["hopLimit"]->AsNumber();
-        p->decoded.payload.size =
-            pb_encode_to_bytes(p->decoded.payload.bytes, sizeof(p->decoded.payload.bytes), &meshtastic_Position_msg,
-                               &pos); // make the Data protobuf from position
-        service->sendToMesh(p, RX_SRC_LOCAL);
-    } else {
+        break;
+    case JSON_DOWNLINK_TOO_LONG:
+        LOG_WARN("Received MQTT json payload too long, drop");
+        break;
+    default:
         LOG_DEBUG("JSON ignore downlink message with unsupported type");
+        break;
     }
+    packetPool.release(p);
 }
 #endif
 
@@ -417,6 +381,21 @@ MQTT::MQTT() : concurrency::OSThread("mqtt"), mqttQueue(MAX_MQTT_QUEUE)
             pubSub.setCallback(mqttCallback);
 #endif
 
+#if MQTT_SPILL_QUEUE
+        {
+            // Pick up whatever a previous run couldn't deliver
+            concurrency::LockGuard g(spiLock);
+            if (FSCom.exists(spillFileName)) {
+                File f = FSCom.open(spillFileName, FILE_O_READ);
+                if (f) {
+                    spillSize = f.size();
+                    f.close();
+                    LOG_INFO("MQTT resume %u bytes of spilled messages", spillSize);
+                }
+            }
+        }
+#endif
+
         if (moduleConfig.mqtt.proxy_to_client_enabled) {
             LOG_INFO("MQTT configured to use client proxy");
             enabled = true;
@@ -594,7 +573,10 @@ int32_t MQTT::runOnce()
         }
 
         powerFSM.trigger(EVENT_CONTACT_FROM_PHONE); // Suppress entering light sleep (because that would turn off bluetooth)
-        return 20;
+
+        // Keep draining whatever piled up during an outage, a time slice per run
+        publishQueuedMessages();
+        return hasQueuedMessages() ? 0 : 20;
     }
 #endif
     return 30000;
@@ -647,39 +629,137 @@ void MQTT::publishNodeInfo()
 }
 void MQTT::publishQueuedMessages()
 {
-    if (mqttQueue.isEmpty())
-        return;
+    const uint32_t start = millis();
+    size_t count = 0;
 
-    LOG_DEBUG("Publish enqueued MQTT message");
-    const std::unique_ptr<QueueEntry> entry(mqttQueue.dequeuePtr(0));
-    LOG_INFO("publish %s, %u bytes from queue", entry->topic.c_str(), entry->envBytes.size());
-    publish(entry->topic.c_str(), entry->envBytes.data(), entry->envBytes.size(), false);
+    while (hasQueuedMessages()) {
+        // The client proxy drops its oldest message when full, so leave room for the JSON copy too
+        if (moduleConfig.mqtt.proxy_to_client_enabled ? service->numFreeMqttClientProxyMessages() < 2 : !isConnectedDirectly())
+            break;
 
-#if !defined(ARCH_NRF52) ||                                                                                                      \
-    defined(NRF52_USE_JSON) // JSON is not supported on nRF52, see issue #2804 ### Fixed by using ArduinoJson ###
-    if (!moduleConfig.mqtt.json_enabled)
-        return;
+        const std::unique_ptr<QueueEntry> entry(dequeueMessage());
+        if (!entry)
+            break;
+        publishEntry(*entry);
+        count++;
 
-    // handle json topic
-    const DecodedServiceEnvelope env(entry->envBytes.data(), entry->envBytes.size());
-    if (!env.validDecode || env.packet == NULL || env.channel_id == NULL)
-        return;
+        if (!Throttle::isWithinTimespanMs(start, MQTT_DRAIN_BUDGET_MSEC))
+            break;
+    }
 
-    auto jsonString = MeshPacketSerializer::JsonSerialize(env.packet);
-    if (jsonString.length() == 0)
-        return;
+    if (count)
+        LOG_DEBUG("Published %u queued MQTT messages in %u ms", count, millis() - start);
+}
 
-    std::string topicJson;
-    if (env.packet->pki_encrypted) {
-        topicJson = jsonTopic + "PKI/" + owner.id;
-    } else {
-        topicJson = jsonTopic + env.channel_id + "/" + owner.id;
+void MQTT::publishEntry(const QueueEntry &entry)
+{
+    LOG_INFO("publish %s, %u bytes from queue", entry.topic.c_str(), entry.envBytes.size());
+    publish(entry.topic.c_str(), entry.envBytes.data(), entry.envBytes.size(), false);
+
+    if (!entry.jsonTopic.empty()) {
+        LOG_INFO("JSON publish message to %s, %u bytes: %s", entry.jsonTopic.c_str(), entry.json.length(), entry.json.c_str());
+        publish(entry.jsonTopic.c_str(), entry.json.c_str(), false);
     }
-    LOG_INFO("JSON publish message to %s, %u bytes: %s", topicJson.c_str(), jsonString.length(), jsonString.c_str());
-    publish(topicJson.c_str(), jsonString.c_str(), false);
-#endif // ARCH_NRF52 NRF52_USE_JSON
 }
 
+bool MQTT::hasQueuedMessages()
+{
+#if MQTT_SPILL_QUEUE
+    if (spillReadPos < spillSize)
+        return true;
+#endif
+    return !mqttQueue.isEmpty();
+}
+
+void MQTT::enqueueMessage(QueueEntry *entry)
+{
+    if (mqttQueue.numFree() == 0) {
+        const std::unique_ptr<QueueEntry> oldest(mqttQueue.dequeuePtr(0));
+#if MQTT_SPILL_QUEUE
+        if (spillEntry(*oldest))
+            LOG_DEBUG("MQTT queue is full, spill oldest to %s", spillFileName);
+        else
+#endif
+            LOG_WARN("MQTT queue is full, discard oldest");
+    }
+    if (!mqttQueue.enqueue(entry, 0)) {
+        // Can't happen with room made above, but don't leak the entry if it does
+        LOG_ERROR("MQTT queue enqueue failed, discard message");
+        delete entry;
+    }
+}
+
+MQTT::QueueEntry *MQTT::dequeueMessage()
+{
+#if MQTT_SPILL_QUEUE
+    // Everything spilled is older than what is still in memory
+    if (spillReadPos < spillSize)
+        return unspillEntry();
+#endif
+    return mqttQueue.dequeuePtr(0);
+}
+
+#if MQTT_SPILL_QUEUE
+bool MQTT::spillEntry(const QueueEntry &entry)
+{
+    const SpillHeader header = {(uint16_t)entry.topic.size(), (uint16_t)entry.envBytes.size(), (uint16_t)entry.jsonTopic.size(),
+                                (uint16_t)entry.json.size()};
+    const uint32_t len = sizeof(header) + header.topicLen + header.envLen + header.jsonTopicLen + header.jsonLen;
+    if (spillSize + len > MQTT_SPILL_MAX_BYTES)
+        return false;
+
+    concurrency::LockGuard g(spiLock);
+    File f = FSCom.open(spillFileName, FILE_O_APPEND);
+    if (!f)
+        return false;
+    size_t written = f.write((const uint8_t *)&header, sizeof(header));
+    written += f.write((const uint8_t *)entry.topic.data(), header.topicLen);
+    written += f.write(entry.envBytes.data(), header.envLen);
+    written += f.write((const uint8_t *)entry.jsonTopic.data(), header.jsonTopicLen);
+    written += f.write((const uint8_t *)entry.json.data(), header.jsonLen);
+    f.close();
+
+    // A short write leaves a torn record behind, unspillEntry() notices and drops the rest of the file
+    spillSize += written;
+    return written == len;
+}
+
+MQTT::QueueEntry *MQTT::unspillEntry()
+{
+    std::unique_ptr<QueueEntry> entry(new QueueEntry);
+    SpillHeader header;
+    bool ok = false;
+    {
+        concurrency::LockGuard g(spiLock);
+        File f = FSCom.open(spillFileName, FILE_O_READ);
+        if (f) {
+            ok = f.seek(spillReadPos) && f.read((uint8_t *)&header, sizeof(header)) == sizeof(header) &&
+                 readSpilled(f, entry->topic, header.topicLen) && readSpilled(f, entry->envBytes, header.envLen) &&
+                 readSpilled(f, entry->jsonTopic, header.jsonTopicLen) && readSpilled(f, entry->json, header.jsonLen);
+            f.close();
+        }
+    }
+
+    if (!ok) {
+        LOG_WARN("MQTT spill file is damaged, drop %u bytes", spillSize - spillReadPos);
+        resetSpill();
+        return NULL;
+    }
+
+    spillReadPos += sizeof(header) + header.topicLen + header.envLen + header.jsonTopicLen + header.jsonLen;
+    if (spillReadPos >= spillSize)
+        resetSpill();
+    return entry.release();
+}
+
+void MQTT::resetSpill()
+{
+    concurrency::LockGuard g(spiLock);
+    FSCom.remove(spillFileName);
+    spillReadPos = spillSize = 0;
+}
+#endif
+
 void MQTT::onSend(const meshtastic_MeshPacket &mp_encrypted, const meshtastic_MeshPacket &mp_decoded, ChannelIndex chIndex)
 {
     if (mp_encrypted.via_mqtt)
@@ -736,34 +816,33 @@ void MQTT::onSend(const meshtastic_MeshPacket &mp_encrypted, const meshtastic_Me
     size_t numBytes = pb_encode_to_bytes(bytes, sizeof(bytes), &meshtastic_ServiceEnvelope_msg, &env);
     std::string topic = cryptTopic + channelId + "/" + owner.id;
 
+    std::string jsonString, topicJson;
+#if !defined(ARCH_NRF52) ||                                                                                                      \
+    defined(NRF52_USE_JSON) // JSON is not supported on nRF52, see issue #2804 ### Fixed by using ArduinoJson ###
+    if (moduleConfig.mqtt.json_enabled) {
+        // Serialize now, from the packet we already have decoded, even if the publish has to wait in the queue
+        jsonString = MeshPacketSerializer::JsonSerialize(&mp_decoded);
+        if (jsonString.length() != 0)
+            topicJson = jsonTopic + channelId + "/" + owner.id;
+    }
+#endif // ARCH_NRF52 NRF52_USE_JSON
+
     if (moduleConfig.mqtt.proxy_to_client_enabled || this->isConnectedDirectly()) {
         LOG_DEBUG("MQTT Publish %s, %u bytes", topic.c_str(), numBytes);
         publish(topic.c_str(), bytes, numBytes, false);
 
-#if !defined(ARCH_NRF52) ||                                                                                                      \
-    defined(NRF52_USE_JSON) // JSON is not supported on nRF52, see issue #2804 ### Fixed by using ArduinoJson ###
-        if (!moduleConfig.mqtt.json_enabled)
-            return;
-        // handle json topic
-        auto jsonString = MeshPacketSerializer::JsonSerialize(&mp_decoded);
-        if (jsonString.length() == 0)
-            return;
-        std::string topicJson = jsonTopic + channelId + "/" + owner.id;
-        LOG_INFO("JSON publish message to %s, %u bytes: %s", topicJson.c_str(), jsonString.length(), jsonString.c_str());
-        publish(topicJson.c_str(), jsonString.c_str(), false);
-#endif // ARCH_NRF52 NRF52_USE_JSON
+        if (!topicJson.empty()) {
+            LOG_INFO("JSON publish message to %s, %u bytes: %s", topicJson.c_str(), jsonString.length(), jsonString.c_str());
+            publish(topicJson.c_str(), jsonString.c_str(), false);
+        }
     } else {
         LOG_INFO("MQTT not connected, queue packet");
-        QueueEntry *entry;
-        if (mqttQueue.numFree() == 0) {
-            LOG_WARN("MQTT queue is full, discard oldest");
-            entry = mqttQueue.dequeuePtr(0);
-        } else {
-            entry = new QueueEntry;
-        }
+        QueueEntry *entry = new QueueEntry;
         entry->topic = std::move(topic);
         entry->envBytes.assign(bytes, numBytes);
-        assert(mqttQueue.enqueue(entry, 0));
+        entry->jsonTopic = std::move(topicJson);
+        entry->json = std::move(jsonString);
+        enqueueMessage(entry);
     }
 }
 
@@ -24,7 +24,31 @@
 #include <memory>
 #endif
 
+#ifndef MAX_MQTT_QUEUE
+#ifdef BOARD_HAS_PSRAM
+#define MAX_MQTT_QUEUE 128 // entries are heap allocated, PSRAM boards can ride out a longer broker outage
+#else
 #define MAX_MQTT_QUEUE 16
+#endif
+#endif
+
+// How long one runOnce() may spend publishing queued messages once the broker is back
+#ifndef MQTT_DRAIN_BUDGET_MSEC
+#define MQTT_DRAIN_BUDGET_MSEC 50
+#endif
+
+// Spill the oldest queued messages to the filesystem instead of dropping them when the queue is full
+#ifndef MQTT_SPILL_QUEUE
+#ifdef ARCH_PORTDUINO
+#define MQTT_SPILL_QUEUE 1
+#else
+#define MQTT_SPILL_QUEUE 0
+#endif
+#endif
+
+#ifndef MQTT_SPILL_MAX_BYTES
+#define MQTT_SPILL_MAX_BYTES (1024 * 1024)
+#endif
 
 /**
  * Our wrapper/singleton for sending/receiving MQTT "udp" packets.  This object isolates the MQTT protocol implementation from
@@ -68,9 +92,17 @@ class MQTT : private concurrency::OSThread
     struct QueueEntry {
         std::string topic;
         std::basic_string<uint8_t> envBytes; // binary/pb_encode_to_bytes ServiceEnvelope
+        std::string jsonTopic;               // empty if there is no JSON copy to publish
+        std::string json;                    // serialized from the decoded packet when it was queued
     };
     PointerQueue<QueueEntry> mqttQueue;
 
+#if MQTT_SPILL_QUEUE
+    // Entries spilled to the spill file, all older than the ones in mqttQueue.  Consumed from spillReadPos, removed once empty.
+    uint32_t spillReadPos = 0;
+    uint32_t spillSize = 0;
+#endif
+
     int reconnectCount = 0;
     bool isConfiguredForDefaultServer = true;
     bool isConfiguredForDefaultRootTopic = true;
@@ -127,8 +159,26 @@ class MQTT : private concurrency::OSThread
     /// Called when a new publish arrives from the MQTT server
     void onReceive(char *topic, byte *payload, size_t length);
 
+    /// Publish queued messages, oldest first, until the queue is empty or MQTT_DRAIN_BUDGET_MSEC is used up
     void publishQueuedMessages();
 
+    /// @return true if there are queued messages waiting for the broker
+    bool hasQueuedMessages();
+
+    /// Queue a message while we can't publish, making room by spilling or dropping the oldest one if needed
+    void enqueueMessage(QueueEntry *entry);
+
+    /// @return the oldest queued message, or NULL
+    QueueEntry *dequeueMessage();
+
+    void publishEntry(const QueueEntry &entry);
+
+#if MQTT_SPILL_QUEUE
+    bool spillEntry(const QueueEntry &entry);
+    QueueEntry *unspillEntry();
+    void resetSpill();
+#endif
+
     void publishNodeInfo();
 
     // Check if we should report unencrypted information about our node for consumption by a map
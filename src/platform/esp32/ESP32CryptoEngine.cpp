@@ -3,15 +3,54 @@
 
 #include "mbedtls/aes.h"
 
-class ESP32CryptoEngine : public CryptoEngine
+/// mbedTLS AES, which the ESP32 runs on its AES peripheral
+class MbedTLSAESContext : public AESContext
 {
-
     mbedtls_aes_context aes;
 
   public:
-    ESP32CryptoEngine() { mbedtls_aes_init(&aes); }
+    MbedTLSAESContext(const uint8_t *key, size_t keyLen)
+    {
+        mbedtls_aes_init(&aes);
+        mbedtls_aes_setkey_enc(&aes, key, keyLen * 8);
+    }
+
+    ~MbedTLSAESContext() { mbedtls_aes_free(&aes); }
+
+    virtual void encryptBlock(const uint8_t *in, uint8_t *out) override
+    {
+        mbedtls_aes_crypt_ecb(&aes, MBEDTLS_AES_ENCRYPT, in, out);
+    }
+
+    virtual void ctr(const uint8_t *nonce, size_t numBytes, uint8_t *bytes) override
+    {
+        uint8_t counter[16];
+        uint8_t stream_block[16];
+        size_t nc_off = 0;
+        memcpy(counter, nonce, sizeof(counter)); // mbedTLS advances the counter it is given
+        mbedtls_aes_crypt_ctr(&aes, numBytes, &nc_off, counter, stream_block, bytes, bytes);
+    }
+};
 
-    ~ESP32CryptoEngine() { mbedtls_aes_free(&aes); }
+class MbedTLSCryptoBackend : public CryptoBackend
+{
+  public:
+    virtual const char *name() const override { return "mbedtls"; }
+
+    virtual AESContext *newContext(const uint8_t *key, size_t keyLen) override
+    {
+        if (keyLen != 16 && keyLen != 32)
+            return NULL;
+        return new MbedTLSAESContext(key, keyLen);
+    }
+};
+
+static MbedTLSCryptoBackend mbedTLSBackend;
+
+class ESP32CryptoEngine : public CryptoEngine
+{
+  public:
+    ESP32CryptoEngine() { backend = &mbedTLSBackend; }
 
     /**
      * Encrypt a packet
@@ -23,14 +62,7 @@ class ESP32CryptoEngine : public CryptoEngine
     {
         if (_key.length > 0) {
             if (numBytes <= MAX_BLOCKSIZE) {
-                mbedtls_aes_setkey_enc(&aes, _key.bytes, _key.length * 8);
-                static uint8_t scratch[MAX_BLOCKSIZE];
-                uint8_t stream_block[16];
-                size_t nc_off = 0;
-                memcpy(scratch, bytes, numBytes);
-                memset(scratch + numBytes, 0,
-                       sizeof(scratch) - numBytes); // Fill rest of buffer with zero (in case cypher looks at it)
-                mbedtls_aes_crypt_ctr(&aes, numBytes, &nc_off, _nonce, stream_block, scratch, bytes);
+                CryptoEngine::encryptAESCtr(_key, _nonce, numBytes, bytes);
             } else {
                 LOG_ERROR("Packet too large for crypto engine: %d. noop encryption!", numBytes);
             }
@@ -38,4 +70,4 @@ class ESP32CryptoEngine : public CryptoEngine
     }
 };
 
-CryptoEngine *crypto = new ESP32CryptoEngine();
\ No newline at end of file
+CryptoEngine *crypto = new ESP32CryptoEngine();
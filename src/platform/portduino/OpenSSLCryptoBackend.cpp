@@ -0,0 +1,67 @@
+#include "CryptoBackend.h"
+
+#if HAS_OPENSSL_CRYPTO_BACKEND
+#include <openssl/evp.h>
+
+class OpenSSLAESContext : public AESContext
+{
+    EVP_CIPHER_CTX *ecb = EVP_CIPHER_CTX_new();
+    EVP_CIPHER_CTX *ctrMode = EVP_CIPHER_CTX_new();
+
+  public:
+    OpenSSLAESContext(const EVP_CIPHER *ecbCipher, const EVP_CIPHER *ctrCipher, const uint8_t *key)
+    {
+        EVP_EncryptInit_ex(ecb, ecbCipher, NULL, key, NULL);
+        EVP_CIPHER_CTX_set_padding(ecb, 0);
+        EVP_EncryptInit_ex(ctrMode, ctrCipher, NULL, key, NULL);
+    }
+
+    ~OpenSSLAESContext()
+    {
+        EVP_CIPHER_CTX_free(ecb);
+        EVP_CIPHER_CTX_free(ctrMode);
+    }
+
+    bool isValid() const { return ecb && ctrMode; }
+
+    virtual void encryptBlock(const uint8_t *in, uint8_t *out) override
+    {
+        int len;
+        EVP_EncryptUpdate(ecb, out, &len, in, 16);
+    }
+
+    virtual void ctr(const uint8_t *nonce, size_t numBytes, uint8_t *bytes) override
+    {
+        // A new IV restarts the keystream but keeps the expanded key
+        int len;
+        EVP_EncryptInit_ex(ctrMode, NULL, NULL, NULL, nonce);
+        EVP_EncryptUpdate(ctrMode, bytes, &len, bytes, numBytes);
+    }
+};
+
+class OpenSSLCryptoBackend : public CryptoBackend
+{
+  public:
+    virtual const char *name() const override { return "openssl"; }
+
+    virtual AESContext *newContext(const uint8_t *key, size_t keyLen) override
+    {
+        OpenSSLAESContext *context = NULL;
+        if (keyLen == 16)
+            context = new OpenSSLAESContext(EVP_aes_128_ecb(), EVP_aes_128_ctr(), key);
+        else if (keyLen == 32)
+            context = new OpenSSLAESContext(EVP_aes_256_ecb(), EVP_aes_256_ctr(), key);
+        if (context && !context->isValid()) {
+            delete context;
+            context = NULL;
+        }
+        return context;
+    }
+};
+
+CryptoBackend *openSSLCryptoBackend()
+{
+    static OpenSSLCryptoBackend backend;
+    return &backend;
+}
+#endif
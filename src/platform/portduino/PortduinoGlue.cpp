@@ -139,6 +139,23 @@ void getMacAddr(uint8_t *dmac)
  * use portduino specific init code (such as gpioBind) to setup portduino on their host machine,
  * before running 'arduino' code.
  */
+/// Pick the AES implementation asked for in config.yaml, OpenSSL unless told otherwise
+static void setupCryptoBackend()
+{
+    const std::string &wanted = settingsStrings[crypto_backend];
+#if HAS_OPENSSL_CRYPTO_BACKEND
+    if (wanted != "software")
+        crypto->setBackend(openSSLCryptoBackend());
+    else
+        crypto->setBackend(softwareCryptoBackend());
+#else
+    if (wanted == "openssl")
+        std::cout << "Built without OpenSSL" << std::endl;
+    crypto->setBackend(softwareCryptoBackend());
+#endif
+    std::cout << "Using the " << crypto->getBackend()->name() << " crypto backend" << std::endl;
+}
+
 void portduinoSetup()
 {
     printf("Set up Meshtastic on Portduino...\n");
@@ -196,6 +213,7 @@ void portduinoSetup()
         settingsMap[logoutputlevel] = level_debug; // Default to debug
         // Set the random seed equal to TCPPort to have a different seed per instance
         randomSeed(TCPPort);
+        setupCryptoBackend();
         return;
     }
 
@@ -209,6 +227,7 @@ void portduinoSetup()
             }
         }
     }
+    setupCryptoBackend();
 
     // If LoRa `Module: auto` (default in config.yaml),
     // attempt to auto config based on Product Strings
@@ -609,6 +628,7 @@ bool loadConfig(const char *configPath)
         if (yamlConfig["General"]) {
             settingsMap[maxnodes] = (yamlConfig["General"]["MaxNodes"]).as<int>(200);
             settingsMap[maxtophone] = (yamlConfig["General"]["MaxMessageQueue"]).as<int>(100);
+            settingsMap[maxpackethistory] = (yamlConfig["General"]["MaxPacketHistory"]).as<int>(0);
             settingsStrings[config_directory] = (yamlConfig["General"]["ConfigDirectory"]).as<std::string>("");
             settingsStrings[available_directory] =
                 (yamlConfig["General"]["AvailableDirectory"]).as<std::string>("/etc/meshtasticd/available.d/");
@@ -618,6 +638,7 @@ bool loadConfig(const char *configPath)
                 exit(EXIT_FAILURE);
             }
             settingsStrings[mac_address] = (yamlConfig["General"]["MACAddress"]).as<std::string>("");
+            settingsStrings[crypto_backend] = (yamlConfig["General"]["CryptoBackend"]).as<std::string>("auto");
             if ((yamlConfig["General"]["MACAddressSource"]).as<std::string>("") != "") {
                 std::ifstream infile("/sys/class/net/" + (yamlConfig["General"]["MACAddressSource"]).as<std::string>("") +
                                      "/address");
@@ -97,10 +97,12 @@ enum configNames {
     websslcertpath,
     maxtophone,
     maxnodes,
+    maxpackethistory,
     ascii_logs,
     config_directory,
     available_directory,
     mac_address,
+    crypto_backend,
     hostMetrics_interval,
     hostMetrics_channel,
     hostMetrics_user_command
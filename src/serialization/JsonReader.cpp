@@ -0,0 +1,356 @@
+#include "JsonReader.h"
+#include <stdlib.h>
+#include <string.h>
+
+static_assert(JSON_READER_MAX_DEPTH <= 32, "JsonReader keeps one bit per nesting level in a uint32_t");
+
+JsonReader::JsonReader(const char *json, size_t len) : json(json), len(json ? len : 0)
+{
+    if (len > JSON_READER_MAX_LENGTH)
+        fail(TOO_LONG);
+}
+
+JsonToken JsonReader::fail(Error e)
+{
+    state = FAILED;
+    error = e;
+    errorPos = pos;
+    return JSON_ERROR;
+}
+
+void JsonReader::skipWhitespace()
+{
+    while (pos < len && (json[pos] == ' ' || json[pos] == '\t' || json[pos] == '\r' || json[pos] == '\n'))
+        pos++;
+}
+
+JsonToken JsonReader::next()
+{
+    if (state == FAILED)
+        return JSON_ERROR;
+    if (state == DONE)
+        return JSON_END;
+
+    skipWhitespace();
+    if (pos >= len) {
+        if (state == AFTER_VALUE && depth == 0) {
+            state = DONE;
+            return JSON_END;
+        }
+        return fail(SYNTAX);
+    }
+
+    char c = json[pos];
+    switch (state) {
+    case FIRST_VALUE_OR_END:
+        if (c == ']')
+            return close(false);
+        return readValue();
+
+    case VALUE:
+        return readValue();
+
+    case FIRST_KEY_OR_END:
+        if (c == '}')
+            return close(true);
+        // fall through
+    case KEY:
+        if (c != '"' || !scanString())
+            return fail(SYNTAX);
+        skipWhitespace();
+        if (pos >= len || json[pos] != ':')
+            return fail(SYNTAX);
+        pos++;
+        state = VALUE;
+        return JSON_KEY;
+
+    case AFTER_VALUE: {
+        if (depth == 0)
+            return fail(SYNTAX); // Something after the value
+        bool object = inObject & (1u << (depth - 1));
+        if (c == (object ? '}' : ']'))
+            return close(object);
+        if (c != ',')
+            return fail(SYNTAX);
+        pos++;
+        state = object ? KEY : VALUE;
+        return next();
+    }
+
+    default:
+        return fail(SYNTAX);
+    }
+}
+
+JsonToken JsonReader::readValue()
+{
+    JsonToken token;
+    switch (json[pos]) {
+    case '{':
+        return open(true);
+    case '[':
+        return open(false);
+    case '"':
+        if (!scanString())
+            return fail(SYNTAX);
+        token = JSON_STRING;
+        break;
+    case 't':
+        if (!scanLiteral("true"))
+            return fail(SYNTAX);
+        token = JSON_TRUE;
+        break;
+    case 'f':
+        if (!scanLiteral("false"))
+            return fail(SYNTAX);
+        token = JSON_FALSE;
+        break;
+    case 'n':
+        if (!scanLiteral("null"))
+            return fail(SYNTAX);
+        token = JSON_NULL;
+        break;
+    default:
+        if (!scanNumber())
+            return state == FAILED ? JSON_ERROR : fail(SYNTAX);
+        token = JSON_NUMBER;
+        break;
+    }
+    state = AFTER_VALUE;
+    return token;
+}
+
+JsonToken JsonReader::open(bool object)
+{
+    if (depth >= JSON_READER_MAX_DEPTH)
+        return fail(TOO_DEEP);
+    if (object)
+        inObject |= 1u << depth;
+    else
+        inObject &= ~(1u << depth);
+    depth++;
+    pos++;
+    state = object ? FIRST_KEY_OR_END : FIRST_VALUE_OR_END;
+    return object ? JSON_BEGIN_OBJECT : JSON_BEGIN_ARRAY;
+}
+
+JsonToken JsonReader::close(bool object)
+{
+    depth--;
+    pos++;
+    state = AFTER_VALUE;
+    return object ? JSON_END_OBJECT : JSON_END_ARRAY;
+}
+
+static bool isHex(char c)
+{
+    return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+}
+
+bool JsonReader::scanString()
+{
+    size_t i = pos + 1;
+    while (true) {
+        if (i >= len)
+            return false;
+        uint8_t c = json[i];
+        if (c == '"')
+            break;
+        if (c < 0x20)
+            return false; // Control characters must be escaped
+        if (c != '\\') {
+            i++;
+            continue;
+        }
+        if (++i >= len)
+            return false;
+        if (json[i] == 'u') {
+            if (i + 4 >= len || !isHex(json[i + 1]) || !isHex(json[i + 2]) || !isHex(json[i + 3]) || !isHex(json[i + 4]))
+                return false;
+            i += 5;
+        } else if (json[i] && strchr("\"\\/bfnrt", json[i])) {
+            i++;
+        } else {
+            return false;
+        }
+    }
+    tokenStart = pos + 1;
+    tokenLength = i - pos - 1;
+    pos = i + 1;
+    return true;
+}
+
+bool JsonReader::scanNumber()
+{
+    size_t i = pos;
+    auto digits = [&]() {
+        size_t start = i;
+        while (i < len && json[i] >= '0' && json[i] <= '9')
+            i++;
+        return i > start;
+    };
+
+    if (i < len && json[i] == '-')
+        i++;
+    if (i < len && json[i] == '0')
+        i++; // No leading zeros
+    else if (!digits())
+        return false;
+    if (i < len && json[i] == '.') {
+        i++;
+        if (!digits())
+            return false;
+    }
+    if (i < len && (json[i] == 'e' || json[i] == 'E')) {
+        i++;
+        if (i < len && (json[i] == '+' || json[i] == '-'))
+            i++;
+        if (!digits())
+            return false;
+    }
+    if (i - pos > JSON_READER_MAX_NUMBER) {
+        fail(TOO_LONG);
+        return false;
+    }
+    tokenStart = pos;
+    tokenLength = i - pos;
+    pos = i;
+    return true;
+}
+
+bool JsonReader::scanLiteral(const char *word)
+{
+    size_t n = strlen(word);
+    if (len - pos < n || memcmp(json + pos, word, n) != 0)
+        return false;
+    pos += n;
+    return true;
+}
+
+bool JsonReader::skipValue()
+{
+    JsonToken token = next();
+    if (token == JSON_BEGIN_OBJECT || token == JSON_BEGIN_ARRAY)
+        return skipContainer();
+    return token != JSON_ERROR && token != JSON_END && token != JSON_END_OBJECT && token != JSON_END_ARRAY;
+}
+
+bool JsonReader::skipContainer()
+{
+    if (depth == 0)
+        return false;
+    uint8_t outer = depth - 1;
+    while (depth > outer) {
+        if (next() == JSON_ERROR)
+            return false;
+    }
+    return true;
+}
+
+static uint16_t hex4(const char *s)
+{
+    uint16_t v = 0;
+    for (int i = 0; i < 4; i++) {
+        char c = s[i];
+        v = (v << 4) | (c <= '9' ? c - '0' : (c | 0x20) - 'a' + 10);
+    }
+    return v;
+}
+
+template <class Emit> void JsonReader::decodeString(Emit emit) const
+{
+    const char *s = json + tokenStart;
+    const char *end = s + tokenLength;
+    while (s < end) {
+        if (*s != '\\') {
+            emit(*s++);
+            continue;
+        }
+        s++;
+        char e = *s++;
+        switch (e) {
+        case 'b':
+            emit('\b');
+            break;
+        case 'f':
+            emit('\f');
+            break;
+        case 'n':
+            emit('\n');
+            break;
+        case 'r':
+            emit('\r');
+            break;
+        case 't':
+            emit('\t');
+            break;
+        case 'u': {
+            uint32_t cp = hex4(s);
+            s += 4;
+            if (cp >= 0xD800 && cp <= 0xDBFF && end - s >= 6 && s[0] == '\\' && s[1] == 'u') {
+                uint16_t low = hex4(s + 2);
+                if (low >= 0xDC00 && low <= 0xDFFF) {
+                    cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                    s += 6;
+                }
+            }
+            if (cp >= 0xD800 && cp <= 0xDFFF)
+                cp = 0xFFFD; // A surrogate without its other half
+            if (cp < 0x80) {
+                emit((char)cp);
+            } else if (cp < 0x800) {
+                emit((char)(0xC0 | (cp >> 6)));
+                emit((char)(0x80 | (cp & 0x3F)));
+            } else if (cp < 0x10000) {
+                emit((char)(0xE0 | (cp >> 12)));
+                emit((char)(0x80 | ((cp >> 6) & 0x3F)));
+                emit((char)(0x80 | (cp & 0x3F)));
+            } else {
+                emit((char)(0xF0 | (cp >> 18)));
+                emit((char)(0x80 | ((cp >> 12) & 0x3F)));
+                emit((char)(0x80 | ((cp >> 6) & 0x3F)));
+                emit((char)(0x80 | (cp & 0x3F)));
+            }
+            break;
+        }
+        default: // " \ and /
+            emit(e);
+            break;
+        }
+    }
+}
+
+size_t JsonReader::copyString(char *out, size_t size) const
+{
+    size_t n = 0;
+    decodeString([&](char c) {
+        if (n < size)
+            out[n] = c;
+        n++;
+    });
+    if (n < size)
+        out[n] = 0;
+    return n;
+}
+
+bool JsonReader::keyIs(const char *s) const
+{
+    size_t n = 0;
+    bool same = true;
+    decodeString([&](char c) {
+        if (same && s[n] && s[n] == c)
+            n++;
+        else
+            same = false;
+    });
+    return same && s[n] == 0;
+}
+
+double JsonReader::getNumber() const
+{
+    char buf[JSON_READER_MAX_NUMBER + 1];
+    size_t n = tokenLength < JSON_READER_MAX_NUMBER ? tokenLength : JSON_READER_MAX_NUMBER;
+    memcpy(buf, json + tokenStart, n);
+    buf[n] = 0;
+    return strtod(buf, NULL);
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/// Deepest nesting of objects and arrays accepted, the envelopes we read need 2
+#ifndef JSON_READER_MAX_DEPTH
+#define JSON_READER_MAX_DEPTH 16
+#endif
+
+/// Longest input accepted, anything bigger is refused before looking at it
+#ifndef JSON_READER_MAX_LENGTH
+#define JSON_READER_MAX_LENGTH 8192
+#endif
+
+/// Longest number accepted, in characters
+#define JSON_READER_MAX_NUMBER 32
+
+enum JsonToken : uint8_t {
+    JSON_END,   // The whole input was one valid JSON value and it has been read
+    JSON_ERROR, // Malformed, too deep or too long, getError() says which.  Every call after returns JSON_ERROR again
+    JSON_BEGIN_OBJECT,
+    JSON_END_OBJECT,
+    JSON_BEGIN_ARRAY,
+    JSON_END_ARRAY,
+    JSON_KEY, // A member name, its value is the next token
+    JSON_STRING,
+    JSON_NUMBER,
+    JSON_TRUE,
+    JSON_FALSE,
+    JSON_NULL,
+};
+
+/**
+ * Pull parser for JSON text, reading it where it is without allocating or copying.
+ *
+ * next() returns one token at a time and checks the grammar as it goes, so a caller picks out the members it wants and
+ * skipValue()s the rest, and knows the input was well formed once next() returns JSON_END.  Strings are handed out as
+ * they are in the input, copyString() and keyIs() undo the escapes.  The input needs no NUL terminator.
+ *
+ * Nesting is limited to JSON_READER_MAX_DEPTH and the input to JSON_READER_MAX_LENGTH, so hostile input (from MQTT or the
+ * mesh) costs bounded time and no stack.
+ */
+class JsonReader
+{
+  public:
+    enum Error : uint8_t { NO_ERROR, SYNTAX, TOO_DEEP, TOO_LONG };
+
+    JsonReader(const char *json, size_t len);
+
+    JsonToken next();
+
+    /// Read past the value that comes next (after a JSON_KEY, or in an array), however deeply nested.  @return false on error
+    bool skipValue();
+
+    /// Read past the end of the object or array whose JSON_BEGIN_OBJECT or JSON_BEGIN_ARRAY was just returned.  @return false on
+    /// error
+    bool skipContainer();
+
+    /// Raw text of the last JSON_KEY or JSON_STRING (between the quotes, escapes as they are) or JSON_NUMBER
+    const char *getText() const { return json + tokenStart; }
+    size_t getTextLength() const { return tokenLength; }
+
+    /**
+     * Copy the last JSON_KEY or JSON_STRING with its escapes undone, as UTF-8: at most size bytes, then a NUL if there is
+     * room for one.
+     * @return the length of the whole string, which is > size if it didn't fit
+     */
+    size_t copyString(char *out, size_t size) const;
+
+    /// Whether the last JSON_KEY or JSON_STRING is s once its escapes are undone
+    bool keyIs(const char *s) const;
+
+    /// The value of the last JSON_NUMBER
+    double getNumber() const;
+
+    /// Nesting level: 0 outside any object or array, 1 inside the outer one...
+    uint8_t getDepth() const { return depth; }
+
+    Error getError() const { return error; }
+
+    /// Where in the input the error was found
+    size_t getErrorOffset() const { return errorPos; }
+
+  private:
+    enum State : uint8_t {
+        VALUE,              // A value must come, at the start or after a key or a comma in an array
+        FIRST_VALUE_OR_END, // Just after [
+        KEY,                // After a comma in an object
+        FIRST_KEY_OR_END,   // Just after {
+        AFTER_VALUE,        // A comma, a closing bracket or the end of input must come
+        DONE,
+        FAILED,
+    };
+
+    const char *json;
+    size_t len;
+    size_t pos = 0;
+    size_t tokenStart = 0;
+    size_t tokenLength = 0;
+    size_t errorPos = 0;
+
+    uint32_t inObject = 0; // One bit per nesting level, set for an object, clear for an array
+    uint8_t depth = 0;
+    State state = VALUE;
+    Error error = NO_ERROR;
+
+    JsonToken fail(Error e);
+    void skipWhitespace();
+    JsonToken readValue();
+    JsonToken open(bool object);
+    JsonToken close(bool object);
+    bool scanString();
+    bool scanNumber();
+    bool scanLiteral(const char *word);
+
+    /// Undo the escapes of the raw string at the current token, calling emit for every byte of UTF-8
+    template <class Emit> void decodeString(Emit emit) const;
+};
@@ -0,0 +1,193 @@
+#include "JsonWriter.h"
+#include <math.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+void JsonWriter::put(const char *s, size_t n)
+{
+    if (len < size)
+        memcpy(buf + len, s, (n < size - len) ? n : size - len);
+    len += n;
+}
+
+void JsonWriter::putf(const char *format, ...)
+{
+    char tmp[32];
+    va_list args;
+    va_start(args, format);
+    int n = vsnprintf(tmp, sizeof(tmp), format, args);
+    va_end(args);
+    if (n > 0)
+        put(tmp, (size_t)n < sizeof(tmp) ? n : sizeof(tmp) - 1);
+}
+
+void JsonWriter::separate()
+{
+    if (afterKey) {
+        afterKey = false;
+        return;
+    }
+    if (depth > 0) {
+        uint32_t bit = 1u << ((depth - 1) & 31);
+        if (hasMembers & bit)
+            put(',');
+        hasMembers |= bit;
+    }
+}
+
+void JsonWriter::beginObject()
+{
+    separate();
+    put('{');
+    depth++;
+    hasMembers &= ~(1u << ((depth - 1) & 31));
+}
+
+void JsonWriter::endObject()
+{
+    depth--;
+    put('}');
+}
+
+void JsonWriter::beginArray()
+{
+    separate();
+    put('[');
+    depth++;
+    hasMembers &= ~(1u << ((depth - 1) & 31));
+}
+
+void JsonWriter::endArray()
+{
+    depth--;
+    put(']');
+}
+
+JsonWriter &JsonWriter::key(const char *name)
+{
+    separate();
+    putString(name, strlen(name));
+    put(':');
+    afterKey = true;
+    return *this;
+}
+
+void JsonWriter::value(const char *s)
+{
+    value(s, strlen(s));
+}
+
+void JsonWriter::value(const char *s, size_t n)
+{
+    separate();
+    putString(s, n);
+}
+
+// JSONValue keeps every number as a double, integers print the same either way
+void JsonWriter::value(unsigned int v)
+{
+    separate();
+    putf("%u", v);
+}
+
+void JsonWriter::value(int v)
+{
+    separate();
+    putf("%d", v);
+}
+
+void JsonWriter::value(double v)
+{
+    separate();
+    if (isinf(v) || isnan(v))
+        put("null", 4);
+    else
+        putf("%.15g", v); // what a std::stringstream with precision(15) gives
+}
+
+void JsonWriter::value(bool v)
+{
+    separate();
+    if (v)
+        put("true", 4);
+    else
+        put("false", 5);
+}
+
+void JsonWriter::valueNull()
+{
+    separate();
+    put("null", 4);
+}
+
+void JsonWriter::valueHex(const uint8_t *bytes, size_t n)
+{
+    static const char hex[] = "0123456789ABCDEF";
+    separate();
+    put('"');
+    for (size_t i = 0; i < n; i++) {
+        put(hex[bytes[i] >> 4]);
+        put(hex[bytes[i] & 0x0F]);
+    }
+    put('"');
+}
+
+void JsonWriter::valueRaw(const char *json, size_t n)
+{
+    separate();
+    put(json, n);
+}
+
+// Same escaping as JSONValue::StringifyString(), quirks included, so the output stays byte for byte identical
+void JsonWriter::putString(const char *s, size_t n)
+{
+    put('"');
+    for (size_t i = 0; i < n; i++) {
+        char chr = s[i];
+
+        if (chr == '"' || chr == '\\' || chr == '/') {
+            put('\\');
+            put(chr);
+        } else if (chr == '\b') {
+            put("\\b", 2);
+        } else if (chr == '\f') {
+            put("\\f", 2);
+        } else if (chr == '\n') {
+            put("\\n", 2);
+        } else if (chr == '\r') {
+            put("\\r", 2);
+        } else if (chr == '\t') {
+            put("\\t", 2);
+        } else if (chr < 0x20 || chr == 0x7F) {
+            char tmp[7];
+            snprintf(tmp, sizeof(tmp), "\\u%04x", chr);
+            put(tmp, strlen(tmp));
+        } else if (chr < 0x80) {
+            put(chr);
+        } else {
+            // Only reachable where char is unsigned, copy the rest of the UTF-8 sequence
+            put(chr);
+            size_t remain = n - i - 1;
+            size_t follow = 0;
+            if ((chr & 0xE0) == 0xC0 && remain >= 1)
+                follow = 1;
+            else if ((chr & 0xF0) == 0xE0 && remain >= 2)
+                follow = 2;
+            else if ((chr & 0xF8) == 0xF0 && remain >= 3)
+                follow = 3;
+            put(s + i + 1, follow);
+            i += follow;
+        }
+    }
+    put('"');
+}
+
+size_t JsonWriter::finish()
+{
+    if (len < size)
+        buf[len] = 0;
+    else if (size > 0)
+        buf[size - 1] = 0;
+    return len;
+}
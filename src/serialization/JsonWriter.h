@@ -0,0 +1,66 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Streams JSON text into a caller supplied buffer, without allocating
+ *
+ * Numbers and strings come out exactly as JSONValue::Stringify() writes them.  Callers have to write object members in
+ * key order to match a JSONObject (which is a std::map).  Like snprintf, the writer keeps counting once the buffer is full,
+ * so length() tells how big a buffer would have been needed.
+ */
+class JsonWriter
+{
+  public:
+    JsonWriter(char *buf, size_t size) : buf(buf), size(size) {}
+
+    void beginObject();
+    void endObject();
+    void beginArray();
+    void endArray();
+
+    /// Start a member of the current object, the value must follow
+    JsonWriter &key(const char *name);
+
+    void value(const char *s);
+    void value(const char *s, size_t len);
+    void value(unsigned int v);
+    void value(int v);
+    void value(double v);
+    void value(bool v);
+    void valueNull();
+
+    /// Bytes as an upper case hex string
+    void valueHex(const uint8_t *bytes, size_t len);
+
+    /// Copy in an already serialized JSON value
+    void valueRaw(const char *json, size_t len);
+
+    /// NUL terminate the buffer.  @return the JSON length, which is >= the buffer size if it didn't fit
+    size_t finish();
+
+    size_t length() const { return len; }
+
+  private:
+    char *buf;
+    size_t size;
+    size_t len = 0;
+
+    uint32_t hasMembers = 0; // one bit per nesting level, set once it needs a comma before the next member
+    uint8_t depth = 0;
+    bool afterKey = false;
+
+    void put(char c)
+    {
+        if (len < size)
+            buf[len] = c;
+        len++;
+    }
+    void put(const char *s, size_t n);
+    void putf(const char *format, ...);
+    void putString(const char *s, size_t n);
+
+    /// Comma handling before a new array element or object member
+    void separate();
+};
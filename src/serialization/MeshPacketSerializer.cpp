@@ -1,6 +1,7 @@
 #ifndef NRF52_USE_JSON
 #include "MeshPacketSerializer.h"
 #include "JSON.h"
+#include "JsonWriter.h"
 #include "NodeDB.h"
 #include "mesh/generated/meshtastic/mqtt.pb.h"
 #include "mesh/generated/meshtastic/telemetry.pb.h"
@@ -15,369 +16,433 @@
 
 static const char *errStr = "Error decoding proto for %s message!";
 
-std::string MeshPacketSerializer::JsonSerialize(const meshtastic_MeshPacket *mp, bool shouldLog)
+/// Cheap check before handing text to JSON::Parse: does it start like a JSON value?
+static bool looksLikeJson(const char *s, size_t len)
 {
-    // the created jsonObj is immutable after creation, so
-    // we need to do the heavy lifting before assembling it.
-    std::string msgType;
-    JSONObject jsonObj;
+    size_t i = 0;
+    while (i < len && (s[i] == ' ' || s[i] == '\t' || s[i] == '\r' || s[i] == '\n'))
+        i++;
+    return i < len && strchr("{[\"-0123456789tTfFnN", s[i]) != NULL;
+}
 
-    if (mp->which_payload_variant == meshtastic_MeshPacket_decoded_tag) {
-        JSONObject msgPayload;
-        switch (mp->decoded.portnum) {
-        case meshtastic_PortNum_TEXT_MESSAGE_APP: {
-            msgType = "text";
-            // convert bytes to string
+/// Decode a protobuf payload, logging on failure
+template <class T> static bool decodePayload(const meshtastic_MeshPacket *mp, const pb_msgdesc_t *fields, T *dest,
+                                             const char *msgType, bool shouldLog)
+{
+    memset(dest, 0, sizeof(*dest));
+    if (pb_decode_from_bytes(mp->decoded.payload.bytes, mp->decoded.payload.size, fields, dest))
+        return true;
+    if (shouldLog)
+        LOG_ERROR(errStr, msgType);
+    return false;
+}
+
+/*
+ * Payload encoders, one per portnum.  Each writes the "payload" member (if it has one) and returns the message type.
+ * Members have to be written in sorted key order, which is what the JSONObject based serializer produced.
+ */
+
+static const char *writeTextPayload(JsonWriter &w, const meshtastic_MeshPacket *mp, bool shouldLog)
+{
+    if (shouldLog)
+        LOG_DEBUG("got text message of size %u", mp->decoded.payload.size);
+
+    // The text ends at the first NUL, if any
+    const char *text = (const char *)mp->decoded.payload.bytes;
+    size_t len = strnlen(text, mp->decoded.payload.size);
+
+    // check if this is a JSON payload, plain text doesn't get near the parser
+    if (looksLikeJson(text, len)) {
+        char payloadStr[len + 1];
+        memcpy(payloadStr, text, len);
+        payloadStr[len] = 0;
+        JSONValue *json_value = JSON::Parse(payloadStr);
+        if (json_value != NULL) {
             if (shouldLog)
-                LOG_DEBUG("got text message of size %u", mp->decoded.payload.size);
-
-            char payloadStr[(mp->decoded.payload.size) + 1];
-            memcpy(payloadStr, mp->decoded.payload.bytes, mp->decoded.payload.size);
-            payloadStr[mp->decoded.payload.size] = 0; // null terminated string
-            // check if this is a JSON payload
-            JSONValue *json_value = JSON::Parse(payloadStr);
-            if (json_value != NULL) {
-                if (shouldLog)
-                    LOG_INFO("text message payload is of type json");
-
-                // if it is, then we can just use the json object
-                jsonObj["payload"] = json_value;
-            } else {
-                // if it isn't, then we need to create a json object
-                // with the string as the value
-                if (shouldLog)
-                    LOG_INFO("text message payload is of type plaintext");
-
-                msgPayload["text"] = new JSONValue(payloadStr);
-                jsonObj["payload"] = new JSONValue(msgPayload);
-            }
-            break;
-        }
-        case meshtastic_PortNum_TELEMETRY_APP: {
-            msgType = "telemetry";
-            meshtastic_Telemetry scratch;
-            meshtastic_Telemetry *decoded = NULL;
-            memset(&scratch, 0, sizeof(scratch));
-            if (pb_decode_from_bytes(mp->decoded.payload.bytes, mp->decoded.payload.size, &meshtastic_Telemetry_msg, &scratch)) {
-                decoded = &scratch;
-                if (decoded->which_variant == meshtastic_Telemetry_device_metrics_tag) {
-                    msgPayload["battery_level"] = new JSONValue((unsigned int)decoded->variant.device_metrics.battery_level);
-                    msgPayload["voltage"] = new JSONValue(decoded->variant.device_metrics.voltage);
-                    msgPayload["channel_utilization"] = new JSONValue(decoded->variant.device_metrics.channel_utilization);
-                    msgPayload["air_util_tx"] = new JSONValue(decoded->variant.device_metrics.air_util_tx);
-                    msgPayload["uptime_seconds"] = new JSONValue((unsigned int)decoded->variant.device_metrics.uptime_seconds);
-                } else if (decoded->which_variant == meshtastic_Telemetry_environment_metrics_tag) {
-                    msgPayload["temperature"] = new JSONValue(decoded->variant.environment_metrics.temperature);
-                    msgPayload["relative_humidity"] = new JSONValue(decoded->variant.environment_metrics.relative_humidity);
-                    msgPayload["barometric_pressure"] = new JSONValue(decoded->variant.environment_metrics.barometric_pressure);
-                    msgPayload["gas_resistance"] = new JSONValue(decoded->variant.environment_metrics.gas_resistance);
-                    msgPayload["voltage"] = new JSONValue(decoded->variant.environment_metrics.voltage);
-                    msgPayload["current"] = new JSONValue(decoded->variant.environment_metrics.current);
-                    msgPayload["lux"] = new JSONValue(decoded->variant.environment_metrics.lux);
-                    msgPayload["white_lux"] = new JSONValue(decoded->variant.environment_metrics.white_lux);
-                    msgPayload["iaq"] = new JSONValue((uint)decoded->variant.environment_metrics.iaq);
-                    msgPayload["wind_speed"] = new JSONValue(decoded->variant.environment_metrics.wind_speed);
-                    msgPayload["wind_direction"] = new JSONValue((uint)decoded->variant.environment_metrics.wind_direction);
-                    msgPayload["wind_gust"] = new JSONValue(decoded->variant.environment_metrics.wind_gust);
-                    msgPayload["wind_lull"] = new JSONValue(decoded->variant.environment_metrics.wind_lull);
-                    msgPayload["radiation"] = new JSONValue(decoded->variant.environment_metrics.radiation);
-                } else if (decoded->which_variant == meshtastic_Telemetry_air_quality_metrics_tag) {
-                    msgPayload["pm10"] = new JSONValue((unsigned int)decoded->variant.air_quality_metrics.pm10_standard);
-                    msgPayload["pm25"] = new JSONValue((unsigned int)decoded->variant.air_quality_metrics.pm25_standard);
-                    msgPayload["pm100"] = new JSONValue((unsigned int)decoded->variant.air_quality_metrics.pm100_standard);
-                    msgPayload["pm10_e"] = new JSONValue((unsigned int)decoded->variant.air_quality_metrics.pm10_environmental);
-                    msgPayload["pm25_e"] = new JSONValue((unsigned int)decoded->variant.air_quality_metrics.pm25_environmental);
-                    msgPayload["pm100_e"] = new JSONValue((unsigned int)decoded->variant.air_quality_metrics.pm100_environmental);
-                } else if (decoded->which_variant == meshtastic_Telemetry_power_metrics_tag) {
-                    msgPayload["voltage_ch1"] = new JSONValue(decoded->variant.power_metrics.ch1_voltage);
-                    msgPayload["current_ch1"] = new JSONValue(decoded->variant.power_metrics.ch1_current);
-                    msgPayload["voltage_ch2"] = new JSONValue(decoded->variant.power_metrics.ch2_voltage);
-                    msgPayload["current_ch2"] = new JSONValue(decoded->variant.power_metrics.ch2_current);
-                    msgPayload["voltage_ch3"] = new JSONValue(decoded->variant.power_metrics.ch3_voltage);
-                    msgPayload["current_ch3"] = new JSONValue(decoded->variant.power_metrics.ch3_current);
-                }
-                jsonObj["payload"] = new JSONValue(msgPayload);
-            } else if (shouldLog) {
-                LOG_ERROR(errStr, msgType.c_str());
-            }
-            break;
-        }
-        case meshtastic_PortNum_NODEINFO_APP: {
-            msgType = "nodeinfo";
-            meshtastic_User scratch;
-            meshtastic_User *decoded = NULL;
-            memset(&scratch, 0, sizeof(scratch));
-            if (pb_decode_from_bytes(mp->decoded.payload.bytes, mp->decoded.payload.size, &meshtastic_User_msg, &scratch)) {
-                decoded = &scratch;
-                msgPayload["id"] = new JSONValue(decoded->id);
-                msgPayload["longname"] = new JSONValue(decoded->long_name);
-                msgPayload["shortname"] = new JSONValue(decoded->short_name);
-                msgPayload["hardware"] = new JSONValue(decoded->hw_model);
-                msgPayload["role"] = new JSONValue((int)decoded->role);
-                jsonObj["payload"] = new JSONValue(msgPayload);
-            } else if (shouldLog) {
-                LOG_ERROR(errStr, msgType.c_str());
-            }
-            break;
-        }
-        case meshtastic_PortNum_POSITION_APP: {
-            msgType = "position";
-            meshtastic_Position scratch;
-            meshtastic_Position *decoded = NULL;
-            memset(&scratch, 0, sizeof(scratch));
-            if (pb_decode_from_bytes(mp->decoded.payload.bytes, mp->decoded.payload.size, &meshtastic_Position_msg, &scratch)) {
-                decoded = &scratch;
-                if ((int)decoded->time) {
-                    msgPayload["time"] = new JSONValue((unsigned int)decoded->time);
-                }
-                if ((int)decoded->timestamp) {
-                    msgPayload["timestamp"] = new JSONValue((unsigned int)decoded->timestamp);
-                }
-                msgPayload["latitude_i"] = new JSONValue((int)decoded->latitude_i);
-                msgPayload["longitude_i"] = new JSONValue((int)decoded->longitude_i);
-                if ((int)decoded->altitude) {
-                    msgPayload["altitude"] = new JSONValue((int)decoded->altitude);
-                }
-                if ((int)decoded->ground_speed) {
-                    msgPayload["ground_speed"] = new JSONValue((unsigned int)decoded->ground_speed);
-                }
-                if (int(decoded->ground_track)) {
-                    msgPayload["ground_track"] = new JSONValue((unsigned int)decoded->ground_track);
-                }
-                if (int(decoded->sats_in_view)) {
-                    msgPayload["sats_in_view"] = new JSONValue((unsigned int)decoded->sats_in_view);
-                }
-                if ((int)decoded->PDOP) {
-                    msgPayload["PDOP"] = new JSONValue((int)decoded->PDOP);
-                }
-                if ((int)decoded->HDOP) {
-                    msgPayload["HDOP"] = new JSONValue((int)decoded->HDOP);
-                }
-                if ((int)decoded->VDOP) {
-                    msgPayload["VDOP"] = new JSONValue((int)decoded->VDOP);
-                }
-                if ((int)decoded->precision_bits) {
-                    msgPayload["precision_bits"] = new JSONValue((int)decoded->precision_bits);
-                }
-                jsonObj["payload"] = new JSONValue(msgPayload);
-            } else if (shouldLog) {
-                LOG_ERROR(errStr, msgType.c_str());
-            }
-            break;
-        }
-        case meshtastic_PortNum_WAYPOINT_APP: {
-            msgType = "waypoint";
-            meshtastic_Waypoint scratch;
-            meshtastic_Waypoint *decoded = NULL;
-            memset(&scratch, 0, sizeof(scratch));
-            if (pb_decode_from_bytes(mp->decoded.payload.bytes, mp->decoded.payload.size, &meshtastic_Waypoint_msg, &scratch)) {
-                decoded = &scratch;
-                msgPayload["id"] = new JSONValue((unsigned int)decoded->id);
-                msgPayload["name"] = new JSONValue(decoded->name);
-                msgPayload["description"] = new JSONValue(decoded->description);
-                msgPayload["expire"] = new JSONValue((unsigned int)decoded->expire);
-                msgPayload["locked_to"] = new JSONValue((unsigned int)decoded->locked_to);
-                msgPayload["latitude_i"] = new JSONValue((int)decoded->latitude_i);
-                msgPayload["longitude_i"] = new JSONValue((int)decoded->longitude_i);
-                jsonObj["payload"] = new JSONValue(msgPayload);
-            } else if (shouldLog) {
-                LOG_ERROR(errStr, msgType.c_str());
-            }
-            break;
-        }
-        case meshtastic_PortNum_NEIGHBORINFO_APP: {
-            msgType = "neighborinfo";
-            meshtastic_NeighborInfo scratch;
-            meshtastic_NeighborInfo *decoded = NULL;
-            memset(&scratch, 0, sizeof(scratch));
-            if (pb_decode_from_bytes(mp->decoded.payload.bytes, mp->decoded.payload.size, &meshtastic_NeighborInfo_msg,
-                                     &scratch)) {
-                decoded = &scratch;
-                msgPayload["node_id"] = new JSONValue((unsigned int)decoded->node_id);
-                msgPayload["node_broadcast_interval_secs"] = new JSONValue((unsigned int)decoded->node_broadcast_interval_secs);
-                msgPayload["last_sent_by_id"] = new JSONValue((unsigned int)decoded->last_sent_by_id);
-                msgPayload["neighbors_count"] = new JSONValue(decoded->neighbors_count);
-                JSONArray neighbors;
-                for (uint8_t i = 0; i < decoded->neighbors_count; i++) {
-                    JSONObject neighborObj;
-                    neighborObj["node_id"] = new JSONValue((unsigned int)decoded->neighbors[i].node_id);
-                    neighborObj["snr"] = new JSONValue((int)decoded->neighbors[i].snr);
-                    neighbors.push_back(new JSONValue(neighborObj));
-                }
-                msgPayload["neighbors"] = new JSONValue(neighbors);
-                jsonObj["payload"] = new JSONValue(msgPayload);
-            } else if (shouldLog) {
-                LOG_ERROR(errStr, msgType.c_str());
-            }
-            break;
-        }
-        case meshtastic_PortNum_TRACEROUTE_APP: {
-            if (mp->decoded.request_id) { // Only report the traceroute response
-                msgType = "traceroute";
-                meshtastic_RouteDiscovery scratch;
-                meshtastic_RouteDiscovery *decoded = NULL;
-                memset(&scratch, 0, sizeof(scratch));
-                if (pb_decode_from_bytes(mp->decoded.payload.bytes, mp->decoded.payload.size, &meshtastic_RouteDiscovery_msg,
-                                         &scratch)) {
-                    decoded = &scratch;
-                    JSONArray route;      // Route this message took
-                    JSONArray routeBack;  // Route this message took back
-                    JSONArray snrTowards; // Snr for forward route
-                    JSONArray snrBack;    // Snr for reverse route
-
-                    // Lambda function for adding a long name to the route
-                    auto addToRoute = [](JSONArray *route, NodeNum num) {
-                        char long_name[40] = "Unknown";
-                        meshtastic_NodeInfoLite *node = nodeDB->getMeshNode(num);
-                        bool name_known = node ? node->has_user : false;
-                        if (name_known)
-                            memcpy(long_name, node->user.long_name, sizeof(long_name));
-                        route->push_back(new JSONValue(long_name));
-                    };
-                    addToRoute(&route, mp->to); // Started at the original transmitter (destination of response)
-                    for (uint8_t i = 0; i < decoded->route_count; i++) {
-                        addToRoute(&route, decoded->route[i]);
-                    }
-                    addToRoute(&route, mp->from); // Ended at the original destination (source of response)
-
-                    addToRoute(&routeBack, mp->from); // Started at the original destination (source of response)
-                    for (uint8_t i = 0; i < decoded->route_back_count; i++) {
-                        addToRoute(&routeBack, decoded->route_back[i]);
-                    }
-                    addToRoute(&routeBack, mp->to); // Ended at the original transmitter (destination of response)
-
-                    for (uint8_t i = 0; i < decoded->snr_back_count; i++) {
-                        snrBack.push_back(new JSONValue((float)decoded->snr_back[i] / 4));
-                    }
-
-                    for (uint8_t i = 0; i < decoded->snr_towards_count; i++) {
-                        snrTowards.push_back(new JSONValue((float)decoded->snr_towards[i] / 4));
-                    }
-
-                    msgPayload["route"] = new JSONValue(route);
-                    msgPayload["route_back"] = new JSONValue(routeBack);
-                    msgPayload["snr_back"] = new JSONValue(snrBack);
-                    msgPayload["snr_towards"] = new JSONValue(snrTowards);
-                    jsonObj["payload"] = new JSONValue(msgPayload);
-                } else if (shouldLog) {
-                    LOG_ERROR(errStr, msgType.c_str());
-                }
-            }
-            break;
-        }
-        case meshtastic_PortNum_DETECTION_SENSOR_APP: {
-            msgType = "detection";
-            char payloadStr[(mp->decoded.payload.size) + 1];
-            memcpy(payloadStr, mp->decoded.payload.bytes, mp->decoded.payload.size);
-            payloadStr[mp->decoded.payload.size] = 0; // null terminated string
-            msgPayload["text"] = new JSONValue(payloadStr);
-            jsonObj["payload"] = new JSONValue(msgPayload);
-            break;
+                LOG_INFO("text message payload is of type json");
+            std::string json = json_value->Stringify();
+            delete json_value;
+            w.key("payload").valueRaw(json.c_str(), json.length());
+            return "text";
         }
+    }
+
+    if (shouldLog)
+        LOG_INFO("text message payload is of type plaintext");
+    w.key("payload").beginObject();
+    w.key("text").value(text, len);
+    w.endObject();
+    return "text";
+}
+
+static const char *writeTelemetryPayload(JsonWriter &w, const meshtastic_MeshPacket *mp, bool shouldLog)
+{
+    meshtastic_Telemetry decoded;
+    if (!decodePayload(mp, &meshtastic_Telemetry_msg, &decoded, "telemetry", shouldLog))
+        return "telemetry";
+
+    w.key("payload").beginObject();
+    if (decoded.which_variant == meshtastic_Telemetry_device_metrics_tag) {
+        const meshtastic_DeviceMetrics &m = decoded.variant.device_metrics;
+        w.key("air_util_tx").value((double)m.air_util_tx);
+        w.key("battery_level").value((unsigned int)m.battery_level);
+        w.key("channel_utilization").value((double)m.channel_utilization);
+        w.key("uptime_seconds").value((unsigned int)m.uptime_seconds);
+        w.key("voltage").value((double)m.voltage);
+    } else if (decoded.which_variant == meshtastic_Telemetry_environment_metrics_tag) {
+        const meshtastic_EnvironmentMetrics &m = decoded.variant.environment_metrics;
+        w.key("barometric_pressure").value((double)m.barometric_pressure);
+        w.key("current").value((double)m.current);
+        w.key("gas_resistance").value((double)m.gas_resistance);
+        w.key("iaq").value((unsigned int)m.iaq);
+        w.key("lux").value((double)m.lux);
+        w.key("radiation").value((double)m.radiation);
+        w.key("relative_humidity").value((double)m.relative_humidity);
+        w.key("temperature").value((double)m.temperature);
+        w.key("voltage").value((double)m.voltage);
+        w.key("white_lux").value((double)m.white_lux);
+        w.key("wind_direction").value((unsigned int)m.wind_direction);
+        w.key("wind_gust").value((double)m.wind_gust);
+        w.key("wind_lull").value((double)m.wind_lull);
+        w.key("wind_speed").value((double)m.wind_speed);
+    } else if (decoded.which_variant == meshtastic_Telemetry_air_quality_metrics_tag) {
+        const meshtastic_AirQualityMetrics &m = decoded.variant.air_quality_metrics;
+        w.key("pm10").value((unsigned int)m.pm10_standard);
+        w.key("pm100").value((unsigned int)m.pm100_standard);
+        w.key("pm100_e").value((unsigned int)m.pm100_environmental);
+        w.key("pm10_e").value((unsigned int)m.pm10_environmental);
+        w.key("pm25").value((unsigned int)m.pm25_standard);
+        w.key("pm25_e").value((unsigned int)m.pm25_environmental);
+    } else if (decoded.which_variant == meshtastic_Telemetry_power_metrics_tag) {
+        const meshtastic_PowerMetrics &m = decoded.variant.power_metrics;
+        w.key("current_ch1").value((double)m.ch1_current);
+        w.key("current_ch2").value((double)m.ch2_current);
+        w.key("current_ch3").value((double)m.ch3_current);
+        w.key("voltage_ch1").value((double)m.ch1_voltage);
+        w.key("voltage_ch2").value((double)m.ch2_voltage);
+        w.key("voltage_ch3").value((double)m.ch3_voltage);
+    }
+    w.endObject();
+    return "telemetry";
+}
+
+static const char *writeNodeInfoPayload(JsonWriter &w, const meshtastic_MeshPacket *mp, bool shouldLog)
+{
+    meshtastic_User decoded;
+    if (!decodePayload(mp, &meshtastic_User_msg, &decoded, "nodeinfo", shouldLog))
+        return "nodeinfo";
+
+    w.key("payload").beginObject();
+    w.key("hardware").value((int)decoded.hw_model);
+    w.key("id").value(decoded.id);
+    w.key("longname").value(decoded.long_name);
+    w.key("role").value((int)decoded.role);
+    w.key("shortname").value(decoded.short_name);
+    w.endObject();
+    return "nodeinfo";
+}
+
+static const char *writePositionPayload(JsonWriter &w, const meshtastic_MeshPacket *mp, bool shouldLog)
+{
+    meshtastic_Position decoded;
+    if (!decodePayload(mp, &meshtastic_Position_msg, &decoded, "position", shouldLog))
+        return "position";
+
+    // Upper case keys sort first
+    w.key("payload").beginObject();
+    if ((int)decoded.HDOP)
+        w.key("HDOP").value((int)decoded.HDOP);
+    if ((int)decoded.PDOP)
+        w.key("PDOP").value((int)decoded.PDOP);
+    if ((int)decoded.VDOP)
+        w.key("VDOP").value((int)decoded.VDOP);
+    if ((int)decoded.altitude)
+        w.key("altitude").value((int)decoded.altitude);
+    if ((int)decoded.ground_speed)
+        w.key("ground_speed").value((unsigned int)decoded.ground_speed);
+    if (int(decoded.ground_track))
+        w.key("ground_track").value((unsigned int)decoded.ground_track);
+    w.key("latitude_i").value((int)decoded.latitude_i);
+    w.key("longitude_i").value((int)decoded.longitude_i);
+    if ((int)decoded.precision_bits)
+        w.key("precision_bits").value((int)decoded.precision_bits);
+    if (int(decoded.sats_in_view))
+        w.key("sats_in_view").value((unsigned int)decoded.sats_in_view);
+    if ((int)decoded.time)
+        w.key("time").value((unsigned int)decoded.time);
+    if ((int)decoded.timestamp)
+        w.key("timestamp").value((unsigned int)decoded.timestamp);
+    w.endObject();
+    return "position";
+}
+
+static const char *writeWaypointPayload(JsonWriter &w, const meshtastic_MeshPacket *mp, bool shouldLog)
+{
+    meshtastic_Waypoint decoded;
+    if (!decodePayload(mp, &meshtastic_Waypoint_msg, &decoded, "waypoint", shouldLog))
+        return "waypoint";
+
+    w.key("payload").beginObject();
+    w.key("description").value(decoded.description);
+    w.key("expire").value((unsigned int)decoded.expire);
+    w.key("id").value((unsigned int)decoded.id);
+    w.key("latitude_i").value((int)decoded.latitude_i);
+    w.key("locked_to").value((unsigned int)decoded.locked_to);
+    w.key("longitude_i").value((int)decoded.longitude_i);
+    w.key("name").value(decoded.name);
+    w.endObject();
+    return "waypoint";
+}
+
+static const char *writeNeighborInfoPayload(JsonWriter &w, const meshtastic_MeshPacket *mp, bool shouldLog)
+{
+    meshtastic_NeighborInfo decoded;
+    if (!decodePayload(mp, &meshtastic_NeighborInfo_msg, &decoded, "neighborinfo", shouldLog))
+        return "neighborinfo";
+
+    w.key("payload").beginObject();
+    w.key("last_sent_by_id").value((unsigned int)decoded.last_sent_by_id);
+    w.key("neighbors").beginArray();
+    for (uint8_t i = 0; i < decoded.neighbors_count; i++) {
+        w.beginObject();
+        w.key("node_id").value((unsigned int)decoded.neighbors[i].node_id);
+        w.key("snr").value((int)decoded.neighbors[i].snr);
+        w.endObject();
+    }
+    w.endArray();
+    w.key("neighbors_count").value((int)decoded.neighbors_count);
+    w.key("node_broadcast_interval_secs").value((unsigned int)decoded.node_broadcast_interval_secs);
+    w.key("node_id").value((unsigned int)decoded.node_id);
+    w.endObject();
+    return "neighborinfo";
+}
+
+/// Add the long name of a node (or "Unknown") to a traceroute route
+static void writeRouteName(JsonWriter &w, NodeNum num)
+{
+    meshtastic_NodeInfoLite *node = nodeDB->getMeshNode(num);
+    if (node && node->has_user)
+        w.value(node->user.long_name, strnlen(node->user.long_name, sizeof(node->user.long_name)));
+    else
+        w.value("Unknown");
+}
+
+static const char *writeTraceroutePayload(JsonWriter &w, const meshtastic_MeshPacket *mp, bool shouldLog)
+{
+    if (!mp->decoded.request_id) // Only report the traceroute response
+        return "";
+
+    meshtastic_RouteDiscovery decoded;
+    if (!decodePayload(mp, &meshtastic_RouteDiscovery_msg, &decoded, "traceroute", shouldLog))
+        return "traceroute";
+
+    w.key("payload").beginObject();
+
+    // Route this message took: started at the original transmitter (destination of response), ended at the original
+    // destination (source of response)
+    w.key("route").beginArray();
+    writeRouteName(w, mp->to);
+    for (uint8_t i = 0; i < decoded.route_count; i++)
+        writeRouteName(w, decoded.route[i]);
+    writeRouteName(w, mp->from);
+    w.endArray();
+
+    // Route this message took back
+    w.key("route_back").beginArray();
+    writeRouteName(w, mp->from);
+    for (uint8_t i = 0; i < decoded.route_back_count; i++)
+        writeRouteName(w, decoded.route_back[i]);
+    writeRouteName(w, mp->to);
+    w.endArray();
+
+    w.key("snr_back").beginArray();
+    for (uint8_t i = 0; i < decoded.snr_back_count; i++)
+        w.value((double)((float)decoded.snr_back[i] / 4));
+    w.endArray();
+
+    w.key("snr_towards").beginArray();
+    for (uint8_t i = 0; i < decoded.snr_towards_count; i++)
+        w.value((double)((float)decoded.snr_towards[i] / 4));
+    w.endArray();
+
+    w.endObject();
+    return "traceroute";
+}
+
+static const char *writeDetectionSensorPayload(JsonWriter &w, const meshtastic_MeshPacket *mp, bool shouldLog)
+{
+    const char *text = (const char *)mp->decoded.payload.bytes;
+    w.key("payload").beginObject();
+    w.key("text").value(text, strnlen(text, mp->decoded.payload.size));
+    w.endObject();
+    return "detection";
+}
+
 #ifdef ARCH_ESP32
-        case meshtastic_PortNum_PAXCOUNTER_APP: {
-            msgType = "paxcounter";
-            meshtastic_Paxcount scratch;
-            meshtastic_Paxcount *decoded = NULL;
-            memset(&scratch, 0, sizeof(scratch));
-            if (pb_decode_from_bytes(mp->decoded.payload.bytes, mp->decoded.payload.size, &meshtastic_Paxcount_msg, &scratch)) {
-                decoded = &scratch;
-                msgPayload["wifi_count"] = new JSONValue((unsigned int)decoded->wifi);
-                msgPayload["ble_count"] = new JSONValue((unsigned int)decoded->ble);
-                msgPayload["uptime"] = new JSONValue((unsigned int)decoded->uptime);
-                jsonObj["payload"] = new JSONValue(msgPayload);
-            } else if (shouldLog) {
-                LOG_ERROR(errStr, msgType.c_str());
-            }
-            break;
-        }
+static const char *writePaxcounterPayload(JsonWriter &w, const meshtastic_MeshPacket *mp, bool shouldLog)
+{
+    meshtastic_Paxcount decoded;
+    if (!decodePayload(mp, &meshtastic_Paxcount_msg, &decoded, "paxcounter", shouldLog))
+        return "paxcounter";
+
+    w.key("payload").beginObject();
+    w.key("ble_count").value((unsigned int)decoded.ble);
+    w.key("uptime").value((unsigned int)decoded.uptime);
+    w.key("wifi_count").value((unsigned int)decoded.wifi);
+    w.endObject();
+    return "paxcounter";
+}
 #endif
-        case meshtastic_PortNum_REMOTE_HARDWARE_APP: {
-            meshtastic_HardwareMessage scratch;
-            meshtastic_HardwareMessage *decoded = NULL;
-            memset(&scratch, 0, sizeof(scratch));
-            if (pb_decode_from_bytes(mp->decoded.payload.bytes, mp->decoded.payload.size, &meshtastic_HardwareMessage_msg,
-                                     &scratch)) {
-                decoded = &scratch;
-                if (decoded->type == meshtastic_HardwareMessage_Type_GPIOS_CHANGED) {
-                    msgType = "gpios_changed";
-                    msgPayload["gpio_value"] = new JSONValue((unsigned int)decoded->gpio_value);
-                    jsonObj["payload"] = new JSONValue(msgPayload);
-                } else if (decoded->type == meshtastic_HardwareMessage_Type_READ_GPIOS_REPLY) {
-                    msgType = "gpios_read_reply";
-                    msgPayload["gpio_value"] = new JSONValue((unsigned int)decoded->gpio_value);
-                    msgPayload["gpio_mask"] = new JSONValue((unsigned int)decoded->gpio_mask);
-                    jsonObj["payload"] = new JSONValue(msgPayload);
-                }
-            } else if (shouldLog) {
-                LOG_ERROR(errStr, "RemoteHardware");
-            }
-            break;
-        }
-        // add more packet types here if needed
-        default:
-            break;
-        }
+
+static const char *writeRemoteHardwarePayload(JsonWriter &w, const meshtastic_MeshPacket *mp, bool shouldLog)
+{
+    meshtastic_HardwareMessage decoded;
+    if (!decodePayload(mp, &meshtastic_HardwareMessage_msg, &decoded, "RemoteHardware", shouldLog))
+        return "";
+
+    if (decoded.type == meshtastic_HardwareMessage_Type_GPIOS_CHANGED) {
+        w.key("payload").beginObject();
+        w.key("gpio_value").value((unsigned int)decoded.gpio_value);
+        w.endObject();
+        return "gpios_changed";
+    } else if (decoded.type == meshtastic_HardwareMessage_Type_READ_GPIOS_REPLY) {
+        w.key("payload").beginObject();
+        w.key("gpio_mask").value((unsigned int)decoded.gpio_mask);
+        w.key("gpio_value").value((unsigned int)decoded.gpio_value);
+        w.endObject();
+        return "gpios_read_reply";
+    }
+    return "";
+}
+
+typedef const char *(*PayloadWriter)(JsonWriter &w, const meshtastic_MeshPacket *mp, bool shouldLog);
+
+static PayloadWriter payloadWriterFor(meshtastic_PortNum portnum)
+{
+    switch (portnum) {
+    case meshtastic_PortNum_TEXT_MESSAGE_APP:
+        return writeTextPayload;
+    case meshtastic_PortNum_TELEMETRY_APP:
+        return writeTelemetryPayload;
+    case meshtastic_PortNum_NODEINFO_APP:
+        return writeNodeInfoPayload;
+    case meshtastic_PortNum_POSITION_APP:
+        return writePositionPayload;
+    case meshtastic_PortNum_WAYPOINT_APP:
+        return writeWaypointPayload;
+    case meshtastic_PortNum_NEIGHBORINFO_APP:
+        return writeNeighborInfoPayload;
+    case meshtastic_PortNum_TRACEROUTE_APP:
+        return writeTraceroutePayload;
+    case meshtastic_PortNum_DETECTION_SENSOR_APP:
+        return writeDetectionSensorPayload;
+#ifdef ARCH_ESP32
+    case meshtastic_PortNum_PAXCOUNTER_APP:
+        return writePaxcounterPayload;
+#endif
+    case meshtastic_PortNum_REMOTE_HARDWARE_APP:
+        return writeRemoteHardwarePayload;
+    // add more packet types here if needed
+    default:
+        return NULL;
+    }
+}
+
+/// The hop_start and hops_away members, shared by both serializers
+static void writeHops(JsonWriter &w, const meshtastic_MeshPacket *mp)
+{
+    if (mp->hop_start != 0 && mp->hop_limit <= mp->hop_start) {
+        w.key("hop_start").value((unsigned int)(mp->hop_start));
+        w.key("hops_away").value((unsigned int)(mp->hop_start - mp->hop_limit));
+    }
+}
+
+size_t MeshPacketSerializer::JsonSerialize(const meshtastic_MeshPacket *mp, char *buf, size_t bufSize, bool shouldLog)
+{
+    JsonWriter w(buf, bufSize);
+    const char *msgType = "";
+
+    // Members in sorted key order, the same order the JSONObject (a std::map) used to give us
+    w.beginObject();
+    w.key("channel").value((unsigned int)mp->channel);
+    w.key("from").value((unsigned int)mp->from);
+    writeHops(w, mp);
+    w.key("id").value((unsigned int)mp->id);
+
+    if (mp->which_payload_variant == meshtastic_MeshPacket_decoded_tag) {
+        PayloadWriter writePayload = payloadWriterFor(mp->decoded.portnum);
+        if (writePayload)
+            msgType = writePayload(w, mp, shouldLog);
     } else if (shouldLog) {
         LOG_WARN("Couldn't convert encrypted payload of MeshPacket to JSON");
     }
 
-    jsonObj["id"] = new JSONValue((unsigned int)mp->id);
-    jsonObj["timestamp"] = new JSONValue((unsigned int)mp->rx_time);
-    jsonObj["to"] = new JSONValue((unsigned int)mp->to);
-    jsonObj["from"] = new JSONValue((unsigned int)mp->from);
-    jsonObj["channel"] = new JSONValue((unsigned int)mp->channel);
-    jsonObj["type"] = new JSONValue(msgType.c_str());
-    jsonObj["sender"] = new JSONValue(owner.id);
     if (mp->rx_rssi != 0)
-        jsonObj["rssi"] = new JSONValue((int)mp->rx_rssi);
+        w.key("rssi").value((int)mp->rx_rssi);
+    w.key("sender").value(owner.id);
     if (mp->rx_snr != 0)
-        jsonObj["snr"] = new JSONValue((float)mp->rx_snr);
-    if (mp->hop_start != 0 && mp->hop_limit <= mp->hop_start) {
-        jsonObj["hops_away"] = new JSONValue((unsigned int)(mp->hop_start - mp->hop_limit));
-        jsonObj["hop_start"] = new JSONValue((unsigned int)(mp->hop_start));
-    }
+        w.key("snr").value((double)(float)mp->rx_snr);
+    w.key("timestamp").value((unsigned int)mp->rx_time);
+    w.key("to").value((unsigned int)mp->to);
+    w.key("type").value(msgType);
+    w.endObject();
 
-    // serialize and write it to the stream
-    JSONValue *value = new JSONValue(jsonObj);
-    std::string jsonStr = value->Stringify();
+    size_t len = w.finish();
+    if (shouldLog && len < bufSize)
+        LOG_INFO("serialized json message: %s", buf);
+    return len;
+}
+
+std::string MeshPacketSerializer::JsonSerialize(const meshtastic_MeshPacket *mp, bool shouldLog)
+{
+    char buf[MESH_PACKET_JSON_BUF_SIZE];
+    size_t len = JsonSerialize(mp, buf, sizeof(buf), shouldLog);
+    if (len < sizeof(buf))
+        return std::string(buf, len);
 
+    // Rare (long escaped texts or traceroutes), do it again into a big enough buffer
+    std::string jsonStr(len + 1, '\0');
+    JsonSerialize(mp, &jsonStr[0], jsonStr.size(), false);
+    jsonStr.resize(len);
     if (shouldLog)
         LOG_INFO("serialized json message: %s", jsonStr.c_str());
-
-    delete value;
     return jsonStr;
 }
 
-std::string MeshPacketSerializer::JsonSerializeEncrypted(const meshtastic_MeshPacket *mp)
+size_t MeshPacketSerializer::JsonSerializeEncrypted(const meshtastic_MeshPacket *mp, char *buf, size_t bufSize)
 {
-    JSONObject jsonObj;
-
-    jsonObj["id"] = new JSONValue((unsigned int)mp->id);
-    jsonObj["time_ms"] = new JSONValue((double)millis());
-    jsonObj["timestamp"] = new JSONValue((unsigned int)mp->rx_time);
-    jsonObj["to"] = new JSONValue((unsigned int)mp->to);
-    jsonObj["from"] = new JSONValue((unsigned int)mp->from);
-    jsonObj["channel"] = new JSONValue((unsigned int)mp->channel);
-    jsonObj["want_ack"] = new JSONValue(mp->want_ack);
+    JsonWriter w(buf, bufSize);
 
+    w.beginObject();
+    w.key("bytes").valueHex(mp->encrypted.bytes, mp->encrypted.size);
+    w.key("channel").value((unsigned int)mp->channel);
+    w.key("from").value((unsigned int)mp->from);
+    writeHops(w, mp);
+    w.key("id").value((unsigned int)mp->id);
     if (mp->rx_rssi != 0)
-        jsonObj["rssi"] = new JSONValue((int)mp->rx_rssi);
+        w.key("rssi").value((int)mp->rx_rssi);
+    w.key("size").value((unsigned int)mp->encrypted.size);
     if (mp->rx_snr != 0)
-        jsonObj["snr"] = new JSONValue((float)mp->rx_snr);
-    if (mp->hop_start != 0 && mp->hop_limit <= mp->hop_start) {
-        jsonObj["hops_away"] = new JSONValue((unsigned int)(mp->hop_start - mp->hop_limit));
-        jsonObj["hop_start"] = new JSONValue((unsigned int)(mp->hop_start));
-    }
-    jsonObj["size"] = new JSONValue((unsigned int)mp->encrypted.size);
-    auto encryptedStr = bytesToHex(mp->encrypted.bytes, mp->encrypted.size);
-    jsonObj["bytes"] = new JSONValue(encryptedStr.c_str());
+        w.key("snr").value((double)(float)mp->rx_snr);
+    w.key("time_ms").value((double)millis());
+    w.key("timestamp").value((unsigned int)mp->rx_time);
+    w.key("to").value((unsigned int)mp->to);
+    w.key("want_ack").value(mp->want_ack);
+    w.endObject();
+
+    return w.finish();
+}
 
-    // serialize and write it to the stream
-    JSONValue *value = new JSONValue(jsonObj);
-    std::string jsonStr = value->Stringify();
+std::string MeshPacketSerializer::JsonSerializeEncrypted(const meshtastic_MeshPacket *mp)
+{
+    char buf[MESH_PACKET_JSON_BUF_SIZE];
+    size_t len = JsonSerializeEncrypted(mp, buf, sizeof(buf));
+    if (len < sizeof(buf))
+        return std::string(buf, len);
 
-    delete value;
+    std::string jsonStr(len + 1, '\0');
+    JsonSerializeEncrypted(mp, &jsonStr[0], jsonStr.size());
+    jsonStr.resize(len);
     return jsonStr;
 }
 #endif
\ No newline at end of file
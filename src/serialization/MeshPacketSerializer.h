@@ -1,6 +1,13 @@
+#pragma once
+
 #include <meshtastic/mesh.pb.h>
 #include <string>
 
+// Stack buffer the std::string serializers try first, anything longer takes a second pass
+#ifndef MESH_PACKET_JSON_BUF_SIZE
+#define MESH_PACKET_JSON_BUF_SIZE 512
+#endif
+
 static const char hexChars[16] = {'0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'A', 'B', 'C', 'D', 'E', 'F'};
 
 class MeshPacketSerializer
@@ -9,6 +16,13 @@ class MeshPacketSerializer
     static std::string JsonSerialize(const meshtastic_MeshPacket *mp, bool shouldLog = true);
     static std::string JsonSerializeEncrypted(const meshtastic_MeshPacket *mp);
 
+    /**
+     * Serialize straight into buf (always NUL terminated), without building a JSONValue tree
+     * @return the JSON length, like snprintf it is >= bufSize if the output didn't fit
+     */
+    static size_t JsonSerialize(const meshtastic_MeshPacket *mp, char *buf, size_t bufSize, bool shouldLog = true);
+    static size_t JsonSerializeEncrypted(const meshtastic_MeshPacket *mp, char *buf, size_t bufSize);
+
   private:
     static std::string bytesToHex(const uint8_t *bytes, int len)
     {
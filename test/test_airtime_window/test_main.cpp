@@ -0,0 +1,146 @@
+#include "DebugConfiguration.h"
+#include "TestUtil.h"
+#include <unity.h>
+
+#include "AirtimeWindow.h"
+
+namespace
+{
+// One minute in half second buckets, like channel utilization
+typedef AirtimeWindow<uint16_t, 120, 500> MinuteWindow;
+
+void test_slidesOut()
+{
+    MinuteWindow w;
+    w.add(1000, 200);
+    TEST_ASSERT_EQUAL_UINT32(200, w.sum(1000));
+    w.add(30000, 300);
+    TEST_ASSERT_EQUAL_UINT32(500, w.sum(30000));
+    // The first packet ended in the bucket starting at 500, which leaves the window a minute later
+    TEST_ASSERT_EQUAL_UINT32(200 + 300, w.sum(60499));
+    TEST_ASSERT_EQUAL_UINT32(300, w.sum(60500));
+    TEST_ASSERT_EQUAL_UINT32(0, w.sum(90000));
+}
+
+void test_spreadsOverBuckets()
+{
+    MinuteWindow w;
+    w.advance(0);
+    // 2.2 s of airtime ending at 10.1 s covers 7.9 s to 10.1 s
+    w.add(10100, 2200);
+    TEST_ASSERT_EQUAL_UINT32(2200, w.sum(10100));
+    // The 7.5 s - 8 s bucket holds 100 ms and is the first to go, a minute after it started
+    TEST_ASSERT_EQUAL_UINT32(2200, w.sum(67499));
+    TEST_ASSERT_EQUAL_UINT32(2100, w.sum(67500));
+    TEST_ASSERT_EQUAL_UINT32(100, w.sum(69999));
+    TEST_ASSERT_EQUAL_UINT32(0, w.sum(70000));
+}
+
+void test_longGapClears()
+{
+    MinuteWindow w;
+    w.add(5000, 400);
+    TEST_ASSERT_EQUAL_UINT32(0, w.sum(5000 + 10 * 60 * 1000));
+    w.add(5000 + 10 * 60 * 1000, 50);
+    TEST_ASSERT_EQUAL_UINT32(50, w.sum(5000 + 10 * 60 * 1000));
+}
+
+void test_millisWrap()
+{
+    MinuteWindow w;
+    uint32_t start = UINT32_MAX - 20000;
+    w.add(start, 100);
+    w.add(start + 30000, 100); // after the wrap
+    TEST_ASSERT_EQUAL_UINT32(200, w.sum(start + 30000));
+    TEST_ASSERT_EQUAL_UINT32(100, w.sum(start + 61000));
+    TEST_ASSERT_EQUAL_UINT32(0, w.sum(start + 91000));
+}
+
+void test_saturates()
+{
+    MinuteWindow w;
+    w.advance(0);
+    // Overlapping receptions can't push a 500 ms bucket past what its type holds
+    for (int i = 0; i < 1000; i++)
+        w.add(250, 200);
+    TEST_ASSERT_EQUAL_UINT32(UINT16_MAX, w.sum(250));
+}
+
+void test_msecUntilAtMost()
+{
+    // An hour in 10 s buckets, like TX utilization
+    AirtimeWindow<uint16_t, 360, 10000> w;
+    w.advance(0);
+    w.add(5000, 5000);    // bucket 0
+    w.add(605000, 4000);  // bucket 60
+    w.add(1205000, 3000); // bucket 120
+    uint32_t now = 1205000;
+    TEST_ASSERT_EQUAL_UINT32(0, w.msecUntilAtMost(now, 12000));
+    // Bucket 0 leaves at 3600 s
+    TEST_ASSERT_EQUAL_UINT32(3600000 - now, w.msecUntilAtMost(now, 7000));
+    // then bucket 60 at 4200 s
+    TEST_ASSERT_EQUAL_UINT32(4200000 - now, w.msecUntilAtMost(now, 3000));
+    TEST_ASSERT_EQUAL_UINT32(4800000 - now, w.msecUntilAtMost(now, 0));
+    TEST_ASSERT_EQUAL_UINT32(12000, w.sum(now));
+}
+
+void test_tallyKeepsBusiest()
+{
+    AirtimeTally<4> tally;
+    uint32_t now = 1000;
+    tally.add(now, 0x10, 500);
+    tally.add(now, 0x20, 100);
+    tally.add(now, 0x30, 300);
+    tally.add(now, 0x40, 200);
+    tally.add(now, 0x10, 500);
+
+    // A new key replaces the quietest one
+    tally.add(now, 0x50, 50);
+    TEST_ASSERT_EQUAL_UINT32(0, tally.get(now, 0x20));
+    TEST_ASSERT_EQUAL_UINT32(50, tally.get(now, 0x50));
+    TEST_ASSERT_EQUAL_UINT32(1000, tally.get(now, 0x10));
+
+    AirtimeShare top[3];
+    TEST_ASSERT_EQUAL(3, tally.getTop(now, top, 3));
+    TEST_ASSERT_EQUAL_UINT32(0x10, top[0].key);
+    TEST_ASSERT_EQUAL_UINT32(1000, top[0].msec);
+    TEST_ASSERT_EQUAL_UINT32(0x30, top[1].key);
+    TEST_ASSERT_EQUAL_UINT32(0x40, top[2].key);
+
+    AirtimeShare all[8];
+    TEST_ASSERT_EQUAL(4, tally.getTop(now, all, 8));
+    TEST_ASSERT_EQUAL_UINT32(0x50, all[3].key);
+}
+
+void test_tallyAgesOut()
+{
+    AirtimeTally<4> tally;
+    tally.add(1000, 0x10, 900);
+    tally.add(30 * 60 * 1000, 0x20, 100);
+    TEST_ASSERT_EQUAL_UINT32(900, tally.get(59 * 60 * 1000, 0x10));
+    TEST_ASSERT_EQUAL_UINT32(0, tally.get(61 * 60 * 1000, 0x10));
+
+    AirtimeShare top[4];
+    TEST_ASSERT_EQUAL(1, tally.getTop(61 * 60 * 1000, top, 4));
+    TEST_ASSERT_EQUAL_UINT32(0x20, top[0].key);
+}
+
+} // namespace
+
+void setup()
+{
+    initializeTestEnvironment();
+
+    UNITY_BEGIN();
+    RUN_TEST(test_slidesOut);
+    RUN_TEST(test_spreadsOverBuckets);
+    RUN_TEST(test_longGapClears);
+    RUN_TEST(test_millisWrap);
+    RUN_TEST(test_saturates);
+    RUN_TEST(test_msecUntilAtMost);
+    RUN_TEST(test_tallyKeepsBusiest);
+    RUN_TEST(test_tallyAgesOut);
+    exit(UNITY_END());
+}
+
+void loop() {}
@@ -1,8 +1,11 @@
 // trunk-ignore-all(gitleaks): These are dummy values. Not real secrets.
 #include "CryptoEngine.h"
+#include "aes-ccm.h"
 
 #include "TestUtil.h"
+#include <algorithm>
 #include <unity.h>
+#include <vector>
 
 void HexToBytes(uint8_t *result, const std::string hex, size_t len = 0)
 {
@@ -152,6 +155,46 @@ void test_PKC(void)
     TEST_ASSERT_EQUAL_MEMORY(expected_decrypted, decrypted, 10);
 }
 
+void test_PKC_shared_key_cache(void)
+{
+    uint8_t private_key[32];
+    meshtastic_UserLite_public_key_t public_key;
+    uint8_t expected_shared[32];
+    uint8_t radioBytes[128] __attribute__((__aligned__));
+    uint8_t decrypted[128] __attribute__((__aligned__));
+
+    uint32_t fromNode = 0x0929;
+    uint64_t packetNum = 0x13b2d662;
+    HexToBytes(public_key.bytes, "db18fc50eea47f00251cb784819a3cf5fc361882597f589f0d7ff820e8064457");
+    public_key.size = 32;
+    HexToBytes(private_key, "a00330633e63522f8a4d81ec6d9d1e6617f6c8ffd3a4c698229537d44e522277");
+    HexToBytes(expected_shared, "777b1545c9d6f9a2");
+    HexToBytes(radioBytes, "8c646d7a2909000062d6b2136b00000040df24abfcc30a17a3d9046726099e796a1c036a792b");
+    crypto->setDHPrivateKey(private_key);
+    crypto->invalidateSharedKey(fromNode);
+
+    // First packet from a peer derives the shared key, the next one comes from the cache
+    uint32_t hits = crypto->sharedKeyCacheHits;
+    uint32_t misses = crypto->sharedKeyCacheMisses;
+    TEST_ASSERT(crypto->decryptCurve25519(fromNode, public_key, packetNum, 22, radioBytes + 16, decrypted));
+    TEST_ASSERT_EQUAL(misses + 1, crypto->sharedKeyCacheMisses);
+    TEST_ASSERT(crypto->decryptCurve25519(fromNode, public_key, packetNum, 22, radioBytes + 16, decrypted));
+    TEST_ASSERT_EQUAL(hits + 1, crypto->sharedKeyCacheHits);
+    TEST_ASSERT_EQUAL_MEMORY(expected_shared, crypto->shared_key, 8);
+
+    // A different public key for the same node must not hit the cached key
+    meshtastic_UserLite_public_key_t other_key = public_key;
+    other_key.bytes[0] ^= 0x01;
+    crypto->decryptCurve25519(fromNode, other_key, packetNum, 22, radioBytes + 16, decrypted);
+    TEST_ASSERT_EQUAL(misses + 2, crypto->sharedKeyCacheMisses);
+
+    // Invalidating the node drops its entries
+    crypto->invalidateSharedKey(fromNode);
+    TEST_ASSERT(crypto->decryptCurve25519(fromNode, public_key, packetNum, 22, radioBytes + 16, decrypted));
+    TEST_ASSERT_EQUAL(misses + 3, crypto->sharedKeyCacheMisses);
+    TEST_ASSERT_EQUAL_MEMORY(expected_shared, crypto->shared_key, 8);
+}
+
 void test_AES_CTR(void)
 {
     uint8_t expected[32];
@@ -178,6 +221,142 @@ void test_AES_CTR(void)
     TEST_ASSERT_EQUAL_MEMORY(expected, plain, 16);
 }
 
+/// Every backend this build has
+std::vector<CryptoBackend *> backends()
+{
+    std::vector<CryptoBackend *> all = {softwareCryptoBackend()};
+#if HAS_OPENSSL_CRYPTO_BACKEND
+    all.push_back(openSSLCryptoBackend());
+#endif
+    return all;
+}
+
+void test_AES_context_cache(void)
+{
+    CryptoKey channelA, channelB;
+    channelA.length = 16;
+    memset(channelA.bytes, 0xaa, sizeof(channelA.bytes));
+    channelB.length = 32;
+    memset(channelB.bytes, 0xbb, sizeof(channelB.bytes));
+    uint8_t nonce[16] = {0};
+    uint8_t bytes[64] = {0};
+    uint8_t zero[64] = {0};
+
+    crypto->encryptAESCtr(channelA, nonce, sizeof(bytes), bytes);
+    crypto->encryptAESCtr(channelB, nonce, sizeof(bytes), bytes);
+    uint32_t hits = crypto->aesContextCacheHits;
+    uint32_t misses = crypto->aesContextCacheMisses;
+
+    // Trying one channel key after the other, as perhapsDecode does, expands neither of them again
+    for (int i = 0; i < 10; i++) {
+        crypto->encryptAESCtr(channelA, nonce, sizeof(bytes), bytes);
+        crypto->encryptAESCtr(channelB, nonce, sizeof(bytes), bytes);
+    }
+    TEST_ASSERT_EQUAL(misses, crypto->aesContextCacheMisses);
+    TEST_ASSERT_EQUAL(hits + 20, crypto->aesContextCacheHits);
+
+    // In place, so every second pass with the same key and nonce gives the plaintext back
+    crypto->encryptAESCtr(channelA, nonce, sizeof(bytes), bytes);
+    crypto->encryptAESCtr(channelB, nonce, sizeof(bytes), bytes);
+    TEST_ASSERT_EQUAL_MEMORY(zero, bytes, sizeof(bytes));
+
+    // A new backend starts from scratch
+    crypto->setBackend(crypto->getBackend());
+    crypto->encryptAESCtr(channelA, nonce, sizeof(bytes), bytes);
+    TEST_ASSERT_EQUAL(misses + 1, crypto->aesContextCacheMisses);
+}
+
+void test_backends_agree(void)
+{
+    CryptoBackend *original = crypto->getBackend();
+    CryptoKey k;
+    k.length = 32;
+    HexToBytes(k.bytes, "776BEFF2851DB06F4C8A0542C8696F6C6A81AF1EEC96B4D37FC1D689E6C1C104");
+    uint8_t nonce[16] = {0x62, 0xd6, 0xb2, 0x13, 0, 0, 0, 0, 0x29, 0x09};
+    uint8_t expectedCtr[MAX_BLOCKSIZE], expectedCcm[MAX_BLOCKSIZE + 8];
+
+    for (CryptoBackend *backend : backends()) {
+        LOG_INFO("Test the %s crypto backend", backend->name());
+        crypto->setBackend(backend);
+        test_ECB_AES256();
+        test_AES_CTR();
+        test_PKC();
+
+        // Whole packets, many blocks and a partial one, must come out the same whatever the backend
+        uint8_t ctr[MAX_BLOCKSIZE], ccm[MAX_BLOCKSIZE + 8], plain[MAX_BLOCKSIZE];
+        for (size_t i = 0; i < sizeof(plain); i++)
+            plain[i] = i * 7;
+        memcpy(ctr, plain, 233);
+        crypto->encryptAESCtr(k, nonce, 233, ctr);
+        aes_ccm_ae(k.bytes, 32, nonce, 8, plain, 233, nullptr, 0, ccm, ccm + 233);
+        if (backend == softwareCryptoBackend()) {
+            memcpy(expectedCtr, ctr, 233);
+            memcpy(expectedCcm, ccm, 233 + 8);
+        }
+        TEST_ASSERT_EQUAL_MEMORY(expectedCtr, ctr, 233);
+        TEST_ASSERT_EQUAL_MEMORY(expectedCcm, ccm, 233 + 8);
+        uint8_t decrypted[MAX_BLOCKSIZE];
+        TEST_ASSERT_TRUE(aes_ccm_ad(k.bytes, 32, nonce, 8, ccm, 233, nullptr, 0, ccm + 233, decrypted));
+        TEST_ASSERT_EQUAL_MEMORY(plain, decrypted, 233);
+    }
+    crypto->setBackend(original);
+}
+
+/// Throughput and per packet latency of channel (CTR) and PKI (CCM) crypto, for every backend
+void test_benchmark(void)
+{
+    CryptoBackend *original = crypto->getBackend();
+    const int rounds = 5000;
+    const size_t len = 200;
+    CryptoKey k;
+    k.length = 32;
+    HexToBytes(k.bytes, "776BEFF2851DB06F4C8A0542C8696F6C6A81AF1EEC96B4D37FC1D689E6C1C104");
+    uint8_t nonce[16] = {0x62, 0xd6, 0xb2, 0x13};
+    uint8_t plain[MAX_BLOCKSIZE] = {0}, bytes[MAX_BLOCKSIZE] = {0}, crypt[MAX_BLOCKSIZE + 8];
+    auto report = [&](const char *what, uint32_t usec) {
+        usec = std::max<uint32_t>(usec, 1);
+        LOG_INFO("  %s: %.1f MB/s, %.2f us/packet", what, (double)rounds * len / usec, (double)usec / rounds);
+    };
+
+    for (CryptoBackend *backend : backends()) {
+        crypto->setBackend(backend);
+        crypto->setKey(k);
+        LOG_INFO("%s crypto backend, %d packets of %u bytes", backend->name(), rounds, (unsigned)len);
+
+        uint32_t start = micros();
+        for (int i = 0; i < rounds; i++)
+            crypto->encryptPacket(0x0929, i, len, bytes);
+        report("CTR encrypt", micros() - start);
+
+        start = micros();
+        for (int i = rounds - 1; i >= 0; i--)
+            crypto->decrypt(0x0929, i, len, bytes);
+        report("CTR decrypt", micros() - start);
+        TEST_ASSERT_EQUAL_MEMORY(plain, bytes, len);
+
+        // What every packet used to cost, expanding the key each time
+        start = micros();
+        for (int i = 0; i < rounds; i++) {
+            crypto->clearAESContextCache();
+            crypto->encryptPacket(0x0929, i, len, bytes);
+        }
+        report("CTR encrypt, key expanded per packet", micros() - start);
+
+        start = micros();
+        for (int i = 0; i < rounds; i++)
+            aes_ccm_ae(k.bytes, 32, nonce, 8, plain, len, nullptr, 0, crypt, crypt + len);
+        report("CCM encrypt", micros() - start);
+
+        bool ok = true;
+        start = micros();
+        for (int i = 0; i < rounds; i++)
+            ok &= aes_ccm_ad(k.bytes, 32, nonce, 8, crypt, len, nullptr, 0, crypt + len, bytes);
+        report("CCM decrypt", micros() - start);
+        TEST_ASSERT_TRUE(ok);
+    }
+    crypto->setBackend(original);
+}
+
 void setup()
 {
     // NOTE!!! Wait for >2 secs
@@ -192,6 +371,10 @@ void setup()
     RUN_TEST(test_DH25519);
     RUN_TEST(test_AES_CTR);
     RUN_TEST(test_PKC);
+    RUN_TEST(test_PKC_shared_key_cache);
+    RUN_TEST(test_AES_context_cache);
+    RUN_TEST(test_backends_agree);
+    RUN_TEST(test_benchmark);
     exit(UNITY_END()); // stop unit testing
 }
 
@@ -0,0 +1,200 @@
+#include "DebugConfiguration.h"
+#include "TestUtil.h"
+#include <unity.h>
+
+#include "gps/GPSFrameParser.h"
+#include <string.h>
+#include <vector>
+
+namespace
+{
+
+std::vector<uint8_t> ubxFrame(uint8_t cls, uint8_t id, const std::vector<uint8_t> &payload)
+{
+    std::vector<uint8_t> f = {0xB5, 0x62, cls, id, (uint8_t)payload.size(), (uint8_t)(payload.size() >> 8)};
+    f.insert(f.end(), payload.begin(), payload.end());
+    uint8_t a = 0, b = 0;
+    for (size_t i = 2; i < f.size(); i++) {
+        a += f[i];
+        b += a;
+    }
+    f.push_back(a);
+    f.push_back(b);
+    return f;
+}
+
+/// Same sum as CASChecksum() in GPS.cpp
+std::vector<uint8_t> casFrame(uint8_t cls, uint8_t id, const std::vector<uint8_t> &payload)
+{
+    std::vector<uint8_t> f = {0xBA, 0xCE, (uint8_t)payload.size(), (uint8_t)(payload.size() >> 8), cls, id};
+    f.insert(f.end(), payload.begin(), payload.end());
+    uint32_t sum = ((uint32_t)id << 24) + ((uint32_t)cls << 16) + payload.size();
+    for (size_t i = 0; i + 4 <= payload.size(); i += 4)
+        sum += payload[i] | payload[i + 1] << 8 | payload[i + 2] << 16 | (uint32_t)payload[i + 3] << 24;
+    for (int i = 0; i < 4; i++)
+        f.push_back(sum >> (8 * i));
+    return f;
+}
+
+std::vector<uint8_t> text(const char *s)
+{
+    return std::vector<uint8_t>(s, s + strlen(s));
+}
+
+/// Feed bytes and collect the frame types that came out
+std::vector<GPSFrameType> feedAll(GPSFrameParser &parser, const std::vector<uint8_t> &bytes)
+{
+    std::vector<GPSFrameType> got;
+    for (uint8_t c : bytes) {
+        GPSFrameType t = parser.feed(c);
+        if (t != GPS_FRAME_NONE)
+            got.push_back(t);
+    }
+    return got;
+}
+
+void test_nmeaSentences()
+{
+    GPSFrameParser parser;
+    auto got = feedAll(parser, text("$GPTXT,01,01,02,HW=ATGM336H,0A*53\r\n"));
+    TEST_ASSERT_EQUAL(1, got.size());
+    TEST_ASSERT_EQUAL(GPS_FRAME_NMEA, got[0]);
+    TEST_ASSERT_EQUAL_STRING("$GPTXT,01,01,02,HW=ATGM336H,0A*53", parser.getSentence());
+    TEST_ASSERT_TRUE(parser.hasChecksum());
+
+    // Version replies from some chips come without a checksum and with bare \n
+    got = feedAll(parser, text("$PDTINFO,UC6580,R3.2\n"));
+    TEST_ASSERT_EQUAL(1, got.size());
+    TEST_ASSERT_EQUAL_STRING("$PDTINFO,UC6580,R3.2", parser.getSentence());
+    TEST_ASSERT_FALSE(parser.hasChecksum());
+    TEST_ASSERT_EQUAL_UINT32(0, parser.getErrors());
+}
+
+void test_nmeaBadChecksum()
+{
+    GPSFrameParser parser;
+    TEST_ASSERT_EQUAL(0, feedAll(parser, text("$GPTXT,01,01,02,HW=ATGM336H,0A*52\r\n")).size());
+    TEST_ASSERT_EQUAL(0, feedAll(parser, text("$GPTXT,01,01,02,HW=ATGM336H,0A*1\r\n")).size());
+    TEST_ASSERT_EQUAL_UINT32(2, parser.getErrors());
+
+    // A sentence cut short by a new one is dropped, the new one still comes through
+    auto got = feedAll(parser, text("$GPGGA,12$PMTK605*31\r\n"));
+    TEST_ASSERT_EQUAL(1, got.size());
+    TEST_ASSERT_EQUAL_STRING("$PMTK605*31", parser.getSentence());
+}
+
+void test_ubxFrames()
+{
+    GPSFrameParser parser;
+    // UBX-ACK-ACK for CFG-RATE, between two sentences
+    std::vector<uint8_t> bytes = text("$PMTK605*31\r\n");
+    auto ack = ubxFrame(0x05, 0x01, {0x06, 0x08});
+    bytes.insert(bytes.end(), ack.begin(), ack.end());
+    auto more = text("$PQTMVERNO*58\r\n");
+    bytes.insert(bytes.end(), more.begin(), more.end());
+
+    auto got = feedAll(parser, bytes);
+    TEST_ASSERT_EQUAL(3, got.size());
+    TEST_ASSERT_EQUAL(GPS_FRAME_UBX, got[1]);
+    TEST_ASSERT_EQUAL_STRING("$PQTMVERNO*58", parser.getSentence());
+
+    parser.reset();
+    for (size_t i = 0; i < ack.size(); i++)
+        TEST_ASSERT_EQUAL(i + 1 == ack.size() ? GPS_FRAME_UBX : GPS_FRAME_NONE, parser.feed(ack[i]));
+    TEST_ASSERT_EQUAL_HEX8(0x05, parser.getClass());
+    TEST_ASSERT_EQUAL_HEX8(0x01, parser.getId());
+    TEST_ASSERT_EQUAL(2, parser.getPayloadLength());
+    TEST_ASSERT_EQUAL_HEX8(0x06, parser.getPayload()[0]);
+    TEST_ASSERT_EQUAL_HEX8(0x08, parser.getPayload()[1]);
+
+    // Empty payload
+    TEST_ASSERT_EQUAL(1, feedAll(parser, ubxFrame(0x0A, 0x04, {})).size());
+    TEST_ASSERT_EQUAL(0, parser.getPayloadLength());
+    TEST_ASSERT_EQUAL_UINT32(0, parser.getErrors());
+}
+
+void test_ubxBadChecksum()
+{
+    GPSFrameParser parser;
+    auto ack = ubxFrame(0x05, 0x01, {0x06, 0x08});
+    ack[7] ^= 1;
+    TEST_ASSERT_EQUAL(0, feedAll(parser, ack).size());
+    TEST_ASSERT_EQUAL_UINT32(1, parser.getErrors());
+}
+
+void test_monVerPayload()
+{
+    // 40 bytes of versions and 5 extensions, like a M8 sends
+    std::vector<uint8_t> payload(40 + 5 * 30, 0);
+    memcpy(&payload[0], "ROM CORE 3.01 (107888)", 22);
+    memcpy(&payload[30], "00080000", 8);
+    memcpy(&payload[40 + 30], "PROTVER=18.00", 13);
+
+    GPSFrameParser parser;
+    auto got = feedAll(parser, ubxFrame(0x0A, 0x04, payload));
+    TEST_ASSERT_EQUAL(1, got.size());
+    TEST_ASSERT_EQUAL(payload.size(), parser.getPayloadLength());
+    TEST_ASSERT_EQUAL_STRING("00080000", (const char *)parser.getPayload() + 30);
+    TEST_ASSERT_EQUAL_STRING("PROTVER=18.00", (const char *)parser.getPayload() + 70);
+}
+
+void test_casFrames()
+{
+    GPSFrameParser parser;
+    // CAS-ACK-ACK for CFG-NAVX
+    auto got = feedAll(parser, casFrame(0x05, 0x01, {0x06, 0x07, 0x00, 0x00}));
+    TEST_ASSERT_EQUAL(1, got.size());
+    TEST_ASSERT_EQUAL(GPS_FRAME_CAS, got[0]);
+    TEST_ASSERT_EQUAL_HEX8(0x05, parser.getClass());
+    TEST_ASSERT_EQUAL_HEX8(0x01, parser.getId());
+    TEST_ASSERT_EQUAL_HEX8(0x07, parser.getPayload()[1]);
+
+    auto bad = casFrame(0x05, 0x00, {0x06, 0x04, 0x00, 0x00});
+    bad[bad.size() - 1] ^= 0x80;
+    TEST_ASSERT_EQUAL(0, feedAll(parser, bad).size());
+    TEST_ASSERT_EQUAL_UINT32(1, parser.getErrors());
+}
+
+void test_resyncAfterGarbage()
+{
+    GPSFrameParser parser;
+    // Noise from a wrong baud rate, a false UBX sync with a huge length, then good data
+    std::vector<uint8_t> bytes = {0x00, 0xFF, 0xB5, 0x13, 0xB5, 0x62, 0x01, 0x02, 0xFF, 0xFF, 0xBA, 0x00};
+    auto ack = ubxFrame(0x05, 0x00, {0x06, 0x3E});
+    bytes.insert(bytes.end(), ack.begin(), ack.end());
+    auto line = text("$GNRMC,,V,,,,,,,,,,N*4D\r\n");
+    bytes.insert(bytes.end(), line.begin(), line.end());
+
+    auto got = feedAll(parser, bytes);
+    TEST_ASSERT_EQUAL(2, got.size());
+    TEST_ASSERT_EQUAL(GPS_FRAME_UBX, got[0]);
+    TEST_ASSERT_EQUAL(GPS_FRAME_NMEA, got[1]);
+    TEST_ASSERT_EQUAL_STRING("$GNRMC,,V,,,,,,,,,,N*4D", parser.getSentence());
+
+    // Too long for the sentence buffer
+    std::vector<uint8_t> longLine(1, '$');
+    longLine.insert(longLine.end(), GPS_FRAME_MAX_SENTENCE + 10, 'A');
+    longLine.push_back('\n');
+    uint32_t errors = parser.getErrors();
+    TEST_ASSERT_EQUAL(0, feedAll(parser, longLine).size());
+    TEST_ASSERT_EQUAL_UINT32(errors + 1, parser.getErrors());
+}
+
+} // namespace
+
+void setup()
+{
+    initializeTestEnvironment();
+
+    UNITY_BEGIN();
+    RUN_TEST(test_nmeaSentences);
+    RUN_TEST(test_nmeaBadChecksum);
+    RUN_TEST(test_ubxFrames);
+    RUN_TEST(test_ubxBadChecksum);
+    RUN_TEST(test_monVerPayload);
+    RUN_TEST(test_casFrames);
+    RUN_TEST(test_resyncAfterGarbage);
+    exit(UNITY_END());
+}
+
+void loop() {}
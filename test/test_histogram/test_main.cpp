@@ -0,0 +1,86 @@
+#include "DebugConfiguration.h"
+#include "TestUtil.h"
+#include <unity.h>
+
+#include "mesh/Histogram.h"
+
+namespace
+{
+
+void test_buckets()
+{
+    Log2Histogram<6> h;
+    h.add(0);
+    h.add(1);
+    h.add(2);
+    h.add(3);
+    h.add(4);
+    h.add(15);
+    h.add(16);
+    h.add(UINT32_MAX);
+
+    TEST_ASSERT_EQUAL_UINT32(8, h.getTotal());
+    TEST_ASSERT_EQUAL_UINT32(1, h.getCount(0)); // 0
+    TEST_ASSERT_EQUAL_UINT32(1, h.getCount(1)); // 1
+    TEST_ASSERT_EQUAL_UINT32(2, h.getCount(2)); // 2..3
+    TEST_ASSERT_EQUAL_UINT32(1, h.getCount(3)); // 4..7
+    TEST_ASSERT_EQUAL_UINT32(1, h.getCount(4)); // 8..15
+    TEST_ASSERT_EQUAL_UINT32(2, h.getCount(5)); // 16 and up
+    TEST_ASSERT_EQUAL_UINT32(0, h.getCount(6));
+}
+
+void test_bucketLimits()
+{
+    TEST_ASSERT_EQUAL_UINT32(0, Log2Histogram<6>::getBucketLimit(0));
+    TEST_ASSERT_EQUAL_UINT32(1, Log2Histogram<6>::getBucketLimit(1));
+    TEST_ASSERT_EQUAL_UINT32(15, Log2Histogram<6>::getBucketLimit(4));
+    TEST_ASSERT_EQUAL_UINT32(UINT32_MAX, Log2Histogram<6>::getBucketLimit(5));
+    TEST_ASSERT_EQUAL_UINT32((1UL << 31) - 1, Log2Histogram<33>::getBucketLimit(31));
+
+    // Every value lands in a bucket whose limit is at least the value
+    const uint32_t values[] = {0, 1, 7, 8, 1000, 65535, 65536, UINT32_MAX};
+    Log2Histogram<33> h;
+    for (uint32_t v : values) {
+        h.reset();
+        h.add(v);
+        TEST_ASSERT_TRUE(h.percentile(100) >= v);
+        TEST_ASSERT_TRUE(h.percentile(100) / 2 <= v);
+    }
+}
+
+void test_percentile()
+{
+    Log2Histogram<16> h;
+    TEST_ASSERT_EQUAL_UINT32(0, h.percentile(50));
+
+    for (int i = 0; i < 98; i++)
+        h.add(10); // 8..15
+    h.add(100);    // 64..127
+    h.add(5000);   // 4096..8191
+
+    TEST_ASSERT_EQUAL_UINT32(15, h.percentile(0));
+    TEST_ASSERT_EQUAL_UINT32(15, h.percentile(50));
+    TEST_ASSERT_EQUAL_UINT32(15, h.percentile(98));
+    TEST_ASSERT_EQUAL_UINT32(127, h.percentile(99));
+    TEST_ASSERT_EQUAL_UINT32(8191, h.percentile(100));
+
+    h.reset();
+    TEST_ASSERT_EQUAL_UINT32(0, h.getTotal());
+    TEST_ASSERT_EQUAL_UINT32(0, h.getCount(3));
+    TEST_ASSERT_EQUAL_UINT32(0, h.percentile(99));
+}
+
+} // namespace
+
+void setup()
+{
+    initializeTestEnvironment();
+
+    UNITY_BEGIN();
+    RUN_TEST(test_buckets);
+    RUN_TEST(test_bucketLimits);
+    RUN_TEST(test_percentile);
+    exit(UNITY_END());
+}
+
+void loop() {}
@@ -0,0 +1,365 @@
+#include "DebugConfiguration.h"
+#include "TestUtil.h"
+#include <unity.h>
+
+#include "mesh/generated/meshtastic/mesh.pb.h"
+#include "mqtt/JsonDownlink.h"
+#include "serialization/JSON.h"
+#include "serialization/JsonReader.h"
+#include <mesh-pb-constants.h>
+
+#include <atomic>
+#include <cstddef>
+#include <new>
+#include <string.h>
+#include <string>
+
+// Count every allocation in this test binary and the most heap in use at once, so the benchmark can compare both parsers
+static std::atomic<size_t> allocations;
+static std::atomic<size_t> heapInUse;
+static std::atomic<size_t> heapPeak;
+
+void *operator new(size_t size)
+{
+    allocations++;
+    // Keep the size in front of the block, so delete knows how much is given back
+    std::max_align_t *p = (std::max_align_t *)malloc(sizeof(std::max_align_t) + size);
+    if (!p)
+        throw std::bad_alloc();
+    *(size_t *)p = size;
+    size_t inUse = heapInUse += size;
+    size_t peak = heapPeak;
+    while (inUse > peak && !heapPeak.compare_exchange_weak(peak, inUse))
+        ;
+    return p + 1;
+}
+
+void operator delete(void *p) noexcept
+{
+    if (!p)
+        return;
+    std::max_align_t *block = (std::max_align_t *)p - 1;
+    heapInUse -= *(size_t *)block;
+    free(block);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+    operator delete(p);
+}
+
+namespace
+{
+constexpr NodeNum ourNode = 0x12345678; // 305419896
+const char *ourId = "!12345678";
+
+/// All tokens of json as one letter each, X for an error
+std::string tokens(const char *json)
+{
+    static const char letters[] = "EX{}[]ksn10_";
+    JsonReader reader(json, strlen(json));
+    std::string result;
+    while (true) {
+        JsonToken token = reader.next();
+        result += letters[token];
+        if (token == JSON_END || token == JSON_ERROR)
+            return result;
+    }
+}
+
+JsonDownlinkResult decode(const char *json, meshtastic_MeshPacket &p)
+{
+    p = meshtastic_MeshPacket_init_default;
+    return decodeJsonDownlink(json, strlen(json), ourNode, ourId, 2, p);
+}
+
+void test_tokens()
+{
+    TEST_ASSERT_EQUAL_STRING("{ksk[n10_]kn}E", tokens(" {\"a\" : \"b\", \"c\":[1,true,false,null],\"d\":-0.5e+3}\r\n").c_str());
+    TEST_ASSERT_EQUAL_STRING("{}E", tokens("{}").c_str());
+    TEST_ASSERT_EQUAL_STRING("[[]{}]E", tokens("[[],{}]").c_str());
+    TEST_ASSERT_EQUAL_STRING("nE", tokens("42").c_str());
+    TEST_ASSERT_EQUAL_STRING("sE", tokens("\"\"").c_str());
+}
+
+void test_strictRejects()
+{
+    TEST_ASSERT_EQUAL_STRING("X", tokens("").c_str());
+    TEST_ASSERT_EQUAL_STRING("X", tokens("TRUE").c_str());
+    TEST_ASSERT_EQUAL_STRING("nX", tokens("01").c_str());
+    TEST_ASSERT_EQUAL_STRING("X", tokens("1.").c_str());
+    TEST_ASSERT_EQUAL_STRING("X", tokens(".5").c_str());
+    TEST_ASSERT_EQUAL_STRING("X", tokens("-").c_str());
+    TEST_ASSERT_EQUAL_STRING("X", tokens("1e").c_str());
+    TEST_ASSERT_EQUAL_STRING("X", tokens("\"tab\there\"").c_str());
+    TEST_ASSERT_EQUAL_STRING("X", tokens("\"\\x\"").c_str());
+    TEST_ASSERT_EQUAL_STRING("X", tokens("\"\\u12\"").c_str());
+    TEST_ASSERT_EQUAL_STRING("nX", tokens("1 2").c_str());
+    TEST_ASSERT_EQUAL_STRING("[nX", tokens("[1,]").c_str());
+    TEST_ASSERT_EQUAL_STRING("{knX", tokens("{\"a\":1,}").c_str());
+    TEST_ASSERT_EQUAL_STRING("{X", tokens("{\"a\" 1}").c_str());
+    TEST_ASSERT_EQUAL_STRING("{X", tokens("{a:1}").c_str());
+    TEST_ASSERT_EQUAL_STRING("[nX", tokens("[1}").c_str());
+    TEST_ASSERT_EQUAL_STRING("{kX", tokens("{\"unterminated\": ").c_str());
+
+    JsonReader reader("[1 x", 4);
+    reader.next();
+    reader.next();
+    TEST_ASSERT_EQUAL(JSON_ERROR, reader.next());
+    TEST_ASSERT_EQUAL(JsonReader::SYNTAX, reader.getError());
+    TEST_ASSERT_EQUAL(3, reader.getErrorOffset());
+    TEST_ASSERT_EQUAL(JSON_ERROR, reader.next()); // and stays failed
+}
+
+void test_limits()
+{
+    std::string deep(JSON_READER_MAX_DEPTH, '[');
+    deep += std::string(JSON_READER_MAX_DEPTH, ']');
+    JsonReader ok(deep.c_str(), deep.size());
+    TEST_ASSERT_TRUE(ok.skipValue());
+    TEST_ASSERT_EQUAL(JSON_END, ok.next());
+
+    std::string tooDeep = "[" + deep + "]";
+    JsonReader reader(tooDeep.c_str(), tooDeep.size());
+    TEST_ASSERT_FALSE(reader.skipValue());
+    TEST_ASSERT_EQUAL(JsonReader::TOO_DEEP, reader.getError());
+    TEST_ASSERT_EQUAL(JSON_READER_MAX_DEPTH, reader.getErrorOffset());
+
+    std::string big = "\"" + std::string(JSON_READER_MAX_LENGTH, 'a') + "\"";
+    JsonReader tooBig(big.c_str(), big.size());
+    TEST_ASSERT_EQUAL(JSON_ERROR, tooBig.next());
+    TEST_ASSERT_EQUAL(JsonReader::TOO_LONG, tooBig.getError());
+
+    std::string number(JSON_READER_MAX_NUMBER + 1, '1');
+    JsonReader longNumber(number.c_str(), number.size());
+    TEST_ASSERT_EQUAL(JSON_ERROR, longNumber.next());
+    TEST_ASSERT_EQUAL(JsonReader::TOO_LONG, longNumber.getError());
+}
+
+void test_strings()
+{
+    const char *json = "[\"a\\\"b\\\\c\\/d\\n\", \"\\u00e9\\u20AC\\ud83d\\udce1\", \"\\ud83d!\", \"no NUL after this\"]";
+    JsonReader reader(json, strlen(json));
+    char out[32];
+    reader.next();
+
+    TEST_ASSERT_EQUAL(JSON_STRING, reader.next());
+    TEST_ASSERT_EQUAL(8, reader.copyString(out, sizeof(out)));
+    TEST_ASSERT_EQUAL_STRING("a\"b\\c/d\n", out);
+    TEST_ASSERT_EQUAL(12, reader.getTextLength()); // escapes as they are
+    TEST_ASSERT_TRUE(reader.keyIs("a\"b\\c/d\n"));
+    TEST_ASSERT_FALSE(reader.keyIs("a\"b\\c/d"));
+    TEST_ASSERT_FALSE(reader.keyIs("a\"b\\c/d\nx"));
+
+    TEST_ASSERT_EQUAL(JSON_STRING, reader.next());
+    TEST_ASSERT_EQUAL(9, reader.copyString(out, sizeof(out)));
+    TEST_ASSERT_EQUAL_STRING("\xC3\xA9\xE2\x82\xAC\xF0\x9F\x93\xA1", out);
+
+    TEST_ASSERT_EQUAL(JSON_STRING, reader.next());
+    reader.copyString(out, sizeof(out));
+    TEST_ASSERT_EQUAL_STRING("\xEF\xBF\xBD!", out); // a lone surrogate
+
+    // Too small: as much as fits, no NUL, and the length needed
+    TEST_ASSERT_EQUAL(JSON_STRING, reader.next());
+    memset(out, 'x', sizeof(out));
+    TEST_ASSERT_EQUAL(17, reader.copyString(out, 4));
+    TEST_ASSERT_EQUAL_MEMORY("no N", out, 4);
+    TEST_ASSERT_EQUAL('x', out[4]);
+
+    // Exactly fitting: no room for the NUL either
+    TEST_ASSERT_EQUAL(17, reader.copyString(out, 17));
+    TEST_ASSERT_EQUAL('x', out[17]);
+
+    TEST_ASSERT_EQUAL(JSON_END_ARRAY, reader.next());
+    TEST_ASSERT_EQUAL(JSON_END, reader.next());
+
+    JsonReader truncated(json, 6); // ["a\"b
+    truncated.next();
+    TEST_ASSERT_EQUAL(JSON_ERROR, truncated.next()); // it never looks past len for the closing quote
+}
+
+void test_numbers()
+{
+    const char *json = "[0, -12, 3.25, 1e3, -2.5E-2]";
+    JsonReader reader(json, strlen(json));
+    reader.next();
+    const double expected[] = {0, -12, 3.25, 1000, -0.025};
+    for (double value : expected) {
+        TEST_ASSERT_EQUAL(JSON_NUMBER, reader.next());
+        TEST_ASSERT_EQUAL_DOUBLE(value, reader.getNumber());
+    }
+}
+
+void test_skipValue()
+{
+    const char *json = "{\"skip\": {\"a\": [1, {\"b\": []}], \"c\": \"}\"}, \"keep\": 7}";
+    JsonReader reader(json, strlen(json));
+    TEST_ASSERT_EQUAL(JSON_BEGIN_OBJECT, reader.next());
+    TEST_ASSERT_EQUAL(JSON_KEY, reader.next());
+    TEST_ASSERT_TRUE(reader.skipValue());
+    TEST_ASSERT_EQUAL(1, reader.getDepth());
+    TEST_ASSERT_EQUAL(JSON_KEY, reader.next());
+    TEST_ASSERT_TRUE(reader.keyIs("keep"));
+    TEST_ASSERT_EQUAL(JSON_NUMBER, reader.next());
+    TEST_ASSERT_EQUAL(JSON_END_OBJECT, reader.next());
+    TEST_ASSERT_EQUAL(JSON_END, reader.next());
+}
+
+void test_downlinkText()
+{
+    meshtastic_MeshPacket p;
+    TEST_ASSERT_EQUAL(JSON_DOWNLINK_OK, decode("{\"from\": 305419896, \"type\": \"sendtext\", \"payload\": \"hi \\u00e9\"}", p));
+    TEST_ASSERT_EQUAL(meshtastic_PortNum_TEXT_MESSAGE_APP, p.decoded.portnum);
+    TEST_ASSERT_EQUAL(5, p.decoded.payload.size);
+    TEST_ASSERT_EQUAL_MEMORY("hi \xC3\xA9", p.decoded.payload.bytes, 5);
+    TEST_ASSERT_EQUAL_UINT32(0, p.to); // untouched
+    TEST_ASSERT_EQUAL(0, p.channel);
+
+    // Members in any order, unknown ones skipped
+    TEST_ASSERT_EQUAL(JSON_DOWNLINK_OK, decode("{\"payload\": \"x\", \"extra\": {\"a\": [1]}, \"hopLimit\": 2,"
+                                               " \"to\": 4294967295, \"channel\": 1, \"type\": \"sendtext\","
+                                               " \"from\": 305419896}",
+                                               p));
+    TEST_ASSERT_EQUAL_UINT32(0xFFFFFFFF, p.to);
+    TEST_ASSERT_EQUAL(1, p.channel);
+    TEST_ASSERT_EQUAL(2, p.hop_limit);
+
+    // A channel we don't have is ignored, like before
+    TEST_ASSERT_EQUAL(JSON_DOWNLINK_OK,
+                      decode("{\"from\": 305419896, \"type\": \"sendtext\", \"payload\": \"x\", \"channel\": 2}", p));
+    TEST_ASSERT_EQUAL(0, p.channel);
+}
+
+void test_downlinkTextLength()
+{
+    meshtastic_MeshPacket p;
+    const size_t max = sizeof(p.decoded.payload.bytes);
+    std::string head = "{\"from\": 305419896, \"type\": \"sendtext\", \"payload\": \"";
+
+    std::string fits = head + std::string(max, 'a') + "\"}";
+    TEST_ASSERT_EQUAL(JSON_DOWNLINK_OK, decode(fits.c_str(), p));
+    TEST_ASSERT_EQUAL(max, p.decoded.payload.size);
+
+    std::string tooLong = head + std::string(max + 1, 'a') + "\"}";
+    TEST_ASSERT_EQUAL(JSON_DOWNLINK_TOO_LONG, decode(tooLong.c_str(), p));
+}
+
+void test_downlinkPosition()
+{
+    meshtastic_MeshPacket p;
+    TEST_ASSERT_EQUAL(JSON_DOWNLINK_OK,
+                      decode("{\"from\": 305419896, \"type\": \"sendposition\", \"payload\": {\"latitude_i\": 523456789,"
+                             " \"longitude_i\": -41234567, \"time\": 1700000000, \"speed\": [1]}}",
+                             p));
+    TEST_ASSERT_EQUAL(meshtastic_PortNum_POSITION_APP, p.decoded.portnum);
+
+    meshtastic_Position pos = meshtastic_Position_init_default;
+    TEST_ASSERT_TRUE(pb_decode_from_bytes(p.decoded.payload.bytes, p.decoded.payload.size, &meshtastic_Position_msg, &pos));
+    TEST_ASSERT_TRUE(pos.has_latitude_i);
+    TEST_ASSERT_EQUAL_INT32(523456789, pos.latitude_i);
+    TEST_ASSERT_TRUE(pos.has_longitude_i);
+    TEST_ASSERT_EQUAL_INT32(-41234567, pos.longitude_i);
+    TEST_ASSERT_FALSE(pos.has_altitude);
+    TEST_ASSERT_EQUAL_UINT32(1700000000, pos.time);
+}
+
+void test_downlinkRejects()
+{
+    meshtastic_MeshPacket p;
+    TEST_ASSERT_EQUAL(JSON_DOWNLINK_MALFORMED, decode("{\"from\": 305419896, \"type\": \"sendtext\", \"payload\": \"x\"", p));
+    TEST_ASSERT_EQUAL(JSON_DOWNLINK_MALFORMED, decode("{\"from\": 305419896, \"type\": \"sendtext\", \"payload\": \"x\"} {}", p));
+    TEST_ASSERT_EQUAL(JSON_DOWNLINK_MALFORMED, decode("", p));
+    TEST_ASSERT_EQUAL(JSON_DOWNLINK_BAD_ENVELOPE, decode("[1, 2]", p));
+    TEST_ASSERT_EQUAL(JSON_DOWNLINK_BAD_ENVELOPE, decode("\"sendtext\"", p));
+
+    TEST_ASSERT_EQUAL(JSON_DOWNLINK_BAD_ENVELOPE, decode("{\"from\": 1, \"type\": \"sendtext\", \"payload\": \"x\"}", p));
+    TEST_ASSERT_EQUAL(JSON_DOWNLINK_BAD_ENVELOPE,
+                      decode("{\"from\": \"305419896\", \"type\": \"sendtext\", \"payload\": \"x\"}", p));
+    TEST_ASSERT_EQUAL(JSON_DOWNLINK_BAD_ENVELOPE, decode("{\"from\": 305419896, \"payload\": \"x\"}", p));
+    TEST_ASSERT_EQUAL(JSON_DOWNLINK_BAD_ENVELOPE, decode("{\"from\": 305419896, \"type\": \"sendtext\"}", p));
+    TEST_ASSERT_EQUAL(JSON_DOWNLINK_BAD_ENVELOPE,
+                      decode("{\"from\": 305419896, \"type\": \"sendtext\", \"payload\": \"x\", \"hopLimit\": \"3\"}", p));
+    TEST_ASSERT_EQUAL(JSON_DOWNLINK_BAD_ENVELOPE,
+                      decode("{\"from\": 305419896, \"type\": \"sendtext\", \"payload\": \"x\", \"sender\": \"!12345678\"}", p));
+    TEST_ASSERT_EQUAL(JSON_DOWNLINK_OK,
+                      decode("{\"from\": 305419896, \"type\": \"sendtext\", \"payload\": \"x\", \"sender\": \"!87654321\"}", p));
+
+    TEST_ASSERT_EQUAL(JSON_DOWNLINK_UNSUPPORTED, decode("{\"from\": 305419896, \"type\": \"sendtext\", \"payload\": {}}", p));
+    TEST_ASSERT_EQUAL(JSON_DOWNLINK_UNSUPPORTED,
+                      decode("{\"from\": 305419896, \"type\": \"sendposition\", \"payload\": \"x\"}", p));
+    TEST_ASSERT_EQUAL(JSON_DOWNLINK_UNSUPPORTED,
+                      decode("{\"from\": 305419896, \"type\": \"sendtextsendtextsendtext\", \"payload\": \"x\"}", p));
+}
+
+/// Envelopes per second, allocations and peak heap for JSON::Parse against decodeJsonDownlink
+void test_benchmark()
+{
+    const char *envelopes[] = {
+        "{\"from\": 305419896, \"type\": \"sendtext\", \"payload\": \"Anyone on the mountain tonight?\", \"channel\": 1}",
+        "{\"from\": 305419896, \"to\": 4294967295, \"hopLimit\": 3, \"type\": \"sendposition\", \"payload\": "
+        "{\"latitude_i\": 523456789, \"longitude_i\": 41234567, \"altitude\": 120, \"time\": 1700000000}}",
+    };
+    const int rounds = 20000;
+    size_t checksum = 0;
+
+    size_t allocsBefore = allocations;
+    heapPeak = heapInUse.load();
+    size_t heapBefore = heapInUse;
+    uint32_t start = millis();
+    for (int i = 0; i < rounds; i++)
+        for (const char *json : envelopes) {
+            JSONValue *value = JSON::Parse(json);
+            checksum += value && value->IsObject() ? value->AsObject().size() : 0;
+            delete value;
+        }
+    uint32_t domMsec = millis() - start;
+    size_t domAllocs = allocations - allocsBefore;
+    size_t domPeak = heapPeak - heapBefore;
+
+    meshtastic_MeshPacket p;
+    allocsBefore = allocations;
+    heapPeak = heapInUse.load();
+    heapBefore = heapInUse;
+    start = millis();
+    for (int i = 0; i < rounds; i++)
+        for (const char *json : envelopes) {
+            p = meshtastic_MeshPacket_init_default;
+            checksum += decodeJsonDownlink(json, strlen(json), ourNode, ourId, 2, p) == JSON_DOWNLINK_OK;
+        }
+    uint32_t readerMsec = millis() - start;
+    size_t readerAllocs = allocations - allocsBefore;
+    size_t readerPeak = heapPeak - heapBefore;
+
+    const size_t n = rounds * (sizeof(envelopes) / sizeof(envelopes[0]));
+    LOG_INFO("JSON downlink benchmark, %u envelopes: JSON::Parse %u ms, %.1f allocs/envelope, %u bytes peak heap; "
+             "JsonReader %u ms, %.1f allocs/envelope, %u bytes peak heap",
+             (unsigned)n, domMsec, (double)domAllocs / n, (unsigned)domPeak, readerMsec, (double)readerAllocs / n,
+             (unsigned)readerPeak);
+
+    TEST_ASSERT_EQUAL(rounds * (4 + 5 + 2), checksum); // both saw every envelope
+    TEST_ASSERT_EQUAL(0, readerAllocs);
+    TEST_ASSERT_EQUAL(0, readerPeak);
+}
+
+} // namespace
+
+void setup()
+{
+    initializeTestEnvironment();
+
+    UNITY_BEGIN();
+    RUN_TEST(test_tokens);
+    RUN_TEST(test_strictRejects);
+    RUN_TEST(test_limits);
+    RUN_TEST(test_strings);
+    RUN_TEST(test_numbers);
+    RUN_TEST(test_skipValue);
+    RUN_TEST(test_downlinkText);
+    RUN_TEST(test_downlinkTextLength);
+    RUN_TEST(test_downlinkPosition);
+    RUN_TEST(test_downlinkRejects);
+    RUN_TEST(test_benchmark);
+    exit(UNITY_END());
+}
+
+void loop() {}
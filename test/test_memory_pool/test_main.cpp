@@ -0,0 +1,113 @@
+#include "DebugConfiguration.h"
+#include "TestUtil.h"
+#include <unity.h>
+
+#include "mesh/MemoryPool.h"
+#include "mesh/MeshTypes.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace
+{
+constexpr size_t poolSize = 16;
+
+void test_allocReleaseReuses()
+{
+    MemoryPool<meshtastic_MeshPacket, poolSize> pool;
+
+    meshtastic_MeshPacket *p = pool.allocZeroed();
+    TEST_ASSERT_NOT_NULL(p);
+    TEST_ASSERT_EQUAL_UINT32(0, p->id);
+    pool.release(p);
+
+    // The free list is a stack, so the block we just gave back is the next one handed out
+    TEST_ASSERT_EQUAL_PTR(p, pool.allocZeroed());
+}
+
+void test_statsTrackLiveAndHighWater()
+{
+    MemoryPool<meshtastic_MeshPacket, poolSize> pool;
+    std::vector<meshtastic_MeshPacket *> packets;
+
+    for (size_t i = 0; i < 5; i++)
+        packets.push_back(pool.allocZeroed());
+    pool.release(packets.back());
+    packets.pop_back();
+
+    MemoryPoolStats stats = pool.getStats();
+    TEST_ASSERT_EQUAL_UINT32(poolSize, stats.capacity);
+    TEST_ASSERT_EQUAL_UINT32(4, stats.live);
+    TEST_ASSERT_EQUAL_UINT32(5, stats.highWater);
+    TEST_ASSERT_EQUAL_UINT32(0, stats.overflows);
+
+    for (auto p : packets)
+        pool.release(p);
+    TEST_ASSERT_EQUAL_UINT32(0, pool.getStats().live);
+}
+
+void test_overflowFallsBackToHeap()
+{
+    MemoryPool<meshtastic_MeshPacket, poolSize> pool;
+    std::vector<meshtastic_MeshPacket *> packets;
+
+    for (size_t i = 0; i < poolSize + 3; i++) {
+        packets.push_back(pool.allocZeroed());
+        TEST_ASSERT_NOT_NULL(packets.back());
+    }
+
+    MemoryPoolStats stats = pool.getStats();
+    TEST_ASSERT_EQUAL_UINT32(poolSize + 3, stats.live);
+    TEST_ASSERT_EQUAL_UINT32(3, stats.overflows);
+
+    for (auto p : packets)
+        pool.release(p);
+    TEST_ASSERT_EQUAL_UINT32(0, pool.getStats().live);
+}
+
+void test_concurrentAllocRelease()
+{
+    static MemoryPool<meshtastic_MeshPacket, poolSize> pool;
+    const uint32_t rounds = 20000;
+    static std::atomic<bool> clash(false);
+
+    std::vector<std::thread> threads;
+    for (uint32_t t = 1; t <= 4; t++) {
+        threads.emplace_back([t, rounds] {
+            for (uint32_t i = 0; i < rounds; i++) {
+                meshtastic_MeshPacket *a = pool.allocZeroed();
+                meshtastic_MeshPacket *b = pool.allocZeroed();
+                a->id = t;
+                b->id = t;
+                // Nobody else may have been handed the same blocks (Unity asserts are not thread safe)
+                if (a->id != t || b->id != t)
+                    clash = true;
+                pool.release(b);
+                pool.release(a);
+            }
+        });
+    }
+    for (auto &th : threads)
+        th.join();
+
+    TEST_ASSERT_FALSE(clash);
+    MemoryPoolStats stats = pool.getStats();
+    TEST_ASSERT_EQUAL_UINT32(0, stats.live);
+    TEST_ASSERT_EQUAL_UINT32(0, stats.overflows);
+}
+} // namespace
+
+void setup()
+{
+    initializeTestEnvironment();
+
+    UNITY_BEGIN();
+    RUN_TEST(test_allocReleaseReuses);
+    RUN_TEST(test_statsTrackLiveAndHighWater);
+    RUN_TEST(test_overflowFallsBackToHeap);
+    RUN_TEST(test_concurrentAllocRelease);
+    exit(UNITY_END());
+}
+
+void loop() {}
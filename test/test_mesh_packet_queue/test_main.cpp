@@ -0,0 +1,240 @@
+#include "DebugConfiguration.h"
+#include "TestUtil.h"
+#include <unity.h>
+
+#include "mesh/MeshPacketQueue.h"
+#include "mesh/NodeDB.h"
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+bool CompareMeshPacketFunc(const meshtastic_MeshPacket *p1, const meshtastic_MeshPacket *p2);
+
+namespace
+{
+class MockNodeDB : public NodeDB
+{
+  public:
+    meshtastic_NodeInfoLite *getMeshNode(NodeNum n) override { return &emptyNode; }
+    meshtastic_NodeInfoLite emptyNode = {};
+};
+
+/// The previous MeshPacketQueue: a vector kept sorted with upper_bound inserts and linear scans.  The heap based queue must
+/// hand out packets in exactly the same order.
+class ReferenceQueue
+{
+    size_t maxLen;
+    std::vector<meshtastic_MeshPacket *> queue;
+
+  public:
+    explicit ReferenceQueue(size_t _maxLen) : maxLen(_maxLen) {}
+
+    bool enqueue(meshtastic_MeshPacket *p)
+    {
+        if (queue.size() >= maxLen) {
+            // Evict the last non-late packet if it has lower priority
+            auto it = queue.end();
+            while (it != queue.begin() && (*(it - 1))->tx_after)
+                it--;
+            if (it == queue.begin() || (*(it - 1))->priority >= p->priority)
+                return false;
+            packetPool.release(*(it - 1));
+            queue.erase(it - 1);
+        }
+        queue.insert(std::upper_bound(queue.begin(), queue.end(), p, CompareMeshPacketFunc), p);
+        return true;
+    }
+
+    meshtastic_MeshPacket *dequeue()
+    {
+        if (queue.empty())
+            return NULL;
+        auto p = queue.front();
+        queue.erase(queue.begin());
+        return p;
+    }
+
+    meshtastic_MeshPacket *remove(NodeNum from, PacketId id, bool tx_normal, bool tx_late)
+    {
+        for (auto it = queue.begin(); it != queue.end(); it++) {
+            auto p = *it;
+            if (getFrom(p) == from && p->id == id && ((tx_normal && !p->tx_after) || (tx_late && p->tx_after))) {
+                queue.erase(it);
+                return p;
+            }
+        }
+        return NULL;
+    }
+
+    bool find(NodeNum from, PacketId id)
+    {
+        return std::any_of(queue.begin(), queue.end(), [&](auto p) { return getFrom(p) == from && p->id == id; });
+    }
+
+    size_t size() { return queue.size(); }
+};
+
+/// Serial number stashed in rx_time, so packets from the two queues can be matched up
+uint32_t nextSerial = 1;
+
+meshtastic_MeshPacket *makePacket(NodeNum from, PacketId id, uint32_t priority, uint32_t txAfter = 0)
+{
+    meshtastic_MeshPacket p = meshtastic_MeshPacket_init_zero;
+    p.from = from;
+    p.id = id;
+    p.priority = (meshtastic_MeshPacket_Priority)priority;
+    p.tx_after = txAfter;
+    p.rx_time = nextSerial++;
+    return packetPool.allocCopy(p);
+}
+
+void test_priorityThenArrivalOrder()
+{
+    MeshPacketQueue q(8);
+
+    auto bg = makePacket(0x10, 1, meshtastic_MeshPacket_Priority_BACKGROUND);
+    auto late = makePacket(0x10, 2, meshtastic_MeshPacket_Priority_ACK, 1000);
+    auto rel1 = makePacket(0x10, 3, meshtastic_MeshPacket_Priority_RELIABLE);
+    auto ack = makePacket(0x10, 4, meshtastic_MeshPacket_Priority_ACK);
+    auto rel2 = makePacket(0x10, 5, meshtastic_MeshPacket_Priority_RELIABLE);
+    for (auto p : {bg, late, rel1, ack, rel2})
+        TEST_ASSERT_TRUE(q.enqueue(p));
+
+    // Late window last regardless of priority, equal priorities first come first served
+    for (auto p : {ack, rel1, rel2, bg, late}) {
+        TEST_ASSERT_EQUAL_PTR(p, q.dequeue());
+        packetPool.release(p);
+    }
+    TEST_ASSERT_NULL(q.dequeue());
+}
+
+void test_removeAndFind()
+{
+    MeshPacketQueue q(8);
+
+    auto normal = makePacket(0x20, 7, meshtastic_MeshPacket_Priority_DEFAULT);
+    auto late = makePacket(0x20, 7, meshtastic_MeshPacket_Priority_DEFAULT, 500);
+    q.enqueue(late);
+    q.enqueue(normal);
+
+    TEST_ASSERT_TRUE(q.find(0x20, 7));
+    TEST_ASSERT_FALSE(q.find(0x21, 7));
+    TEST_ASSERT_EQUAL_PTR(late, q.remove(0x20, 7, false, true));
+    TEST_ASSERT_NULL(q.remove(0x20, 7, false, true));
+    TEST_ASSERT_EQUAL_PTR(normal, q.remove(0x20, 7));
+    TEST_ASSERT_FALSE(q.find(0x20, 7));
+    TEST_ASSERT_TRUE(q.empty());
+    packetPool.release(late);
+    packetPool.release(normal);
+}
+
+void test_fullQueueEvictsLowerPriority()
+{
+    MeshPacketQueue q(2);
+
+    q.enqueue(makePacket(0x30, 1, meshtastic_MeshPacket_Priority_BACKGROUND));
+    auto late = makePacket(0x30, 2, meshtastic_MeshPacket_Priority_MIN, 100);
+    q.enqueue(late);
+
+    // Late packets are never evicted, and the background one only for something more important
+    auto low = makePacket(0x30, 3, meshtastic_MeshPacket_Priority_MIN);
+    TEST_ASSERT_FALSE(q.enqueue(low));
+    packetPool.release(low);
+
+    auto high = makePacket(0x30, 4, meshtastic_MeshPacket_Priority_HIGH);
+    TEST_ASSERT_TRUE(q.enqueue(high));
+    TEST_ASSERT_FALSE(q.find(0x30, 1));
+    TEST_ASSERT_EQUAL_PTR(high, q.dequeue());
+    TEST_ASSERT_EQUAL_PTR(late, q.dequeue());
+    packetPool.release(high);
+    packetPool.release(late);
+}
+
+void assertSamePacket(meshtastic_MeshPacket *expected, meshtastic_MeshPacket *actual)
+{
+    TEST_ASSERT_EQUAL(!!expected, !!actual);
+    if (expected)
+        TEST_ASSERT_EQUAL_UINT32(expected->rx_time, actual->rx_time);
+}
+
+void test_matchesReferenceOrdering()
+{
+    const uint32_t maxLen = 16, rounds = 200, opsPerRound = 400;
+    srandom(42);
+
+    for (uint32_t round = 0; round < rounds; round++) {
+        MeshPacketQueue q(maxLen);
+        ReferenceQueue ref(maxLen);
+
+        for (uint32_t op = 0; op < opsPerRound; op++) {
+            NodeNum from = random() % 3 ? 0x40 + random() % 3 : 0; // 0 means from us
+            NodeNum key = from ? from : nodeDB->getNodeNum();
+            PacketId id = 1 + random() % 8;
+            switch (random() % 8) {
+            case 0:
+            case 1:
+            case 2: {
+                meshtastic_MeshPacket *p = makePacket(from, id, 10 * (random() % 12), random() % 4 ? 0 : 1 + random() % 9);
+                meshtastic_MeshPacket *copy = packetPool.allocCopy(*p);
+                bool queued = ref.enqueue(p);
+                TEST_ASSERT_EQUAL(queued, q.enqueue(copy));
+                if (!queued) {
+                    packetPool.release(p);
+                    packetPool.release(copy);
+                }
+                break;
+            }
+            case 3:
+            case 4: {
+                meshtastic_MeshPacket *expected = ref.dequeue(), *actual = q.dequeue();
+                assertSamePacket(expected, actual);
+                if (expected) {
+                    packetPool.release(expected);
+                    packetPool.release(actual);
+                }
+                break;
+            }
+            case 5:
+            case 6: {
+                bool normal = random() % 2, late = random() % 2;
+                meshtastic_MeshPacket *expected = ref.remove(key, id, normal, late), *actual = q.remove(key, id, normal, late);
+                assertSamePacket(expected, actual);
+                if (expected) {
+                    packetPool.release(expected);
+                    packetPool.release(actual);
+                }
+                break;
+            }
+            default:
+                TEST_ASSERT_EQUAL(ref.find(key, id), q.find(key, id));
+                TEST_ASSERT_EQUAL(maxLen - ref.size(), q.getFree());
+            }
+        }
+
+        while (meshtastic_MeshPacket *expected = ref.dequeue()) {
+            meshtastic_MeshPacket *actual = q.dequeue();
+            assertSamePacket(expected, actual);
+            packetPool.release(expected);
+            packetPool.release(actual);
+        }
+        TEST_ASSERT_TRUE(q.empty());
+    }
+}
+} // namespace
+
+void setup()
+{
+    initializeTestEnvironment();
+    const std::unique_ptr<MockNodeDB> mockNodeDB(new MockNodeDB());
+    nodeDB = mockNodeDB.get();
+
+    UNITY_BEGIN();
+    RUN_TEST(test_priorityThenArrivalOrder);
+    RUN_TEST(test_removeAndFind);
+    RUN_TEST(test_fullQueueEvictsLowerPriority);
+    RUN_TEST(test_matchesReferenceOrdering);
+    exit(UNITY_END());
+}
+
+void loop() {}
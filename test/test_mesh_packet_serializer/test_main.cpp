@@ -0,0 +1,800 @@
+#include "DebugConfiguration.h"
+#include "TestUtil.h"
+#include <unity.h>
+
+#include "mesh/NodeDB.h"
+#include "mesh/generated/meshtastic/mqtt.pb.h"
+#include "mesh/generated/meshtastic/remote_hardware.pb.h"
+#include "mesh/generated/meshtastic/telemetry.pb.h"
+#include "serialization/JSON.h"
+#include "serialization/MeshPacketSerializer.h"
+#include <mesh-pb-constants.h>
+#if defined(ARCH_ESP32)
+#include "mesh/generated/meshtastic/paxcount.pb.h"
+#endif
+
+#include <atomic>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+
+// Count every allocation in this test binary, so the benchmark can compare heap churn
+static std::atomic<size_t> allocations;
+
+void *operator new(size_t size)
+{
+    allocations++;
+    void *p = malloc(size ? size : 1);
+    if (!p)
+        throw std::bad_alloc();
+    return p;
+}
+
+void operator delete(void *p) noexcept
+{
+    free(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+    free(p);
+}
+
+namespace
+{
+class MockNodeDB : public NodeDB
+{
+  public:
+    // Odd node numbers are known, with a long name made from the number
+    meshtastic_NodeInfoLite *getMeshNode(NodeNum n) override
+    {
+        node = meshtastic_NodeInfoLite_init_zero;
+        node.num = n;
+        node.has_user = n & 1;
+        snprintf(node.user.long_name, sizeof(node.user.long_name), "Node \"%u\" / é", n);
+        return &node;
+    }
+    meshtastic_NodeInfoLite node;
+};
+
+/*
+ * The JSONValue based serializer MeshPacketSerializer used before it streamed its output, kept verbatim as the reference the
+ * streaming one has to match byte for byte.
+ */
+std::string referenceBytesToHex(const uint8_t *bytes, int len)
+{
+    static const char hexChars[16] = {'0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'A', 'B', 'C', 'D', 'E', 'F'};
+    std::string result = "";
+    for (int i = 0; i < len; ++i) {
+        char const byte = bytes[i];
+        result += hexChars[(byte & 0xF0) >> 4];
+        result += hexChars[(byte & 0x0F) >> 0];
+    }
+    return result;
+}
+
+static const char *errStr = "Error decoding proto for %s message!";
+
+std::string referenceJsonSerialize(const meshtastic_MeshPacket *mp, bool shouldLog = false)
+{
+    // the created jsonObj is immutable after creation, so
+    // we need to do the heavy lifting before assembling it.
+    std::string msgType;
+    JSONObject jsonObj;
+
+    if (mp->which_payload_variant == meshtastic_MeshPacket_decoded_tag) {
+        JSONObject msgPayload;
+        switch (mp->decoded.portnum) {
+        case meshtastic_PortNum_TEXT_MESSAGE_APP: {
+            msgType = "text";
+            // convert bytes to string
+            if (shouldLog)
+                LOG_DEBUG("got text message of size %u", mp->decoded.payload.size);
+
+            char payloadStr[(mp->decoded.payload.size) + 1];
+            memcpy(payloadStr, mp->decoded.payload.bytes, mp->decoded.payload.size);
+            payloadStr[mp->decoded.payload.size] = 0; // null terminated string
+            // check if this is a JSON payload
+            JSONValue *json_value = JSON::Parse(payloadStr);
+            if (json_value != NULL) {
+                if (shouldLog)
+                    LOG_INFO("text message payload is of type json");
+
+                // if it is, then we can just use the json object
+                jsonObj["payload"] = json_value;
+            } else {
+                // if it isn't, then we need to create a json object
+                // with the string as the value
+                if (shouldLog)
+                    LOG_INFO("text message payload is of type plaintext");
+
+                msgPayload["text"] = new JSONValue(payloadStr);
+                jsonObj["payload"] = new JSONValue(msgPayload);
+            }
+            break;
+        }
+        case meshtastic_PortNum_TELEMETRY_APP: {
+            msgType = "telemetry";
+            meshtastic_Telemetry scratch;
+            meshtastic_Telemetry *decoded = NULL;
+            memset(&scratch, 0, sizeof(scratch));
+            if (pb_decode_from_bytes(mp->decoded.payload.bytes, mp->decoded.payload.size, &meshtastic_Telemetry_msg, &scratch)) {
+                decoded = &scratch;
+                if (decoded->which_variant == meshtastic_Telemetry_device_metrics_tag) {
+                    msgPayload["battery_level"] = new JSONValue((unsigned int)decoded->variant.device_metrics.battery_level);
+                    msgPayload["voltage"] = new JSONValue(decoded->variant.device_metrics.voltage);
+                    msgPayload["channel_utilization"] = new JSONValue(decoded->variant.device_metrics.channel_utilization);
+                    msgPayload["air_util_tx"] = new JSONValue(decoded->variant.device_metrics.air_util_tx);
+                    msgPayload["uptime_seconds"] = new JSONValue((unsigned int)decoded->variant.device_metrics.uptime_seconds);
+                } else if (decoded->which_variant == meshtastic_Telemetry_environment_metrics_tag) {
+                    msgPayload["temperature"] = new JSONValue(decoded->variant.environment_metrics.temperature);
+                    msgPayload["relative_humidity"] = new JSONValue(decoded->variant.environment_metrics.relative_humidity);
+                    msgPayload["barometric_pressure"] = new JSONValue(decoded->variant.environment_metrics.barometric_pressure);
+                    msgPayload["gas_resistance"] = new JSONValue(decoded->variant.environment_metrics.gas_resistance);
+                    msgPayload["voltage"] = new JSONValue(decoded->variant.environment_metrics.voltage);
+                    msgPayload["current"] = new JSONValue(decoded->variant.environment_metrics.current);
+                    msgPayload["lux"] = new JSONValue(decoded->variant.environment_metrics.lux);
+                    msgPayload["white_lux"] = new JSONValue(decoded->variant.environment_metrics.white_lux);
+                    msgPayload["iaq"] = new JSONValue((uint)decoded->variant.environment_metrics.iaq);
+                    msgPayload["wind_speed"] = new JSONValue(decoded->variant.environment_metrics.wind_speed);
+                    msgPayload["wind_direction"] = new JSONValue((uint)decoded->variant.environment_metrics.wind_direction);
+                    msgPayload["wind_gust"] = new JSONValue(decoded->variant.environment_metrics.wind_gust);
+                    msgPayload["wind_lull"] = new JSONValue(decoded->variant.environment_metrics.wind_lull);
+                    msgPayload["radiation"] = new JSONValue(decoded->variant.environment_metrics.radiation);
+                } else if (decoded->which_variant == meshtastic_Telemetry_air_quality_metrics_tag) {
+                    msgPayload["pm10"] = new JSONValue((unsigned int)decoded->variant.air_quality_metrics.pm10_standard);
+                    msgPayload["pm25"] = new JSONValue((unsigned int)decoded->variant.air_quality_metrics.pm25_standard);
+                    msgPayload["pm100"] = new JSONValue((unsigned int)decoded->variant.air_quality_metrics.pm100_standard);
+                    msgPayload["pm10_e"] = new JSONValue((unsigned int)decoded->variant.air_quality_metrics.pm10_environmental);
+                    msgPayload["pm25_e"] = new JSONValue((unsigned int)decoded->variant.air_quality_metrics.pm25_environmental);
+                    msgPayload["pm100_e"] = new JSONValue((unsigned int)decoded->variant.air_quality_metrics.pm100_environmental);
+                } else if (decoded->which_variant == meshtastic_Telemetry_power_metrics_tag) {
+                    msgPayload["voltage_ch1"] = new JSONValue(decoded->variant.power_metrics.ch1_voltage);
+                    msgPayload["current_ch1"] = new JSONValue(decoded->variant.power_metrics.ch1_current);
+                    msgPayload["voltage_ch2"] = new JSONValue(decoded->variant.power_metrics.ch2_voltage);
+                    msgPayload["current_ch2"] = new JSONValue(decoded->variant.power_metrics.ch2_current);
+                    msgPayload["voltage_ch3"] = new JSONValue(decoded->variant.power_metrics.ch3_voltage);
+                    msgPayload["current_ch3"] = new JSONValue(decoded->variant.power_metrics.ch3_current);
+                }
+                jsonObj["payload"] = new JSONValue(msgPayload);
+            } else if (shouldLog) {
+                LOG_ERROR(errStr, msgType.c_str());
+            }
+            break;
+        }
+        case meshtastic_PortNum_NODEINFO_APP: {
+            msgType = "nodeinfo";
+            meshtastic_User scratch;
+            meshtastic_User *decoded = NULL;
+            memset(&scratch, 0, sizeof(scratch));
+            if (pb_decode_from_bytes(mp->decoded.payload.bytes, mp->decoded.payload.size, &meshtastic_User_msg, &scratch)) {
+                decoded = &scratch;
+                msgPayload["id"] = new JSONValue(decoded->id);
+                msgPayload["longname"] = new JSONValue(decoded->long_name);
+                msgPayload["shortname"] = new JSONValue(decoded->short_name);
+                msgPayload["hardware"] = new JSONValue(decoded->hw_model);
+                msgPayload["role"] = new JSONValue((int)decoded->role);
+                jsonObj["payload"] = new JSONValue(msgPayload);
+            } else if (shouldLog) {
+                LOG_ERROR(errStr, msgType.c_str());
+            }
+            break;
+        }
+        case meshtastic_PortNum_POSITION_APP: {
+            msgType = "position";
+            meshtastic_Position scratch;
+            meshtastic_Position *decoded = NULL;
+            memset(&scratch, 0, sizeof(scratch));
+            if (pb_decode_from_bytes(mp->decoded.payload.bytes, mp->decoded.payload.size, &meshtastic_Position_msg, &scratch)) {
+                decoded = &scratch;
+                if ((int)decoded->time) {
+                    msgPayload["time"] = new JSONValue((unsigned int)decoded->time);
+                }
+                if ((int)decoded->timestamp) {
+                    msgPayload["timestamp"] = new JSONValue((unsigned int)decoded->timestamp);
+                }
+                msgPayload["latitude_i"] = new JSONValue((int)decoded->latitude_i);
+                msgPayload["longitude_i"] = new JSONValue((int)decoded->longitude_i);
+                if ((int)decoded->altitude) {
+                    msgPayload["altitude"] = new JSONValue((int)decoded->altitude);
+                }
+                if ((int)decoded->ground_speed) {
+                    msgPayload["ground_speed"] = new JSONValue((unsigned int)decoded->ground_speed);
+                }
+                if (int(decoded->ground_track)) {
+                    msgPayload["ground_track"] = new JSONValue((unsigned int)decoded->ground_track);
+                }
+                if (int(decoded->sats_in_view)) {
+                    msgPayload["sats_in_view"] = new JSONValue((unsigned int)decoded->sats_in_view);
+                }
+                if ((int)decoded->PDOP) {
+                    msgPayload["PDOP"] = new JSONValue((int)decoded->PDOP);
+                }
+                if ((int)decoded->HDOP) {
+                    msgPayload["HDOP"] = new JSONValue((int)decoded->HDOP);
+                }
+                if ((int)decoded->VDOP) {
+                    msgPayload["VDOP"] = new JSONValue((int)decoded->VDOP);
+                }
+                if ((int)decoded->precision_bits) {
+                    msgPayload["precision_bits"] = new JSONValue((int)decoded->precision_bits);
+                }
+                jsonObj["payload"] = new JSONValue(msgPayload);
+            } else if (shouldLog) {
+                LOG_ERROR(errStr, msgType.c_str());
+            }
+            break;
+        }
+        case meshtastic_PortNum_WAYPOINT_APP: {
+            msgType = "waypoint";
+            meshtastic_Waypoint scratch;
+            meshtastic_Waypoint *decoded = NULL;
+            memset(&scratch, 0, sizeof(scratch));
+            if (pb_decode_from_bytes(mp->decoded.payload.bytes, mp->decoded.payload.size, &meshtastic_Waypoint_msg, &scratch)) {
+                decoded = &scratch;
+                msgPayload["id"] = new JSONValue((unsigned int)decoded->id);
+                msgPayload["name"] = new JSONValue(decoded->name);
+                msgPayload["description"] = new JSONValue(decoded->description);
+                msgPayload["expire"] = new JSONValue((unsigned int)decoded->expire);
+                msgPayload["locked_to"] = new JSONValue((unsigned int)decoded->locked_to);
+                msgPayload["latitude_i"] = new JSONValue((int)decoded->latitude_i);
+                msgPayload["longitude_i"] = new JSONValue((int)decoded->longitude_i);
+                jsonObj["payload"] = new JSONValue(msgPayload);
+            } else if (shouldLog) {
+                LOG_ERROR(errStr, msgType.c_str());
+            }
+            break;
+        }
+        case meshtastic_PortNum_NEIGHBORINFO_APP: {
+            msgType = "neighborinfo";
+            meshtastic_NeighborInfo scratch;
+            meshtastic_NeighborInfo *decoded = NULL;
+            memset(&scratch, 0, sizeof(scratch));
+            if (pb_decode_from_bytes(mp->decoded.payload.bytes, mp->decoded.payload.size, &meshtastic_NeighborInfo_msg,
+                                     &scratch)) {
+                decoded = &scratch;
+                msgPayload["node_id"] = new JSONValue((unsigned int)decoded->node_id);
+                msgPayload["node_broadcast_interval_secs"] = new JSONValue((unsigned int)decoded->node_broadcast_interval_secs);
+                msgPayload["last_sent_by_id"] = new JSONValue((unsigned int)decoded->last_sent_by_id);
+                msgPayload["neighbors_count"] = new JSONValue(decoded->neighbors_count);
+                JSONArray neighbors;
+                for (uint8_t i = 0; i < decoded->neighbors_count; i++) {
+                    JSONObject neighborObj;
+                    neighborObj["node_id"] = new JSONValue((unsigned int)decoded->neighbors[i].node_id);
+                    neighborObj["snr"] = new JSONValue((int)decoded->neighbors[i].snr);
+                    neighbors.push_back(new JSONValue(neighborObj));
+                }
+                msgPayload["neighbors"] = new JSONValue(neighbors);
+                jsonObj["payload"] = new JSONValue(msgPayload);
+            } else if (shouldLog) {
+                LOG_ERROR(errStr, msgType.c_str());
+            }
+            break;
+        }
+        case meshtastic_PortNum_TRACEROUTE_APP: {
+            if (mp->decoded.request_id) { // Only report the traceroute response
+                msgType = "traceroute";
+                meshtastic_RouteDiscovery scratch;
+                meshtastic_RouteDiscovery *decoded = NULL;
+                memset(&scratch, 0, sizeof(scratch));
+                if (pb_decode_from_bytes(mp->decoded.payload.bytes, mp->decoded.payload.size, &meshtastic_RouteDiscovery_msg,
+                                         &scratch)) {
+                    decoded = &scratch;
+                    JSONArray route;      // Route this message took
+                    JSONArray routeBack;  // Route this message took back
+                    JSONArray snrTowards; // Snr for forward route
+                    JSONArray snrBack;    // Snr for reverse route
+
+                    // Lambda function for adding a long name to the route
+                    auto addToRoute = [](JSONArray *route, NodeNum num) {
+                        char long_name[40] = "Unknown";
+                        meshtastic_NodeInfoLite *node = nodeDB->getMeshNode(num);
+                        bool name_known = node ? node->has_user : false;
+                        if (name_known)
+                            memcpy(long_name, node->user.long_name, sizeof(long_name));
+                        route->push_back(new JSONValue(long_name));
+                    };
+                    addToRoute(&route, mp->to); // Started at the original transmitter (destination of response)
+                    for (uint8_t i = 0; i < decoded->route_count; i++) {
+                        addToRoute(&route, decoded->route[i]);
+                    }
+                    addToRoute(&route, mp->from); // Ended at the original destination (source of response)
+
+                    addToRoute(&routeBack, mp->from); // Started at the original destination (source of response)
+                    for (uint8_t i = 0; i < decoded->route_back_count; i++) {
+                        addToRoute(&routeBack, decoded->route_back[i]);
+                    }
+                    addToRoute(&routeBack, mp->to); // Ended at the original transmitter (destination of response)
+
+                    for (uint8_t i = 0; i < decoded->snr_back_count; i++) {
+                        snrBack.push_back(new JSONValue((float)decoded->snr_back[i] / 4));
+                    }
+
+                    for (uint8_t i = 0; i < decoded->snr_towards_count; i++) {
+                        snrTowards.push_back(new JSONValue((float)decoded->snr_towards[i] / 4));
+                    }
+
+                    msgPayload["route"] = new JSONValue(route);
+                    msgPayload["route_back"] = new JSONValue(routeBack);
+                    msgPayload["snr_back"] = new JSONValue(snrBack);
+                    msgPayload["snr_towards"] = new JSONValue(snrTowards);
+                    jsonObj["payload"] = new JSONValue(msgPayload);
+                } else if (shouldLog) {
+                    LOG_ERROR(errStr, msgType.c_str());
+                }
+            }
+            break;
+        }
+        case meshtastic_PortNum_DETECTION_SENSOR_APP: {
+            msgType = "detection";
+            char payloadStr[(mp->decoded.payload.size) + 1];
+            memcpy(payloadStr, mp->decoded.payload.bytes, mp->decoded.payload.size);
+            payloadStr[mp->decoded.payload.size] = 0; // null terminated string
+            msgPayload["text"] = new JSONValue(payloadStr);
+            jsonObj["payload"] = new JSONValue(msgPayload);
+            break;
+        }
+#ifdef ARCH_ESP32
+        case meshtastic_PortNum_PAXCOUNTER_APP: {
+            msgType = "paxcounter";
+            meshtastic_Paxcount scratch;
+            meshtastic_Paxcount *decoded = NULL;
+            memset(&scratch, 0, sizeof(scratch));
+            if (pb_decode_from_bytes(mp->decoded.payload.bytes, mp->decoded.payload.size, &meshtastic_Paxcount_msg, &scratch)) {
+                decoded = &scratch;
+                msgPayload["wifi_count"] = new JSONValue((unsigned int)decoded->wifi);
+                msgPayload["ble_count"] = new JSONValue((unsigned int)decoded->ble);
+                msgPayload["uptime"] = new JSONValue((unsigned int)decoded->uptime);
+                jsonObj["payload"] = new JSONValue(msgPayload);
+            } else if (shouldLog) {
+                LOG_ERROR(errStr, msgType.c_str());
+            }
+            break;
+        }
+#endif
+        case meshtastic_PortNum_REMOTE_HARDWARE_APP: {
+            meshtastic_HardwareMessage scratch;
+            meshtastic_HardwareMessage *decoded = NULL;
+            memset(&scratch, 0, sizeof(scratch));
+            if (pb_decode_from_bytes(mp->decoded.payload.bytes, mp->decoded.payload.size, &meshtastic_HardwareMessage_msg,
+                                     &scratch)) {
+                decoded = &scratch;
+                if (decoded->type == meshtastic_HardwareMessage_Type_GPIOS_CHANGED) {
+                    msgType = "gpios_changed";
+                    msgPayload["gpio_value"] = new JSONValue((unsigned int)decoded->gpio_value);
+                    jsonObj["payload"] = new JSONValue(msgPayload);
+                } else if (decoded->type == meshtastic_HardwareMessage_Type_READ_GPIOS_REPLY) {
+                    msgType = "gpios_read_reply";
+                    msgPayload["gpio_value"] = new JSONValue((unsigned int)decoded->gpio_value);
+                    msgPayload["gpio_mask"] = new JSONValue((unsigned int)decoded->gpio_mask);
+                    jsonObj["payload"] = new JSONValue(msgPayload);
+                }
+            } else if (shouldLog) {
+                LOG_ERROR(errStr, "RemoteHardware");
+            }
+            break;
+        }
+        // add more packet types here if needed
+        default:
+            break;
+        }
+    } else if (shouldLog) {
+        LOG_WARN("Couldn't convert encrypted payload of MeshPacket to JSON");
+    }
+
+    jsonObj["id"] = new JSONValue((unsigned int)mp->id);
+    jsonObj["timestamp"] = new JSONValue((unsigned int)mp->rx_time);
+    jsonObj["to"] = new JSONValue((unsigned int)mp->to);
+    jsonObj["from"] = new JSONValue((unsigned int)mp->from);
+    jsonObj["channel"] = new JSONValue((unsigned int)mp->channel);
+    jsonObj["type"] = new JSONValue(msgType.c_str());
+    jsonObj["sender"] = new JSONValue(owner.id);
+    if (mp->rx_rssi != 0)
+        jsonObj["rssi"] = new JSONValue((int)mp->rx_rssi);
+    if (mp->rx_snr != 0)
+        jsonObj["snr"] = new JSONValue((float)mp->rx_snr);
+    if (mp->hop_start != 0 && mp->hop_limit <= mp->hop_start) {
+        jsonObj["hops_away"] = new JSONValue((unsigned int)(mp->hop_start - mp->hop_limit));
+        jsonObj["hop_start"] = new JSONValue((unsigned int)(mp->hop_start));
+    }
+
+    // serialize and write it to the stream
+    JSONValue *value = new JSONValue(jsonObj);
+    std::string jsonStr = value->Stringify();
+
+    if (shouldLog)
+        LOG_INFO("serialized json message: %s", jsonStr.c_str());
+
+    delete value;
+    return jsonStr;
+}
+
+std::string referenceJsonSerializeEncrypted(const meshtastic_MeshPacket *mp)
+{
+    JSONObject jsonObj;
+
+    jsonObj["id"] = new JSONValue((unsigned int)mp->id);
+    jsonObj["time_ms"] = new JSONValue((double)millis());
+    jsonObj["timestamp"] = new JSONValue((unsigned int)mp->rx_time);
+    jsonObj["to"] = new JSONValue((unsigned int)mp->to);
+    jsonObj["from"] = new JSONValue((unsigned int)mp->from);
+    jsonObj["channel"] = new JSONValue((unsigned int)mp->channel);
+    jsonObj["want_ack"] = new JSONValue(mp->want_ack);
+
+    if (mp->rx_rssi != 0)
+        jsonObj["rssi"] = new JSONValue((int)mp->rx_rssi);
+    if (mp->rx_snr != 0)
+        jsonObj["snr"] = new JSONValue((float)mp->rx_snr);
+    if (mp->hop_start != 0 && mp->hop_limit <= mp->hop_start) {
+        jsonObj["hops_away"] = new JSONValue((unsigned int)(mp->hop_start - mp->hop_limit));
+        jsonObj["hop_start"] = new JSONValue((unsigned int)(mp->hop_start));
+    }
+    jsonObj["size"] = new JSONValue((unsigned int)mp->encrypted.size);
+    auto encryptedStr = referenceBytesToHex(mp->encrypted.bytes, mp->encrypted.size);
+    jsonObj["bytes"] = new JSONValue(encryptedStr.c_str());
+
+    // serialize and write it to the stream
+    JSONValue *value = new JSONValue(jsonObj);
+    std::string jsonStr = value->Stringify();
+
+    delete value;
+    return jsonStr;
+}
+
+/// A decoded packet carrying msg, encoded with fields, on portnum
+template <class T>
+meshtastic_MeshPacket makePacket(meshtastic_PortNum portnum, const pb_msgdesc_t *fields, const T &msg, uint32_t requestId = 0)
+{
+    meshtastic_MeshPacket mp = meshtastic_MeshPacket_init_zero;
+    mp.from = 0x11223344;
+    mp.to = 0xffffffff;
+    mp.id = 0x55667788;
+    mp.channel = 2;
+    mp.rx_time = 1700000000;
+    mp.which_payload_variant = meshtastic_MeshPacket_decoded_tag;
+    mp.decoded.portnum = portnum;
+    mp.decoded.request_id = requestId;
+    mp.decoded.payload.size =
+        pb_encode_to_bytes(mp.decoded.payload.bytes, sizeof(mp.decoded.payload.bytes), fields, &msg);
+    return mp;
+}
+
+meshtastic_MeshPacket makeTextPacket(const std::string &text, meshtastic_PortNum portnum = meshtastic_PortNum_TEXT_MESSAGE_APP)
+{
+    meshtastic_MeshPacket mp = meshtastic_MeshPacket_init_zero;
+    mp.from = 0x11223344;
+    mp.to = 0x01020304;
+    mp.id = 42;
+    mp.rx_time = 1700000000;
+    mp.which_payload_variant = meshtastic_MeshPacket_decoded_tag;
+    mp.decoded.portnum = portnum;
+    mp.decoded.payload.size = std::min(text.size(), sizeof(mp.decoded.payload.bytes));
+    memcpy(mp.decoded.payload.bytes, text.data(), mp.decoded.payload.size);
+    return mp;
+}
+
+void assertSameJson(const meshtastic_MeshPacket &mp)
+{
+    std::string expected = referenceJsonSerialize(&mp);
+    std::string actual = MeshPacketSerializer::JsonSerialize(&mp, false);
+    TEST_ASSERT_EQUAL_STRING(expected.c_str(), actual.c_str());
+    TEST_ASSERT_EQUAL(expected.size(), actual.size());
+
+    // The buffer API says how much room it needed and gives the same bytes
+    std::vector<char> buf(expected.size() + 1);
+    TEST_ASSERT_EQUAL(expected.size(), MeshPacketSerializer::JsonSerialize(&mp, buf.data(), buf.size(), false));
+    TEST_ASSERT_EQUAL_STRING(expected.c_str(), buf.data());
+}
+
+/// Drop the "time_ms" member, it is millis() at the time of serializing
+std::string withoutTimeMs(std::string json)
+{
+    size_t start = json.find("\"time_ms\":");
+    if (start != std::string::npos)
+        json.erase(start, json.find(',', start) - start + 1);
+    return json;
+}
+
+void test_textMatchesDom()
+{
+    const char *texts[] = {
+        "hello mesh",
+        "",
+        "   ",
+        "quotes \" backslash \\ slash / tab \t newline \n cr \r",
+        "bell \x07 escape \x1b delete \x7f",
+        "caf\xc3\xa9 \xe2\x9c\x93 \xf0\x9f\x93\xa1",
+        "{\"b\": 1, \"a\": [true, false, null, -1.5e3, \"x\"]}",
+        "  [1, 2.25, {\"nested\": {\"z\": 0, \"y\": \"\\u0041\"}}]  ",
+        "42",
+        "-0.001",
+        "TRUE",
+        "nope, not json",
+        "{\"unterminated\": ",
+        "7 dwarves",
+        "\"a json string\"",
+    };
+    for (const char *text : texts)
+        assertSameJson(makeTextPacket(text));
+
+    // The text stops at the first NUL, like the C string the old code made
+    assertSameJson(makeTextPacket(std::string("before\0after", 12)));
+    assertSameJson(makeTextPacket("detected motion", meshtastic_PortNum_DETECTION_SENSOR_APP));
+}
+
+void test_randomTextMatchesDom()
+{
+    std::mt19937 rng(7);
+    const char alphabet[] = "{}[]\":,.-+eE0123456789 tfnrue\\/\t\n\x01\x7f\xc3\xa9\xe2\x82\xacabcXYZ";
+    for (int i = 0; i < 2000; i++) {
+        std::string text;
+        size_t len = rng() % 64;
+        for (size_t j = 0; j < len; j++)
+            text += alphabet[rng() % (sizeof(alphabet) - 1)];
+        assertSameJson(makeTextPacket(text));
+    }
+}
+
+void test_telemetryMatchesDom()
+{
+    meshtastic_Telemetry t = meshtastic_Telemetry_init_zero;
+    t.time = 1700000000;
+
+    t.which_variant = meshtastic_Telemetry_device_metrics_tag;
+    t.variant.device_metrics = {true, 87, true, 3.97f, true, 12.345f, true, 1.5f, true, 86400};
+    assertSameJson(makePacket(meshtastic_PortNum_TELEMETRY_APP, &meshtastic_Telemetry_msg, t));
+
+    t.which_variant = meshtastic_Telemetry_environment_metrics_tag;
+    t.variant.environment_metrics = meshtastic_EnvironmentMetrics_init_zero;
+    t.variant.environment_metrics.has_temperature = true;
+    t.variant.environment_metrics.temperature = -12.3f;
+    t.variant.environment_metrics.has_relative_humidity = true;
+    t.variant.environment_metrics.relative_humidity = 45.6f;
+    t.variant.environment_metrics.has_iaq = true;
+    t.variant.environment_metrics.iaq = 77;
+    t.variant.environment_metrics.has_wind_direction = true;
+    t.variant.environment_metrics.wind_direction = 270;
+    t.variant.environment_metrics.has_lux = true;
+    t.variant.environment_metrics.lux = 1e-7f;
+    assertSameJson(makePacket(meshtastic_PortNum_TELEMETRY_APP, &meshtastic_Telemetry_msg, t));
+
+    t.which_variant = meshtastic_Telemetry_air_quality_metrics_tag;
+    t.variant.air_quality_metrics = meshtastic_AirQualityMetrics_init_zero;
+    t.variant.air_quality_metrics.has_pm10_standard = true;
+    t.variant.air_quality_metrics.pm10_standard = 10;
+    t.variant.air_quality_metrics.has_pm100_environmental = true;
+    t.variant.air_quality_metrics.pm100_environmental = 100;
+    assertSameJson(makePacket(meshtastic_PortNum_TELEMETRY_APP, &meshtastic_Telemetry_msg, t));
+
+    t.which_variant = meshtastic_Telemetry_power_metrics_tag;
+    t.variant.power_metrics = meshtastic_PowerMetrics_init_zero;
+    t.variant.power_metrics.has_ch2_voltage = true;
+    t.variant.power_metrics.ch2_voltage = 5.1f;
+    t.variant.power_metrics.has_ch3_current = true;
+    t.variant.power_metrics.ch3_current = 250.0f;
+    assertSameJson(makePacket(meshtastic_PortNum_TELEMETRY_APP, &meshtastic_Telemetry_msg, t));
+
+    // A variant the serializer doesn't know gives an empty payload object
+    t.which_variant = meshtastic_Telemetry_local_stats_tag;
+    t.variant.local_stats = meshtastic_LocalStats_init_zero;
+    assertSameJson(makePacket(meshtastic_PortNum_TELEMETRY_APP, &meshtastic_Telemetry_msg, t));
+}
+
+void test_otherPortsMatchDom()
+{
+    meshtastic_User user = meshtastic_User_init_zero;
+    strcpy(user.id, "!11223344");
+    strcpy(user.long_name, "Long \"Name\"");
+    strcpy(user.short_name, "LN");
+    user.hw_model = meshtastic_HardwareModel_HELTEC_V3;
+    user.role = meshtastic_Config_DeviceConfig_Role_ROUTER;
+    assertSameJson(makePacket(meshtastic_PortNum_NODEINFO_APP, &meshtastic_User_msg, user));
+
+    meshtastic_Position pos = meshtastic_Position_init_zero;
+    pos.has_latitude_i = pos.has_longitude_i = true;
+    pos.latitude_i = 523456789;
+    pos.longitude_i = -1234567;
+    assertSameJson(makePacket(meshtastic_PortNum_POSITION_APP, &meshtastic_Position_msg, pos));
+    pos.time = 1700000000;
+    pos.timestamp = 1700000001;
+    pos.has_altitude = true;
+    pos.altitude = -20;
+    pos.has_ground_speed = pos.has_ground_track = true;
+    pos.ground_speed = 12;
+    pos.ground_track = 350;
+    pos.sats_in_view = 9;
+    pos.PDOP = 110;
+    pos.HDOP = 90;
+    pos.VDOP = 70;
+    pos.precision_bits = 32;
+    assertSameJson(makePacket(meshtastic_PortNum_POSITION_APP, &meshtastic_Position_msg, pos));
+
+    meshtastic_Waypoint wp = meshtastic_Waypoint_init_zero;
+    wp.id = 99;
+    strcpy(wp.name, "Camp");
+    strcpy(wp.description, "by the lake\n2nd tent");
+    wp.expire = 1800000000;
+    wp.locked_to = 0x11223344;
+    wp.has_latitude_i = wp.has_longitude_i = true;
+    wp.latitude_i = 1;
+    wp.longitude_i = -1;
+    assertSameJson(makePacket(meshtastic_PortNum_WAYPOINT_APP, &meshtastic_Waypoint_msg, wp));
+
+    meshtastic_NeighborInfo ni = meshtastic_NeighborInfo_init_zero;
+    ni.node_id = 0x11223344;
+    ni.last_sent_by_id = 0x55667788;
+    ni.node_broadcast_interval_secs = 900;
+    assertSameJson(makePacket(meshtastic_PortNum_NEIGHBORINFO_APP, &meshtastic_NeighborInfo_msg, ni));
+    ni.neighbors_count = 3;
+    for (int i = 0; i < 3; i++) {
+        ni.neighbors[i].node_id = 100 + i;
+        ni.neighbors[i].snr = -7.75f + 5 * i;
+    }
+    assertSameJson(makePacket(meshtastic_PortNum_NEIGHBORINFO_APP, &meshtastic_NeighborInfo_msg, ni));
+
+    meshtastic_RouteDiscovery rd = meshtastic_RouteDiscovery_init_zero;
+    rd.route_count = 3;
+    rd.route[0] = 1;
+    rd.route[1] = 2;
+    rd.route[2] = 3;
+    rd.snr_towards_count = 4;
+    rd.snr_towards[0] = -40;
+    rd.snr_towards[1] = 13;
+    rd.snr_towards[2] = 0;
+    rd.snr_towards[3] = 127;
+    rd.route_back_count = 1;
+    rd.route_back[0] = 5;
+    rd.snr_back_count = 2;
+    rd.snr_back[0] = -3;
+    rd.snr_back[1] = 1;
+    assertSameJson(makePacket(meshtastic_PortNum_TRACEROUTE_APP, &meshtastic_RouteDiscovery_msg, rd, 1234));
+    // Requests are not reported
+    assertSameJson(makePacket(meshtastic_PortNum_TRACEROUTE_APP, &meshtastic_RouteDiscovery_msg, rd));
+
+    meshtastic_HardwareMessage hw = meshtastic_HardwareMessage_init_zero;
+    hw.gpio_value = 0xF0;
+    hw.gpio_mask = 0xFF;
+    hw.type = meshtastic_HardwareMessage_Type_GPIOS_CHANGED;
+    assertSameJson(makePacket(meshtastic_PortNum_REMOTE_HARDWARE_APP, &meshtastic_HardwareMessage_msg, hw));
+    hw.type = meshtastic_HardwareMessage_Type_READ_GPIOS_REPLY;
+    assertSameJson(makePacket(meshtastic_PortNum_REMOTE_HARDWARE_APP, &meshtastic_HardwareMessage_msg, hw));
+    hw.type = meshtastic_HardwareMessage_Type_WRITE_GPIOS;
+    assertSameJson(makePacket(meshtastic_PortNum_REMOTE_HARDWARE_APP, &meshtastic_HardwareMessage_msg, hw));
+
+#ifdef ARCH_ESP32
+    meshtastic_Paxcount pax = {12, 34, 5678};
+    assertSameJson(makePacket(meshtastic_PortNum_PAXCOUNTER_APP, &meshtastic_Paxcount_msg, pax));
+#endif
+
+    // Ports without an encoder, and payloads that don't decode
+    assertSameJson(makeTextPacket("whatever", meshtastic_PortNum_PRIVATE_APP));
+    assertSameJson(makeTextPacket("\xff\xff\xff not a protobuf", meshtastic_PortNum_POSITION_APP));
+    assertSameJson(makeTextPacket("\xff\xff\xff not a protobuf", meshtastic_PortNum_TELEMETRY_APP));
+}
+
+void test_headerMatchesDom()
+{
+    meshtastic_MeshPacket mp = makeTextPacket("hi");
+    assertSameJson(mp);
+    mp.rx_rssi = -110;
+    mp.rx_snr = -12.25f;
+    assertSameJson(mp);
+    mp.hop_start = 7;
+    mp.hop_limit = 3;
+    assertSameJson(mp);
+    mp.hop_limit = 8; // bogus, not reported
+    assertSameJson(mp);
+
+    // Still encrypted
+    mp.which_payload_variant = meshtastic_MeshPacket_encrypted_tag;
+    mp.encrypted.size = 5;
+    memcpy(mp.encrypted.bytes, "\x00\x7f\x80\xab\xff", 5);
+    assertSameJson(mp);
+}
+
+void test_encryptedMatchesDom()
+{
+    meshtastic_MeshPacket mp = makeTextPacket("");
+    mp.which_payload_variant = meshtastic_MeshPacket_encrypted_tag;
+    mp.encrypted.size = 16;
+    for (int i = 0; i < 16; i++)
+        mp.encrypted.bytes[i] = i * 17;
+    mp.want_ack = true;
+    mp.rx_snr = 6.5f;
+    mp.hop_start = 3;
+    mp.hop_limit = 3;
+
+    std::string expected = withoutTimeMs(referenceJsonSerializeEncrypted(&mp));
+    std::string actual = withoutTimeMs(MeshPacketSerializer::JsonSerializeEncrypted(&mp));
+    TEST_ASSERT_EQUAL_STRING(expected.c_str(), actual.c_str());
+}
+
+void test_smallBufferReportsLength()
+{
+    meshtastic_MeshPacket mp = makeTextPacket(std::string(200, '"')); // every quote doubles when escaped
+    std::string expected = referenceJsonSerialize(&mp);
+    TEST_ASSERT_GREATER_THAN(MESH_PACKET_JSON_BUF_SIZE, expected.size());
+
+    char small[16];
+    TEST_ASSERT_EQUAL(expected.size(), MeshPacketSerializer::JsonSerialize(&mp, small, sizeof(small), false));
+    TEST_ASSERT_EQUAL(sizeof(small) - 1, strlen(small));
+    TEST_ASSERT_EQUAL(0, strncmp(expected.c_str(), small, sizeof(small) - 1));
+
+    // The std::string version takes the second pass
+    TEST_ASSERT_EQUAL_STRING(expected.c_str(), MeshPacketSerializer::JsonSerialize(&mp, false).c_str());
+}
+
+/// Packets per second and allocations per packet for both serializers, on a mix of common packets
+void test_benchmark()
+{
+    std::vector<meshtastic_MeshPacket> packets;
+    packets.push_back(makeTextPacket("Anyone on the mountain tonight?"));
+    meshtastic_Position pos = meshtastic_Position_init_zero;
+    pos.has_latitude_i = pos.has_longitude_i = pos.has_altitude = true;
+    pos.latitude_i = 523456789;
+    pos.longitude_i = 41234567;
+    pos.altitude = 120;
+    pos.time = 1700000000;
+    pos.sats_in_view = 9;
+    packets.push_back(makePacket(meshtastic_PortNum_POSITION_APP, &meshtastic_Position_msg, pos));
+    meshtastic_Telemetry t = meshtastic_Telemetry_init_zero;
+    t.which_variant = meshtastic_Telemetry_device_metrics_tag;
+    t.variant.device_metrics = {true, 87, true, 3.97f, true, 12.345f, true, 1.5f, true, 86400};
+    packets.push_back(makePacket(meshtastic_PortNum_TELEMETRY_APP, &meshtastic_Telemetry_msg, t));
+    meshtastic_User user = meshtastic_User_init_zero;
+    strcpy(user.id, "!11223344");
+    strcpy(user.long_name, "Benchmark node");
+    strcpy(user.short_name, "BN");
+    packets.push_back(makePacket(meshtastic_PortNum_NODEINFO_APP, &meshtastic_User_msg, user));
+
+    const int rounds = 5000;
+    char buf[MESH_PACKET_JSON_BUF_SIZE];
+    size_t checksum = 0;
+
+    size_t allocsBefore = allocations;
+    uint32_t start = millis();
+    for (int i = 0; i < rounds; i++)
+        for (const auto &mp : packets)
+            checksum += referenceJsonSerialize(&mp).size();
+    uint32_t domMsec = millis() - start;
+    size_t domAllocs = allocations - allocsBefore;
+
+    allocsBefore = allocations;
+    start = millis();
+    for (int i = 0; i < rounds; i++)
+        for (const auto &mp : packets)
+            checksum -= MeshPacketSerializer::JsonSerialize(&mp, buf, sizeof(buf), false);
+    uint32_t streamMsec = millis() - start;
+    size_t streamAllocs = allocations - allocsBefore;
+
+    const size_t n = rounds * packets.size();
+    LOG_INFO("JSON serializer benchmark, %u packets: DOM %u ms, %.1f allocs/packet; streaming %u ms, %.1f allocs/packet",
+             (unsigned)n, domMsec, (double)domAllocs / n, streamMsec, (double)streamAllocs / n);
+
+    TEST_ASSERT_EQUAL(0, checksum);     // same lengths
+    TEST_ASSERT_EQUAL(0, streamAllocs); // nothing here needs the JSON text parser
+}
+} // namespace
+
+void setup()
+{
+    initializeTestEnvironment();
+    MockNodeDB *mockNodeDB = new MockNodeDB();
+    nodeDB = mockNodeDB;
+    owner = meshtastic_User_init_zero;
+    strcpy(owner.id, "!aabbccdd");
+
+    UNITY_BEGIN();
+    RUN_TEST(test_textMatchesDom);
+    RUN_TEST(test_randomTextMatchesDom);
+    RUN_TEST(test_telemetryMatchesDom);
+    RUN_TEST(test_otherPortsMatchDom);
+    RUN_TEST(test_headerMatchesDom);
+    RUN_TEST(test_encryptedMatchesDom);
+    RUN_TEST(test_smallBufferReportsLength);
+    RUN_TEST(test_benchmark);
+    exit(UNITY_END());
+}
+
+void loop() {}
@@ -0,0 +1,502 @@
+#include "DebugConfiguration.h"
+#include "TestUtil.h"
+#include <unity.h>
+
+#ifdef ARCH_PORTDUINO
+#include "mesh/MeshPacketQueue.h"
+#include "mesh/MeshRadio.h"
+#include "mesh/NextHopRouter.h"
+#include "mesh/NodeDB.h"
+#include "mesh/PacketHistory.h"
+#include "mesh/RadioInterface.h"
+#include "platform/portduino/PortduinoGlue.h"
+
+#include <chrono>
+#include <math.h>
+#include <memory>
+#include <queue>
+#include <random>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+/**
+ * Deterministic many-node flooding simulation.
+ *
+ * Every simulated node gets its own PacketHistory and MeshPacketQueue - the real ones - and makes its relay decisions with
+ * the same functions NextHopRouter (which the firmware's ReliableRouter builds on) uses: NextHopRouter::dupeAction() and
+ * FloodingRouter::cancelsDupes() for packets heard before, NextHopRouter::copyForRelay() for whether and what to relay.  A
+ * relay goes out after an SNR weighted contention delay.  Nodes sit at random positions; link SNR follows a log-distance path
+ * loss, airtime comes from RadioInterface::getPacketTime, overlapping receptions collide and radios are half duplex.  The
+ * firmware code reads the node number and role from globals, so those are switched to the current node before each call.
+ *
+ * The defaults keep this quick enough for CI.  For bigger runs set MESH_SIM_NODES, MESH_SIM_PACKETS, MESH_SIM_SEED,
+ * MESH_SIM_AREA_KM, MESH_SIM_LOSS, MESH_SIM_ROUTERS (percent), MESH_SIM_HOP_LIMIT and MESH_SIM_PAYLOAD.  Each run prints one
+ * "MESH_SIM_RESULT {json}" line.
+ */
+namespace
+{
+class MockNodeDB : public NodeDB
+{
+  public:
+    meshtastic_NodeInfoLite *getMeshNode(NodeNum n) override { return &emptyNode; }
+    meshtastic_NodeInfoLite emptyNode = {};
+};
+
+/// Just enough radio to borrow the firmware's airtime and contention window maths
+class ChannelModelRadio : public RadioInterface
+{
+  public:
+    virtual ErrorCode send(meshtastic_MeshPacket *p) override
+    {
+        packetPool.release(p);
+        return ERRNO_OK;
+    }
+};
+
+struct SimConfig {
+    uint32_t nodes = 60;
+    uint32_t packets = 10;
+    uint32_t seed = 1;
+    float areaKm = 6;
+    float loss = 0.05;   // independent per-link frame loss
+    uint32_t routers = 5; // percent of nodes with the ROUTER role
+    uint32_t hopLimit = 3;
+    uint32_t payload = 40;
+
+    // Link budget: SNR at 1 km and how fast it falls off, receptions below snrFloor are lost
+    float snrAt1Km = 5;
+    float pathLossExp = 3;
+    float snrFloor = -15;
+
+    uint32_t originIntervalMsec = 30 * 1000;
+};
+
+struct SimResult {
+    double deliveryRatio;
+    uint32_t transmissions, rebroadcasts, duplicatesHeard, cancelledRebroadcasts, collisions, lostToHalfDuplex;
+    uint32_t maxQueueDepth;
+    double historyHitRate;
+    uint64_t airtimeMsec;
+    uint32_t receptions;
+    double cpuNsecPerRx;
+};
+
+uint32_t envOr(const char *name, uint32_t dflt)
+{
+    const char *v = getenv(name);
+    return v ? strtoul(v, NULL, 10) : dflt;
+}
+
+float envOr(const char *name, float dflt)
+{
+    const char *v = getenv(name);
+    return v ? strtof(v, NULL) : dflt;
+}
+
+class MeshSim
+{
+    struct Link {
+        uint32_t to;
+        float snr;
+    };
+
+    struct Hearing {
+        uint32_t tx;
+        bool corrupted;
+    };
+
+    struct Node {
+        NodeNum num;
+        float x, y;
+        meshtastic_Config_DeviceConfig_Role role;
+        std::unique_ptr<PacketHistory> history;
+        std::unique_ptr<MeshPacketQueue> txQueue;
+        std::vector<Link> links;
+        std::vector<Hearing> hearing; // transmissions currently arriving here
+        uint32_t txUntil = 0;         // busy transmitting until
+        bool attemptScheduled = false;
+    };
+
+    struct Transmission {
+        uint32_t sender;
+        meshtastic_MeshPacket packet;
+    };
+
+    enum EventType { TX_ATTEMPT, TX_END, ORIGINATE };
+
+    struct Event {
+        uint32_t time, seq;
+        EventType type;
+        uint32_t node, tx;
+        bool operator>(const Event &o) const { return time != o.time ? time > o.time : seq > o.seq; }
+    };
+
+    SimConfig cfg;
+    std::mt19937 rng;
+    ChannelModelRadio radio;
+    std::vector<Node> nodes;
+    std::vector<Transmission> transmissions;
+    std::priority_queue<Event, std::vector<Event>, std::greater<Event>> events;
+    uint32_t now = 0, nextSeq = 0;
+
+    /// reached[packet][node], for the delivery ratio
+    std::vector<std::vector<bool>> reached;
+
+    SimResult result = {};
+    uint64_t cpuNsec = 0;
+
+    void schedule(uint32_t time, EventType type, uint32_t node, uint32_t tx = 0)
+    {
+        events.push(Event{time, nextSeq++, type, node, tx});
+    }
+
+    /// Point the firmware globals at node i
+    void activate(uint32_t i)
+    {
+        myNodeInfo.my_node_num = nodes[i].num;
+        config.device.role = nodes[i].role;
+    }
+
+    void scheduleAttempt(uint32_t i, float snr)
+    {
+        if (!nodes[i].attemptScheduled) {
+            activate(i);
+            nodes[i].attemptScheduled = true;
+            schedule(now + radio.getTxDelayMsecWeighted(snr), TX_ATTEMPT, i);
+        }
+    }
+
+    void noteQueueDepth(uint32_t i)
+    {
+        uint32_t depth = nodes[i].txQueue->getMaxLen() - nodes[i].txQueue->getFree();
+        if (depth > result.maxQueueDepth)
+            result.maxQueueDepth = depth;
+    }
+
+    void build()
+    {
+        std::uniform_real_distribution<float> pos(0, cfg.areaKm);
+        std::uniform_int_distribution<uint32_t> pct(0, 99);
+        for (uint32_t i = 0; i < cfg.nodes; i++) {
+            Node n;
+            n.num = 0x10000 + i;
+            n.x = pos(rng);
+            n.y = pos(rng);
+            n.role = pct(rng) < cfg.routers ? meshtastic_Config_DeviceConfig_Role_ROUTER
+                                            : meshtastic_Config_DeviceConfig_Role_CLIENT;
+            n.history.reset(new PacketHistory(256));
+            n.txQueue.reset(new MeshPacketQueue(MAX_TX_QUEUE));
+            nodes.push_back(std::move(n));
+        }
+
+        for (uint32_t i = 0; i < cfg.nodes; i++) {
+            for (uint32_t j = 0; j < cfg.nodes; j++) {
+                if (i == j)
+                    continue;
+                float d = hypotf(nodes[i].x - nodes[j].x, nodes[i].y - nodes[j].y);
+                float snr = cfg.snrAt1Km - 10 * cfg.pathLossExp * log10f(fmaxf(d, 0.01f));
+                if (snr >= cfg.snrFloor)
+                    nodes[i].links.push_back(Link{j, snr});
+            }
+        }
+    }
+
+    void originate(uint32_t i, uint32_t packetNum)
+    {
+        activate(i);
+        meshtastic_MeshPacket *p = packetPool.allocZeroed();
+        p->from = nodes[i].num;
+        p->to = NODENUM_BROADCAST;
+        p->id = packetNum + 1;
+        p->hop_limit = p->hop_start = cfg.hopLimit;
+        p->priority = meshtastic_MeshPacket_Priority_DEFAULT;
+        p->which_payload_variant = meshtastic_MeshPacket_encrypted_tag;
+        p->encrypted.size = cfg.payload;
+        p->relay_node = nodes[i].num & 0xff;
+
+        nodes[i].history->wasSeenRecently(p); // record our own packet, like Router::send does
+        reached[packetNum][i] = true;
+        if (nodes[i].txQueue->enqueue(p))
+            scheduleAttempt(i, 0);
+        else
+            packetPool.release(p);
+        noteQueueDepth(i);
+    }
+
+    void attempt(uint32_t i)
+    {
+        Node &n = nodes[i];
+        n.attemptScheduled = false;
+        if (n.txQueue->empty())
+            return;
+
+        if (!n.hearing.empty() || n.txUntil > now) {
+            // Channel busy, back off and retry
+            scheduleAttempt(i, 0);
+            return;
+        }
+
+        meshtastic_MeshPacket *p = n.txQueue->dequeue();
+        uint32_t tx = transmissions.size();
+        transmissions.push_back(Transmission{i, *p});
+        packetPool.release(p);
+
+        uint32_t airtime = radio.getPacketTime(cfg.payload + sizeof(PacketHeader));
+        n.txUntil = now + airtime;
+        result.transmissions++;
+        result.airtimeMsec += airtime;
+
+        // Starting to transmit wrecks whatever we were in the middle of receiving
+        for (auto &h : n.hearing)
+            h.corrupted = true;
+
+        for (auto &l : n.links) {
+            Node &r = nodes[l.to];
+            if (r.txUntil > now) {
+                result.lostToHalfDuplex++;
+                continue;
+            }
+            bool collided = !r.hearing.empty();
+            for (auto &h : r.hearing)
+                h.corrupted = true;
+            r.hearing.push_back(Hearing{tx, collided});
+        }
+        schedule(n.txUntil, TX_END, i, tx);
+    }
+
+    void endTransmission(uint32_t i, uint32_t tx)
+    {
+        std::uniform_real_distribution<float> unit(0, 1);
+        for (auto &l : nodes[i].links) {
+            Node &r = nodes[l.to];
+            for (auto it = r.hearing.begin(); it != r.hearing.end(); ++it) {
+                if (it->tx != tx)
+                    continue;
+                bool corrupted = it->corrupted;
+                r.hearing.erase(it);
+                if (corrupted)
+                    result.collisions++;
+                else if (unit(rng) >= cfg.loss)
+                    receive(l.to, transmissions[tx].packet, l.snr, nodes[i].num);
+                break;
+            }
+        }
+
+        if (!nodes[i].txQueue->empty())
+            scheduleAttempt(i, 0);
+    }
+
+    /// Router::cancelSending, on hearing a dupe
+    void cancel(uint32_t i, const meshtastic_MeshPacket &p)
+    {
+        Node &n = nodes[i];
+        meshtastic_MeshPacket *cancelled = n.txQueue->remove(p.from, p.id);
+        if (cancelled) {
+            n.history->removeRelayer(nodeDB->getLastByteOfNodeNum(n.num), p.id, p.from);
+            result.cancelledRebroadcasts++;
+            packetPool.release(cancelled);
+        }
+    }
+
+    /// NextHopRouter::perhapsRelay, @return true if a relay got queued
+    bool relay(uint32_t i, const meshtastic_MeshPacket &p)
+    {
+        Node &n = nodes[i];
+        meshtastic_MeshPacket *tosend = NextHopRouter::copyForRelay(&p);
+        if (!tosend)
+            return false;
+
+        // What NextHopRouter::send does before handing it to the radio, our packets are all broadcasts so have no next hop
+        tosend->relay_node = nodeDB->getLastByteOfNodeNum(n.num);
+        n.history->wasSeenRecently(tosend);
+        tosend->next_hop = NO_NEXT_HOP_PREFERENCE;
+        if (n.txQueue->enqueue(tosend))
+            return true;
+        packetPool.release(tosend);
+        return false;
+    }
+
+    void receive(uint32_t i, const meshtastic_MeshPacket &heard, float snr, NodeNum relayer)
+    {
+        Node &n = nodes[i];
+        activate(i);
+        result.receptions++;
+
+        auto start = std::chrono::steady_clock::now();
+
+        meshtastic_MeshPacket p = heard;
+        p.rx_snr = snr;
+        p.relay_node = relayer & 0xff;
+
+        bool rebroadcast = false;
+        bool wasFallback = false, weWereNextHop = false;
+        if (n.history->wasSeenRecently(&p, true, &wasFallback, &weWereNextHop)) {
+            result.duplicatesHeard++;
+            switch (NextHopRouter::dupeAction(&p, wasFallback, weWereNextHop)) {
+            case FloodingRouter::DUPE_CANCEL:
+                if (FloodingRouter::cancelsDupes())
+                    cancel(i, p);
+                break;
+            case FloodingRouter::DUPE_RELAY_AGAIN:
+            case FloodingRouter::DUPE_REPEATED:
+                if (!n.txQueue->find(p.from, p.id))
+                    rebroadcast = relay(i, p);
+                break;
+            case FloodingRouter::DUPE_DROP:
+                break;
+            }
+        } else {
+            reached[p.id - 1][i] = true;
+            rebroadcast = relay(i, p);
+        }
+
+        cpuNsec += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+
+        if (rebroadcast) {
+            result.rebroadcasts++;
+            noteQueueDepth(i);
+            scheduleAttempt(i, snr);
+        }
+    }
+
+  public:
+    explicit MeshSim(const SimConfig &c) : cfg(c), rng(c.seed)
+    {
+        randomSeed(c.seed); // contention windows use the Arduino random()
+        build();
+        reached.assign(cfg.packets, std::vector<bool>(cfg.nodes, false));
+    }
+
+    ~MeshSim()
+    {
+        for (auto &n : nodes) {
+            activate(&n - &nodes[0]);
+            while (meshtastic_MeshPacket *p = n.txQueue->dequeue())
+                packetPool.release(p);
+        }
+    }
+
+    SimResult run()
+    {
+        std::uniform_int_distribution<uint32_t> pick(0, cfg.nodes - 1);
+        for (uint32_t k = 0; k < cfg.packets; k++)
+            schedule(k * cfg.originIntervalMsec, ORIGINATE, pick(rng), k);
+
+        while (!events.empty()) {
+            Event e = events.top();
+            events.pop();
+            now = e.time;
+            switch (e.type) {
+            case ORIGINATE:
+                originate(e.node, e.tx);
+                break;
+            case TX_ATTEMPT:
+                attempt(e.node);
+                break;
+            case TX_END:
+                endTransmission(e.node, e.tx);
+                break;
+            }
+        }
+
+        uint64_t delivered = 0;
+        for (auto &r : reached)
+            for (bool b : r)
+                delivered += b;
+        // The originator counts itself as reached, leave it out
+        result.deliveryRatio =
+            cfg.nodes > 1 ? (double)(delivered - cfg.packets) / ((uint64_t)cfg.packets * (cfg.nodes - 1)) : 1;
+        result.historyHitRate = result.receptions ? (double)result.duplicatesHeard / result.receptions : 0;
+        result.cpuNsecPerRx = result.receptions ? (double)cpuNsec / result.receptions : 0;
+        return result;
+    }
+
+    void print(const SimResult &r) const
+    {
+        printf("MESH_SIM_RESULT {\"seed\":%u,\"nodes\":%u,\"packets\":%u,\"area_km\":%.1f,\"loss\":%.3f,\"hop_limit\":%u,"
+               "\"delivery_ratio\":%.4f,\"transmissions\":%u,\"rebroadcasts\":%u,\"duplicates_heard\":%u,"
+               "\"cancelled_rebroadcasts\":%u,\"collisions\":%u,\"half_duplex_losses\":%u,\"max_queue_depth\":%u,"
+               "\"history_hit_rate\":%.4f,\"airtime_ms\":%llu,\"receptions\":%u,\"cpu_ns_per_rx\":%.0f}\n",
+               cfg.seed, cfg.nodes, cfg.packets, cfg.areaKm, cfg.loss, cfg.hopLimit, r.deliveryRatio, r.transmissions,
+               r.rebroadcasts, r.duplicatesHeard, r.cancelledRebroadcasts, r.collisions, r.lostToHalfDuplex, r.maxQueueDepth,
+               r.historyHitRate, (unsigned long long)r.airtimeMsec, r.receptions, r.cpuNsecPerRx);
+    }
+};
+
+SimConfig configFromEnv()
+{
+    SimConfig c;
+    c.nodes = envOr("MESH_SIM_NODES", c.nodes);
+    c.packets = envOr("MESH_SIM_PACKETS", c.packets);
+    c.seed = envOr("MESH_SIM_SEED", c.seed);
+    c.areaKm = envOr("MESH_SIM_AREA_KM", c.areaKm);
+    c.loss = envOr("MESH_SIM_LOSS", c.loss);
+    c.routers = envOr("MESH_SIM_ROUTERS", c.routers);
+    c.hopLimit = envOr("MESH_SIM_HOP_LIMIT", c.hopLimit);
+    c.payload = envOr("MESH_SIM_PAYLOAD", c.payload);
+    return c;
+}
+
+void test_sameSeedSameResult()
+{
+    SimConfig c;
+    c.nodes = 30;
+    c.packets = 5;
+    SimResult a = MeshSim(c).run(), b = MeshSim(c).run();
+
+    TEST_ASSERT_EQUAL_DOUBLE(a.deliveryRatio, b.deliveryRatio);
+    TEST_ASSERT_EQUAL_UINT32(a.transmissions, b.transmissions);
+    TEST_ASSERT_EQUAL_UINT32(a.duplicatesHeard, b.duplicatesHeard);
+    TEST_ASSERT_EQUAL_UINT32(a.collisions, b.collisions);
+    TEST_ASSERT_EQUAL_UINT64(a.airtimeMsec, b.airtimeMsec);
+}
+
+void test_denseLosslessMeshDelivers()
+{
+    // Everybody hears everybody and nothing is lost, so the first transmission reaches every node
+    SimConfig c;
+    c.nodes = 20;
+    c.packets = 3;
+    c.areaKm = 0.5;
+    c.loss = 0;
+    SimResult r = MeshSim(c).run();
+
+    TEST_ASSERT_EQUAL_DOUBLE(1.0, r.deliveryRatio);
+    TEST_ASSERT_GREATER_THAN_UINT32(0, r.cancelledRebroadcasts);
+}
+
+void test_benchmark()
+{
+    SimConfig c = configFromEnv();
+    MeshSim sim(c);
+    SimResult r = sim.run();
+    sim.print(r);
+    TEST_ASSERT_GREATER_THAN_UINT32(0, r.transmissions);
+}
+} // namespace
+
+void setup()
+{
+    initializeTestEnvironment();
+    const std::unique_ptr<MockNodeDB> mockNodeDB(new MockNodeDB());
+    nodeDB = mockNodeDB.get();
+    settingsMap[logoutputlevel] = level_warn; // the relay decisions log at info level, the contention window maths at debug
+    initRegion();                             // RadioInterface needs myRegion for its slot time
+
+    UNITY_BEGIN();
+    RUN_TEST(test_sameSeedSameResult);
+    RUN_TEST(test_denseLosslessMeshDelivers);
+    RUN_TEST(test_benchmark);
+    exit(UNITY_END());
+}
+#else
+void setup()
+{
+    initializeTestEnvironment();
+    LOG_WARN("This test requires the ARCH_PORTDUINO variant");
+    UNITY_BEGIN();
+    UNITY_END();
+}
+#endif
+void loop() {}
@@ -26,6 +26,7 @@
 #include <string_view>
 #include <utility>
 #include <variant>
+#include <vector>
 
 namespace
 {
@@ -491,6 +492,71 @@ void test_sendQueued(void)
     TEST_ASSERT_EQUAL(decoded.id, env.packet->id);
 }
 
+// Ids of the packets published on the encrypted/protobuf topics, in publish order.
+std::vector<uint32_t> publishedPacketIds()
+{
+    std::vector<uint32_t> ids;
+    for (const auto &[topic, payload] : pubsub->published_) {
+        if (topic.rfind("msh/2/e/", 0) != 0)
+            continue;
+        const DecodedServiceEnvelope &env = std::get<DecodedServiceEnvelope>(payload);
+        TEST_ASSERT_TRUE(env.validDecode);
+        ids.push_back(env.packet->id);
+    }
+    return ids;
+}
+
+// Send n copies of the decoded packet with consecutive ids while the MQTT server is down, then let it come back.
+// Returns the number of msecs from reconnecting until the last one was published, or -1 on timeout.
+long sendQueuedBurst(size_t n)
+{
+    pubsub->connected_ = false;
+    pubsub->refuseConnection_ = true;
+    TEST_ASSERT_TRUE(loopUntil([] { return !unitTest->getPubSub().connected(); }));
+
+    for (size_t i = 0; i < n; i++) {
+        meshtastic_MeshPacket p = decoded;
+        p.id = 100 + i;
+        mqtt->onSend(p, p, 0);
+    }
+    TEST_ASSERT_TRUE(pubsub->published_.empty());
+
+    pubsub->refuseConnection_ = false;
+    const long start = millis();
+    if (!loopUntil([n] { return publishedPacketIds().size() >= n; }))
+        return -1;
+    return millis() - start;
+}
+
+// Everything queued during an outage is published in order soon after reconnecting, not one message per reconnect.
+void test_sendQueuedDrainsBacklog(void)
+{
+    const long msec = sendQueuedBurst(MAX_MQTT_QUEUE);
+    TEST_ASSERT_GREATER_OR_EQUAL(0, msec);
+    LOG_INFO("Drained %d queued messages in %ld ms", MAX_MQTT_QUEUE, msec);
+
+    TEST_ASSERT_EQUAL(0, unitTest->queueSize());
+    const std::vector<uint32_t> ids = publishedPacketIds();
+    TEST_ASSERT_EQUAL(MAX_MQTT_QUEUE, ids.size());
+    for (size_t i = 0; i < ids.size(); i++)
+        TEST_ASSERT_EQUAL(100 + i, ids[i]);
+}
+
+#if MQTT_SPILL_QUEUE
+// Messages that don't fit in the queue are spilled to the filesystem instead of dropped, and still come out in order.
+void test_sendQueuedSpillsOverflow(void)
+{
+    const size_t n = MAX_MQTT_QUEUE + 4;
+    TEST_ASSERT_GREATER_OR_EQUAL(0, sendQueuedBurst(n));
+
+    TEST_ASSERT_EQUAL(0, unitTest->queueSize());
+    const std::vector<uint32_t> ids = publishedPacketIds();
+    TEST_ASSERT_EQUAL(n, ids.size());
+    for (size_t i = 0; i < ids.size(); i++)
+        TEST_ASSERT_EQUAL(100 + i, ids[i]);
+}
+#endif
+
 // Verify reconnecting with the proxy enabled does not reconnect to a MQTT server.
 void test_reconnectProxyDoesNotReconnectMqtt(void)
 {
@@ -882,6 +948,10 @@ void setup()
     RUN_TEST(test_noRangeTestAppOnDefaultServer);
     RUN_TEST(test_noDetectionSensorAppOnDefaultServer);
     RUN_TEST(test_sendQueued);
+    RUN_TEST(test_sendQueuedDrainsBacklog);
+#if MQTT_SPILL_QUEUE
+    RUN_TEST(test_sendQueuedSpillsOverflow);
+#endif
     RUN_TEST(test_reconnectProxyDoesNotReconnectMqtt);
     RUN_TEST(test_receiveEmptyMeshPacket);
     RUN_TEST(test_receiveDecodedProto);
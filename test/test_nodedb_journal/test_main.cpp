@@ -0,0 +1,430 @@
+#include "DebugConfiguration.h"
+#include "TestUtil.h"
+#include <unity.h>
+
+#include "FSCommon.h"
+#include "mesh/NodeDBJournal.h"
+#include "mesh/mesh-pb-constants.h"
+
+#include <map>
+#include <random>
+
+namespace
+{
+const char *journalFile = "/nodes_test.journal";
+
+constexpr NodeNum nodeA = 0x0a;
+constexpr NodeNum nodeB = 0x0b;
+constexpr NodeNum nodeC = 0x0c;
+
+/// Stands in for NodeDB, the journal only sees it through its callbacks
+struct Nodes {
+    std::map<NodeNum, meshtastic_NodeInfoLite> nodes;
+
+    NodeDBJournal::Lookup lookup()
+    {
+        return [this](NodeNum n) -> const meshtastic_NodeInfoLite * {
+            auto it = nodes.find(n);
+            return it == nodes.end() ? NULL : &it->second;
+        };
+    }
+
+    bool replay(NodeDBJournal &journal)
+    {
+        return journal.replay(
+            [this](NodeNum n) {
+                meshtastic_NodeInfoLite &node = nodes[n];
+                node.num = n;
+                return &node;
+            },
+            [this](NodeNum n) { nodes.erase(n); });
+    }
+
+    /// What writing these nodes as the node database file would take
+    size_t snapshotBytes() const
+    {
+        meshtastic_NodeDatabase db = {1, {}};
+        for (const auto &n : nodes)
+            db.nodes.push_back(n.second);
+        size_t size = 0;
+        pb_get_encoded_size(&size, meshtastic_NodeDatabase_fields, &db);
+        return size;
+    }
+};
+
+meshtastic_NodeInfoLite makeNode(NodeNum n)
+{
+    meshtastic_NodeInfoLite node = meshtastic_NodeInfoLite_init_zero;
+    node.num = n;
+    node.has_user = true;
+    snprintf(node.user.long_name, sizeof(node.user.long_name), "Meshtastic %04x", (unsigned)n);
+    snprintf(node.user.short_name, sizeof(node.user.short_name), "%04x", (unsigned)n & 0xffff);
+    node.user.hw_model = meshtastic_HardwareModel_HELTEC_V3;
+    node.user.public_key.size = 32;
+    memset(node.user.public_key.bytes, n & 0xff, 32);
+    node.has_position = true;
+    node.position.latitude_i = 520000000 + n;
+    node.position.longitude_i = 45000000 + n;
+    node.position.altitude = 10;
+    node.has_device_metrics = true;
+    node.device_metrics.has_battery_level = true;
+    node.device_metrics.battery_level = 80;
+    node.device_metrics.has_channel_utilization = true;
+    node.device_metrics.channel_utilization = 12.5f;
+    node.last_heard = 1000;
+    node.snr = 6.25f;
+    node.has_hops_away = true;
+    node.hops_away = 1;
+    return node;
+}
+
+void removeJournal()
+{
+    concurrency::LockGuard g(spiLock);
+    FSCom.remove(journalFile);
+}
+
+void appendToJournal(const uint8_t *bytes, size_t len)
+{
+    concurrency::LockGuard g(spiLock);
+    File f = FSCom.open(journalFile, "a");
+    TEST_ASSERT_TRUE(f);
+    f.write(bytes, len);
+    f.close();
+}
+
+void assertSameNodes(const Nodes &expected, const Nodes &actual)
+{
+    TEST_ASSERT_EQUAL(expected.nodes.size(), actual.nodes.size());
+    for (const auto &e : expected.nodes) {
+        auto it = actual.nodes.find(e.first);
+        TEST_ASSERT_TRUE(it != actual.nodes.end());
+        const meshtastic_NodeInfoLite &a = it->second, &b = e.second;
+        TEST_ASSERT_EQUAL(b.num, a.num);
+        TEST_ASSERT_EQUAL(b.last_heard, a.last_heard);
+        TEST_ASSERT_EQUAL_FLOAT(b.snr, a.snr);
+        TEST_ASSERT_EQUAL(b.hops_away, a.hops_away);
+        TEST_ASSERT_EQUAL(b.has_position, a.has_position);
+        TEST_ASSERT_EQUAL(b.position.latitude_i, a.position.latitude_i);
+        TEST_ASSERT_EQUAL(b.position.time, a.position.time);
+        TEST_ASSERT_EQUAL(b.device_metrics.battery_level, a.device_metrics.battery_level);
+        TEST_ASSERT_EQUAL(b.has_user, a.has_user);
+        TEST_ASSERT_EQUAL_STRING(b.user.long_name, a.user.long_name);
+        TEST_ASSERT_EQUAL(b.user.public_key.size, a.user.public_key.size);
+        TEST_ASSERT_EQUAL(b.channel, a.channel);
+        TEST_ASSERT_EQUAL(b.is_favorite, a.is_favorite);
+    }
+}
+
+void test_replayRestoresChanges()
+{
+    removeJournal();
+    NodeDBJournal journal(journalFile);
+    Nodes live;
+    for (NodeNum n : {nodeA, nodeB, nodeC}) {
+        live.nodes[n] = makeNode(n);
+        journal.mark(n, NodeDBJournal::NODE);
+    }
+    TEST_ASSERT_TRUE(journal.flush(live.lookup()));
+    TEST_ASSERT_FALSE(journal.isDirty());
+
+    live.nodes[nodeA].last_heard = 2000;
+    journal.mark(nodeA, NodeDBJournal::HEARD);
+    live.nodes[nodeB].position.latitude_i = 1;
+    live.nodes[nodeB].position.time = 1500;
+    journal.mark(nodeB, NodeDBJournal::POSITION);
+    strcpy(live.nodes[nodeC].user.long_name, "Renamed");
+    live.nodes[nodeC].channel = 2;
+    journal.mark(nodeC, NodeDBJournal::USER);
+    live.nodes[nodeC].device_metrics.battery_level = 42;
+    journal.mark(nodeC, NodeDBJournal::METRICS);
+    TEST_ASSERT_TRUE(journal.flush(live.lookup()));
+
+    Nodes restored;
+    NodeDBJournal reopened(journalFile);
+    TEST_ASSERT_TRUE(restored.replay(reopened));
+    assertSameNodes(live, restored);
+    TEST_ASSERT_EQUAL(journal.size(), reopened.size());
+    TEST_ASSERT_EQUAL(journal.size(), journal.getBytesWritten());
+}
+
+void test_onlyMarkedPartsAreWritten()
+{
+    removeJournal();
+    NodeDBJournal journal(journalFile);
+    Nodes live;
+    live.nodes[nodeA] = makeNode(nodeA);
+    Nodes restored = live;
+
+    // A position nobody marked stays behind
+    live.nodes[nodeA].last_heard = 3000;
+    live.nodes[nodeA].position.latitude_i = 7;
+    journal.mark(nodeA, NodeDBJournal::HEARD);
+    TEST_ASSERT_TRUE(journal.flush(live.lookup()));
+
+    // Flushing some parts leaves the others marked
+    live.nodes[nodeA].device_metrics.battery_level = 10;
+    live.nodes[nodeA].last_heard = 4000;
+    journal.mark(nodeA, NodeDBJournal::METRICS | NodeDBJournal::HEARD);
+    TEST_ASSERT_TRUE(journal.flush(live.lookup(), (uint8_t)~NodeDBJournal::HEARD));
+    TEST_ASSERT_TRUE(journal.isDirty());
+
+    NodeDBJournal reopened(journalFile);
+    TEST_ASSERT_TRUE(restored.replay(reopened));
+    const meshtastic_NodeInfoLite &node = restored.nodes[nodeA];
+    TEST_ASSERT_EQUAL(3000, node.last_heard);
+    TEST_ASSERT_EQUAL(10, node.device_metrics.battery_level);
+    TEST_ASSERT_EQUAL(520000000 + nodeA, node.position.latitude_i);
+    TEST_ASSERT_EQUAL_STRING(live.nodes[nodeA].user.long_name, node.user.long_name);
+
+    TEST_ASSERT_TRUE(journal.flush(live.lookup()));
+    TEST_ASSERT_FALSE(journal.isDirty());
+    restored = Nodes();
+    TEST_ASSERT_TRUE(restored.replay(reopened));
+    TEST_ASSERT_EQUAL(4000, restored.nodes[nodeA].last_heard);
+}
+
+void test_removedNodes()
+{
+    removeJournal();
+    NodeDBJournal journal(journalFile);
+    Nodes live;
+    for (NodeNum n : {nodeA, nodeB, nodeC})
+        live.nodes[n] = makeNode(n);
+    Nodes restored = live;
+
+    // Gone for good, and gone but heard again before the flush
+    live.nodes.erase(nodeA);
+    journal.mark(nodeA, NodeDBJournal::HEARD);
+    journal.mark(nodeA, NodeDBJournal::REMOVED);
+    live.nodes.erase(nodeB);
+    journal.mark(nodeB, NodeDBJournal::REMOVED);
+    live.nodes[nodeB] = meshtastic_NodeInfoLite_init_zero;
+    live.nodes[nodeB].num = nodeB;
+    live.nodes[nodeB].last_heard = 5000;
+    journal.mark(nodeB, NodeDBJournal::HEARD);
+    TEST_ASSERT_TRUE(journal.flush(live.lookup()));
+
+    NodeDBJournal reopened(journalFile);
+    TEST_ASSERT_TRUE(restored.replay(reopened));
+    assertSameNodes(live, restored);
+    TEST_ASSERT_FALSE(restored.nodes[nodeB].has_user);
+}
+
+void test_damagedTailIsIgnored()
+{
+    removeJournal();
+    NodeDBJournal journal(journalFile);
+    Nodes live;
+    live.nodes[nodeA] = makeNode(nodeA);
+    live.nodes[nodeB] = makeNode(nodeB);
+    journal.mark(nodeA, NodeDBJournal::NODE);
+    journal.mark(nodeB, NodeDBJournal::NODE);
+    TEST_ASSERT_TRUE(journal.flush(live.lookup()));
+    const uint32_t good = journal.size();
+
+    // A record cut short by a power loss
+    const uint8_t torn[] = {0x12, 0x34, 0x56, 0x78, 0x4A, 0x01, 0x20, 0x00, 0x0a};
+    appendToJournal(torn, sizeof(torn));
+    Nodes restored;
+    NodeDBJournal reopened(journalFile);
+    TEST_ASSERT_FALSE(restored.replay(reopened));
+    assertSameNodes(live, restored);
+    TEST_ASSERT_EQUAL(good, reopened.size());
+
+    // And a whole record with a bit flipped
+    removeJournal();
+    journal.reset();
+    journal.mark(nodeA, NodeDBJournal::NODE);
+    TEST_ASSERT_TRUE(journal.flush(live.lookup()));
+    live.nodes[nodeA].last_heard = 9999;
+    journal.mark(nodeA, NodeDBJournal::HEARD);
+    TEST_ASSERT_TRUE(journal.flush(live.lookup()));
+    std::vector<uint8_t> bytes(journal.size());
+    {
+        concurrency::LockGuard g(spiLock);
+        File f = FSCom.open(journalFile, FILE_O_READ);
+        TEST_ASSERT_EQUAL(bytes.size(), f.read(bytes.data(), bytes.size()));
+        f.close();
+        FSCom.remove(journalFile);
+    }
+    bytes.back() ^= 0x01;
+    appendToJournal(bytes.data(), bytes.size());
+
+    restored = Nodes();
+    TEST_ASSERT_FALSE(restored.replay(reopened));
+    TEST_ASSERT_EQUAL(1000, restored.nodes[nodeA].last_heard);
+}
+
+void test_replayTwiceChangesNothing()
+{
+    removeJournal();
+    NodeDBJournal journal(journalFile);
+    Nodes live;
+    live.nodes[nodeA] = makeNode(nodeA);
+    Nodes snapshot = live;
+    live.nodes[nodeA].last_heard = 6000;
+    live.nodes[nodeA].position.latitude_i = 3;
+    journal.mark(nodeA, NodeDBJournal::HEARD | NodeDBJournal::POSITION);
+    live.nodes[nodeC] = makeNode(nodeC);
+    journal.mark(nodeC, NodeDBJournal::NODE);
+    TEST_ASSERT_TRUE(journal.flush(live.lookup()));
+
+    // As after a crash between writing a snapshot and dropping the journal
+    NodeDBJournal reopened(journalFile);
+    TEST_ASSERT_TRUE(snapshot.replay(reopened));
+    TEST_ASSERT_TRUE(snapshot.replay(reopened));
+    assertSameNodes(live, snapshot);
+    TEST_ASSERT_FALSE(reopened.isDirty());
+}
+
+void test_compaction()
+{
+    removeJournal();
+    NodeDBJournal journal(journalFile);
+    Nodes live;
+    for (NodeNum n = 1; n <= 20; n++)
+        live.nodes[n] = makeNode(n);
+    const size_t snapshotBytes = std::max<size_t>(live.snapshotBytes(), NODEDB_JOURNAL_MIN_COMPACT_BYTES);
+
+    uint32_t heard = 0;
+    while (!journal.wantsCompaction(live.snapshotBytes())) {
+        for (auto &n : live.nodes) {
+            n.second.last_heard = ++heard;
+            journal.mark(n.first, NodeDBJournal::HEARD);
+        }
+        TEST_ASSERT_TRUE(journal.flush(live.lookup()));
+    }
+    TEST_ASSERT_GREATER_THAN(snapshotBytes, journal.size());
+
+    journal.reset();
+    TEST_ASSERT_EQUAL(0, journal.size());
+    Nodes restored;
+    NodeDBJournal reopened(journalFile);
+    TEST_ASSERT_TRUE(restored.replay(reopened));
+    TEST_ASSERT_EQUAL(0, restored.nodes.size());
+}
+
+/**
+ * An hour in a busy mesh, saving the nodes the way NodeDB did before the journal, rewriting the whole node file at most once a
+ * minute whenever a user changed, and the way it does now.  Every node is heard every couple of minutes, sends its position
+ * every 15 minutes and its telemetry every 30, and its user every 3 hours, a quarter of them changed.
+ */
+void test_bytesWrittenPerHour()
+{
+    removeJournal();
+    constexpr uint32_t numNodes = 150;
+    constexpr uint32_t hour = 60 * 60;
+    std::mt19937 rng(15);
+    auto jitter = [&](uint32_t period) { return period / 2 + rng() % period; };
+
+    Nodes live;
+    struct Due {
+        uint32_t heard, position, metrics, user;
+    };
+    std::map<NodeNum, Due> due;
+    for (NodeNum n = 1; n <= numNodes; n++) {
+        live.nodes[0x10000 + n] = makeNode(0x10000 + n);
+        due[0x10000 + n] = {(uint32_t)(rng() % 120), (uint32_t)(rng() % 900), (uint32_t)(rng() % 1800),
+                            (uint32_t)(rng() % (3 * hour))};
+    }
+
+    size_t rewriteBytes = 0;
+    uint32_t lastRewrite = 0;
+    bool rewritten = false;
+
+    NodeDBJournal journal(journalFile);
+    Nodes snapshot = live;
+    size_t snapshotBytes = live.snapshotBytes(), compactionBytes = 0;
+    uint32_t lastFlush = 0, lastUserFlush = 0;
+    bool userFlushed = false;
+    auto flush = [&](uint32_t now, uint8_t parts) {
+        lastFlush = now;
+        if (journal.wantsCompaction(snapshotBytes)) {
+            snapshot = live;
+            snapshotBytes = live.snapshotBytes();
+            compactionBytes += snapshotBytes;
+            journal.reset();
+        } else {
+            TEST_ASSERT_TRUE(journal.flush(live.lookup(), parts));
+        }
+    };
+
+    for (uint32_t now = 1; now <= hour; now++) {
+        for (auto &d : due) {
+            meshtastic_NodeInfoLite &node = live.nodes[d.first];
+            bool userChanged = false;
+            if (now >= d.second.position) {
+                node.position.latitude_i += rng() % 100;
+                node.position.time = now;
+                journal.mark(d.first, NodeDBJournal::POSITION);
+                d.second.position = now + jitter(900);
+            }
+            if (now >= d.second.metrics) {
+                node.device_metrics.battery_level = rng() % 100;
+                node.device_metrics.has_uptime_seconds = true;
+                node.device_metrics.uptime_seconds = now;
+                journal.mark(d.first, NodeDBJournal::METRICS);
+                d.second.metrics = now + jitter(1800);
+            }
+            if (now >= d.second.user) {
+                if (rng() % 4 == 0) {
+                    snprintf(node.user.long_name, sizeof(node.user.long_name), "Renamed %u", (unsigned)now);
+                    journal.mark(d.first, NodeDBJournal::USER);
+                    userChanged = true;
+                }
+                d.second.user = now + jitter(3 * hour);
+            }
+            if (now < d.second.heard && !userChanged)
+                continue;
+            node.last_heard = now;
+            node.snr = (float)(rng() % 40) / 4;
+            journal.mark(d.first, NodeDBJournal::HEARD);
+            d.second.heard = now + jitter(120);
+
+            if (userChanged && (!rewritten || now - lastRewrite >= 60)) {
+                rewriteBytes += live.snapshotBytes();
+                lastRewrite = now;
+                rewritten = true;
+            }
+            if (userChanged && (!userFlushed || now - lastUserFlush >= 60)) {
+                flush(now, (uint8_t)~NodeDBJournal::HEARD);
+                lastUserFlush = now;
+                userFlushed = true;
+            }
+            if (now - lastFlush >= NODEDB_JOURNAL_FLUSH_MSEC / 1000)
+                flush(now, 0xFF);
+        }
+    }
+    flush(hour, 0xFF);
+
+    // Nothing got lost on the way
+    Nodes restored = snapshot;
+    NodeDBJournal reopened(journalFile);
+    TEST_ASSERT_TRUE(restored.replay(reopened));
+    assertSameNodes(live, restored);
+
+    const size_t journalBytes = journal.getBytesWritten() + compactionBytes;
+    LOG_INFO("%u nodes for an hour: rewriting the node file wrote %u bytes, the journal %u (%u of them compacting)",
+             (unsigned)numNodes, (unsigned)rewriteBytes, (unsigned)journalBytes, (unsigned)compactionBytes);
+    TEST_ASSERT_LESS_THAN(rewriteBytes / 2, journalBytes);
+    removeJournal();
+}
+} // namespace
+
+void setup()
+{
+    initializeTestEnvironment();
+
+    UNITY_BEGIN();
+    RUN_TEST(test_replayRestoresChanges);
+    RUN_TEST(test_onlyMarkedPartsAreWritten);
+    RUN_TEST(test_removedNodes);
+    RUN_TEST(test_damagedTailIsIgnored);
+    RUN_TEST(test_replayTwiceChangesNothing);
+    RUN_TEST(test_compaction);
+    RUN_TEST(test_bytesWrittenPerHour);
+    exit(UNITY_END());
+}
+
+void loop() {}
@@ -0,0 +1,117 @@
+#include "DebugConfiguration.h"
+#include "TestUtil.h"
+#include <unity.h>
+
+#include "concurrency/OSThread.h"
+#include <algorithm>
+
+namespace
+{
+
+/// Runs every period msecs, counting its runs, and deletes victim on its first run if given one
+class CountingThread : public concurrency::OSThread
+{
+  public:
+    CountingThread(const char *name, uint32_t period, CountingThread **victim = NULL)
+        : OSThread(name, period), period(period), victim(victim)
+    {
+    }
+
+    uint32_t runs = 0;
+
+  protected:
+    int32_t runOnce() override
+    {
+        runs++;
+        if (victim && *victim) {
+            delete *victim;
+            *victim = NULL;
+        }
+        return period;
+    }
+
+  private:
+    uint32_t period;
+    CountingThread **victim;
+};
+
+/// Call runOrDelay() for msec, sleeping as it asks
+void runFor(uint32_t msec)
+{
+    uint32_t start = millis();
+    while (millis() - start < msec) {
+        long delayMsec = concurrency::OSThread::runOrDelay();
+        delay(std::min(delayMsec, 2L));
+    }
+}
+
+void test_deleteParkedThread()
+{
+    CountingThread *keeper = new CountingThread("keeper", 5);
+    CountingThread *parked = new CountingThread("parked", 10);
+    runFor(15);
+    TEST_ASSERT_GREATER_THAN(0, parked->runs);
+
+    // Disabling parks it, but its last heap entry stays behind until it comes due
+    parked->disable();
+    concurrency::OSThread::runOrDelay();
+    delete parked;
+
+    uint32_t keeperRuns = keeper->runs;
+    runFor(30); // well past the parked thread's old deadline
+    TEST_ASSERT_GREATER_THAN(keeperRuns, keeper->runs);
+    delete keeper;
+}
+
+void test_deleteThreadMidPass()
+{
+    CountingThread *victim = new CountingThread("victim", 0);
+    // Leave superseded entries of the victim in the heap
+    for (int i = 0; i < 5; i++)
+        victim->setIntervalFromNow(i);
+    CountingThread *killer = new CountingThread("killer", 0, &victim);
+    CountingThread *bystander = new CountingThread("bystander", 0);
+
+    // Everything is due in the first pass, the killer deletes the victim whether it already ran or not
+    concurrency::OSThread::runOrDelay();
+    TEST_ASSERT_NULL(victim);
+    TEST_ASSERT_EQUAL_UINT32(1, killer->runs);
+
+    uint32_t bystanderRuns = bystander->runs;
+    runFor(20);
+    TEST_ASSERT_GREATER_THAN(bystanderRuns, bystander->runs);
+    TEST_ASSERT_GREATER_THAN(1, killer->runs);
+    delete killer;
+    delete bystander;
+}
+
+void test_deleteDueThreadBeforePass()
+{
+    CountingThread *keeper = new CountingThread("keeper", 1);
+    CountingThread *due = new CountingThread("due", 1);
+    runFor(5);
+    // Rescheduled but not yet picked up by runOrDelay(), with its old entry due
+    due->setIntervalFromNow(1000);
+    delay(3);
+    delete due;
+
+    uint32_t keeperRuns = keeper->runs;
+    runFor(10);
+    TEST_ASSERT_GREATER_THAN(keeperRuns, keeper->runs);
+    delete keeper;
+}
+
+} // namespace
+
+void setup()
+{
+    initializeTestEnvironment();
+
+    UNITY_BEGIN();
+    RUN_TEST(test_deleteParkedThread);
+    RUN_TEST(test_deleteThreadMidPass);
+    RUN_TEST(test_deleteDueThreadBeforePass);
+    exit(UNITY_END());
+}
+
+void loop() {}
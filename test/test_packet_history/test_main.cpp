@@ -0,0 +1,153 @@
+#include "DebugConfiguration.h"
+#include "TestUtil.h"
+#include <unity.h>
+
+#include "mesh/NodeDB.h"
+#include "mesh/PacketHistory.h"
+
+#include <memory>
+#include <vector>
+
+namespace
+{
+// Minimal NodeDB, PacketHistory only needs our own node number.
+class MockNodeDB : public NodeDB
+{
+  public:
+    meshtastic_NodeInfoLite *getMeshNode(NodeNum n) override { return &emptyNode; }
+    meshtastic_NodeInfoLite emptyNode = {};
+};
+
+// Number of in-flight packet ids used for the lookup benchmark.
+constexpr uint32_t numInFlight = 10000;
+
+meshtastic_MeshPacket makePacket(NodeNum from, PacketId id, uint8_t relayNode = 0)
+{
+    meshtastic_MeshPacket p = meshtastic_MeshPacket_init_zero;
+    p.from = from;
+    p.to = NODENUM_BROADCAST;
+    p.id = id;
+    p.relay_node = relayNode;
+    return p;
+}
+
+} // namespace
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+// A packet is only reported as seen after it has been recorded.
+void test_seenAfterUpdate(void)
+{
+    PacketHistory history(16);
+    meshtastic_MeshPacket p = makePacket(0x1234, 42);
+
+    TEST_ASSERT_FALSE(history.wasSeenRecently(&p, false));
+    TEST_ASSERT_EQUAL(0, history.getNumRecords());
+    TEST_ASSERT_FALSE(history.wasSeenRecently(&p));
+    TEST_ASSERT_TRUE(history.wasSeenRecently(&p));
+    TEST_ASSERT_EQUAL(1, history.getNumRecords());
+}
+
+// Packets with id 0 are never recorded.
+void test_zeroIdIgnored(void)
+{
+    PacketHistory history(16);
+    meshtastic_MeshPacket p = makePacket(0x1234, 0);
+
+    TEST_ASSERT_FALSE(history.wasSeenRecently(&p));
+    TEST_ASSERT_FALSE(history.wasSeenRecently(&p));
+    TEST_ASSERT_EQUAL(0, history.getNumRecords());
+}
+
+// The same id from a different sender is a different packet.
+void test_senderIsPartOfKey(void)
+{
+    PacketHistory history(16);
+    meshtastic_MeshPacket a = makePacket(0x1234, 42);
+    meshtastic_MeshPacket b = makePacket(0x5678, 42);
+
+    history.wasSeenRecently(&a);
+    TEST_ASSERT_FALSE(history.wasSeenRecently(&b, false));
+    TEST_ASSERT_TRUE(history.wasSeenRecently(&a, false));
+}
+
+// Relayers are accumulated per packet and can be removed again.
+void test_relayers(void)
+{
+    PacketHistory history(16);
+    meshtastic_MeshPacket first = makePacket(0x1234, 42, 0x11);
+    meshtastic_MeshPacket second = makePacket(0x1234, 42, 0x22);
+
+    history.wasSeenRecently(&first);
+    history.wasSeenRecently(&second);
+    TEST_ASSERT_TRUE(history.wasRelayer(0x11, 42, 0x1234));
+    TEST_ASSERT_TRUE(history.wasRelayer(0x22, 42, 0x1234));
+    TEST_ASSERT_FALSE(history.wasRelayer(0x33, 42, 0x1234));
+    TEST_ASSERT_FALSE(history.wasRelayer(0, 42, 0x1234));
+
+    history.removeRelayer(0x11, 42, 0x1234);
+    TEST_ASSERT_FALSE(history.wasRelayer(0x11, 42, 0x1234));
+    TEST_ASSERT_TRUE(history.wasRelayer(0x22, 42, 0x1234));
+}
+
+// The table never holds more than its capacity and keeps the newest records.
+void test_capacityBounded(void)
+{
+    const uint32_t capacity = 64;
+    PacketHistory history(capacity);
+
+    for (PacketId id = 1; id <= capacity * 10; id++) {
+        meshtastic_MeshPacket p = makePacket(0x1000 + (id % 7), id);
+        history.wasSeenRecently(&p);
+        TEST_ASSERT_LESS_OR_EQUAL(capacity, history.getNumRecords());
+    }
+    TEST_ASSERT_EQUAL(capacity, history.getNumRecords());
+    TEST_ASSERT_EQUAL(capacity, history.getCapacity());
+}
+
+// Lookups per second with numInFlight packet ids in the table.
+void test_lookupBenchmark(void)
+{
+    PacketHistory history(numInFlight);
+    std::vector<meshtastic_MeshPacket> packets;
+    packets.reserve(numInFlight);
+    for (uint32_t i = 0; i < numInFlight; i++) {
+        packets.push_back(makePacket(0x1000 + (random() % 500), (uint32_t)random() | 1, 0x11));
+        history.wasSeenRecently(&packets.back());
+    }
+
+    const uint32_t rounds = 20;
+    uint32_t hits = 0;
+    uint32_t start = millis();
+    for (uint32_t r = 0; r < rounds; r++) {
+        for (const auto &p : packets) {
+            hits += history.wasRelayer(p.relay_node, p.id, p.from) ? 1 : 0;
+        }
+    }
+    uint32_t elapsed = millis() - start;
+
+    TEST_ASSERT_EQUAL(rounds * numInFlight, hits);
+    uint32_t lookups = rounds * numInFlight;
+    LOG_INFO("PacketHistory: %u lookups with %u in-flight ids in %ums (%u lookups/s)", lookups, numInFlight, elapsed,
+             elapsed ? (uint32_t)((uint64_t)lookups * 1000 / elapsed) : lookups * 1000);
+}
+
+void setup()
+{
+    initializeTestEnvironment();
+    const std::unique_ptr<MockNodeDB> mockNodeDB(new MockNodeDB());
+    nodeDB = mockNodeDB.get();
+
+    UNITY_BEGIN();
+    RUN_TEST(test_seenAfterUpdate);
+    RUN_TEST(test_zeroIdIgnored);
+    RUN_TEST(test_senderIsPartOfKey);
+    RUN_TEST(test_relayers);
+    RUN_TEST(test_capacityBounded);
+    RUN_TEST(test_lookupBenchmark);
+    exit(UNITY_END());
+}
+
+void loop() {}
@@ -0,0 +1,229 @@
+#include "DebugConfiguration.h"
+#include "TestUtil.h"
+#include <unity.h>
+
+#include "mesh/RetransmissionQueue.h"
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+namespace
+{
+/// A few seconds before millis() wraps
+constexpr uint32_t nearRollover = 0xFFFFFFFFu - 3000;
+
+PendingPacket pendingAt(uint32_t nextTxMsec)
+{
+    PendingPacket rec;
+    rec.nextTxMsec = nextTxMsec;
+    return rec;
+}
+
+/// Pop everything due at now, returning the packet ids in the order they came out
+std::vector<PacketId> drainDue(RetransmissionQueue &q, uint32_t now)
+{
+    std::vector<PacketId> ids;
+    while (auto e = q.nextDue(now)) {
+        ids.push_back(e->first.id);
+        q.remove(e->first);
+    }
+    return ids;
+}
+
+void test_dueInDeadlineOrder()
+{
+    RetransmissionQueue q;
+    q.add(GlobalPacketId(1, 30), pendingAt(3000));
+    q.add(GlobalPacketId(1, 10), pendingAt(1000));
+    q.add(GlobalPacketId(2, 20), pendingAt(2000));
+    q.add(GlobalPacketId(2, 40), pendingAt(4000));
+
+    TEST_ASSERT_NULL(q.nextDue(999));
+    TEST_ASSERT_EQUAL_INT32(1, q.msecUntilNext(999));
+
+    std::vector<PacketId> ids = drainDue(q, 3000);
+    TEST_ASSERT_EQUAL(3, ids.size());
+    TEST_ASSERT_EQUAL_UINT32(10, ids[0]);
+    TEST_ASSERT_EQUAL_UINT32(20, ids[1]);
+    TEST_ASSERT_EQUAL_UINT32(30, ids[2]);
+    TEST_ASSERT_EQUAL_INT32(1000, q.msecUntilNext(3000));
+    TEST_ASSERT_EQUAL_INT32(0, q.msecUntilNext(5000));
+
+    TEST_ASSERT_TRUE(q.remove(GlobalPacketId(2, 40)));
+    TEST_ASSERT_TRUE(q.empty());
+    TEST_ASSERT_EQUAL_INT32(INT32_MAX, q.msecUntilNext(5000));
+}
+
+void test_findRemoveAndReschedule()
+{
+    RetransmissionQueue q;
+    for (PacketId id = 1; id <= 8; id++)
+        q.add(GlobalPacketId(7, id), pendingAt(id * 100));
+
+    TEST_ASSERT_NULL(q.find(GlobalPacketId(8, 1)));
+    TEST_ASSERT_TRUE(q.remove(GlobalPacketId(7, 4)));
+    TEST_ASSERT_FALSE(q.remove(GlobalPacketId(7, 4)));
+    TEST_ASSERT_NULL(q.find(GlobalPacketId(7, 4)));
+
+    // Move the earliest one to the back and another one to the front
+    PendingPacket *first = q.find(GlobalPacketId(7, 1));
+    TEST_ASSERT_NOT_NULL(first);
+    first->nextTxMsec = 10000;
+    q.reschedule(first);
+    PendingPacket *sixth = q.find(GlobalPacketId(7, 6));
+    sixth->nextTxMsec = 50;
+    q.reschedule(sixth);
+
+    // Adding an id again replaces the old record
+    q.add(GlobalPacketId(7, 8), pendingAt(150));
+    TEST_ASSERT_EQUAL(7, q.size());
+
+    std::vector<PacketId> ids = drainDue(q, 10000);
+    PacketId expected[] = {6, 8, 2, 3, 5, 7, 1};
+    TEST_ASSERT_EQUAL(7, ids.size());
+    TEST_ASSERT_EQUAL_UINT32_ARRAY(expected, ids.data(), 7);
+}
+
+void test_rolloverKeepsOrder()
+{
+    RetransmissionQueue q;
+    // Deadlines on both sides of the wrap, the ones after it are numerically tiny
+    q.add(GlobalPacketId(1, 3), pendingAt(nearRollover + 5000)); // wraps around to 1999
+    q.add(GlobalPacketId(1, 1), pendingAt(nearRollover + 1000));
+    q.add(GlobalPacketId(1, 4), pendingAt(nearRollover + 6000));
+    q.add(GlobalPacketId(1, 2), pendingAt(nearRollover + 2000));
+
+    uint32_t now = nearRollover;
+    TEST_ASSERT_NULL(q.nextDue(now));
+    TEST_ASSERT_EQUAL_INT32(1000, q.msecUntilNext(now));
+
+    now += 2000; // still before the wrap
+    std::vector<PacketId> ids = drainDue(q, now);
+    TEST_ASSERT_EQUAL(2, ids.size());
+    TEST_ASSERT_EQUAL_UINT32(1, ids[0]);
+    TEST_ASSERT_EQUAL_UINT32(2, ids[1]);
+
+    // A wrapped deadline must not look overdue before the wrap, nor a huge wait after it
+    TEST_ASSERT_EQUAL_INT32(3000, q.msecUntilNext(now));
+    now += 3500; // past the wrap
+    TEST_ASSERT_TRUE(now < nearRollover);
+    ids = drainDue(q, now);
+    TEST_ASSERT_EQUAL(1, ids.size());
+    TEST_ASSERT_EQUAL_UINT32(3, ids[0]);
+    TEST_ASSERT_EQUAL_INT32(500, q.msecUntilNext(now));
+}
+
+void test_delayAllSkipsOwnPacket()
+{
+    RetransmissionQueue q;
+    q.add(GlobalPacketId(1, 1), pendingAt(nearRollover + 1000));
+    q.add(GlobalPacketId(1, 2), pendingAt(nearRollover + 2000));
+    q.add(GlobalPacketId(2, 3), pendingAt(nearRollover + 3000));
+
+    // Everything but packet 3 waits another 2500ms, so 3 (now past the wrap) is first
+    PacketId except = 3;
+    q.delayAll(2500, &except);
+    TEST_ASSERT_EQUAL_UINT32(nearRollover + 3500, q.find(GlobalPacketId(1, 1))->nextTxMsec);
+    TEST_ASSERT_EQUAL_UINT32(nearRollover + 3000, q.find(GlobalPacketId(2, 3))->nextTxMsec);
+
+    std::vector<PacketId> ids = drainDue(q, nearRollover + 10000);
+    PacketId expected[] = {3, 1, 2};
+    TEST_ASSERT_EQUAL(3, ids.size());
+    TEST_ASSERT_EQUAL_UINT32_ARRAY(expected, ids.data(), 3);
+}
+
+/// Random adds, removes, reschedules and delays around the rollover, checked against a linear scan
+void test_matchesLinearScan()
+{
+    std::mt19937 rng(1234);
+    RetransmissionQueue q;
+    typedef std::pair<PacketId, uint32_t> Record; // id -> deadline, all from node 1
+    std::vector<Record> reference;
+    uint32_t now = nearRollover - 20000;
+
+    auto refFind = [&](PacketId id) {
+        return std::find_if(reference.begin(), reference.end(), [id](const Record &r) { return r.first == id; });
+    };
+
+    for (int step = 0; step < 20000; step++) {
+        PacketId id = rng() % 64;
+        switch (rng() % 5) {
+        case 0:
+        case 1: {
+            uint32_t deadline = now + rng() % 8000;
+            q.add(GlobalPacketId(1, id), pendingAt(deadline));
+            auto it = refFind(id);
+            if (it != reference.end())
+                it->second = deadline;
+            else
+                reference.push_back(std::make_pair(id, deadline));
+            break;
+        }
+        case 2: {
+            auto it = refFind(id);
+            TEST_ASSERT_EQUAL(it != reference.end(), q.remove(GlobalPacketId(1, id)));
+            if (it != reference.end())
+                reference.erase(it);
+            break;
+        }
+        case 3: {
+            PendingPacket *rec = q.find(GlobalPacketId(1, id));
+            auto it = refFind(id);
+            TEST_ASSERT_EQUAL(it != reference.end(), rec != NULL);
+            if (rec) {
+                rec->nextTxMsec = now + rng() % 8000;
+                q.reschedule(rec);
+                it->second = rec->nextTxMsec;
+            }
+            break;
+        }
+        default: {
+            uint32_t msec = rng() % 300;
+            q.delayAll(msec, &id);
+            for (auto &r : reference)
+                if (r.first != id)
+                    r.second += msec;
+            break;
+        }
+        }
+
+        now += rng() % 200;
+
+        // The reference answer: the earliest deadline, if it has come
+        auto earliest = std::min_element(reference.begin(), reference.end(), [](const Record &a, const Record &b) {
+            return (int32_t)(a.second - b.second) < 0;
+        });
+        TEST_ASSERT_EQUAL(reference.size(), q.size());
+        if (earliest == reference.end()) {
+            TEST_ASSERT_EQUAL_INT32(INT32_MAX, q.msecUntilNext(now));
+            continue;
+        }
+        int32_t wait = (int32_t)(earliest->second - now);
+        TEST_ASSERT_EQUAL_INT32(wait > 0 ? wait : 0, q.msecUntilNext(now));
+
+        RetransmissionQueue::Entry *due = q.nextDue(now);
+        TEST_ASSERT_EQUAL(wait <= 0, due != NULL);
+        if (due) {
+            TEST_ASSERT_EQUAL_UINT32(earliest->second, due->second.nextTxMsec);
+            reference.erase(refFind(due->first.id));
+            q.remove(due->first);
+        }
+    }
+}
+} // namespace
+
+void setup()
+{
+    initializeTestEnvironment();
+
+    UNITY_BEGIN();
+    RUN_TEST(test_dueInDeadlineOrder);
+    RUN_TEST(test_findRemoveAndReschedule);
+    RUN_TEST(test_rolloverKeepsOrder);
+    RUN_TEST(test_delayAllSkipsOwnPacket);
+    RUN_TEST(test_matchesLinearScan);
+    exit(UNITY_END());
+}
+
+void loop() {}
@@ -0,0 +1,149 @@
+#include "DebugConfiguration.h"
+#include "TestUtil.h"
+#include <unity.h>
+
+#include "mesh/StaticAssetManifest.h"
+
+namespace
+{
+
+void test_hashedNames()
+{
+    TEST_ASSERT_TRUE(StaticAssetManifest::isHashedName("assets/index-3f2a9c1b.js"));
+    TEST_ASSERT_TRUE(StaticAssetManifest::isHashedName("main.5b1e0f2c.css"));
+    TEST_ASSERT_TRUE(StaticAssetManifest::isHashedName("assets/vendor-B7xQz_1a.js"));
+
+    TEST_ASSERT_FALSE(StaticAssetManifest::isHashedName("index.html"));
+    TEST_ASSERT_FALSE(StaticAssetManifest::isHashedName("app-settings.js"));
+    TEST_ASSERT_FALSE(StaticAssetManifest::isHashedName("assets/logo-3f2a.svg"));
+    TEST_ASSERT_FALSE(StaticAssetManifest::isHashedName("3f2a9c1b-x/index.html"));
+    TEST_ASSERT_FALSE(StaticAssetManifest::isHashedName("README"));
+}
+
+void test_etagMatches()
+{
+    const char *etag = "\"0badc0de-1f4\"";
+    TEST_ASSERT_TRUE(StaticAssetManifest::etagMatches("\"0badc0de-1f4\"", etag));
+    TEST_ASSERT_TRUE(StaticAssetManifest::etagMatches("W/\"0badc0de-1f4\"", etag));
+    TEST_ASSERT_TRUE(StaticAssetManifest::etagMatches("\"12345678-10\", \"0badc0de-1f4\"", etag));
+    TEST_ASSERT_TRUE(StaticAssetManifest::etagMatches("*", etag));
+
+    TEST_ASSERT_FALSE(StaticAssetManifest::etagMatches(NULL, etag));
+    TEST_ASSERT_FALSE(StaticAssetManifest::etagMatches("", etag));
+    TEST_ASSERT_FALSE(StaticAssetManifest::etagMatches("\"0badc0de-1f5\"", etag));
+    TEST_ASSERT_FALSE(StaticAssetManifest::etagMatches("\"0badc0de-1f4", etag));
+    TEST_ASSERT_FALSE(StaticAssetManifest::etagMatches("0badc0de-1f4", etag));
+}
+
+void test_acceptsGzip()
+{
+    TEST_ASSERT_TRUE(StaticAssetManifest::acceptsGzip("gzip, deflate, br, zstd"));
+    TEST_ASSERT_TRUE(StaticAssetManifest::acceptsGzip("br;q=1.0, GZIP;q=0.5"));
+    TEST_ASSERT_TRUE(StaticAssetManifest::acceptsGzip("*"));
+
+    TEST_ASSERT_FALSE(StaticAssetManifest::acceptsGzip(NULL));
+    TEST_ASSERT_FALSE(StaticAssetManifest::acceptsGzip("identity"));
+    TEST_ASSERT_FALSE(StaticAssetManifest::acceptsGzip("deflate, gzip;q=0"));
+    TEST_ASSERT_FALSE(StaticAssetManifest::acceptsGzip("x-gzip, gzipped"));
+}
+
+void test_findPrefersGzip()
+{
+    StaticAssetManifest manifest;
+    TEST_ASSERT_TRUE(manifest.add("index.html", "/static/index.html", 1000, 1));
+    TEST_ASSERT_TRUE(manifest.add("index.html.gz", "/static/index.html.gz", 300, 2));
+    TEST_ASSERT_TRUE(manifest.add("assets/index-3f2a9c1b.js.gz", "/static/assets/index-3f2a9c1b.js.gz", 5000, 3));
+    manifest.setBuilt(12);
+    TEST_ASSERT_EQUAL(3, manifest.getFileCount());
+
+    StaticAsset asset;
+    TEST_ASSERT_TRUE(manifest.find("index.html", true, asset));
+    TEST_ASSERT_TRUE(asset.gzip);
+    TEST_ASSERT_EQUAL_STRING("/static/index.html.gz", asset.file.c_str());
+    TEST_ASSERT_EQUAL_UINT32(300, asset.size);
+    TEST_ASSERT_FALSE(asset.immutable);
+    TEST_ASSERT_EQUAL_STRING(STATIC_ASSET_CACHE_REVALIDATE, StaticAssetManifest::cacheControl(asset));
+
+    TEST_ASSERT_TRUE(manifest.find("index.html", false, asset));
+    TEST_ASSERT_FALSE(asset.gzip);
+    TEST_ASSERT_EQUAL_STRING("\"00000001-3e8\"", asset.etag);
+
+    // Only the .gz exists, it is sent either way like before
+    TEST_ASSERT_TRUE(manifest.find("assets/index-3f2a9c1b.js", false, asset));
+    TEST_ASSERT_TRUE(asset.gzip);
+    TEST_ASSERT_TRUE(asset.immutable);
+    TEST_ASSERT_EQUAL_STRING(STATIC_ASSET_CACHE_IMMUTABLE, StaticAssetManifest::cacheControl(asset));
+
+    // Asking for the .gz itself gets it without a Content-Encoding
+    TEST_ASSERT_TRUE(manifest.find("index.html.gz", true, asset));
+    TEST_ASSERT_FALSE(asset.gzip);
+    TEST_ASSERT_EQUAL_STRING("/static/index.html.gz", asset.file.c_str());
+
+    TEST_ASSERT_FALSE(manifest.find("missing.js", true, asset));
+
+    manifest.clear();
+    TEST_ASSERT_FALSE(manifest.isBuilt());
+    TEST_ASSERT_FALSE(manifest.find("index.html", true, asset));
+}
+
+void test_etagFollowsContent()
+{
+    StaticAssetHasher a, b;
+    a.update((const uint8_t *)"hello", 5);
+    b.update((const uint8_t *)"hel", 3);
+    b.update((const uint8_t *)"lo", 2);
+    TEST_ASSERT_EQUAL_HEX32(a.get(), b.get());
+
+    StaticAssetHasher c;
+    c.update((const uint8_t *)"hellO", 5);
+    TEST_ASSERT_NOT_EQUAL(a.get(), c.get());
+}
+
+void test_manifestFull()
+{
+    StaticAssetManifest manifest;
+    char name[16];
+    for (int i = 0; i < STATIC_ASSET_MAX_FILES; i++) {
+        snprintf(name, sizeof(name), "f%d.js", i);
+        TEST_ASSERT_TRUE(manifest.add(name, name, 1, i));
+    }
+    TEST_ASSERT_FALSE(manifest.add("one-more.js", "one-more.js", 1, 0));
+}
+
+void test_stats()
+{
+    StaticAssetManifest manifest;
+    manifest.add("a.js.gz", "/static/a.js.gz", 100, 1);
+    StaticAsset asset;
+    manifest.find("a.js", true, asset);
+    manifest.count(&asset, false, 100, 50);
+    manifest.count(&asset, true, 0, 5);
+    manifest.count(NULL, false, 20, 5);
+
+    StaticAssetStats stats = manifest.getStats();
+    TEST_ASSERT_EQUAL_UINT32(3, stats.requests);
+    TEST_ASSERT_EQUAL_UINT32(1, stats.notModified);
+    TEST_ASSERT_EQUAL_UINT32(1, stats.notFound);
+    TEST_ASSERT_EQUAL_UINT32(1, stats.gzipSent);
+    TEST_ASSERT_EQUAL_UINT32(120, (uint32_t)stats.bytesSent);
+    TEST_ASSERT_EQUAL_UINT32(60, (uint32_t)stats.sendUsec);
+}
+
+} // namespace
+
+void setup()
+{
+    initializeTestEnvironment();
+
+    UNITY_BEGIN();
+    RUN_TEST(test_hashedNames);
+    RUN_TEST(test_etagMatches);
+    RUN_TEST(test_acceptsGzip);
+    RUN_TEST(test_findPrefersGzip);
+    RUN_TEST(test_etagFollowsContent);
+    RUN_TEST(test_manifestFull);
+    RUN_TEST(test_stats);
+    exit(UNITY_END());
+}
+
+void loop() {}
@@ -0,0 +1,277 @@
+#include "DebugConfiguration.h"
+#include "TestUtil.h"
+#include <unity.h>
+
+#include "FSCommon.h"
+#include "modules/StoreForwardArchive.h"
+
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace
+{
+const char *archiveDir = "/sf_test";
+
+constexpr NodeNum nodeA = 0x0a;
+constexpr NodeNum nodeB = 0x0b;
+constexpr NodeNum nodeC = 0x0c;
+
+meshtastic_MeshPacket textPacket(NodeNum from, NodeNum to, PacketId id, const std::string &text)
+{
+    meshtastic_MeshPacket mp = meshtastic_MeshPacket_init_zero;
+    mp.from = from;
+    mp.to = to;
+    mp.id = id;
+    mp.channel = 1;
+    mp.which_payload_variant = meshtastic_MeshPacket_decoded_tag;
+    mp.decoded.portnum = meshtastic_PortNum_TEXT_MESSAGE_APP;
+    mp.decoded.payload.size = text.size();
+    memcpy(mp.decoded.payload.bytes, text.data(), text.size());
+    return mp;
+}
+
+/// Every record client would get from seq onwards, in order, as their ids
+std::vector<PacketId> replay(const StoreForwardArchive &archive, NodeNum client, uint32_t from = 0, uint32_t since = 0)
+{
+    std::vector<PacketId> ids;
+    StoreForwardArchive::Record record;
+    uint8_t payload[meshtastic_Constants_DATA_PAYLOAD_LEN];
+    for (uint32_t seq = archive.nextFor(client, from, since); seq != archive.endSeq();
+         seq = archive.nextFor(client, seq + 1, since)) {
+        TEST_ASSERT_TRUE(archive.read(seq, record, payload));
+        ids.push_back(record.id);
+    }
+    TEST_ASSERT_EQUAL(ids.size(), archive.countFor(client, from, since));
+    return ids;
+}
+
+/// The segment file written last
+std::string newestSegment()
+{
+    std::string newest;
+    for (const auto &file : getFiles(archiveDir, 0)) {
+        const char *name = strrchr(file.file_name, '/');
+        newest = std::max(newest, std::string(name ? name + 1 : file.file_name));
+    }
+    return std::string(archiveDir) + "/" + newest;
+}
+
+void test_replayForClient()
+{
+    StoreForwardArchive archive;
+    TEST_ASSERT_TRUE(archive.open(NULL, 0, 100));
+    archive.add(textPacket(nodeA, NODENUM_BROADCAST, 1, "hello all"), 100);
+    archive.add(textPacket(nodeA, nodeB, 2, "hello B"), 101);
+    archive.add(textPacket(nodeA, nodeC, 3, "hello C"), 102);
+    archive.add(textPacket(nodeB, NODENUM_BROADCAST, 4, "B here"), 103);
+    archive.add(textPacket(nodeC, nodeB, 5, "C to B"), 104);
+
+    // Broadcasts and messages to the client, but not its own
+    std::vector<PacketId> expected = {1, 2, 5};
+    TEST_ASSERT_TRUE(expected == replay(archive, nodeB));
+    TEST_ASSERT_EQUAL(3, archive.countFor(nodeB, 0, 0));
+    expected = {1, 3, 4};
+    TEST_ASSERT_TRUE(expected == replay(archive, nodeC));
+
+    // Continuing from a sequence number, or only what came after some time
+    expected = {5};
+    TEST_ASSERT_TRUE(expected == replay(archive, nodeB, 2));
+    TEST_ASSERT_EQUAL(1, archive.countFor(nodeB, 2, 0));
+    expected = {2, 5};
+    TEST_ASSERT_TRUE(expected == replay(archive, nodeB, 0, 100));
+    TEST_ASSERT_EQUAL(2, archive.countFor(nodeB, 0, 100));
+
+    StoreForwardArchive::Record record;
+    uint8_t payload[meshtastic_Constants_DATA_PAYLOAD_LEN];
+    TEST_ASSERT_TRUE(archive.read(1, record, payload));
+    TEST_ASSERT_EQUAL(nodeA, record.from);
+    TEST_ASSERT_EQUAL(nodeB, record.to);
+    TEST_ASSERT_EQUAL(101, record.time);
+    TEST_ASSERT_EQUAL(1, record.channel);
+    TEST_ASSERT_EQUAL(7, record.payloadSize);
+    TEST_ASSERT_EQUAL_MEMORY("hello B", payload, 7);
+    TEST_ASSERT_FALSE(archive.read(5, record, payload));
+}
+
+void test_timeNeverGoesBack()
+{
+    StoreForwardArchive archive;
+    TEST_ASSERT_TRUE(archive.open(NULL, 0, 100));
+    archive.add(textPacket(nodeA, NODENUM_BROADCAST, 1, "one"), 200);
+    archive.add(textPacket(nodeA, NODENUM_BROADCAST, 2, "two"), 150); // the clock stepped back
+
+    StoreForwardArchive::Record record;
+    uint8_t payload[meshtastic_Constants_DATA_PAYLOAD_LEN];
+    TEST_ASSERT_TRUE(archive.read(1, record, payload));
+    TEST_ASSERT_EQUAL(200, record.time);
+    TEST_ASSERT_EQUAL(2, archive.countFor(nodeB, 0, 199));
+    TEST_ASSERT_EQUAL(0, archive.countFor(nodeB, 0, 200));
+}
+
+void test_expireFreesSegments()
+{
+    StoreForwardArchive archive;
+    TEST_ASSERT_TRUE(archive.open(NULL, 64 * SF_ARCHIVE_SEGMENT_BYTES, 100000));
+    const std::string text(200, 'x');
+    const uint32_t count = 4 * SF_ARCHIVE_SEGMENT_BYTES / 200;
+    for (uint32_t i = 0; i < count; i++)
+        TEST_ASSERT_TRUE(archive.add(textPacket(nodeA, NODENUM_BROADCAST, i + 1, text), 1000 + i));
+    TEST_ASSERT_EQUAL(count, archive.size());
+    const uint32_t bytes = archive.bytesUsed();
+
+    // Half of it expires, whole segments of it are given back
+    archive.expire(1000 + count / 2);
+    TEST_ASSERT_EQUAL(count / 2, archive.firstSeq());
+    TEST_ASSERT_EQUAL(count - count / 2, archive.size());
+    TEST_ASSERT_LESS_THAN(bytes - SF_ARCHIVE_SEGMENT_BYTES, archive.bytesUsed());
+    TEST_ASSERT_EQUAL(count - count / 2, archive.countFor(nodeB, 0, 0));
+
+    archive.expire(UINT32_MAX);
+    TEST_ASSERT_EQUAL(0, archive.size());
+    TEST_ASSERT_EQUAL(count, archive.firstSeq());
+    TEST_ASSERT_EQUAL(archive.endSeq(), archive.nextFor(nodeB, 0, 0));
+    TEST_ASSERT_TRUE(archive.add(textPacket(nodeA, nodeB, 1, "after"), 5000));
+    TEST_ASSERT_EQUAL(1, archive.countFor(nodeB, 0, 0));
+}
+
+void test_fullDropsOldest()
+{
+    // Room for two segments
+    StoreForwardArchive archive;
+    TEST_ASSERT_TRUE(archive.open(NULL, 2 * SF_ARCHIVE_SEGMENT_BYTES, 100000));
+    const std::string text(100, 'y');
+    for (uint32_t i = 0; i < 1000; i++)
+        TEST_ASSERT_TRUE(archive.add(textPacket(nodeA, i % 2 ? nodeB : NODENUM_BROADCAST, i + 1, text), 1000 + i));
+    TEST_ASSERT_LESS_OR_EQUAL(2 * SF_ARCHIVE_SEGMENT_BYTES, archive.bytesUsed());
+    TEST_ASSERT_GREATER_THAN(SF_ARCHIVE_SEGMENT_BYTES / 128, archive.size());
+    TEST_ASSERT_EQUAL(1000, archive.endSeq());
+
+    // The newest records are all still there
+    std::vector<PacketId> ids = replay(archive, nodeB);
+    TEST_ASSERT_EQUAL(archive.size(), ids.size());
+    TEST_ASSERT_EQUAL(1000, ids.back());
+
+    // And the record limit holds too
+    TEST_ASSERT_TRUE(archive.open(NULL, 2 * SF_ARCHIVE_SEGMENT_BYTES, 10));
+    for (uint32_t i = 0; i < 25; i++)
+        archive.add(textPacket(nodeA, nodeC, i + 1, text), 1000 + i);
+    TEST_ASSERT_EQUAL(10, archive.size());
+    TEST_ASSERT_EQUAL(15, archive.firstSeq());
+}
+
+void test_persistentResume()
+{
+    rmDir(archiveDir);
+    {
+        StoreForwardArchive archive;
+        TEST_ASSERT_TRUE(archive.open(archiveDir, 8 * SF_ARCHIVE_SEGMENT_BYTES, 100000));
+        TEST_ASSERT_EQUAL(0, archive.size());
+        const std::string text(150, 'z');
+        for (uint32_t i = 0; i < 300; i++)
+            TEST_ASSERT_TRUE(archive.add(textPacket(nodeA, i % 3 ? NODENUM_BROADCAST : nodeB, i + 1, text), 1000 + i));
+        archive.add(textPacket(nodeC, nodeB, 301, "last one"), 2000);
+    }
+
+    StoreForwardArchive archive;
+    TEST_ASSERT_TRUE(archive.open(archiveDir, 8 * SF_ARCHIVE_SEGMENT_BYTES, 100000));
+    TEST_ASSERT_EQUAL(301, archive.size());
+    std::vector<PacketId> ids = replay(archive, nodeB);
+    TEST_ASSERT_EQUAL(301, ids.size());
+
+    StoreForwardArchive::Record record;
+    uint8_t payload[meshtastic_Constants_DATA_PAYLOAD_LEN];
+    TEST_ASSERT_TRUE(archive.read(300, record, payload));
+    TEST_ASSERT_EQUAL(nodeC, record.from);
+    TEST_ASSERT_EQUAL(2000, record.time);
+    TEST_ASSERT_EQUAL(8, record.payloadSize);
+    TEST_ASSERT_EQUAL_MEMORY("last one", payload, 8);
+
+    // Appends carry on after a restart
+    TEST_ASSERT_TRUE(archive.add(textPacket(nodeA, nodeB, 302, "resumed"), 2001));
+    archive.close();
+
+    // A record torn by a power loss is ignored, new ones go to a fresh segment
+    TEST_ASSERT_GREATER_THAN(1, getFiles(archiveDir, 0).size());
+    File f = FSCom.open(newestSegment().c_str(), "a");
+    TEST_ASSERT_TRUE(f);
+    f.write((const uint8_t *)"\x5F\x00\x01\xff torn", 9);
+    f.close();
+
+    TEST_ASSERT_TRUE(archive.open(archiveDir, 8 * SF_ARCHIVE_SEGMENT_BYTES, 100000));
+    TEST_ASSERT_EQUAL(302, archive.size());
+    TEST_ASSERT_TRUE(archive.add(textPacket(nodeA, nodeB, 303, "after the tear"), 2002));
+    archive.close();
+    TEST_ASSERT_TRUE(archive.open(archiveDir, 8 * SF_ARCHIVE_SEGMENT_BYTES, 100000));
+    TEST_ASSERT_EQUAL(303, archive.size());
+    TEST_ASSERT_TRUE(archive.read(302, record, payload));
+    TEST_ASSERT_EQUAL(303, record.id);
+
+    // Expired segment files are deleted
+    archive.expire(UINT32_MAX);
+    TEST_ASSERT_EQUAL(0, archive.size());
+    TEST_ASSERT_EQUAL(0, getFiles(archiveDir, 0).size());
+    archive.close();
+    rmDir(archiveDir);
+}
+
+void test_matchesLinearScan()
+{
+    struct Stored {
+        uint32_t seq;
+        NodeNum from;
+        NodeNum to;
+        uint32_t time;
+    };
+    std::vector<Stored> reference;
+    const NodeNum nodes[] = {nodeA, nodeB, nodeC, NODENUM_BROADCAST};
+
+    StoreForwardArchive archive;
+    TEST_ASSERT_TRUE(archive.open(NULL, 4 * SF_ARCHIVE_SEGMENT_BYTES, 500));
+    std::mt19937 rng(14);
+    uint32_t now = 1000;
+    for (uint32_t seq = 0; seq < 5000; seq++) {
+        now += rng() % 5;
+        NodeNum from = nodes[rng() % 3];
+        NodeNum to = nodes[rng() % 4];
+        TEST_ASSERT_TRUE(archive.add(textPacket(from, to, seq + 1, std::string(rng() % 200, 'r')), now));
+        reference.push_back({seq, from, to, now});
+        if (rng() % 50 == 0)
+            archive.expire(now - 200);
+
+        if (seq % 97 == 0) {
+            NodeNum client = nodes[rng() % 3];
+            uint32_t start = seq - std::min<uint32_t>(seq, rng() % 400);
+            uint32_t since = now - rng() % 300;
+            uint32_t count = 0, next = archive.endSeq();
+            for (const auto &s : reference) {
+                if (s.seq >= archive.firstSeq() && s.seq >= start && s.time > since && s.from != client &&
+                    (s.to == NODENUM_BROADCAST || s.to == client)) {
+                    if (!count)
+                        next = s.seq;
+                    count++;
+                }
+            }
+            TEST_ASSERT_EQUAL(count, archive.countFor(client, start, since));
+            TEST_ASSERT_EQUAL(next, archive.nextFor(client, start, since));
+        }
+    }
+}
+} // namespace
+
+void setup()
+{
+    initializeTestEnvironment();
+
+    UNITY_BEGIN();
+    RUN_TEST(test_replayForClient);
+    RUN_TEST(test_timeNeverGoesBack);
+    RUN_TEST(test_expireFreesSegments);
+    RUN_TEST(test_fullDropsOldest);
+    RUN_TEST(test_persistentResume);
+    RUN_TEST(test_matchesLinearScan);
+    exit(UNITY_END());
+}
+
+void loop() {}
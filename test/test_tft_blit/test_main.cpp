@@ -0,0 +1,232 @@
+#include "DebugConfiguration.h"
+#include "TestUtil.h"
+#include <unity.h>
+
+#include "graphics/TFTBlitter.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+namespace
+{
+
+const uint16_t WIDTH = 320;
+const uint16_t HEIGHT = 240;
+const size_t BUFFER_SIZE = WIDTH * HEIGHT / 8;
+
+// SPI cost of the usual MIPI DCS panels: CASET and RASET with 4 bytes each, then RAMWR, then 2 bytes per pixel
+const uint32_t WINDOW_BYTES = 11;
+const uint32_t PIXEL_BYTES = 2;
+
+/// Stands in for the TFT driver, keeps the panel contents and counts what would go over SPI
+class MockTFT
+{
+  public:
+    std::vector<uint8_t> pixels = std::vector<uint8_t>(WIDTH * HEIGHT);
+    uint32_t windows = 0;
+    uint32_t runs = 0;
+    uint32_t bytes = 0;
+    uint16_t x = 0, y = 0, left = 0;
+
+    void beginSpan(uint16_t _x, uint16_t _y, uint16_t len)
+    {
+        TEST_ASSERT_EQUAL(0, left);
+        TEST_ASSERT_TRUE(_x + len <= WIDTH);
+        x = _x;
+        y = _y;
+        left = len;
+        windows++;
+        bytes += WINDOW_BYTES;
+    }
+
+    void pushRun(bool on, uint16_t count)
+    {
+        TEST_ASSERT_TRUE(count <= left);
+        for (uint16_t i = 0; i < count; i++)
+            pixels[y * WIDTH + x++] = on;
+        left -= count;
+        runs++;
+        bytes += count * PIXEL_BYTES;
+    }
+
+    void endSpan() { TEST_ASSERT_EQUAL(0, left); }
+
+    void resetCounts() { windows = runs = bytes = 0; }
+};
+
+bool getPixel(const uint8_t *buffer, uint16_t x, uint16_t y)
+{
+    return buffer[x + (y / 8) * WIDTH] & (1 << (y & 7));
+}
+
+void setPixel(uint8_t *buffer, uint16_t x, uint16_t y, bool on)
+{
+    if (on)
+        buffer[x + (y / 8) * WIDTH] |= 1 << (y & 7);
+    else
+        buffer[x + (y / 8) * WIDTH] &= ~(1 << (y & 7));
+}
+
+/// Something like a screen of text: rows of glyph sized blobs with gaps between them
+void drawText(uint8_t *buffer, uint32_t seed)
+{
+    for (uint16_t line = 0; line + 12 <= HEIGHT; line += 13) {
+        for (uint16_t col = 0; col + 6 <= WIDTH; col += 7) {
+            seed = seed * 1103515245 + 12345;
+            if ((seed >> 16) % 5 == 0)
+                continue; // space
+            for (uint16_t gy = 0; gy < 10; gy++)
+                for (uint16_t gx = 0; gx < 5; gx++)
+                    setPixel(buffer, col + gx, line + gy, (seed >> (gx + gy)) & 1);
+        }
+    }
+}
+
+/// Count the per pixel drawPixel() calls the old display() made
+uint32_t countChangedPixels(const uint8_t *buffer, const uint8_t *back)
+{
+    uint32_t changed = 0;
+    for (uint16_t y = 0; y < HEIGHT; y++)
+        for (uint16_t x = 0; x < WIDTH; x++)
+            changed += getPixel(buffer, x, y) != (back ? getPixel(back, x, y) : false);
+    return changed;
+}
+
+void assertPanelShows(const MockTFT &tft, const uint8_t *buffer)
+{
+    for (uint16_t y = 0; y < HEIGHT; y++)
+        for (uint16_t x = 0; x < WIDTH; x++)
+            TEST_ASSERT_EQUAL_MESSAGE(getPixel(buffer, x, y), tft.pixels[y * WIDTH + x], "panel differs from the frame");
+}
+
+void test_unchangedFrameSendsNothing()
+{
+    uint8_t buffer[BUFFER_SIZE] = {}, back[BUFFER_SIZE] = {};
+    drawText(buffer, 1);
+    memcpy(back, buffer, BUFFER_SIZE);
+
+    MockTFT tft;
+    TFTBlitter::blit(buffer, back, WIDTH, HEIGHT, tft);
+    TEST_ASSERT_EQUAL_UINT32(0, tft.windows);
+}
+
+void test_singlePixel()
+{
+    uint8_t buffer[BUFFER_SIZE] = {}, back[BUFFER_SIZE] = {};
+    setPixel(buffer, WIDTH - 1, 13, true);
+
+    MockTFT tft;
+    TFTBlitter::blit(buffer, back, WIDTH, HEIGHT, tft);
+    TEST_ASSERT_EQUAL_UINT32(1, tft.windows);
+    TEST_ASSERT_EQUAL_UINT32(1, tft.runs);
+    TEST_ASSERT_TRUE(tft.pixels[13 * WIDTH + WIDTH - 1]);
+}
+
+void test_columnsAtWordEdges()
+{
+    uint16_t first, last;
+    uint8_t cur[10] = {}, old[10] = {};
+    TEST_ASSERT_FALSE(TFTBlitter::findChangedColumns(cur, old, 10, first, last));
+
+    cur[3] = 1;
+    cur[4] = 1;
+    TEST_ASSERT_TRUE(TFTBlitter::findChangedColumns(cur, old, 10, first, last));
+    TEST_ASSERT_EQUAL(3, first);
+    TEST_ASSERT_EQUAL(4, last);
+
+    cur[9] = 0x80; // in the tail that isn't a whole word
+    TEST_ASSERT_TRUE(TFTBlitter::findChangedColumns(cur, old, 10, first, last));
+    TEST_ASSERT_EQUAL(9, last);
+
+    memset(cur, 0, sizeof(cur));
+    cur[8] = 1;
+    TEST_ASSERT_TRUE(TFTBlitter::findChangedColumns(cur, old, 10, first, last));
+    TEST_ASSERT_EQUAL(8, first);
+    TEST_ASSERT_EQUAL(8, last);
+    // Without a back buffer only set pixels count
+    TEST_ASSERT_TRUE(TFTBlitter::findChangedColumns(cur, NULL, 10, first, last));
+    TEST_ASSERT_EQUAL(8, first);
+}
+
+void test_gapsSplitSpans()
+{
+    uint8_t buffer[BUFFER_SIZE] = {}, back[BUFFER_SIZE] = {};
+    setPixel(buffer, 10, 0, true);
+    setPixel(buffer, 14, 0, true); // 3 unchanged pixels between, bridged
+    setPixel(buffer, 30, 0, true); // too far, a new span
+
+    MockTFT tft;
+    TFTBlitter::blit(buffer, back, WIDTH, HEIGHT, tft, 3);
+    TEST_ASSERT_EQUAL_UINT32(2, tft.windows);
+    TEST_ASSERT_EQUAL_UINT32(4, tft.runs); // on, off, on then on
+    assertPanelShows(tft, buffer);
+}
+
+void test_framesReplayOntoPanel()
+{
+    static uint8_t frames[4][BUFFER_SIZE];
+    memset(frames, 0, sizeof(frames));
+    for (uint32_t i = 0; i < 4; i++)
+        drawText(frames[i], i + 7);
+
+    MockTFT tft;
+    TFTBlitter::blit(frames[0], NULL, WIDTH, HEIGHT, tft);
+    assertPanelShows(tft, frames[0]);
+    for (uint32_t i = 1; i < 4; i++) {
+        TFTBlitter::blit(frames[i], frames[i - 1], WIDTH, HEIGHT, tft);
+        assertPanelShows(tft, frames[i]);
+    }
+}
+
+/// Not a pass/fail test as such, prints what a frame costs on SPI compared to drawing every changed pixel on its own
+void test_benchmarkFullScreenChange()
+{
+    static uint8_t buffer[BUFFER_SIZE], back[BUFFER_SIZE];
+    memset(buffer, 0, sizeof(buffer));
+    memset(back, 0, sizeof(back));
+    drawText(back, 3);
+    drawText(buffer, 4);
+
+    MockTFT tft;
+    TFTBlitter::blit(back, NULL, WIDTH, HEIGHT, tft);
+    tft.resetCounts();
+    TFTBlitter::blit(buffer, back, WIDTH, HEIGHT, tft);
+    assertPanelShows(tft, buffer);
+    uint32_t changed = countChangedPixels(buffer, back);
+    uint32_t naiveBytes = changed * (WINDOW_BYTES + PIXEL_BYTES);
+
+    char msg[160];
+    snprintf(msg, sizeof(msg), "%ux%u text change: %u changed pixels, per pixel %u transactions/%u bytes, spans %u/%u bytes",
+             WIDTH, HEIGHT, changed, changed, naiveBytes, tft.windows, tft.bytes);
+    TEST_MESSAGE(msg);
+    TEST_ASSERT_TRUE(tft.windows * 4 < changed);
+    TEST_ASSERT_TRUE(tft.bytes * 2 < naiveBytes);
+
+    // Drawing a screen from blank only sends the set pixels
+    tft.resetCounts();
+    TFTBlitter::blit(buffer, NULL, WIDTH, HEIGHT, tft);
+    changed = countChangedPixels(buffer, NULL);
+    snprintf(msg, sizeof(msg), "%ux%u from blank: %u set pixels, per pixel %u bytes, spans %u/%u bytes", WIDTH, HEIGHT, changed,
+             changed * (WINDOW_BYTES + PIXEL_BYTES), tft.windows, tft.bytes);
+    TEST_MESSAGE(msg);
+    TEST_ASSERT_TRUE(tft.bytes < changed * (WINDOW_BYTES + PIXEL_BYTES));
+}
+
+} // namespace
+
+void setup()
+{
+    initializeTestEnvironment();
+
+    UNITY_BEGIN();
+    RUN_TEST(test_unchangedFrameSendsNothing);
+    RUN_TEST(test_singlePixel);
+    RUN_TEST(test_columnsAtWordEdges);
+    RUN_TEST(test_gapsSplitSpans);
+    RUN_TEST(test_framesReplayOntoPanel);
+    RUN_TEST(test_benchmarkFullScreenChange);
+    exit(UNITY_END());
+}
+
+void loop() {}